@@ -0,0 +1,80 @@
+/*
+ * Copyright (c) 2025 John Mears
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "amplitude.h"
+#include "colourmap.h"
+
+#include <cstddef>
+
+int amplitude_render(const float *input, int num_windows, int fft_window_size, int first_x,
+                     uint16_t colour, uint16_t *pixels, uint32_t height,
+                     uint32_t index_stride) {
+    const float *pWindowData = input;
+    int windowIndex = 0;
+
+    const float range_min = -0x7FFF;
+    const float range_max = 0x7FFF;
+    const float range_delta = range_max - range_min;
+    const size_t maxOffset = height * index_stride - 1;
+    const float scaling = (float) height / range_delta;
+
+    // For each window:
+    int x = first_x;
+    for (windowIndex = 0; windowIndex < num_windows; windowIndex++, pWindowData += fft_window_size) {
+        const float *pValue = pWindowData;
+        // Initialize based on the first point in the window:
+        float min = *pValue++, max = min;
+        // Work out the range of values in the window:
+        for (int i = 1; i < fft_window_size; i++, pValue++) {
+            float v = *pValue;
+            if (v < min)
+                min = v;
+            if (v > max)
+                max = v;
+        }
+
+        // Scale those values into the height of the bitmap:
+        int y_min = (int) ((min - range_min) * scaling);
+        int y_max = (int) ((max - range_min) * scaling);
+
+        size_t offset = xy_to_bitmap_offset(x, height - 1, (int) height, index_stride);
+        x += 1;
+
+        // We need to draw the black as well as the colour so that we overwrite
+        // previous amplitudes.
+
+        const uint16_t black = 0;
+        uint16_t pixel = black;
+        for (int y = height; y > 0; y--) {
+            if (y == y_max)
+                pixel = colour;
+            if (y + 1 == y_min)
+                pixel = black;
+            // Paranoia:
+            if (offset <= maxOffset)
+                pixels[offset] = pixel;
+            offset += index_stride;
+        }
+    }
+
+    return windowIndex;
+}
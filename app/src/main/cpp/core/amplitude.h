@@ -0,0 +1,47 @@
+/*
+ * Copyright (c) 2025 John Mears
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef BATGIZMO_AMPLITUDE_H
+#define BATGIZMO_AMPLITUDE_H
+
+#include <cstdint>
+
+/**
+ * Rendering of the amplitude graph shown alongside the spectrogram: one column per FFT
+ * window, showing the range of raw values in the window.
+ *
+ * This is plain C++ with no JNI or Android dependencies.
+ */
+
+/**
+ * Draw num_windows columns starting at column first_x of an RGB565 image of the height
+ * supplied, whose rows are index_stride pixels apart. Each window is fft_window_size
+ * consecutive values of input. Pixels outside the range of values in a window are drawn
+ * black, so that previous amplitudes are overwritten.
+ *
+ * Returns the number of windows drawn.
+ */
+int amplitude_render(const float *input, int num_windows, int fft_window_size, int first_x,
+                     uint16_t colour, uint16_t *pixels, uint32_t height,
+                     uint32_t index_stride);
+
+#endif //BATGIZMO_AMPLITUDE_H
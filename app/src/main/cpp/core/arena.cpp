@@ -0,0 +1,210 @@
+/*
+ * Copyright (c) 2025 John Mears
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "arena.h"
+
+#include <cstdlib>
+#include <mutex>
+#include <vector>
+
+struct arena_block {
+    void *data;
+    size_t size;
+    size_t capacity;
+    size_t high_water;
+};
+
+// A block given up by its slot, which stale buffers may still point into:
+struct arena_retired {
+    void *data;
+    size_t capacity;
+};
+
+struct arena {
+    std::mutex mutex;
+    size_t budget;
+    size_t high_water;
+    arena_block blocks[ARENA_SLOT_COUNT];
+    std::vector<arena_retired> retired;
+};
+
+static const char *s_slot_names[ARENA_SLOT_COUNT] = {
+        "raw",
+        "transformed",
+        "slice",
+        "fft_scratch"
+};
+
+static size_t total_capacity(const arena *a) {
+    size_t total = 0;
+    for (const arena_block &block: a->blocks)
+        total += block.capacity;
+    return total;
+}
+
+static size_t total_in_use(const arena *a) {
+    size_t total = 0;
+    for (const arena_block &block: a->blocks)
+        total += block.size;
+    return total;
+}
+
+static size_t total_retired(const arena *a) {
+    size_t total = 0;
+    for (const arena_retired &retired: a->retired)
+        total += retired.capacity;
+    return total;
+}
+
+/**
+ * Take the slot's memory away from it, keeping it allocated until arena_free_retired. The
+ * caller holds the mutex.
+ */
+static void retire_block(arena *a, arena_block *block) {
+    if (block->data != nullptr)
+        a->retired.push_back({block->data, block->capacity});
+    block->data = nullptr;
+    block->capacity = 0;
+}
+
+static void free_retired(arena *a) {
+    for (const arena_retired &retired: a->retired)
+        free(retired.data);
+    a->retired.clear();
+}
+
+/**
+ * Retire the blocks of released slots, other than the one supplied, until the capacity of
+ * the slots is within the limit, or there are no more to retire. The caller holds the mutex.
+ */
+static void trim_to(arena *a, size_t limit, const arena_block *keep = nullptr) {
+    for (arena_block &block: a->blocks) {
+        if (total_capacity(a) <= limit)
+            return;
+        if (block.size == 0 && &block != keep)
+            retire_block(a, &block);
+    }
+}
+
+arena *arena_create(size_t budget) {
+    auto *a = new(std::nothrow) arena();
+    if (a != nullptr)
+        a->budget = budget;
+    return a;
+}
+
+void arena_destroy(arena *a) {
+    if (a == nullptr)
+        return;
+    for (arena_block &block: a->blocks)
+        retire_block(a, &block);
+    free_retired(a);
+    delete a;
+}
+
+arena *arena_shared() {
+    // Never destroyed: the buffers are reused for as long as the process lasts.
+    static arena *s_shared = arena_create(ARENA_DEFAULT_BUDGET);
+    return s_shared;
+}
+
+void arena_set_budget(arena *a, size_t budget) {
+    std::lock_guard<std::mutex> lock(a->mutex);
+    a->budget = budget;
+    trim_to(a, budget);
+}
+
+void *arena_acquire(arena *a, int slot, size_t size) {
+    if (a == nullptr || slot < 0 || slot >= ARENA_SLOT_COUNT || size == 0)
+        return nullptr;
+
+    std::lock_guard<std::mutex> lock(a->mutex);
+    arena_block *block = &a->blocks[slot];
+
+    if (size > block->capacity) {
+        // Round up so that anything following the block in a bigger one is aligned too:
+        const size_t capacity = (size + ARENA_ALIGNMENT - 1) / ARENA_ALIGNMENT * ARENA_ALIGNMENT;
+
+        // Released blocks give way to the new one, but they are only freed with the other
+        // retired blocks. This block is retired too, so everything allocated counts:
+        if (capacity > a->budget)
+            return nullptr;
+        trim_to(a, a->budget - capacity + block->capacity, block);
+        if (total_capacity(a) + total_retired(a) > a->budget - capacity)
+            return nullptr;
+
+        void *data = nullptr;
+        if (posix_memalign(&data, ARENA_ALIGNMENT, capacity) != 0)
+            return nullptr;
+
+        // Buffers over the old block may still be held, so it is only freed with the retired:
+        retire_block(a, block);
+        block->data = data;
+        block->capacity = capacity;
+    }
+
+    block->size = size;
+    if (size > block->high_water)
+        block->high_water = size;
+    const size_t in_use = total_in_use(a);
+    if (in_use > a->high_water)
+        a->high_water = in_use;
+    return block->data;
+}
+
+void arena_release(arena *a, int slot) {
+    if (a == nullptr || slot < 0 || slot >= ARENA_SLOT_COUNT)
+        return;
+    std::lock_guard<std::mutex> lock(a->mutex);
+    a->blocks[slot].size = 0;
+}
+
+void arena_free_retired(arena *a) {
+    if (a == nullptr)
+        return;
+    std::lock_guard<std::mutex> lock(a->mutex);
+    free_retired(a);
+}
+
+void arena_trim(arena *a) {
+    std::lock_guard<std::mutex> lock(a->mutex);
+    trim_to(a, 0);
+    free_retired(a);
+}
+
+void arena_get_stats(arena *a, arena_stats *stats) {
+    std::lock_guard<std::mutex> lock(a->mutex);
+    stats->budget = a->budget;
+    stats->retired = total_retired(a);
+    stats->capacity = total_capacity(a) + stats->retired;
+    stats->in_use = total_in_use(a);
+    stats->high_water = a->high_water;
+    for (int slot = 0; slot < ARENA_SLOT_COUNT; slot++) {
+        stats->slots[slot].size = a->blocks[slot].size;
+        stats->slots[slot].capacity = a->blocks[slot].capacity;
+        stats->slots[slot].high_water = a->blocks[slot].high_water;
+    }
+}
+
+const char *arena_slot_name(int slot) {
+    return slot >= 0 && slot < ARENA_SLOT_COUNT ? s_slot_names[slot] : "unknown";
+}
@@ -0,0 +1,132 @@
+/*
+ * Copyright (c) 2025 John Mears
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef BATGIZMO_ARENA_H
+#define BATGIZMO_ARENA_H
+
+#include <cstddef>
+
+/**
+ * A memory arena for the large pipeline buffers, so that reconfiguring the pipeline, on
+ * every zoom, reuses the memory it already has rather than freeing it and allocating again.
+ *
+ * Each buffer has its own slot. Acquiring a slot returns its existing block if that is big
+ * enough, so the block's capacity only ever grows, up to the budget for the arena as a
+ * whole. Releasing a slot keeps its capacity for next time; the capacity of released
+ * slots is only given back if the budget requires it or arena_trim is called.
+ *
+ * Memory is never freed while a pipeline may still hold a buffer over it. A block that a
+ * slot outgrows, or that the budget takes back, is retired: it stays allocated, and counted
+ * against the budget, until arena_free_retired or arena_trim, so a stale buffer reads stale
+ * data rather than freed memory.
+ *
+ * Blocks are aligned to ARENA_ALIGNMENT bytes, a cache line, which also suits any SIMD
+ * loads. Their contents are not initialized.
+ *
+ * The functions are thread safe. A block's contents are only meaningful until its slot is
+ * next acquired or released, as a bigger block may replace it.
+ *
+ * This is plain C++ with no JNI or Android dependencies.
+ */
+
+#define ARENA_ALIGNMENT 64
+
+// The budget for the shared arena until arena_set_budget is called:
+#define ARENA_DEFAULT_BUDGET ((size_t) 256 << 20)
+
+// The slot numbers are also used by NativeArena.kt:
+enum arena_slot {
+    ARENA_SLOT_RAW,             // Raw samples for the current page.
+    ARENA_SLOT_TRANSFORMED,     // Transformed data for the current page.
+    ARENA_SLOT_SLICE,           // Unwrapped windows for a slice, input to the FFT.
+    ARENA_SLOT_FFT_SCRATCH,     // Complex FFT output for a batch of windows per thread.
+    ARENA_SLOT_COUNT
+};
+
+struct arena_slot_stats {
+    size_t size;        // As last acquired, or 0 if released.
+    size_t capacity;    // Allocated, including any not in use.
+    size_t high_water;  // The largest size acquired.
+};
+
+struct arena_stats {
+    size_t budget;
+    size_t capacity;    // Total allocated, including retired blocks.
+    size_t retired;     // Allocated in blocks waiting for arena_free_retired.
+    size_t in_use;      // Total acquired and not released.
+    size_t high_water;  // The largest in_use has been.
+    arena_slot_stats slots[ARENA_SLOT_COUNT];
+};
+
+struct arena;
+
+/**
+ * Create an arena which will allocate no more than budget bytes. Returns null on failure.
+ */
+arena *arena_create(size_t budget);
+
+/**
+ * Free the arena and all its blocks.
+ */
+void arena_destroy(arena *a);
+
+/**
+ * The arena shared by the whole process, for the app's pipeline, created on first use.
+ */
+arena *arena_shared();
+
+/**
+ * Change the budget. The capacity of released slots is retired if the arena is over the new
+ * budget, but blocks in use are kept until they are next acquired.
+ */
+void arena_set_budget(arena *a, size_t budget);
+
+/**
+ * Get a block of at least size bytes for the slot, reusing its existing block if that is
+ * big enough. Returns null if the block would take the arena over budget, or on failure,
+ * in which case the slot keeps its existing block. Released slots give way to a block that
+ * doesn't fit, but as their memory is retired, that only makes room once it is freed.
+ */
+void *arena_acquire(arena *a, int slot, size_t size);
+
+/**
+ * Mark the slot as not in use. Its block is kept for reuse.
+ */
+void arena_release(arena *a, int slot);
+
+/**
+ * Free the retired blocks, keeping those of all slots. Only call this when no buffer from
+ * the arena is in use other than those of slots, released or not.
+ */
+void arena_free_retired(arena *a);
+
+/**
+ * Free the blocks of all released slots, and all retired blocks. Only call this when no
+ * buffer from the arena is in use other than those of slots still acquired.
+ */
+void arena_trim(arena *a);
+
+void arena_get_stats(arena *a, arena_stats *stats);
+
+const char *arena_slot_name(int slot);
+
+#endif //BATGIZMO_ARENA_H
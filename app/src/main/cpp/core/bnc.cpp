@@ -0,0 +1,115 @@
+/*
+ * Copyright (c) 2025 John Mears
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "bnc.h"
+#include "workpool.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+// Regions smaller than this are searched on the calling thread:
+#define BNC_MIN_PARALLEL_VALUES (256 * 1024)
+
+/**
+ * Find the range of values in the time indexes x_min..x_max inclusive, and the reflected
+ * frequency indexes y1..y2 inclusive, which must not be empty.
+ */
+static void find_range(int x_min, int x_max, int y1, int y2, int frequency_buckets,
+                       const float *transformed_data, float *min_db, float *max_db) {
+    float minDB = transformed_data[(size_t) x_min * frequency_buckets + y1];
+    float maxDB = minDB;
+
+    // Loop through the range
+    for (int timeIndex = x_min; timeIndex <= x_max; ++timeIndex) {
+        const float *column = transformed_data + (size_t) timeIndex * frequency_buckets;
+        for (int frequencyIndex = y1; frequencyIndex <= y2; frequencyIndex++) {
+            float dB = column[frequencyIndex];
+            if (dB < minDB)
+                minDB = dB;
+            if (dB > maxDB)
+                maxDB = dB;
+        }
+    }
+
+    *min_db = minDB;
+    *max_db = maxDB;
+}
+
+bool bnc_find_range(int x_min, int x_max, int y_min, int y_max, int frequency_buckets,
+                    const float *transformed_data, float *min_db, float *max_db) {
+
+    if (x_min == x_max || y_min == y_max)
+        return false;     // No data available.
+
+    // Reflect the Y indices:
+    const int y1 = frequency_buckets - y_max - 1;
+    const int y2 = frequency_buckets - y_min - 1;
+    if (x_min > x_max || y1 > y2)
+        return false;
+
+    // Large regions, such as a whole page, are split into tiles of whole columns on the
+    // work pool, and the results combined:
+    const int columns = x_max - x_min + 1;
+    const int64_t values = (int64_t) columns * (y2 - y1 + 1);
+    const int tiles = std::min<int64_t>({columns, values / BNC_MIN_PARALLEL_VALUES,
+                                         work_pool_workers(work_pool_shared()) + 1});
+    if (tiles <= 1) {
+        find_range(x_min, x_max, y1, y2, frequency_buckets, transformed_data, min_db, max_db);
+        return true;
+    }
+
+    std::vector<float> tile_min(tiles), tile_max(tiles);
+    work_pool_parallel_for(work_pool_shared(), work_current_priority(), tiles, [&](int t) {
+        const int first = x_min + (int) ((int64_t) columns * t / tiles);
+        const int last = x_min + (int) ((int64_t) columns * (t + 1) / tiles) - 1;
+        find_range(first, last, y1, y2, frequency_buckets, transformed_data,
+                   &tile_min[t], &tile_max[t]);
+    });
+
+    *min_db = *std::min_element(tile_min.begin(), tile_min.end());
+    *max_db = *std::max_element(tile_max.begin(), tile_max.end());
+    return true;
+}
+
+void bnc_auto_range(float data_min_db, float data_max_db, float *low_db, float *high_db) {
+    /*
+     * Subjectively, it's nice if the bottom part of the data dB range is black, as it is noise
+     * and nothing of interest. For now we use a fixed percentage of the range.
+     */
+    const float lower = std::max(BNC_DB_RANGE_MIN, data_min_db);
+    const float diff = data_max_db - lower;
+    const float blackRange = diff * 0.25f;
+
+    // The app stores BnC as a logical range, which clamps it to the supported dB range:
+    *low_db = std::clamp(lower + blackRange, BNC_DB_RANGE_MIN, BNC_DB_RANGE_MAX);
+    *high_db = std::clamp(data_max_db, BNC_DB_RANGE_MIN, BNC_DB_RANGE_MAX);
+}
+
+void bnc_offset_multiplier(float low_db, float high_db, int colour_map_size,
+                           float *offset, float *multiplier) {
+    // We need the dB range to map to colour map indices. Avoid dividing by zero for
+    // featureless data:
+    const float span = high_db > low_db ? high_db - low_db : 1.0f;
+    *offset = low_db;
+    *multiplier = static_cast<float>(colour_map_size) / span;
+}
@@ -0,0 +1,60 @@
+/*
+ * Copyright (c) 2025 John Mears
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef BATGIZMO_BNC_H
+#define BATGIZMO_BNC_H
+
+/**
+ * Brightness and contrast (BnC) calculations on transformed dB data.
+ *
+ * This is plain C++ with no JNI or Android dependencies.
+ */
+
+// The dB range supported by BnC, as ColourMapStep.dbRangeMax:
+#define BNC_DB_RANGE_MIN (-30.0f)
+#define BNC_DB_RANGE_MAX 100.0f
+
+/**
+ * Find the minimum and maximum dB values in the region of transformed data supplied.
+ * The time (x) and frequency (y) index ranges are inclusive. The frequency indexes are
+ * reflected, as they are in the displayed image.
+ *
+ * Returns false if the region is empty.
+ */
+bool bnc_find_range(int x_min, int x_max, int y_min, int y_max, int frequency_buckets,
+                    const float *transformed_data, float *min_db, float *max_db);
+
+/**
+ * Choose a dB range for display given the range of the data, as
+ * AbstractPipeline.calculateAutoBnC does: the bottom part of the range is noise, so is
+ * mapped to black.
+ */
+void bnc_auto_range(float data_min_db, float data_max_db, float *low_db, float *high_db);
+
+/**
+ * Convert a dB range to the offset and multiplier used by colour_map_apply, as
+ * ColourMapStep.calculateRange does.
+ */
+void bnc_offset_multiplier(float low_db, float high_db, int colour_map_size,
+                           float *offset, float *multiplier);
+
+#endif //BATGIZMO_BNC_H
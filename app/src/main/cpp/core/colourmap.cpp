@@ -0,0 +1,170 @@
+/*
+ * Copyright (c) 2025 John Mears
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "colourmap.h"
+#include "kernels.h"
+#include "telemetry.h"
+#include "workpool.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+// Below these sizes, colour mapping is done on the calling thread:
+#define COLOUR_MAP_MIN_STRIPE_COLUMNS 32
+#define COLOUR_MAP_MIN_STRIPE_ROWS 32
+#define COLOUR_MAP_MIN_PARALLEL_PIXELS (256 * 1024)
+
+size_t xy_to_bitmap_offset(int x, int y, int max_y, uint32_t index_stride) {
+    uint32_t row_start = (max_y - y - 1) * index_stride;
+    uint32_t pixel_index = row_start + x;
+    return pixel_index;
+}
+
+void colour_map_apply(const float *transformed_data, int first, int second,
+                      int frequency_bucket_count, const uint16_t *colour_map,
+                      int colour_map_size, float offset, float multiplier,
+                      uint16_t *pixels, uint32_t index_stride) {
+    telemetry_scope scope(TELEMETRY_COLOUR_MAP);
+    const kernel_table *k = kernels();
+
+    // Columns are independent, so large ranges such as a full render are mapped in vertical
+    // stripes on the work pool. A live slice is too small to be worth splitting:
+    const int columns = second - first;
+    const int stripes = std::min(columns / COLOUR_MAP_MIN_STRIPE_COLUMNS,
+                                 work_pool_workers(work_pool_shared()) + 1);
+    if (stripes <= 1 || (int64_t) columns * frequency_bucket_count < COLOUR_MAP_MIN_PARALLEL_PIXELS) {
+        k->colour_map(transformed_data, first, second, frequency_bucket_count, colour_map,
+                      colour_map_size, offset, multiplier, pixels, index_stride);
+        return;
+    }
+
+    work_pool_parallel_for(work_pool_shared(), work_current_priority(), stripes, [&](int s) {
+        const int stripe_first = first + (int) ((int64_t) columns * s / stripes);
+        const int stripe_second = first + (int) ((int64_t) columns * (s + 1) / stripes);
+        k->colour_map(transformed_data, stripe_first, stripe_second, frequency_bucket_count,
+                      colour_map, colour_map_size, offset, multiplier, pixels, index_stride);
+    });
+}
+
+void colour_map_pool_table(int frequency_bucket_count, int rows, int *row_first) {
+    for (int r = 0; r <= rows; r++)
+        row_first[r] = (int) ((int64_t) frequency_bucket_count * r / rows);
+}
+
+void colour_map_apply_pooled(const float *transformed_data, int first, int second,
+                             int frequency_bucket_count, const int *row_first, int rows,
+                             const uint16_t *colour_map, int colour_map_size, float offset,
+                             float multiplier, uint16_t *pixels, uint32_t index_stride) {
+    telemetry_scope scope(TELEMETRY_COLOUR_MAP);
+    const kernel_table *k = kernels();
+
+    // Striped over the work pool as colour_map_apply, by the data read rather than written:
+    const int columns = second - first;
+    const int stripes = std::min(columns / COLOUR_MAP_MIN_STRIPE_COLUMNS,
+                                 work_pool_workers(work_pool_shared()) + 1);
+    if (stripes <= 1 || (int64_t) columns * frequency_bucket_count < COLOUR_MAP_MIN_PARALLEL_PIXELS) {
+        k->colour_map_pooled(transformed_data, first, second, frequency_bucket_count, row_first,
+                             rows, colour_map, colour_map_size, offset, multiplier, pixels,
+                             index_stride);
+        return;
+    }
+
+    work_pool_parallel_for(work_pool_shared(), work_current_priority(), stripes, [&](int s) {
+        const int stripe_first = first + (int) ((int64_t) columns * s / stripes);
+        const int stripe_second = first + (int) ((int64_t) columns * (s + 1) / stripes);
+        k->colour_map_pooled(transformed_data, stripe_first, stripe_second,
+                             frequency_bucket_count, row_first, rows, colour_map,
+                             colour_map_size, offset, multiplier, pixels, index_stride);
+    });
+}
+
+void colour_map_shift_columns(uint16_t *pixels, int width, int height, uint32_t index_stride,
+                              int columns) {
+    const int kept = width - abs(columns);
+    if (columns == 0 || kept <= 0)
+        return;
+
+    const int from = columns > 0 ? columns : 0;
+    const int to = columns > 0 ? 0 : -columns;
+    for (int y = 0; y < height; y++) {
+        uint16_t *row = pixels + (size_t) y * index_stride;
+        memmove(row + to, row + from, kept * sizeof(uint16_t));
+    }
+}
+
+void colour_map_scale_tiles(const uint16_t *const *tiles, const uint32_t *tile_strides,
+                            int tile_columns, int width, int height,
+                            float x_first, float x_last, float y_first, float y_last,
+                            int ring_head, int ring_columns,
+                            uint16_t *output, int output_width, int output_height,
+                            uint32_t output_stride) {
+    if (output_width <= 0 || output_height <= 0)
+        return;
+
+    // The source column of each output column, or -1 for none:
+    std::vector<int> columns(output_width);
+    const float x_scale = (x_last - x_first) / output_width;
+    for (int x = 0; x < output_width; x++) {
+        int column = (int) floorf(x_first + (x + 0.5f) * x_scale);
+        if (ring_head >= 0 && ring_columns > 0 && column >= 0 && column < ring_columns)
+            column = (column + ring_head) % ring_columns;
+        columns[x] = column >= 0 && column < width ? column : -1;
+    }
+
+    const float y_scale = (y_last - y_first) / output_height;
+    auto scale_rows = [&](int first, int second) {
+        for (int y = first; y < second; y++) {
+            uint16_t *out = output + (size_t) y * output_stride;
+            const int row = (int) floorf(y_first + (y + 0.5f) * y_scale);
+            if (row < 0 || row >= height) {
+                memset(out, 0, output_width * sizeof(uint16_t));
+                continue;
+            }
+            for (int x = 0; x < output_width; x++) {
+                const int column = columns[x];
+                if (column < 0) {
+                    out[x] = 0;
+                } else {
+                    const int tile = column / tile_columns;
+                    out[x] = tiles[tile][(size_t) row * tile_strides[tile] + column - tile * tile_columns];
+                }
+            }
+        }
+    };
+
+    // Output rows are independent, so a screen sized output is scaled in horizontal stripes
+    // on the work pool:
+    const int stripes = std::min(output_height / COLOUR_MAP_MIN_STRIPE_ROWS,
+                                 work_pool_workers(work_pool_shared()) + 1);
+    if (stripes <= 1 || (int64_t) output_width * output_height < COLOUR_MAP_MIN_PARALLEL_PIXELS) {
+        scale_rows(0, output_height);
+        return;
+    }
+
+    work_pool_parallel_for(work_pool_shared(), work_current_priority(), stripes, [&](int s) {
+        scale_rows((int) ((int64_t) output_height * s / stripes),
+                   (int) ((int64_t) output_height * (s + 1) / stripes));
+    });
+}
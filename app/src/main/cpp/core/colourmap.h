@@ -0,0 +1,116 @@
+/*
+ * Copyright (c) 2025 John Mears
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef BATGIZMO_COLOURMAP_H
+#define BATGIZMO_COLOURMAP_H
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * Colour mapping of transformed dB values into an RGB565 image, as done by the colour
+ * map pipeline step, plus some pixel format helpers.
+ *
+ * This is plain C++ with no JNI or Android dependencies.
+ */
+
+/**
+ * Map an (x, y) coordinate to the pixel index in an image whose rows are index_stride pixels
+ * apart. y is reflected so that y = 0 is the bottom row, as frequency axes are drawn.
+ */
+size_t xy_to_bitmap_offset(int x, int y, int max_y, uint32_t index_stride);
+
+/**
+ * Colour map transformed time buckets in the half open range first..second into pixels.
+ * The transformed data is laid out as consecutive blocks of frequency_bucket_count values
+ * per time bucket. Each time bucket becomes a column, each frequency bucket a row.
+ *
+ * The dB value is mapped to a colour map index by (value - offset) * multiplier, clamped to
+ * the colour map.
+ */
+void colour_map_apply(const float *transformed_data, int first, int second,
+                      int frequency_bucket_count, const uint16_t *colour_map,
+                      int colour_map_size, float offset, float multiplier,
+                      uint16_t *pixels, uint32_t index_stride);
+
+/**
+ * Fill row_first, of rows + 1 entries, so that image row r pools the frequency buckets
+ * row_first[r] until row_first[r + 1], spreading frequency_bucket_count buckets evenly over
+ * rows rows. rows must be between 1 and frequency_bucket_count.
+ */
+void colour_map_pool_table(int frequency_bucket_count, int rows, int *row_first);
+
+/**
+ * As colour_map_apply, but into an image of only rows rows, for when there are more frequency
+ * buckets than screen pixels. Each row takes the maximum of its frequency buckets from
+ * row_first, as made by colour_map_pool_table, so that a narrow peak survives the reduction.
+ * Row 0 is the bottom row.
+ */
+void colour_map_apply_pooled(const float *transformed_data, int first, int second,
+                             int frequency_bucket_count, const int *row_first, int rows,
+                             const uint16_t *colour_map, int colour_map_size, float offset,
+                             float multiplier, uint16_t *pixels, uint32_t index_stride);
+
+/**
+ * Move the pixels of each row of a width x height image left by columns, or right if columns
+ * is negative, as when the transformed data behind it moves by that many time buckets. The
+ * columns uncovered keep their old pixels, ready to be drawn again.
+ */
+void colour_map_shift_columns(uint16_t *pixels, int width, int height, uint32_t index_stride,
+                              int columns);
+
+/**
+ * Scale part of an RGB565 image of width x height into an output image, nearest neighbour,
+ * as a canvas draws the source rectangle x_first..x_last, y_first..y_last, in fractional
+ * pixels, to the whole of the output. The image is held as tiles of tile_columns columns,
+ * tile t starting at column t * tile_columns, with rows tile_strides[t] pixels apart.
+ *
+ * If ring_head is not negative, the first ring_columns columns of the image are a ring whose
+ * oldest column is ring_head, and the source rectangle is in time order. Output pixels that
+ * fall outside the image are black.
+ */
+void colour_map_scale_tiles(const uint16_t *const *tiles, const uint32_t *tile_strides,
+                            int tile_columns, int width, int height,
+                            float x_first, float x_last, float y_first, float y_last,
+                            int ring_head, int ring_columns,
+                            uint16_t *output, int output_width, int output_height,
+                            uint32_t output_stride);
+
+// The same conversion as UIModel.rgbToRGB565.
+static inline uint16_t colour_map_rgb_to_rgb565(int red, int green, int blue) {
+    const int r5 = (red >> 3) & 0x1F;
+    const int g6 = (green >> 2) & 0x3F;
+    const int b5 = (blue >> 3) & 0x1F;
+    return static_cast<uint16_t>((r5 << 11) | (g6 << 5) | b5);
+}
+
+// Expand an RGB565 pixel to 8 bits per channel, replicating the high bits into the low ones.
+static inline void colour_map_rgb565_to_rgb(uint16_t pixel, uint8_t *rgb) {
+    const int r5 = (pixel >> 11) & 0x1F;
+    const int g6 = (pixel >> 5) & 0x3F;
+    const int b5 = pixel & 0x1F;
+    rgb[0] = static_cast<uint8_t>((r5 << 3) | (r5 >> 2));
+    rgb[1] = static_cast<uint8_t>((g6 << 2) | (g6 >> 4));
+    rgb[2] = static_cast<uint8_t>((b5 << 3) | (b5 >> 2));
+}
+
+#endif //BATGIZMO_COLOURMAP_H
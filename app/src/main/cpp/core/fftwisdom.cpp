@@ -0,0 +1,193 @@
+/*
+ * Copyright (c) 2025 John Mears
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "fftwisdom.h"
+
+#include "synthsource.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+
+#define FFT_WISDOM_HEADER "batgizmo-fft-wisdom"
+#define AUTOTUNE_SAMPLE_RATE 384000
+#define AUTOTUNE_MIN_REPEATS 3
+
+int fft_wisdom_load(const char *path, const std::string &fingerprint, fft_wisdom *wisdom) {
+    wisdom->fingerprint = fingerprint;
+    wisdom->entries.clear();
+
+    FILE *f = fopen(path, "r");
+    if (f == nullptr)
+        return -1;
+
+    char line[512];
+    int version = 0;
+    bool ok = fgets(line, sizeof(line), f) != nullptr
+              && sscanf(line, FFT_WISDOM_HEADER " %d", &version) == 1
+              && version == FFT_WISDOM_VERSION
+              && fgets(line, sizeof(line), f) != nullptr
+              && strncmp(line, "fingerprint ", 12) == 0;
+    if (ok) {
+        std::string file_fingerprint(line + 12);
+        while (!file_fingerprint.empty() && (file_fingerprint.back() == '\n' || file_fingerprint.back() == '\r'))
+            file_fingerprint.pop_back();
+        ok = file_fingerprint == fingerprint;
+    }
+
+    std::vector<fft_wisdom_entry> entries;
+    while (ok && fgets(line, sizeof(line), f) != nullptr) {
+        fft_wisdom_entry entry;
+        if (sscanf(line, "%d %d %d %d %lf", &entry.fft_window_size, &entry.fft_stride,
+                   &entry.plan.batch_windows, &entry.plan.threads, &entry.ns_per_window) != 5) {
+            ok = false;
+            break;
+        }
+        entries.push_back(entry);
+    }
+    fclose(f);
+
+    if (!ok)
+        return -1;
+    wisdom->entries = entries;
+    return 0;
+}
+
+int fft_wisdom_save(const char *path, const fft_wisdom *wisdom) {
+    // Write a temporary file and rename it, so that a partial file is never seen:
+    const std::string temp_path = std::string(path) + ".tmp";
+    FILE *f = fopen(temp_path.c_str(), "w");
+    if (f == nullptr)
+        return -1;
+
+    bool ok = fprintf(f, FFT_WISDOM_HEADER " %d\nfingerprint %s\n", FFT_WISDOM_VERSION,
+                      wisdom->fingerprint.c_str()) > 0;
+    for (const auto &entry: wisdom->entries) {
+        ok = ok && fprintf(f, "%d %d %d %d %.1f\n", entry.fft_window_size, entry.fft_stride,
+                           entry.plan.batch_windows, entry.plan.threads, entry.ns_per_window) > 0;
+    }
+    ok = (fclose(f) == 0) && ok;
+
+    if (!ok || rename(temp_path.c_str(), path) != 0) {
+        remove(temp_path.c_str());
+        return -1;
+    }
+    return 0;
+}
+
+const fft_wisdom_entry *fft_wisdom_find(const fft_wisdom *wisdom, int fft_window_size,
+                                        int fft_stride) {
+    for (const auto &entry: wisdom->entries) {
+        if (entry.fft_window_size == fft_window_size && entry.fft_stride == fft_stride)
+            return &entry;
+    }
+    return nullptr;
+}
+
+void fft_wisdom_set(fft_wisdom *wisdom, const fft_wisdom_entry &entry) {
+    for (auto &existing: wisdom->entries) {
+        if (existing.fft_window_size == entry.fft_window_size && existing.fft_stride == entry.fft_stride) {
+            existing = entry;
+            return;
+        }
+    }
+    wisdom->entries.push_back(entry);
+}
+
+std::vector<transform_plan> fft_autotune_candidates(int max_threads) {
+    std::vector<transform_plan> candidates;
+    for (int threads = 1; threads <= std::min(max_threads, TRANSFORM_MAX_THREADS); threads *= 2) {
+        for (int batch_windows: {1, 8, 32}) {
+            transform_plan plan;
+            plan.batch_windows = batch_windows;
+            plan.threads = threads;
+            candidates.push_back(plan);
+        }
+    }
+    return candidates;
+}
+
+int fft_autotune(int fft_window_size, int fft_stride, int num_windows, int max_threads,
+                 double budget_ms, fft_wisdom_entry *best,
+                 std::vector<fft_wisdom_entry> *results) {
+    typedef std::chrono::steady_clock clock;
+
+    if (num_windows < 1 || fft_stride < 1)
+        return -1;
+
+    transform_state state;
+    if (transform_init(&state, fft_window_size) != 0)
+        return -1;
+
+    // One slice of realistic data, unwrapped as the pipeline does:
+    const int raw_entries = (num_windows - 1) * fft_stride + fft_window_size;
+    std::vector<int16_t> raw(raw_entries);
+    synth_source_config config = {AUTOTUNE_SAMPLE_RATE, 50.0f, 5.0f, 0.002f, 1};
+    synth_source_state source;
+    synth_source_init(&source, &config);
+    synth_source_generate(&source, raw.data(), raw_entries);
+    std::vector<float> window(fft_window_size);
+    transform_hann_window(window.data(), fft_window_size);
+    std::vector<float> input((size_t) num_windows * fft_window_size);
+    transform_unwrap_slices(raw.data(), raw_entries, 0, num_windows, fft_stride, window.data(),
+                            fft_window_size, input.data());
+    std::vector<float> output((size_t) num_windows * state.frequency_buckets);
+
+    const std::vector<transform_plan> candidates = fft_autotune_candidates(max_threads);
+    const auto per_candidate = std::chrono::duration<double, std::milli>(budget_ms / candidates.size());
+
+    int rc = -1;
+    best->ns_per_window = 0.0;
+    for (const auto &plan: candidates) {
+        if (transform_set_plan(&state, &plan) != 0)
+            continue;
+
+        // Take the fastest of several runs, which is the least disturbed by other activity:
+        double fastest_ns = 0.0;
+        const auto start = clock::now();
+        for (int repeat = 0; repeat < AUTOTUNE_MIN_REPEATS || clock::now() - start < per_candidate; repeat++) {
+            bool triggered = false;
+            const auto run_start = clock::now();
+            transform_fft(&state, num_windows, input.data(), output.data(), -30.0f, 0, 0,
+                          1000.0f, &triggered);
+            const double ns = std::chrono::duration<double, std::nano>(clock::now() - run_start).count();
+            if (repeat == 0 || ns < fastest_ns)
+                fastest_ns = ns;
+        }
+
+        fft_wisdom_entry entry;
+        entry.fft_window_size = fft_window_size;
+        entry.fft_stride = fft_stride;
+        entry.plan = plan;
+        entry.ns_per_window = fastest_ns / num_windows;
+        if (results != nullptr)
+            results->push_back(entry);
+        if (rc != 0 || entry.ns_per_window < best->ns_per_window) {
+            *best = entry;
+            rc = 0;
+        }
+    }
+
+    transform_cleanup(&state);
+    return rc;
+}
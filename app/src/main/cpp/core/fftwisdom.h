@@ -0,0 +1,102 @@
+/*
+ * Copyright (c) 2025 John Mears
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef BATGIZMO_FFTWISDOM_H
+#define BATGIZMO_FFTWISDOM_H
+
+#include <string>
+#include <vector>
+
+#include "transform.h"
+
+/**
+ * Per device choice of transform plan ("wisdom"). The fastest plan depends on the CPU, cache
+ * sizes and core count, so rather than guess, candidate plans are timed on the device for each
+ * FFT window size and stride in use, and the winners are saved to a file so that tuning only
+ * happens once.
+ *
+ * The file is text: a version line, a fingerprint line identifying the device and software
+ * that the timings apply to, and one line per tuned case:
+ *
+ *   batgizmo-fft-wisdom 1
+ *   fingerprint <text>
+ *   <fft window size> <fft stride> <batch windows> <threads> <ns per window>
+ *
+ * A file with a different fingerprint is ignored, so that tuning is redone after an update.
+ *
+ * This is plain C++ with no JNI or Android dependencies.
+ */
+
+#define FFT_WISDOM_VERSION 1
+
+struct fft_wisdom_entry {
+    int fft_window_size;
+    int fft_stride;
+    transform_plan plan;
+    double ns_per_window;
+};
+
+struct fft_wisdom {
+    std::string fingerprint;
+    std::vector<fft_wisdom_entry> entries;
+};
+
+/**
+ * Load wisdom from path, replacing what is in *wisdom, which is given the fingerprint
+ * supplied in any case. Returns 0 on success, or -1 if the file is missing, unreadable or has
+ * a different fingerprint, in which case *wisdom is left empty.
+ */
+int fft_wisdom_load(const char *path, const std::string &fingerprint, fft_wisdom *wisdom);
+
+/**
+ * Save wisdom to path, replacing the file atomically. Returns 0 on success or -1 on failure.
+ */
+int fft_wisdom_save(const char *path, const fft_wisdom *wisdom);
+
+/**
+ * Return the entry for the case supplied, or null if it hasn't been tuned.
+ */
+const fft_wisdom_entry *fft_wisdom_find(const fft_wisdom *wisdom, int fft_window_size,
+                                        int fft_stride);
+
+/**
+ * Add an entry, replacing any existing one for the same case.
+ */
+void fft_wisdom_set(fft_wisdom *wisdom, const fft_wisdom_entry &entry);
+
+/**
+ * The candidate plans worth timing given the number of threads available.
+ */
+std::vector<transform_plan> fft_autotune_candidates(int max_threads);
+
+/**
+ * Time each candidate plan transforming num_windows windows of synthetic bat-like data, as
+ * one slice of the pipeline would, sharing about budget_ms between them. The fastest goes in
+ * *best. If results is not null, it receives the timing of every candidate.
+ *
+ * Returns 0 on success or -1 if no plan could be timed.
+ */
+int fft_autotune(int fft_window_size, int fft_stride, int num_windows, int max_threads,
+                 double budget_ms, fft_wisdom_entry *best,
+                 std::vector<fft_wisdom_entry> *results);
+
+#endif //BATGIZMO_FFTWISDOM_H
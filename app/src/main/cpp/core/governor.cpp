@@ -0,0 +1,102 @@
+/*
+ * Copyright (c) 2025 John Mears
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "governor.h"
+
+// Weight of each new measurement in the smoothed load:
+#define GOVERNOR_LOAD_SMOOTHING 0.2f
+
+governor_config governor_default_config(int levels) {
+    governor_config config;
+    config.levels = levels;
+    config.high_load = 0.85f;
+    config.target_load = 0.6f;
+    config.backlog_limit = 2;
+    config.down_after_ns = 500000000LL;
+    config.up_after_ns = 5000000000LL;
+    config.settle_ns = 2000000000LL;
+    return config;
+}
+
+int governor_init(governor_state *state, const governor_config *config) {
+    if (config->levels < 1 || config->high_load <= 0 || config->target_load <= 0
+        || config->target_load >= config->high_load || config->backlog_limit < 0
+        || config->down_after_ns < 0 || config->up_after_ns < 0 || config->settle_ns < 0)
+        return -1;
+
+    state->config = *config;
+    state->level = 0;
+    state->load = -1;
+    state->overload_ns = 0;
+    state->headroom_ns = 0;
+    state->settle_remaining_ns = 0;
+    return 0;
+}
+
+static void change_level(governor_state *state, int level) {
+    state->level = level;
+    state->load = -1;
+    state->overload_ns = 0;
+    state->headroom_ns = 0;
+    state->settle_remaining_ns = state->config.settle_ns;
+}
+
+int governor_update(governor_state *state, int64_t processing_ns, int64_t data_ns, int backlog,
+                    int dropped, float up_cost_ratio) {
+    const governor_config *config = &state->config;
+    if (data_ns <= 0)
+        return state->level;
+
+    // Let the pipeline settle after a change, as the first slices are atypical:
+    if (state->settle_remaining_ns > 0) {
+        state->settle_remaining_ns -= data_ns;
+        return state->level;
+    }
+
+    const float load = (float) processing_ns / (float) data_ns;
+    state->load = state->load < 0 ? load
+                                  : state->load + GOVERNOR_LOAD_SMOOTHING * (load - state->load);
+
+    // Dropped buffers are already visible, so act on them at once:
+    if (dropped > 0 && state->level < config->levels - 1) {
+        change_level(state, state->level + 1);
+        return state->level;
+    }
+
+    if (state->load > config->high_load || backlog > config->backlog_limit) {
+        state->overload_ns += data_ns;
+        state->headroom_ns = 0;
+        if (state->overload_ns >= config->down_after_ns && state->level < config->levels - 1)
+            change_level(state, state->level + 1);
+    } else if (state->level > 0 && backlog == 0 && dropped == 0
+               && state->load * (up_cost_ratio < 1 ? 1 : up_cost_ratio) < config->target_load) {
+        state->headroom_ns += data_ns;
+        state->overload_ns = 0;
+        if (state->headroom_ns >= config->up_after_ns)
+            change_level(state, state->level - 1);
+    } else {
+        state->overload_ns = 0;
+        state->headroom_ns = 0;
+    }
+
+    return state->level;
+}
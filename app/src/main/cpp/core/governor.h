@@ -0,0 +1,84 @@
+/*
+ * Copyright (c) 2025 John Mears
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef BATGIZMO_GOVERNOR_H
+#define BATGIZMO_GOVERNOR_H
+
+#include <cstdint>
+
+/**
+ * Adaptive quality governor for the live pipeline. When processing can't keep up with the
+ * incoming data, buffers are dropped and the display stutters, so instead step the quality
+ * down to a level that can be sustained, and back up when there is headroom.
+ *
+ * Level 0 is full quality, and higher levels are progressively cheaper. The caller decides
+ * what each level means, and tells the governor how much more the next level up would cost.
+ *
+ * Decisions are based on the load, which is the smoothed ratio of processing time to the
+ * real time duration of the data processed, together with the backlog of buffers waiting and
+ * any that have been dropped. Hysteresis comes from requiring a condition to persist before
+ * acting on it, from only stepping up if the predicted load is comfortably low, and from
+ * ignoring a settling period after each change while the pipeline is rebuilt.
+ *
+ * This is plain C++ with no JNI or Android dependencies.
+ */
+
+struct governor_config {
+    int levels;                 // The number of quality levels, at least 1.
+    float high_load;            // Step down when the load stays above this.
+    float target_load;          // Step up when the predicted load stays below this.
+    int backlog_limit;          // Step down when more buffers than this stay waiting.
+    int64_t down_after_ns;      // How long an overload must last, in data time.
+    int64_t up_after_ns;        // How long headroom must last, in data time.
+    int64_t settle_ns;          // Data time to ignore after a change.
+};
+
+struct governor_state {
+    governor_config config;
+    int level;
+    float load;                 // Smoothed, or negative before the first measurement.
+    int64_t overload_ns;        // Data time the overload condition has held.
+    int64_t headroom_ns;        // Data time the headroom condition has held.
+    int64_t settle_remaining_ns;
+};
+
+/**
+ * Defaults suitable for the live pipeline.
+ */
+governor_config governor_default_config(int levels);
+
+/**
+ * Initialise at full quality. Returns 0, or -1 if the config is invalid.
+ */
+int governor_init(governor_state *state, const governor_config *config);
+
+/**
+ * Account for one slice: processing_ns to process data lasting data_ns in real time, with
+ * backlog buffers waiting and dropped buffers dropped since the last call. up_cost_ratio is
+ * the estimated cost of the next level up relative to the current one, 1 or more.
+ *
+ * Returns the level to use from now on.
+ */
+int governor_update(governor_state *state, int64_t processing_ns, int64_t data_ns, int backlog,
+                    int dropped, float up_cost_ratio);
+
+#endif //BATGIZMO_GOVERNOR_H
@@ -0,0 +1,75 @@
+/*
+ * Copyright (c) 2025 John Mears
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "heterodyne.h"
+#include "kernels.h"
+
+#include <cmath>
+#include <cstring>
+
+int32_t heterodyne_iir_coefficient(double cutoff_hz, double sample_rate_hz) {
+    double exponent = -2.0 * M_PI * cutoff_hz / sample_rate_hz;
+    double a = 1.0 - exp(exponent);
+    return (int32_t) lround(a * (1LL << 31));
+}
+
+void heterodyne_filter_reset(heterodyne_state *state) {
+    memset(state->previous, 0, sizeof(state->previous));
+}
+
+int heterodyne_start(heterodyne_state *state, int reference_len, int heterodyne1_kHz,
+                     int heterodyne2_kHz, int audio_boost_shift) {
+    int n = reference_len;
+    if (n > HETERODYNE_MAX_REFERENCE_LEN)      // Paranoia.
+        n = HETERODYNE_MAX_REFERENCE_LEN;
+
+    if (n <= 0 || heterodyne1_kHz > n || heterodyne2_kHz > n)
+        return -1;
+
+    // Don't recalculate this unnecessarily:
+    if (n != state->reference_len) {
+        /*
+         * Set up the correct number of heterodyne data points in a single
+         * cycle of a cosine. Having the same number of points as the sampling rate
+         * makes it easy to generated references for multiples of kHz.
+         */
+        const double pi2 = 3.1415927 * 2;
+        int i = 0;
+        for (i = 0; i < n; i++) {
+            double x = ((double) i) * pi2 / n;
+            state->reference_data[i] = cos(x) * 0x7FFE;
+        }
+        state->reference_data[i] = HETERODYNE_CANARY_VALUE;
+        state->reference_len = n;
+    }
+    state->heterodyne1_kHz = heterodyne1_kHz;
+    state->heterodyne2_kHz = heterodyne2_kHz;
+    state->audio_boost_shift = audio_boost_shift;
+    state->reference1_index = state->reference2_index = 0;
+
+    return 0;
+}
+
+int heterodyne_process(heterodyne_state *state, const int16_t *input, uint32_t sample_count,
+                       int16_t *output) {
+    return kernels()->heterodyne(state, input, sample_count, output);
+}
@@ -0,0 +1,88 @@
+/*
+ * Copyright (c) 2025 John Mears
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef BATGIZMO_HETERODYNE_H
+#define BATGIZMO_HETERODYNE_H
+
+#include <cstdint>
+
+/**
+ * Heterodyne audio output for live data: the raw data is mixed with one or two reference
+ * frequencies, low pass filtered and decimated to an audio output rate.
+ *
+ * This is plain C++ with no JNI or Android dependencies.
+ */
+
+// Any array to hold the heterodyne reference signal. One point per sample in a ms, so this
+// allows for up to 768 kHz, the highest rate the synthetic source generates:
+#define HETERODYNE_MAX_REFERENCE_LEN 768
+
+// Adjust this so that there is no heterodyned audio output visible over
+// about 10 kHz:
+#define HETERODYNE_AA_CUTOFF_HZ 3000      // Conservative (low) value to minimize bleed through/feedback.
+#define HETERODYNE_AA_STAGES 4            // Order of the LPF
+
+#define HETERODYNE_CANARY_VALUE ((int16_t) 0xFACE)
+
+struct heterodyne_state {
+    // One cycle of a cosine, plus a canary:
+    int16_t reference_data[HETERODYNE_MAX_REFERENCE_LEN + 1];
+    int reference_len;
+    int reference1_index, reference2_index;
+    int heterodyne1_kHz, heterodyne2_kHz;
+    int audio_boost_shift;
+    int decimation_factor;              // Constrained to be an integer.
+    int32_t iir_coefficient;            // Fixed point, 1 << 31 is 1.0.
+    int32_t previous[HETERODYNE_AA_STAGES];
+};
+
+/**
+ * Calculate the fixed point coefficient of a single pole IIR low pass filter.
+ */
+int32_t heterodyne_iir_coefficient(double cutoff_hz, double sample_rate_hz);
+
+/**
+ * Reset the anti aliasing filter history.
+ */
+void heterodyne_filter_reset(heterodyne_state *state);
+
+/**
+ * Prepare to heterodyne with reference_len points per cycle of the reference, which is
+ * the number of samples per ms so that each kHz of reference frequency is one step through
+ * it. The reference frequencies must not exceed reference_len kHz.
+ *
+ * Returns 0 on success, or -1 if the arguments are out of range.
+ */
+int heterodyne_start(heterodyne_state *state, int reference_len, int heterodyne1_kHz,
+                     int heterodyne2_kHz, int audio_boost_shift);
+
+/**
+ * Heterodyne sample_count mono samples from input into output, which must have space for
+ * sample_count / decimation_factor samples. The reference phase carries over from one call
+ * to the next, so that changing the frequency doesn't cause a step.
+ *
+ * Returns the number of samples written to output.
+ */
+int heterodyne_process(heterodyne_state *state, const int16_t *input, uint32_t sample_count,
+                       int16_t *output);
+
+#endif //BATGIZMO_HETERODYNE_H
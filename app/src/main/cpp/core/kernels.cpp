@@ -0,0 +1,112 @@
+/*
+ * Copyright (c) 2025 John Mears
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "kernels.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
+
+#if defined(__aarch64__) && defined(__linux__)
+#include <sys/auxv.h>
+#ifndef HWCAP_ASIMDHP
+#define HWCAP_ASIMDHP (1 << 10)
+#endif
+#ifndef HWCAP_ASIMDDP
+#define HWCAP_ASIMDDP (1 << 20)
+#endif
+#ifndef HWCAP_SVE
+#define HWCAP_SVE (1 << 22)
+#endif
+#endif
+
+// One table per variant, each defined in its own kernels_*.cpp:
+extern const kernel_table s_kernels_reference;
+extern const kernel_table s_kernels_baseline;
+#ifdef BATGIZMO_KERNELS_AVX2
+extern const kernel_table s_kernels_avx2;
+#endif
+#ifdef BATGIZMO_KERNELS_ARMV82
+extern const kernel_table s_kernels_armv82;
+#endif
+#ifdef BATGIZMO_KERNELS_SVE
+extern const kernel_table s_kernels_sve;
+#endif
+
+static std::atomic<const kernel_table *> s_kernels{nullptr};
+
+std::vector<const kernel_table *> kernels_supported() {
+    std::vector<const kernel_table *> result;
+
+#if defined(__aarch64__) && defined(__linux__)
+    const unsigned long hwcap = getauxval(AT_HWCAP);
+#ifdef BATGIZMO_KERNELS_SVE
+    if ((hwcap & HWCAP_SVE) && (hwcap & HWCAP_ASIMDHP) && (hwcap & HWCAP_ASIMDDP))
+        result.push_back(&s_kernels_sve);
+#endif
+#ifdef BATGIZMO_KERNELS_ARMV82
+    if ((hwcap & HWCAP_ASIMDHP) && (hwcap & HWCAP_ASIMDDP))
+        result.push_back(&s_kernels_armv82);
+#endif
+    (void) hwcap;
+#endif
+
+#if defined(BATGIZMO_KERNELS_AVX2) && defined(__x86_64__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+        result.push_back(&s_kernels_avx2);
+#endif
+
+    result.push_back(&s_kernels_baseline);
+    result.push_back(&s_kernels_reference);
+    return result;
+}
+
+int kernels_select(const char *name) {
+    if (name == nullptr)
+        name = getenv("BATGIZMO_KERNELS");
+
+    const std::vector<const kernel_table *> supported = kernels_supported();
+    if (name == nullptr || *name == 0) {
+        s_kernels.store(supported.front());
+        return 0;
+    }
+
+    for (const kernel_table *table: supported) {
+        if (strcmp(table->name, name) == 0) {
+            s_kernels.store(table);
+            return 0;
+        }
+    }
+    return -1;
+}
+
+const kernel_table *kernels() {
+    const kernel_table *table = s_kernels.load(std::memory_order_acquire);
+    if (table == nullptr) {
+        // An unknown name in the environment leaves the default in place:
+        if (kernels_select(nullptr) != 0)
+            s_kernels.store(kernels_supported().front());
+        table = s_kernels.load(std::memory_order_acquire);
+    }
+    return table;
+}
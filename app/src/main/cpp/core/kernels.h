@@ -0,0 +1,96 @@
+/*
+ * Copyright (c) 2025 John Mears
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef BATGIZMO_KERNELS_H
+#define BATGIZMO_KERNELS_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "heterodyne.h"
+
+extern "C" {
+#include "kiss_fft.h"
+}
+
+/**
+ * Runtime dispatch of the hot inner loops to variants compiled for different CPU features,
+ * so that one build per ABI can use newer instructions where the device has them without
+ * breaking older devices.
+ *
+ * Every variant is compiled from the same source, kernels_impl.h, with different compiler
+ * flags. They give identical results, except that all but the reference variant use a
+ * vectorisable log2 that is accurate to about 1e-5 dB.
+ *
+ * The best supported variant is selected on first use, or by kernels_select. The environment
+ * variable BATGIZMO_KERNELS overrides the choice, for testing and benchmarking.
+ *
+ * This is plain C++ with no JNI or Android dependencies.
+ */
+
+struct kernel_table {
+    const char *name;
+
+    // Multiply one window of raw data by the window function.
+    void (*unwrap_window)(const int16_t *raw_data, const float *window, int window_size,
+                          float *output);
+
+    // Convert count complex values to dB power, scaled by normalizer2, using min_db for zero.
+    void (*power_to_db)(const kiss_fft_cpx *spectrum, int count, float normalizer2,
+                        float min_db, float *output);
+
+    // As colour_map_apply.
+    void (*colour_map)(const float *transformed_data, int first, int second,
+                       int frequency_bucket_count, const uint16_t *colour_map,
+                       int colour_map_size, float offset, float multiplier,
+                       uint16_t *pixels, uint32_t index_stride);
+
+    // As colour_map_apply_pooled.
+    void (*colour_map_pooled)(const float *transformed_data, int first, int second,
+                              int frequency_bucket_count, const int *row_first, int rows,
+                              const uint16_t *colour_map, int colour_map_size, float offset,
+                              float multiplier, uint16_t *pixels, uint32_t index_stride);
+
+    // As heterodyne_process.
+    int (*heterodyne)(heterodyne_state *state, const int16_t *input, uint32_t sample_count,
+                      int16_t *output);
+};
+
+/**
+ * The kernels to use, selecting the best supported variant if none has been selected yet.
+ */
+const kernel_table *kernels();
+
+/**
+ * Select the named variant, or the best supported one if name is null, in which case
+ * BATGIZMO_KERNELS is honoured if set. Returns 0 on success, or -1 if the named variant
+ * isn't built or isn't supported by this CPU, in which case the selection is unchanged.
+ */
+int kernels_select(const char *name);
+
+/**
+ * All the variants built in that this CPU supports, best first. The reference variant is last.
+ */
+std::vector<const kernel_table *> kernels_supported();
+
+#endif //BATGIZMO_KERNELS_H
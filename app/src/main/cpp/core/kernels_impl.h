@@ -0,0 +1,261 @@
+/*
+ * Copyright (c) 2025 John Mears
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * The bodies of the dispatched kernels, included by one translation unit per variant, each
+ * compiled with its own target flags. Before including this, define:
+ *
+ *   KERNELS_TABLE_NAME     the name of the kernel_table to define
+ *   KERNELS_VARIANT        the variant name, as a string
+ *   KERNELS_FAST_LOG       1 to use the vectorisable log2, 0 for the C library one
+ *
+ * Everything here is static, so that the variants don't clash at link time.
+ */
+
+#include "kernels.h"
+
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+
+/*
+ * Scaling factor used in scaling the squared amplitude to dB.
+ *dB is 10 log10(power).
+ *  - We have already squared the signal level so it represents power.
+ *  - We use log2 below for efficiency, so scale it to result in log10.
+ */
+const static float s_dB_factor = 10.0f / log2(10.0f);
+
+static inline float kernel_log2(float x) {
+#if KERNELS_FAST_LOG
+    /*
+     * The C library log2 is a function call, which prevents the compiler vectorising the dB
+     * loop. Instead, split x into exponent and mantissa, with the mantissa in
+     * [sqrt(0.5), sqrt(2)), and sum a few terms of the series for ln((1 + t) / (1 - t)).
+     *
+     * The range reduction works on the bits, as floating point comparisons would stop
+     * the compiler converting the selects to vector operations unless exceptions are
+     * disabled. x must be positive and normal.
+     */
+    uint32_t bits;
+    memcpy(&bits, &x, sizeof(bits));
+    const uint32_t mantissa = bits & 0x007FFFFFu;
+    const bool high = mantissa > 0x003504F3u;       // The mantissa of sqrt(2).
+    const int32_t exponent = (int32_t) (bits >> 23) - 127 + (high ? 1 : 0);
+    bits = mantissa | (high ? 0x3F000000u : 0x3F800000u);
+    float m;
+    memcpy(&m, &bits, sizeof(m));
+
+    const float t = (m - 1.0f) / (m + 1.0f);
+    const float t2 = t * t;
+    const float ln_m = 2.0f * t * (1.0f + t2 * (1.0f / 3 + t2 * (1.0f / 5 + t2 * (1.0f / 7 + t2 * (1.0f / 9)))));
+    return (float) exponent + ln_m * 1.44269504f;
+#else
+    return log2(x);
+#endif
+}
+
+static void kernel_unwrap_window(const int16_t *raw_data, const float *window, int window_size,
+                                 float *output) {
+    for (int j = 0; j < window_size; j++)
+        output[j] = static_cast<float>(raw_data[j]) * window[j];
+}
+
+static void kernel_power_to_db(const kiss_fft_cpx *spectrum, int count, float normalizer2,
+                               float min_db, float *output) {
+    for (int j = 0; j < count; j++) {
+        float re = spectrum[j].r;
+        float im = spectrum[j].i;
+        const float mag_squared = (re * re + im * im) * normalizer2;
+
+        /**
+         * This is probably the most expensive calculation per pixel. This version
+         * of log2 is based on floats, so hopefully faster than the one based on doubles,
+         * and faster than log10 because it avoids a division.
+         *
+         * I did try assigning the value into a 64 bit integer and using the compiler
+         * built-in to count the number of leading zeroes. This was truly very fast, but
+         * has the problem that brightness/contrast scaling would have to be done previously,
+         * in linear rather than log space, and would have resulted in only 64 levels
+         * of colour mapping which is a bit coarse. So, I settled for a proper log calculation,
+         * which is actually plenty fast enough.
+         *
+         * Multiple by 10 to get a db value, as the square has already given us x 2.
+         */
+#if KERNELS_FAST_LOG
+        // mag_squared isn't negative, so its bits order the same way as its value. Clamp
+        // zero and denormals up to the smallest normal, then substitute min_db for zero.
+        // The substitution is a mask rather than a condition so that the log is always
+        // calculated, otherwise the compiler moves it into a branch that doesn't vectorise:
+        uint32_t bits;
+        memcpy(&bits, &mag_squared, sizeof(bits));
+        const uint32_t normal_bits = bits > 0x00800000u ? bits : 0x00800000u;
+        float normal;
+        memcpy(&normal, &normal_bits, sizeof(normal));
+        const float db_value = s_dB_factor * kernel_log2(normal);
+
+        uint32_t db_bits, min_db_bits;
+        memcpy(&db_bits, &db_value, sizeof(db_bits));
+        memcpy(&min_db_bits, &min_db, sizeof(min_db_bits));
+        const uint32_t zero_mask = (uint32_t) -(int32_t) (bits == 0);   // Avoid log(0).
+        const uint32_t result_bits = (db_bits & ~zero_mask) | (min_db_bits & zero_mask);
+        memcpy(&output[j], &result_bits, sizeof(result_bits));
+#else
+        float db_value = min_db;
+        if (mag_squared > 0.0) { // Avoid log(0).
+            db_value = s_dB_factor * kernel_log2(mag_squared);
+        }
+        output[j] = db_value;
+#endif
+    }
+}
+
+static void kernel_colour_map(const float *transformed_data, int first, int second,
+                              int frequency_bucket_count, const uint16_t *colour_map,
+                              int colour_map_size, float offset, float multiplier,
+                              uint16_t *pixels, uint32_t index_stride) {
+    const float *inputPtr = transformed_data + first * frequency_bucket_count;
+    for (int timeBucket = first; timeBucket < second; timeBucket++) {
+        /**
+         * I'd love to find a way of having the following code do sequential
+         * access in both the source and destination locations, but the FFT generates
+         * data in the opposite sequencing than bitmap buffer requires. I don't
+         * think there is anything I can do about this. Hopefully both the source and
+         * destination can be served by cache reasonably efficiently.
+         *
+         * Frequency bucket 0 is at the bottom of the bitmap, as xy_to_bitmap_offset.
+         */
+        uint16_t *pixel = pixels + (size_t) (frequency_bucket_count - 1) * index_stride + timeBucket;
+        for (int frequencyBucket = 0; frequencyBucket < frequency_bucket_count; frequencyBucket++) {
+
+            float value = *inputPtr++;
+
+            // Apply brightness and contrast:
+            value = (value - offset) * multiplier;
+
+            int int_value = static_cast<int>(value);
+
+            // Do the colour map:
+            if (int_value > colour_map_size - 1)
+                int_value = colour_map_size - 1;
+            else if (int_value < 0)
+                int_value = 0;
+
+            *pixel = colour_map[int_value];
+            pixel -= index_stride;
+        }
+    }
+}
+
+static void kernel_colour_map_pooled(const float *transformed_data, int first, int second,
+                                     int frequency_bucket_count, const int *row_first, int rows,
+                                     const uint16_t *colour_map, int colour_map_size,
+                                     float offset, float multiplier, uint16_t *pixels,
+                                     uint32_t index_stride) {
+    for (int timeBucket = first; timeBucket < second; timeBucket++) {
+        const float *column = transformed_data + (size_t) timeBucket * frequency_bucket_count;
+
+        // Row 0 is at the bottom of the bitmap, as in kernel_colour_map:
+        uint16_t *pixel = pixels + (size_t) (rows - 1) * index_stride + timeBucket;
+        for (int row = 0; row < rows; row++) {
+            // The loudest bucket in the row's range, so that narrow peaks don't vanish:
+            float value = column[row_first[row]];
+            for (int j = row_first[row] + 1; j < row_first[row + 1]; j++)
+                value = column[j] > value ? column[j] : value;
+
+            // Apply brightness and contrast, then the colour map, as kernel_colour_map:
+            int int_value = static_cast<int>((value - offset) * multiplier);
+            if (int_value > colour_map_size - 1)
+                int_value = colour_map_size - 1;
+            else if (int_value < 0)
+                int_value = 0;
+
+            *pixel = colour_map[int_value];
+            pixel -= index_stride;
+        }
+    }
+}
+
+static int kernel_heterodyne(heterodyne_state *state, const int16_t *input,
+                             uint32_t sample_count, int16_t *output) {
+    int decimation_counter = 0;
+    int decimated_sample_count = 0;
+
+    // Should this be split into multiple loops that it is more likely to
+    // handled entirely in CPU registers? But then we would need more intermediate storage, and
+    // more memory accesses.
+
+    for (uint32_t i = 0; i < sample_count; i++) {
+
+        // Multiply the raw data by the reference(s).
+        int32_t mixed = input[i] * state->reference_data[state->reference1_index];
+        if (state->heterodyne2_kHz != 0)
+            mixed += input[i] * state->reference_data[state->reference2_index];
+
+        // Apply a low pass antialiasing filter. This is important to prevent audio feedback:
+        int64_t filtered = mixed;
+        for (int order = 0; order < HETERODYNE_AA_STAGES; order++) {
+            filtered = (int64_t) state->iir_coefficient * filtered +
+                       (int64_t) ((1LL << 31) - state->iir_coefficient) *
+                       state->previous[order];
+            filtered >>= 31;
+            state->previous[order] = (int32_t) filtered;
+        }
+
+        // Down sample:
+        if (++decimation_counter == state->decimation_factor) {
+            decimation_counter = 0;
+
+            // Reduce the result to the range of 16 bit signed. 15 rather than 16 to gain a factor of 2,
+            // because 0.5 * 0.5 is 0.25. Note that it remains a 32 bit signed for the moment:
+            filtered >>= (15 - state->audio_boost_shift);
+
+            if (filtered > INT16_MAX)
+                filtered = INT16_MAX;
+            if (filtered < INT16_MIN)
+                filtered = INT16_MIN;
+
+            output[decimated_sample_count++] = static_cast<int16_t>(filtered);
+        }
+
+        // Step through the reference waveforms:
+        state->reference1_index += state->heterodyne1_kHz;
+        if (state->reference1_index >= state->reference_len)
+            state->reference1_index -= state->reference_len;
+
+        state->reference2_index += state->heterodyne2_kHz;
+        if (state->reference2_index >= state->reference_len)
+            state->reference2_index -= state->reference_len;
+    }
+
+    return decimated_sample_count;
+}
+
+extern const kernel_table KERNELS_TABLE_NAME;
+const kernel_table KERNELS_TABLE_NAME = {
+        KERNELS_VARIANT,
+        kernel_unwrap_window,
+        kernel_power_to_db,
+        kernel_colour_map,
+        kernel_colour_map_pooled,
+        kernel_heterodyne
+};
@@ -0,0 +1,185 @@
+/*
+ * Copyright (c) 2025 John Mears
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "synthsource.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+// The highest fundamental frequency of any call, which is scaled down to fit below Nyquist
+// if needed. Harmonics that don't fit are omitted:
+#define SYNTH_MAX_CALL_HZ 90000.0
+#define SYNTH_NYQUIST_MARGIN 0.9
+
+#define SYNTH_CLICK_DECAY_S 0.0002      // Time constant of the click envelope.
+
+/**
+ * xorshift64*, which is fast and plenty good enough for this.
+ */
+static uint64_t next_random(synth_source_state *state) {
+    uint64_t x = state->random;
+    x ^= x >> 12;
+    x ^= x << 25;
+    x ^= x >> 27;
+    state->random = x;
+    return x * 0x2545F4914F6CDD1DULL;
+}
+
+// Uniform in [0, 1):
+static double uniform(synth_source_state *state) {
+    return (next_random(state) >> 11) * (1.0 / 9007199254740992.0);
+}
+
+// Approximately normal with unit variance, as the sum of uniform values:
+static double gaussian(synth_source_state *state) {
+    double sum = 0.0;
+    for (int i = 0; i < 4; i++)
+        sum += uniform(state);
+    return (sum - 2.0) * 1.7320508;     // sqrt(12 / 4)
+}
+
+// Samples until the next event of a Poisson process of the rate supplied:
+static int64_t interval(synth_source_state *state, float per_second) {
+    if (per_second <= 0.0f)
+        return INT64_MAX;
+    const double u = std::max(uniform(state), 1e-12);
+    return 1 + static_cast<int64_t>(-log(u) / per_second * state->config.sample_rate);
+}
+
+static void start_call(synth_source_state *state) {
+    if (state->active_count >= SYNTH_MAX_ACTIVE_CALLS)
+        return;
+    synth_call &call = state->active[state->active_count++];
+    call.type = static_cast<int>(next_random(state) % SYNTH_CALL_TYPES);
+    call.start = state->sample_index;
+    double duration_s;
+    switch (call.type) {
+        case SYNTH_CALL_FM:     duration_s = 0.003 + 0.004 * uniform(state); break;
+        case SYNTH_CALL_FM_QCF: duration_s = 0.010 + 0.010 * uniform(state); break;
+        default:                duration_s = 0.030 + 0.030 * uniform(state); break;
+    }
+    call.length = std::max(1, static_cast<int>(duration_s * state->config.sample_rate));
+    // Log uniform, as for bats at a range of distances:
+    call.amplitude = static_cast<float>(0.01 * pow(50.0, uniform(state)));
+    call.phase = 0.0;
+}
+
+/**
+ * The instantaneous fundamental frequency in Hz, before scaling, of a call at fraction t of
+ * the way through it.
+ */
+static double call_frequency(int type, double t) {
+    switch (type) {
+        case SYNTH_CALL_FM:
+            // Hyperbolic sweep from 90 kHz down to 45 kHz:
+            return 1.0 / (1.0 / 90000.0 + (1.0 / 45000.0 - 1.0 / 90000.0) * t);
+        case SYNTH_CALL_FM_QCF:
+            // Exponential sweep from 40 kHz flattening to 20 kHz:
+            return 20000.0 + 20000.0 * exp(-6.0 * t);
+        default:
+            // 41.5 kHz constant frequency with an upward FM start and a downward FM end,
+            // so that the second harmonic sits at 83 kHz:
+            if (t < 0.05)
+                return 38000.0 + 3500.0 * t / 0.05;
+            if (t > 0.9)
+                return 41500.0 - 6000.0 * (t - 0.9) / 0.1;
+            return 41500.0;
+    }
+}
+
+// The relative amplitude of the fundamental and second harmonic:
+static void call_harmonics(int type, float *fundamental, float *second) {
+    if (type == SYNTH_CALL_CF) {
+        *fundamental = 0.15f;
+        *second = 1.0f;
+    } else {
+        *fundamental = 1.0f;
+        *second = 0.25f;
+    }
+}
+
+int synth_source_init(synth_source_state *state, const synth_source_config *config) {
+    if (config->sample_rate < SYNTH_MIN_SAMPLE_RATE || config->sample_rate > SYNTH_MAX_SAMPLE_RATE
+        || config->calls_per_second < 0.0f || config->clicks_per_second < 0.0f
+        || config->noise_level < 0.0f || config->noise_level > 1.0f)
+        return -1;
+
+    memset(state, 0, sizeof(*state));
+    state->config = *config;
+
+    state->frequency_limit = SYNTH_NYQUIST_MARGIN * config->sample_rate / 2.0;
+    state->frequency_scale = std::min(1.0, state->frequency_limit / SYNTH_MAX_CALL_HZ);
+    state->random = config->seed != 0 ? config->seed : 0x9E3779B97F4A7C15ULL;
+    state->next_call = interval(state, config->calls_per_second);
+    state->next_click = interval(state, config->clicks_per_second);
+    return 0;
+}
+
+void synth_source_generate(synth_source_state *state, int16_t *output, int count) {
+    const double sample_rate = state->config.sample_rate;
+    const double noise_rms = state->config.noise_level * 32767.0;
+    const float click_decay = static_cast<float>(exp(-1.0 / (SYNTH_CLICK_DECAY_S * sample_rate)));
+
+    for (int i = 0; i < count; i++, state->sample_index++) {
+        if (state->sample_index >= state->next_call) {
+            start_call(state);
+            state->next_call = state->sample_index + interval(state, state->config.calls_per_second);
+        }
+        if (state->sample_index >= state->next_click) {
+            state->click_envelope = static_cast<float>(0.2 + 0.6 * uniform(state));
+            state->next_click = state->sample_index + interval(state, state->config.clicks_per_second);
+        }
+
+        double value = noise_rms > 0.0 ? gaussian(state) * noise_rms : 0.0;
+
+        for (int c = 0; c < state->active_count; ) {
+            synth_call &call = state->active[c];
+            const int64_t offset = state->sample_index - call.start;
+            if (offset >= call.length) {
+                // Finished: replace it with the last active call.
+                call = state->active[--state->active_count];
+                continue;
+            }
+            const double t = static_cast<double>(offset) / call.length;
+            const double envelope = 0.5 - 0.5 * cos(2.0 * M_PI * t);    // Hann.
+            const double frequency = call_frequency(call.type, t) * state->frequency_scale;
+            float fundamental, second;
+            call_harmonics(call.type, &fundamental, &second);
+            const double x = 2.0 * M_PI * call.phase;
+            double wave = fundamental * sin(x);
+            if (2.0 * frequency < state->frequency_limit)
+                wave += second * sin(2.0 * x);
+            value += 32767.0 * call.amplitude * envelope * wave;
+            call.phase += frequency / sample_rate;
+            call.phase -= floor(call.phase);
+            c++;
+        }
+
+        if (state->click_envelope > 1e-4f) {
+            value += 32767.0 * state->click_envelope * (2.0 * uniform(state) - 1.0);
+            state->click_envelope *= click_decay;
+        }
+
+        output[i] = static_cast<int16_t>(std::clamp(lround(value), -32768L, 32767L));
+    }
+}
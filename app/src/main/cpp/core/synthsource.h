@@ -0,0 +1,96 @@
+/*
+ * Copyright (c) 2025 John Mears
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef BATGIZMO_SYNTHSOURCE_H
+#define BATGIZMO_SYNTHSOURCE_H
+
+#include <cstdint>
+
+/**
+ * A synthetic source of bat-like data, for load testing the live pipeline at sample rates
+ * and call densities that real microphones can't provide, and for host tests and benchmarks.
+ *
+ * Calls arrive at random at the requested average rate, each one of:
+ *   - a steep FM sweep with a second harmonic, like a pipistrelle,
+ *   - a shallow FM sweep ending in quasi constant frequency, like a noctule,
+ *   - a long constant frequency call with FM tails and a strong second harmonic, like a
+ *     horseshoe bat.
+ * Broadband clicks and white noise are added. Call frequencies are scaled down if necessary
+ * to fit below the Nyquist frequency.
+ *
+ * The output is a deterministic function of the configuration, including the seed.
+ *
+ * This is plain C++ with no JNI or Android dependencies.
+ */
+
+#define SYNTH_MIN_SAMPLE_RATE 8000
+#define SYNTH_MAX_SAMPLE_RATE 768000
+#define SYNTH_MAX_ACTIVE_CALLS 8
+
+enum synth_call_type {
+    SYNTH_CALL_FM,
+    SYNTH_CALL_FM_QCF,
+    SYNTH_CALL_CF,
+    SYNTH_CALL_TYPES
+};
+
+struct synth_source_config {
+    int sample_rate;
+    float calls_per_second;         // Average call density.
+    float clicks_per_second;
+    float noise_level;              // RMS noise as a fraction of full scale.
+    uint64_t seed;
+};
+
+struct synth_call {
+    int type;
+    int64_t start;                  // Sample index of the start of the call.
+    int length;                     // In samples.
+    float amplitude;                // Peak, as a fraction of full scale.
+    double phase;                   // Of the fundamental, in cycles.
+};
+
+struct synth_source_state {
+    synth_source_config config;
+    double frequency_scale;         // Applied to call frequencies to keep them below Nyquist.
+    double frequency_limit;         // In Hz: harmonics above this are omitted.
+    int64_t sample_index;           // Of the next sample to generate.
+    uint64_t random;
+    int64_t next_call;              // Sample indexes of the next call and click to start.
+    int64_t next_click;
+    int active_count;
+    synth_call active[SYNTH_MAX_ACTIVE_CALLS];
+    float click_envelope;           // Of the current click, decaying to zero.
+};
+
+/**
+ * Initialise a synthetic source. Returns 0 on success, or -1 if the configuration is out
+ * of range.
+ */
+int synth_source_init(synth_source_state *state, const synth_source_config *config);
+
+/**
+ * Generate the next count samples into output.
+ */
+void synth_source_generate(synth_source_state *state, int16_t *output, int count);
+
+#endif //BATGIZMO_SYNTHSOURCE_H
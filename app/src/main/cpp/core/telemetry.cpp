@@ -0,0 +1,193 @@
+/*
+ * Copyright (c) 2025 John Mears
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "telemetry.h"
+
+#include <atomic>
+#include <chrono>
+
+// Four buckets per power of two, up to 2^42 ns, over an hour:
+#define TELEMETRY_SUB_BUCKET_BITS 2
+#define TELEMETRY_BUCKET_COUNT (41 << TELEMETRY_SUB_BUCKET_BITS)
+
+struct telemetry_histogram {
+    std::atomic<uint32_t> buckets[TELEMETRY_BUCKET_COUNT];
+    std::atomic<int64_t> max_ns;
+};
+
+static telemetry_histogram s_histograms[TELEMETRY_STAGE_COUNT];
+static std::atomic<bool> s_enabled{false};
+static telemetry_trace_hooks s_trace_hooks = {};
+
+static const char *s_stage_names[TELEMETRY_STAGE_COUNT] = {
+        "reap",
+        "channel",
+        "copy",
+        "unwrap",
+        "fft",
+        "db",
+        "colour_map",
+        "bitmap_unlock",
+        "draw"
+};
+
+/**
+ * The bucket for a duration: the position of the top bit, then the next
+ * TELEMETRY_SUB_BUCKET_BITS bits below it. Durations under 4 ns share the first buckets.
+ */
+static int bucket_index(int64_t ns) {
+    if (ns < (1 << TELEMETRY_SUB_BUCKET_BITS))
+        return ns < 0 ? 0 : (int) ns;
+    const int top_bit = 63 - __builtin_clzll((unsigned long long) ns);
+    const int sub_bucket = (int) (ns >> (top_bit - TELEMETRY_SUB_BUCKET_BITS))
+                           & ((1 << TELEMETRY_SUB_BUCKET_BITS) - 1);
+    const int index = ((top_bit - TELEMETRY_SUB_BUCKET_BITS + 1) << TELEMETRY_SUB_BUCKET_BITS)
+                      + sub_bucket;
+    return index < TELEMETRY_BUCKET_COUNT ? index : TELEMETRY_BUCKET_COUNT - 1;
+}
+
+/**
+ * The largest duration that falls in a bucket, so that percentiles err on the slow side.
+ */
+static int64_t bucket_limit(int index) {
+    if (index < (1 << TELEMETRY_SUB_BUCKET_BITS))
+        return index;
+    const int top_bit = (index >> TELEMETRY_SUB_BUCKET_BITS) + TELEMETRY_SUB_BUCKET_BITS - 1;
+    const int64_t sub_bucket = index & ((1 << TELEMETRY_SUB_BUCKET_BITS) - 1);
+    const int64_t width = (int64_t) 1 << (top_bit - TELEMETRY_SUB_BUCKET_BITS);
+    return ((int64_t) 1 << top_bit) + (sub_bucket + 1) * width - 1;
+}
+
+void telemetry_set_enabled(bool enabled) {
+    s_enabled.store(enabled, std::memory_order_relaxed);
+}
+
+void telemetry_set_trace_hooks(const telemetry_trace_hooks *hooks) {
+    s_trace_hooks = hooks != nullptr ? *hooks : telemetry_trace_hooks();
+}
+
+static bool tracing() {
+    return s_trace_hooks.is_enabled != nullptr && s_trace_hooks.is_enabled();
+}
+
+bool telemetry_active() {
+    return s_enabled.load(std::memory_order_relaxed) || tracing();
+}
+
+const char *telemetry_stage_name(telemetry_stage stage) {
+    return stage >= 0 && stage < TELEMETRY_STAGE_COUNT ? s_stage_names[stage] : "unknown";
+}
+
+int64_t telemetry_now_ns() {
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void telemetry_record(telemetry_stage stage, int64_t duration_ns) {
+    if (stage < 0 || stage >= TELEMETRY_STAGE_COUNT)
+        return;
+
+    telemetry_histogram *histogram = &s_histograms[stage];
+    histogram->buckets[bucket_index(duration_ns)].fetch_add(1, std::memory_order_relaxed);
+
+    int64_t max_ns = histogram->max_ns.load(std::memory_order_relaxed);
+    while (duration_ns > max_ns
+           && !histogram->max_ns.compare_exchange_weak(max_ns, duration_ns,
+                                                       std::memory_order_relaxed))
+        ;
+}
+
+void telemetry_trace_begin(telemetry_stage stage) {
+    if (tracing())
+        s_trace_hooks.begin_section(telemetry_stage_name(stage));
+}
+
+void telemetry_trace_end() {
+    if (tracing())
+        s_trace_hooks.end_section();
+}
+
+void telemetry_snapshot(telemetry_stats *stats) {
+    for (int stage = 0; stage < TELEMETRY_STAGE_COUNT; stage++) {
+        const telemetry_histogram *histogram = &s_histograms[stage];
+
+        // Copy the counts first, as they may change while we look at them:
+        uint32_t counts[TELEMETRY_BUCKET_COUNT];
+        uint64_t total = 0;
+        for (int i = 0; i < TELEMETRY_BUCKET_COUNT; i++) {
+            counts[i] = histogram->buckets[i].load(std::memory_order_relaxed);
+            total += counts[i];
+        }
+
+        telemetry_stats *s = &stats[stage];
+        s->count = total;
+        s->p50_ns = 0;
+        s->p99_ns = 0;
+        s->max_ns = histogram->max_ns.load(std::memory_order_relaxed);
+
+        // The smallest bucket limit with at least the required fraction at or below it:
+        const uint64_t p50_rank = (total * 50 + 99) / 100;
+        const uint64_t p99_rank = (total * 99 + 99) / 100;
+        uint64_t cumulative = 0;
+        for (int i = 0; i < TELEMETRY_BUCKET_COUNT && total > 0; i++) {
+            const uint64_t previous = cumulative;
+            cumulative += counts[i];
+            if (previous < p50_rank && cumulative >= p50_rank)
+                s->p50_ns = bucket_limit(i);
+            if (previous < p99_rank && cumulative >= p99_rank) {
+                s->p99_ns = bucket_limit(i);
+                break;
+            }
+        }
+
+        // The bucket limit can exceed the largest value seen:
+        if (s->p50_ns > s->max_ns)
+            s->p50_ns = s->max_ns;
+        if (s->p99_ns > s->max_ns)
+            s->p99_ns = s->max_ns;
+    }
+}
+
+void telemetry_reset() {
+    for (telemetry_histogram &histogram: s_histograms) {
+        for (std::atomic<uint32_t> &bucket: histogram.buckets)
+            bucket.store(0, std::memory_order_relaxed);
+        histogram.max_ns.store(0, std::memory_order_relaxed);
+    }
+}
+
+telemetry_scope::telemetry_scope(telemetry_stage stage) : stage(stage), start_ns(0), traced(false) {
+    traced = tracing();
+    if (traced || s_enabled.load(std::memory_order_relaxed)) {
+        if (traced)
+            s_trace_hooks.begin_section(s_stage_names[stage]);
+        start_ns = telemetry_now_ns();
+    }
+}
+
+telemetry_scope::~telemetry_scope() {
+    if (start_ns != 0) {
+        telemetry_record(stage, telemetry_now_ns() - start_ns);
+        if (traced)
+            s_trace_hooks.end_section();
+    }
+}
@@ -0,0 +1,128 @@
+/*
+ * Copyright (c) 2025 John Mears
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef BATGIZMO_TELEMETRY_H
+#define BATGIZMO_TELEMETRY_H
+
+#include <cstdint>
+
+/**
+ * Per stage latency telemetry for the live pipeline, so that lag can be pinned on USB
+ * reaping, the Kotlin channel, the transform, colour mapping or drawing.
+ *
+ * Each stage has a histogram with four buckets per power of two of nanoseconds, updated
+ * with relaxed atomics so that recording never blocks the USB or pipeline threads.
+ * Percentiles are therefore accurate to within about 20%.
+ *
+ * Nothing is recorded unless telemetry is enabled, or a trace hook reports that tracing is
+ * in progress, in which case each timed section is also marked in the trace. Disabled, a
+ * timed section costs one relaxed load.
+ *
+ * This is plain C++ with no JNI or Android dependencies: the Android layer installs the
+ * trace hooks.
+ */
+
+// Keep in step with Telemetry.Stage in the Kotlin:
+enum telemetry_stage {
+    TELEMETRY_REAP,             // URB reaped to the Kotlin callback returning.
+    TELEMETRY_CHANNEL,          // Kotlin callback to the rendering pipeline starting the copy.
+    TELEMETRY_COPY,             // Copying URB data into the raw data buffer.
+    TELEMETRY_UNWRAP,           // Unwrapping raw data into windows.
+    TELEMETRY_FFT,              // The FFTs, excluding the dB conversion.
+    TELEMETRY_DB,               // Converting the FFT output to dB.
+    TELEMETRY_COLOUR_MAP,       // Colour mapping into the bitmap.
+    TELEMETRY_BITMAP_UNLOCK,    // Unlocking a bitmap after drawing into it.
+    TELEMETRY_DRAW,             // signalUpdate to the SurfaceView draw completing.
+    TELEMETRY_STAGE_COUNT
+};
+
+struct telemetry_stats {
+    uint64_t count;
+    int64_t p50_ns;
+    int64_t p99_ns;
+    int64_t max_ns;
+};
+
+/**
+ * Functions to mark sections in a system trace, such as ATrace for Perfetto. is_enabled
+ * must be cheap, as it is called for every timed section.
+ */
+struct telemetry_trace_hooks {
+    void (*begin_section)(const char *name);
+    void (*end_section)();
+    bool (*is_enabled)();
+};
+
+void telemetry_set_enabled(bool enabled);
+
+/**
+ * Install the trace hooks, or remove them if hooks is null. Not thread safe: call this
+ * before any pipeline threads start.
+ */
+void telemetry_set_trace_hooks(const telemetry_trace_hooks *hooks);
+
+/**
+ * True if timed sections should be measured, because telemetry or tracing is enabled.
+ */
+bool telemetry_active();
+
+const char *telemetry_stage_name(telemetry_stage stage);
+
+int64_t telemetry_now_ns();
+
+/**
+ * Add a duration to the histogram for a stage. Thread safe and lock free. Recorded
+ * regardless of whether telemetry is enabled, so that callers that measure across threads
+ * can decide for themselves.
+ */
+void telemetry_record(telemetry_stage stage, int64_t duration_ns);
+
+/**
+ * Mark the start and end of a stage in the trace, if tracing, for callers that record the
+ * duration themselves. Sections must nest.
+ */
+void telemetry_trace_begin(telemetry_stage stage);
+void telemetry_trace_end();
+
+/**
+ * Fill stats, which has TELEMETRY_STAGE_COUNT entries, from the histograms.
+ */
+void telemetry_snapshot(telemetry_stats *stats);
+
+void telemetry_reset();
+
+/**
+ * Time a section of code as a stage, and mark it in the trace, if telemetry_active().
+ */
+struct telemetry_scope {
+    explicit telemetry_scope(telemetry_stage stage);
+    ~telemetry_scope();
+
+    telemetry_scope(const telemetry_scope &) = delete;
+    telemetry_scope &operator=(const telemetry_scope &) = delete;
+
+    telemetry_stage stage;
+    int64_t start_ns;       // 0 if inactive.
+    bool traced;
+};
+
+#endif //BATGIZMO_TELEMETRY_H
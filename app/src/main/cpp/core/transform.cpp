@@ -0,0 +1,282 @@
+/*
+ * Copyright (c) 2025 John Mears
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "transform.h"
+#include "kernels.h"
+#include "telemetry.h"
+#include "workpool.h"
+
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <algorithm>
+
+static const kiss_fft_scalar canaryValue = -1.0;
+
+/**
+ * Allocate a temporary buffer big enough for the plan supplied, with a canary at the end.
+ * Any buffer already in the state's arena slot is reused, or replaced if too small.
+ */
+static kiss_fft_cpx *allocate_temp_buffer(const transform_state *state, const transform_plan *plan) {
+    const size_t allocation_buckets = (size_t) state->frequency_buckets * plan->batch_windows * plan->threads
+            + 1; // Additional +1 for canary value.
+    const size_t size = sizeof(kiss_fft_cpx) * allocation_buckets;
+    void *memory = nullptr;
+    if (state->scratch_arena != nullptr)
+        memory = arena_acquire(state->scratch_arena, ARENA_SLOT_FFT_SCRATCH, size);
+    else if (posix_memalign(&memory, ARENA_ALIGNMENT, size) != 0)
+        memory = nullptr;
+
+    auto *buffer = (kiss_fft_cpx *) memory;
+    if (buffer != nullptr) {
+        memset(buffer, 0, size);
+        buffer[allocation_buckets - 1].r = canaryValue;
+        buffer[allocation_buckets - 1].i = canaryValue;
+    }
+    return buffer;
+}
+
+static void free_temp_buffer(const transform_state *state, kiss_fft_cpx *buffer) {
+    if (state->scratch_arena != nullptr)
+        arena_release(state->scratch_arena, ARENA_SLOT_FFT_SCRATCH);
+    else
+        free(buffer);
+}
+
+int transform_init(transform_state *state, int fft_window_size) {
+
+    transform_cleanup(state);  // Paranoia.
+
+    state->window_size = fft_window_size;
+    state->cfg = kiss_fftr_alloc(fft_window_size, false, nullptr, nullptr);
+
+    state->frequency_buckets = fft_window_size / 2 + 1;
+    state->plan = transform_plan();
+    state->temp_buffer = allocate_temp_buffer(state, &state->plan);
+
+    if (state->cfg == nullptr || state->temp_buffer == nullptr) {
+        transform_cleanup(state);
+        return -1;
+    }
+
+    return 0;
+}
+
+int transform_set_plan(transform_state *state, const transform_plan *plan) {
+    if (state->cfg == nullptr
+        || plan->batch_windows < 1 || plan->batch_windows > TRANSFORM_MAX_BATCH_WINDOWS
+        || plan->threads < 1 || plan->threads > TRANSFORM_MAX_THREADS)
+        return -1;
+
+    // Allocate the configs for any additional threads:
+    for (int t = 1; t < plan->threads; t++) {
+        if (state->thread_cfgs[t - 1] == nullptr) {
+            state->thread_cfgs[t - 1] = kiss_fftr_alloc(state->window_size, false, nullptr, nullptr);
+            if (state->thread_cfgs[t - 1] == nullptr)
+                return -1;
+        }
+    }
+
+    // Done last, as an arena slot replaces the current buffer if it needs a bigger one:
+    kiss_fft_cpx *temp_buffer = allocate_temp_buffer(state, plan);
+    if (temp_buffer == nullptr)
+        return -1;
+
+    if (state->scratch_arena == nullptr)
+        free(state->temp_buffer);
+    state->temp_buffer = temp_buffer;
+    state->plan = *plan;
+    return 0;
+}
+
+void transform_cleanup(transform_state *state) {
+    if (state->cfg != nullptr) {
+        kiss_fftr_free(state->cfg);
+        state->cfg = nullptr;
+    }
+
+    for (kiss_fftr_cfg &cfg: state->thread_cfgs) {
+        if (cfg != nullptr) {
+            kiss_fftr_free(cfg);
+            cfg = nullptr;
+        }
+    }
+
+    if (state->temp_buffer != nullptr) {
+        free_temp_buffer(state, state->temp_buffer);
+        state->temp_buffer = nullptr;
+    }
+
+    state->window_size = 0;
+    state->frequency_buckets = 0;
+    state->plan = transform_plan();
+}
+
+void transform_hann_window(float *window, int length) {
+    // Matches TransformStep.createHannWindow, which this replaces in native callers.
+    for (int i = 0; i < length; i++) {
+        window[i] = static_cast<float>(0.5 * (1.0 - cos(2.0 * M_PI * i / (length - 1.0))));
+    }
+}
+
+void transform_unwrap_slices(const int16_t *raw_data, int raw_data_entries, int start_index,
+                             int window_count, int fft_stride, const float *window,
+                             int fft_window_size, float *output) {
+    telemetry_scope scope(TELEMETRY_UNWRAP);
+    const kernel_table *k = kernels();
+    int unwrapped_index = 0;
+    for (int i = 0; i < window_count; i++) {
+        int end_index = start_index + fft_window_size;  // Half open range.
+        // The last window may extend beyond the range of raw data. That's expected because the final slice
+        // is truncated to the file size. In that case, skip it.
+        if (end_index <= raw_data_entries) {
+            k->unwrap_window(raw_data + start_index, window, fft_window_size,
+                             output + unwrapped_index);
+            unwrapped_index += fft_window_size;
+        }
+
+        start_index += fft_stride;
+    }
+}
+
+/**
+ * Transform num_windows windows on the calling thread, batch_windows at a time, using
+ * cfg, which no other thread may be using, and temp_buffer which has space for a batch.
+ */
+static bool transform_windows(const transform_state *state, kiss_fftr_cfg cfg,
+                              kiss_fft_cpx *temp_buffer,
+                              int num_windows, const float *input, float *output, float min_db,
+                              int min_trigger_bucket, int max_trigger_bucket,
+                              float trigger_threshold) {
+    const int window_size = state->window_size;
+    const int frequency_buckets = state->frequency_buckets;
+    const int batch_windows = state->plan.batch_windows;
+
+    const float *pWindowData = input;
+    int transformedIndex = 0;  // Index within the output array.
+
+    // We will normalize the result so that it is independent of window size
+    // the maximum frequency bin value is A x nFFT / 2, which A is the input magnitude.
+    float normalizer = 2.0f / static_cast<float>(window_size);
+    float normalizer2 = normalizer * normalizer;
+    bool any_triggered = false;
+
+    const auto power_to_db = kernels()->power_to_db;
+    const int trigger_first = std::max(min_trigger_bucket, 0);
+    const int trigger_last = std::min(max_trigger_bucket, frequency_buckets - 1);
+
+    // The FFT and dB conversion alternate, so accumulate the time for each:
+    const bool timed = telemetry_active();
+    int64_t fft_ns = 0;
+    int64_t db_ns = 0;
+
+    for (int windowIndex = 0; windowIndex < num_windows; windowIndex += batch_windows) {
+        const int batch = std::min(batch_windows, num_windows - windowIndex);
+        const int64_t fft_start_ns = timed ? telemetry_now_ns() : 0;
+        if (timed)
+            telemetry_trace_begin(TELEMETRY_FFT);
+
+        // Do the SFFTs for the batch. Doing them together, then the magnitudes together,
+        // is faster on some devices as each loop stays in cache:
+        for (int k = 0; k < batch; k++, pWindowData += window_size)
+            kiss_fftr(cfg, pWindowData, temp_buffer + k * frequency_buckets);
+
+        const int64_t db_start_ns = timed ? telemetry_now_ns() : 0;
+        if (timed) {
+            telemetry_trace_end();
+            telemetry_trace_begin(TELEMETRY_DB);
+        }
+
+        // Convert the complex spectral results to dB, then see if any of them result in
+        // a trigger. The conversion is done by the CPU specific kernels, see kernels.h:
+        for (int k = 0; k < batch; k++, transformedIndex += frequency_buckets) {
+            power_to_db(temp_buffer + k * frequency_buckets, frequency_buckets, normalizer2,
+                        min_db, output + transformedIndex);
+            for (int j = trigger_first; j <= trigger_last && !any_triggered; j++) {
+                if (output[transformedIndex + j] >= trigger_threshold)
+                    any_triggered = true;
+            }
+        }
+
+        if (timed) {
+            telemetry_trace_end();
+            const int64_t end_ns = telemetry_now_ns();
+            fft_ns += db_start_ns - fft_start_ns;
+            db_ns += end_ns - db_start_ns;
+        }
+    }
+
+    if (timed) {
+        telemetry_record(TELEMETRY_FFT, fft_ns);
+        telemetry_record(TELEMETRY_DB, db_ns);
+    }
+
+    return any_triggered;
+}
+
+int transform_fft(const transform_state *state, int num_windows, const float *input,
+                  float *output, float min_db, int min_trigger_bucket, int max_trigger_bucket,
+                  float trigger_threshold, bool *triggered) {
+    const int threads = std::min(state->plan.threads, std::max(num_windows, 1));
+    if (threads <= 1) {
+        *triggered = transform_windows(state, state->cfg, state->temp_buffer, num_windows,
+                                       input, output, min_db, min_trigger_bucket,
+                                       max_trigger_bucket, trigger_threshold);
+        return num_windows;
+    }
+
+    // Split the windows into contiguous runs, one per task on the shared work pool. Each run
+    // has its own config and temporary buffer, whichever thread runs it:
+    const size_t temp_stride = (size_t) state->frequency_buckets * state->plan.batch_windows;
+    bool thread_triggered[TRANSFORM_MAX_THREADS] = {};
+    auto run = [&](int t) {
+        const int first_window = num_windows / threads * t + std::min(t, num_windows % threads);
+        const int count = num_windows / threads + (t < num_windows % threads ? 1 : 0);
+        thread_triggered[t] = transform_windows(state, t == 0 ? state->cfg : state->thread_cfgs[t - 1],
+                                                state->temp_buffer + t * temp_stride, count,
+                                                input + (size_t) first_window * state->window_size,
+                                                output + (size_t) first_window * state->frequency_buckets,
+                                                min_db, min_trigger_bucket, max_trigger_bucket,
+                                                trigger_threshold);
+    };
+    work_pool_parallel_for(work_pool_shared(), work_current_priority(), threads, run);
+
+    bool any_triggered = false;
+    for (int t = 0; t < threads; t++)
+        any_triggered = any_triggered || thread_triggered[t];
+    *triggered = any_triggered;
+    return num_windows;
+}
+
+void transform_spread_columns(float *output, int windows, int column_step, int columns,
+                              int frequency_buckets) {
+    // Work back from the end, as each window moves to a column at or after its own:
+    for (int w = windows - 1; w >= 0; w--) {
+        const float *source = output + (size_t) w * frequency_buckets;
+        const int last = std::min((w + 1) * column_step, columns);
+        for (int column = last - 1; column >= w * column_step; column--) {
+            float *target = output + (size_t) column * frequency_buckets;
+            if (target != source)
+                memcpy(target, source, sizeof(float) * frequency_buckets);
+        }
+    }
+}
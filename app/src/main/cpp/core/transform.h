@@ -0,0 +1,121 @@
+/*
+ * Copyright (c) 2025 John Mears
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef BATGIZMO_TRANSFORM_H
+#define BATGIZMO_TRANSFORM_H
+
+#include <cstddef>
+#include <cstdint>
+
+extern "C" {
+#include "kiss_fftr.h"
+}
+
+#include "arena.h"
+
+/**
+ * The SFFT kernels used by the transform pipeline step: unwrapping raw data into
+ * windowed FFT input, and transforming it to dB values.
+ *
+ * This is plain C++ with no JNI or Android dependencies. All state lives in
+ * transform_state, so that independent callers (for example, worker threads in
+ * a batch tool) can each have their own.
+ */
+
+#define TRANSFORM_MAX_BATCH_WINDOWS 64
+#define TRANSFORM_MAX_THREADS 8
+
+/**
+ * How transform_fft goes about its work. All plans give identical results; which is fastest
+ * depends on the device, so fftwisdom.h chooses one by timing them.
+ */
+struct transform_plan {
+    int batch_windows = 1;              // Windows transformed before converting them all to dB.
+    int threads = 1;                    // Windows are split into this many tasks on the work pool.
+};
+
+struct transform_state {
+    kiss_fftr_cfg cfg = nullptr;
+    // kissfft keeps scratch space in its config, so each task after the first has its own:
+    kiss_fftr_cfg thread_cfgs[TRANSFORM_MAX_THREADS - 1] = {};
+    int window_size = 0;
+    int frequency_buckets = 0;           // window_size / 2 + 1
+    transform_plan plan;
+    kiss_fft_cpx *temp_buffer = nullptr; // A batch of transformed windows per task, plus a canary.
+    // If set, the temporary buffer is kept in this arena's FFT scratch slot, so that its
+    // memory is reused by the next state. Only one state may use an arena at a time:
+    arena *scratch_arena = nullptr;
+};
+
+/**
+ * Prepare to do FFTs of the size supplied. Any resources previously held by the state are
+ * freed first. Returns 0 on success or -1 on failure, in which case the state is left clean.
+ */
+int transform_init(transform_state *state, int fft_window_size);
+
+/**
+ * Switch an initialised state to the plan supplied. Returns 0 on success, or -1 if the plan
+ * is out of range or allocation failed, in which case the previous plan is kept.
+ */
+int transform_set_plan(transform_state *state, const transform_plan *plan);
+
+/**
+ * Free resources allocated by transform_init. It is safe to call this more than once.
+ */
+void transform_cleanup(transform_state *state);
+
+/**
+ * Fill window with a Hann window of the length supplied.
+ */
+void transform_hann_window(float *window, int length);
+
+/**
+ * Unwrap window_count overlapping windows from the raw data, starting at start_index and
+ * spaced by fft_stride, into consecutive blocks of output, applying the window function.
+ * Windows that would extend beyond raw_data_entries are skipped.
+ */
+void transform_unwrap_slices(const int16_t *raw_data, int raw_data_entries, int start_index,
+                             int window_count, int fft_stride, const float *window,
+                             int fft_window_size, float *output);
+
+/**
+ * Transform num_windows consecutive windows of unwrapped input to dB values, writing
+ * frequency_buckets values per window to output. min_db is used in place of log(0).
+ *
+ * If any value in the trigger bucket range (inclusive) reaches trigger_threshold,
+ * *triggered is set to true, otherwise false.
+ *
+ * Returns the number of windows transformed.
+ */
+int transform_fft(const transform_state *state, int num_windows, const float *input,
+                  float *output, float min_db, int min_trigger_bucket, int max_trigger_bucket,
+                  float trigger_threshold, bool *triggered);
+
+/**
+ * Spread the results of windows consecutive windows in output, frequency_buckets values each,
+ * so that each fills column_step consecutive time buckets, as for a coarse preview done with
+ * column_step times the stride. No more than columns time buckets are written.
+ */
+void transform_spread_columns(float *output, int windows, int column_step, int columns,
+                              int frequency_buckets);
+
+#endif //BATGIZMO_TRANSFORM_H
@@ -0,0 +1,160 @@
+/*
+ * Copyright (c) 2025 John Mears
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "urbcapture.h"
+
+#include <cerrno>
+#include <cstring>
+#include <unistd.h>
+
+static const char s_magic[8] = {'B', 'G', 'U', 'R', 'B', 'C', 'A', 'P'};
+
+// The largest payload we accept when reading, as a defence against corrupt files:
+static const uint32_t MAX_PAYLOAD_BYTES = 16 * 1024 * 1024;
+
+static void put_u32(uint8_t *p, uint32_t v) {
+    for (int i = 0; i < 4; i++)
+        p[i] = static_cast<uint8_t>(v >> (8 * i));
+}
+
+static uint32_t get_u32(const uint8_t *p) {
+    return static_cast<uint32_t>(p[0]) | (static_cast<uint32_t>(p[1]) << 8)
+           | (static_cast<uint32_t>(p[2]) << 16) | (static_cast<uint32_t>(p[3]) << 24);
+}
+
+static int write_all(int fd, const void *data, size_t count) {
+    auto p = static_cast<const uint8_t *>(data);
+    while (count > 0) {
+        const ssize_t written = write(fd, p, count);
+        if (written < 0) {
+            if (errno == EINTR)
+                continue;
+            return -1;
+        }
+        p += written;
+        count -= static_cast<size_t>(written);
+    }
+    return 0;
+}
+
+int urb_capture_write_header(int fd, const urb_capture_header *header) {
+    uint8_t buffer[sizeof(s_magic) + 5 * 4];
+    memcpy(buffer, s_magic, sizeof(s_magic));
+    put_u32(buffer + 8, URB_CAPTURE_VERSION);
+    put_u32(buffer + 12, header->sample_rate);
+    put_u32(buffer + 16, header->channels);
+    put_u32(buffer + 20, header->packets_per_urb);
+    put_u32(buffer + 24, header->requested_bytes_per_packet);
+    return write_all(fd, buffer, sizeof(buffer));
+}
+
+int urb_capture_write_urb(int fd, int64_t timestamp_ns, int32_t status, uint32_t actual_length,
+                          const usb_packet_desc *packets, uint32_t packet_count,
+                          const void *payload, uint32_t payload_bytes) {
+    if (packet_count > URB_CAPTURE_MAX_PACKETS)
+        return -1;
+
+    // Assemble everything other than the payload, so that there are only two writes:
+    uint8_t buffer[20 + URB_CAPTURE_MAX_PACKETS * 12 + 4];
+    const auto timestamp = static_cast<uint64_t>(timestamp_ns);
+    put_u32(buffer, static_cast<uint32_t>(timestamp));
+    put_u32(buffer + 4, static_cast<uint32_t>(timestamp >> 32));
+    put_u32(buffer + 8, static_cast<uint32_t>(status));
+    put_u32(buffer + 12, actual_length);
+    put_u32(buffer + 16, packet_count);
+    uint8_t *p = buffer + 20;
+    for (uint32_t i = 0; i < packet_count; i++, p += 12) {
+        put_u32(p, packets[i].length);
+        put_u32(p + 4, packets[i].actual_length);
+        put_u32(p + 8, packets[i].status);
+    }
+    put_u32(p, payload_bytes);
+    p += 4;
+
+    if (write_all(fd, buffer, p - buffer) != 0)
+        return -1;
+    return write_all(fd, payload, payload_bytes);
+}
+
+int urb_capture_read_header(FILE *f, urb_capture_header *header, std::string *error) {
+    uint8_t buffer[sizeof(s_magic) + 5 * 4];
+    if (fread(buffer, 1, sizeof(buffer), f) != sizeof(buffer)) {
+        *error = "file too short";
+        return -1;
+    }
+    if (memcmp(buffer, s_magic, sizeof(s_magic)) != 0) {
+        *error = "not a URB capture file";
+        return -1;
+    }
+    if (get_u32(buffer + 8) != URB_CAPTURE_VERSION) {
+        *error = "unsupported URB capture version " + std::to_string(get_u32(buffer + 8));
+        return -1;
+    }
+    header->sample_rate = get_u32(buffer + 12);
+    header->channels = get_u32(buffer + 16);
+    header->packets_per_urb = get_u32(buffer + 20);
+    header->requested_bytes_per_packet = get_u32(buffer + 24);
+    if (header->sample_rate == 0 || header->channels == 0 || header->channels > 2) {
+        *error = "invalid URB capture header";
+        return -1;
+    }
+    return 0;
+}
+
+int urb_capture_read_urb(FILE *f, urb_capture_record *record) {
+    uint8_t buffer[20];
+    const size_t count = fread(buffer, 1, sizeof(buffer), f);
+    if (count == 0)
+        return 0;       // A clean end of file.
+    if (count != sizeof(buffer))
+        return -1;
+
+    record->timestamp_ns = static_cast<int64_t>(get_u32(buffer)
+                                                | (static_cast<uint64_t>(get_u32(buffer + 4)) << 32));
+    record->status = static_cast<int32_t>(get_u32(buffer + 8));
+    record->actual_length = get_u32(buffer + 12);
+    const uint32_t packet_count = get_u32(buffer + 16);
+    if (packet_count > URB_CAPTURE_MAX_PACKETS)
+        return -1;
+
+    record->packets.resize(packet_count);
+    for (uint32_t i = 0; i < packet_count; i++) {
+        uint8_t packet[12];
+        if (fread(packet, 1, sizeof(packet), f) != sizeof(packet))
+            return -1;
+        record->packets[i].length = get_u32(packet);
+        record->packets[i].actual_length = get_u32(packet + 4);
+        record->packets[i].status = get_u32(packet + 8);
+    }
+
+    uint8_t length[4];
+    if (fread(length, 1, sizeof(length), f) != sizeof(length))
+        return -1;
+    const uint32_t payload_bytes = get_u32(length);
+    if (payload_bytes > MAX_PAYLOAD_BYTES)
+        return -1;
+    record->payload.resize(payload_bytes);
+    if (fread(record->payload.data(), 1, payload_bytes, f) != payload_bytes)
+        return -1;
+
+    return 1;
+}
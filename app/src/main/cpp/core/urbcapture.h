@@ -0,0 +1,93 @@
+/*
+ * Copyright (c) 2025 John Mears
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef BATGIZMO_URBCAPTURE_H
+#define BATGIZMO_URBCAPTURE_H
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+#include "usbpacket.h"
+
+/**
+ * A file format for raw reaped isochronous URBs, so that the live data path can be tested
+ * and benchmarked without a microphone: the app captures URBs as they are reaped, and host
+ * tools replay them through the same code.
+ *
+ * The file is a header followed by one record per URB. All values are little endian:
+ *
+ *   header:  "BGURBCAP", version (u32), sample rate (u32), channels (u32),
+ *            packets per URB (u32), requested bytes per packet (u32)
+ *   record:  timestamp in ns since the first URB (i64), URB status (i32),
+ *            URB actual length (u32), packet count (u32),
+ *            per packet: length, actual length, status (u32 each),
+ *            payload length (u32), payload
+ *
+ * The payload is the whole URB buffer as reaped, including the padding after short packets.
+ *
+ * This is plain C++ with no JNI or Android dependencies.
+ */
+
+#define URB_CAPTURE_VERSION 1
+#define URB_CAPTURE_MAX_PACKETS 1000
+
+struct urb_capture_header {
+    uint32_t sample_rate;
+    uint32_t channels;
+    uint32_t packets_per_urb;
+    uint32_t requested_bytes_per_packet;
+};
+
+struct urb_capture_record {
+    int64_t timestamp_ns;
+    int32_t status;
+    uint32_t actual_length;
+    std::vector<usb_packet_desc> packets;
+    std::vector<uint8_t> payload;
+};
+
+/**
+ * Write the file header to fd. Returns 0 on success or -1 on failure.
+ */
+int urb_capture_write_header(int fd, const urb_capture_header *header);
+
+/**
+ * Write one URB record to fd. Returns 0 on success or -1 on failure.
+ */
+int urb_capture_write_urb(int fd, int64_t timestamp_ns, int32_t status, uint32_t actual_length,
+                          const usb_packet_desc *packets, uint32_t packet_count,
+                          const void *payload, uint32_t payload_bytes);
+
+/**
+ * Read and check the file header. Returns 0 on success, or -1 with a description in *error.
+ */
+int urb_capture_read_header(FILE *f, urb_capture_header *header, std::string *error);
+
+/**
+ * Read the next URB record, reusing the record's storage. Returns 1 if a record was read,
+ * 0 at the end of the file, or -1 if the file is malformed or truncated.
+ */
+int urb_capture_read_urb(FILE *f, urb_capture_record *record);
+
+#endif //BATGIZMO_URBCAPTURE_H
@@ -0,0 +1,92 @@
+/*
+ * Copyright (c) 2025 John Mears
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "usbpacket.h"
+
+#include <cstring>
+
+size_t usb_compact_packets(uint8_t *data, const usb_packet_desc *packets, int packet_count) {
+    // Take account of the fact that we often get back fewer data samples
+    // then we requested - the data buffer contains corresponding padding
+    // entries that we need to remove.
+    size_t dst_byte_offset = 0, source_byte_offset = 0;
+    const usb_packet_desc *frame_desc = packets;
+    for (int frame = 0; frame < packet_count; frame++, frame_desc++) {
+        // memmove because the source and destination overlap:
+        auto actual_length = frame_desc->actual_length;
+        if (frame > 0 && actual_length > 0)
+            memmove(data + dst_byte_offset, data + source_byte_offset, actual_length);
+        dst_byte_offset += frame_desc->actual_length;   // Bytes
+        source_byte_offset += frame_desc->length;       // Bytes
+    }
+    return dst_byte_offset;
+}
+
+int usb_mix_stereo(int16_t *data, int sample_count) {
+    // Sample index, not bytes.
+    for (int i = 0, j = 0; j + 1 < sample_count; i += 1, j += 2) {
+        // Average of the stereo channel values:
+        data[i] = (short) (((int) data[j] + (int) data[j + 1]) >> 1);
+    }
+    return sample_count >> 1;   // We've just halved the the number of samples.
+}
+
+int usb_urb_to_mono(int16_t *data, const usb_packet_desc *packets, int packet_count,
+                    int channels) {
+    const size_t bytes = usb_compact_packets(reinterpret_cast<uint8_t *>(data), packets,
+                                             packet_count);
+    int samples = static_cast<int>(bytes / sizeof(int16_t));
+
+    // For stereo data, combine the two channels into a single channel:
+    if (channels == 2)
+        samples = usb_mix_stereo(data, samples);
+    return samples;
+}
+
+int usb_copy_to_ring(const int16_t *source, int source_samples, int16_t *ring, int ring_offset,
+                     int ring_size) {
+    const int16_t *pSource = source;
+    int16_t *pTarget = ring + ring_offset;
+    int samples_to_copy = source_samples;
+
+    // We need to copy to the destination buffer with wrap, so there may be two parts to the copy.
+
+    const int part1Space = ring_size - ring_offset;
+    const int part1Count = samples_to_copy > part1Space ? part1Space : samples_to_copy;
+    for (int i = 0; i < part1Count; i++) {
+        *pTarget++ = *pSource++;
+    }
+    samples_to_copy -= part1Count;
+
+    if (samples_to_copy > 0) {
+        pTarget = ring;  // Wrap to start of the buffer.
+        const int part2Required = samples_to_copy;
+        const int part2Count = part2Required > ring_size ? ring_size : part2Required;
+        for (int i = 0; i < part2Count; i++) {
+            *pTarget++ = *pSource++;
+        }
+        samples_to_copy -= part2Count;
+    }
+
+    // samples_to_copy should be 0 now.
+    return source_samples - samples_to_copy;
+}
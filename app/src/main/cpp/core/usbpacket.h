@@ -0,0 +1,72 @@
+/*
+ * Copyright (c) 2025 John Mears
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef BATGIZMO_USBPACKET_H
+#define BATGIZMO_USBPACKET_H
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * Compaction of the data in a reaped isochronous URB into contiguous mono samples.
+ *
+ * This is plain C++ with no JNI or Android dependencies.
+ */
+
+/**
+ * The lengths of one isochronous packet, laid out as struct usbdevfs_iso_packet_desc so that
+ * a URB's descriptors can be passed directly.
+ */
+struct usb_packet_desc {
+    unsigned int length;            // Requested length in bytes.
+    unsigned int actual_length;     // Length received in bytes.
+    unsigned int status;
+};
+
+/**
+ * Remove the padding between packets that are shorter than requested, so that the data
+ * received is contiguous at the start of the buffer. Returns the number of bytes received.
+ */
+size_t usb_compact_packets(uint8_t *data, const usb_packet_desc *packets, int packet_count);
+
+/**
+ * Combine interleaved stereo samples into a single channel in place, by averaging.
+ * sample_count counts both channels. Returns the number of mono samples.
+ */
+int usb_mix_stereo(int16_t *data, int sample_count);
+
+/**
+ * Reduce the data in a reaped URB to contiguous mono samples in place, as the live data
+ * path does: compact the packets, then mix stereo to mono. Returns the number of samples.
+ */
+int usb_urb_to_mono(int16_t *data, const usb_packet_desc *packets, int packet_count,
+                    int channels);
+
+/**
+ * Copy samples into a circular buffer of ring_size samples starting at ring_offset, wrapping
+ * to the start as required. Returns the number of samples copied, which is fewer than
+ * requested only if there are more than the buffer holds.
+ */
+int usb_copy_to_ring(const int16_t *source, int source_samples, int16_t *ring, int ring_offset,
+                     int ring_size);
+
+#endif //BATGIZMO_USBPACKET_H
@@ -0,0 +1,366 @@
+/*
+ * Copyright (c) 2025 John Mears
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "wavdecode.h"
+#include "workpool.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#define WAV_DECODE_SSE2 1
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#define WAV_DECODE_NEON 1
+#endif
+
+// Reads shorter than two chunks of this many frames are decoded on the calling thread:
+#define WAV_DECODE_MIN_CHUNK_FRAMES (64 * 1024)
+
+/**
+ * Wav data is little endian, as are all the platforms we run on, so values can be
+ * loaded directly. memcpy avoids unaligned access, and compiles to a plain load.
+ */
+
+static inline int16_t load_int16(const uint8_t *p) {
+    int16_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline int32_t load_int32(const uint8_t *p) {
+    int32_t v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+static inline float load_float(const uint8_t *p) {
+    float v;
+    memcpy(&v, p, sizeof(v));
+    return v;
+}
+
+// Load any integer format as a full scale 32 bit value:
+static inline int32_t load_full_scale(const uint8_t *p, int format) {
+    switch (format) {
+        case WAV_SAMPLE_INT16:
+            return static_cast<int32_t>(static_cast<uint32_t>(load_int16(p)) << 16);
+        case WAV_SAMPLE_INT24:
+            return static_cast<int32_t>((static_cast<uint32_t>(p[0]) << 8)
+                                        | (static_cast<uint32_t>(p[1]) << 16)
+                                        | (static_cast<uint32_t>(p[2]) << 24));
+        default:
+            return load_int32(p);
+    }
+}
+
+/**
+ * Scale a float to 16 bits, saturating. The order of the clamps means that NaN ends up
+ * as the minimum value, which matches what the SSE2 code does. The rounding is to nearest,
+ * as the SIMD conversions do.
+ */
+static inline int16_t float_to_int16(float f) {
+    float v = f * 32768.0f;
+    if (!(v >= -32768.0f))
+        v = -32768.0f;
+    if (v > 32767.0f)
+        v = 32767.0f;
+    return static_cast<int16_t>(lrintf(v));
+}
+
+// Division that rounds towards minus infinity, to match the arithmetic shifts used by SIMD code:
+static inline int64_t floor_divide(int64_t value, int divisor) {
+    int64_t q = value / divisor;
+    if (value % divisor != 0 && value < 0)
+        q--;
+    return q;
+}
+
+/**
+ * Decode a single frame. This is the reference implementation: the SIMD code below must
+ * produce identical results, and defers to this for any frames left over at the end.
+ */
+static inline int16_t decode_frame(const uint8_t *frame, int channels, int format,
+                                   int channel, int bytes_per_value) {
+    if (format == WAV_SAMPLE_FLOAT32) {
+        float value;
+        if (channel == WAV_CHANNEL_DOWNMIX) {
+            float sum = 0.0f;
+            for (int c = 0; c < channels; c++)
+                sum += load_float(frame + c * bytes_per_value);
+            value = sum * (1.0f / static_cast<float>(channels));
+        } else {
+            value = load_float(frame + channel * bytes_per_value);
+        }
+        return float_to_int16(value);
+    }
+
+    int64_t value;
+    if (channel == WAV_CHANNEL_DOWNMIX) {
+        int64_t sum = 0;
+        for (int c = 0; c < channels; c++)
+            sum += load_full_scale(frame + c * bytes_per_value, format);
+        value = floor_divide(sum, channels);
+    } else {
+        value = load_full_scale(frame + channel * bytes_per_value, format);
+    }
+    // Keep the most significant 16 bits:
+    return static_cast<int16_t>(value >> 16);
+}
+
+static void decode_scalar(const uint8_t *src, size_t first, size_t frames, int channels,
+                          int format, int channel, int16_t *dst) {
+    const int bytes_per_value = wav_bytes_per_value(format);
+    const size_t frame_bytes = static_cast<size_t>(bytes_per_value) * channels;
+    for (size_t i = first; i < frames; i++)
+        dst[i] = decode_frame(src + i * frame_bytes, channels, format, channel, bytes_per_value);
+}
+
+/**
+ * SIMD versions of the common cases. Each returns the number of frames it has handled,
+ * which may be fewer than requested; the caller finishes off with decode_scalar.
+ */
+
+static size_t decode_int16_simd(const uint8_t *src, size_t frames, int channels, int channel,
+                                int16_t *dst) {
+    size_t i = 0;
+    if (channels == 1) {
+        // Nothing to convert:
+        memcpy(dst, src, frames * sizeof(int16_t));
+        return frames;
+    }
+    if (channels != 2)
+        return 0;
+
+#if defined(WAV_DECODE_SSE2)
+    for (; i + 8 <= frames; i += 8) {
+        const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i * 4));
+        const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i * 4 + 16));
+        // Sign extend each channel to 32 bits:
+        const __m128i left_a = _mm_srai_epi32(_mm_slli_epi32(a, 16), 16);
+        const __m128i left_b = _mm_srai_epi32(_mm_slli_epi32(b, 16), 16);
+        const __m128i right_a = _mm_srai_epi32(a, 16);
+        const __m128i right_b = _mm_srai_epi32(b, 16);
+        __m128i out_a, out_b;
+        if (channel == WAV_CHANNEL_DOWNMIX) {
+            out_a = _mm_srai_epi32(_mm_add_epi32(left_a, right_a), 1);
+            out_b = _mm_srai_epi32(_mm_add_epi32(left_b, right_b), 1);
+        } else if (channel == 0) {
+            out_a = left_a;
+            out_b = left_b;
+        } else {
+            out_a = right_a;
+            out_b = right_b;
+        }
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), _mm_packs_epi32(out_a, out_b));
+    }
+#elif defined(WAV_DECODE_NEON)
+    for (; i + 8 <= frames; i += 8) {
+        const int16x8x2_t v = vld2q_s16(reinterpret_cast<const int16_t *>(src + i * 4));
+        int16x8_t out;
+        if (channel == WAV_CHANNEL_DOWNMIX)
+            out = vhaddq_s16(v.val[0], v.val[1]);   // (a + b) >> 1 without overflow.
+        else
+            out = v.val[channel];
+        vst1q_s16(dst + i, out);
+    }
+#endif
+    return i;
+}
+
+static size_t decode_int32_simd(const uint8_t *src, size_t frames, int channels, int16_t *dst) {
+    size_t i = 0;
+    if (channels != 1)
+        return 0;
+
+#if defined(WAV_DECODE_SSE2)
+    for (; i + 8 <= frames; i += 8) {
+        const __m128i a = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i * 4));
+        const __m128i b = _mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i * 4 + 16));
+        // After the shift the values are in range, so the saturating pack is exact:
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i),
+                         _mm_packs_epi32(_mm_srai_epi32(a, 16), _mm_srai_epi32(b, 16)));
+    }
+#elif defined(WAV_DECODE_NEON)
+    for (; i + 8 <= frames; i += 8) {
+        const int32x4_t a = vld1q_s32(reinterpret_cast<const int32_t *>(src + i * 4));
+        const int32x4_t b = vld1q_s32(reinterpret_cast<const int32_t *>(src + i * 4 + 16));
+        vst1q_s16(dst + i, vcombine_s16(vshrn_n_s32(a, 16), vshrn_n_s32(b, 16)));
+    }
+#endif
+    return i;
+}
+
+static size_t decode_float_simd(const uint8_t *src, size_t frames, int channels, int channel,
+                                int16_t *dst) {
+    size_t i = 0;
+    if (channels != 1 && channels != 2)
+        return 0;
+
+#if defined(WAV_DECODE_SSE2)
+    const __m128 scale = _mm_set1_ps(32768.0f);
+    const __m128 lo = _mm_set1_ps(-32768.0f);
+    const __m128 hi = _mm_set1_ps(32767.0f);
+    const __m128 half = _mm_set1_ps(0.5f);
+    const auto *p = reinterpret_cast<const float *>(src);
+    for (; i + 8 <= frames; i += 8) {
+        __m128 a, b;
+        if (channels == 1) {
+            a = _mm_loadu_ps(p + i);
+            b = _mm_loadu_ps(p + i + 4);
+        } else {
+            const float *f = p + i * 2;
+            const __m128 f0 = _mm_loadu_ps(f);
+            const __m128 f1 = _mm_loadu_ps(f + 4);
+            const __m128 f2 = _mm_loadu_ps(f + 8);
+            const __m128 f3 = _mm_loadu_ps(f + 12);
+            const __m128 left_a = _mm_shuffle_ps(f0, f1, _MM_SHUFFLE(2, 0, 2, 0));
+            const __m128 right_a = _mm_shuffle_ps(f0, f1, _MM_SHUFFLE(3, 1, 3, 1));
+            const __m128 left_b = _mm_shuffle_ps(f2, f3, _MM_SHUFFLE(2, 0, 2, 0));
+            const __m128 right_b = _mm_shuffle_ps(f2, f3, _MM_SHUFFLE(3, 1, 3, 1));
+            if (channel == WAV_CHANNEL_DOWNMIX) {
+                a = _mm_mul_ps(_mm_add_ps(left_a, right_a), half);
+                b = _mm_mul_ps(_mm_add_ps(left_b, right_b), half);
+            } else if (channel == 0) {
+                a = left_a;
+                b = left_b;
+            } else {
+                a = right_a;
+                b = right_b;
+            }
+        }
+        // Clamp before converting: out of range conversions don't saturate.
+        a = _mm_min_ps(_mm_max_ps(_mm_mul_ps(a, scale), lo), hi);
+        b = _mm_min_ps(_mm_max_ps(_mm_mul_ps(b, scale), lo), hi);
+        _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i),
+                         _mm_packs_epi32(_mm_cvtps_epi32(a), _mm_cvtps_epi32(b)));
+    }
+#elif defined(WAV_DECODE_NEON)
+    const float32x4_t lo = vdupq_n_f32(-32768.0f);
+    const float32x4_t hi = vdupq_n_f32(32767.0f);
+    const auto *p = reinterpret_cast<const float *>(src);
+    for (; i + 8 <= frames; i += 8) {
+        float32x4_t a, b;
+        if (channels == 1) {
+            a = vld1q_f32(p + i);
+            b = vld1q_f32(p + i + 4);
+        } else {
+            const float32x4x2_t fa = vld2q_f32(p + i * 2);
+            const float32x4x2_t fb = vld2q_f32(p + i * 2 + 8);
+            if (channel == WAV_CHANNEL_DOWNMIX) {
+                a = vmulq_n_f32(vaddq_f32(fa.val[0], fa.val[1]), 0.5f);
+                b = vmulq_n_f32(vaddq_f32(fb.val[0], fb.val[1]), 0.5f);
+            } else {
+                a = fa.val[channel];
+                b = fb.val[channel];
+            }
+        }
+        // vmaxnm maps NaN to the lower limit, as the scalar code does:
+        a = vminq_f32(vmaxnmq_f32(vmulq_n_f32(a, 32768.0f), lo), hi);
+        b = vminq_f32(vmaxnmq_f32(vmulq_n_f32(b, 32768.0f), lo), hi);
+        vst1q_s16(dst + i, vcombine_s16(vmovn_s32(vcvtnq_s32_f32(a)), vmovn_s32(vcvtnq_s32_f32(b))));
+    }
+#endif
+    return i;
+}
+
+int wav_bytes_per_value(int format) {
+    switch (format) {
+        case WAV_SAMPLE_INT16:
+            return 2;
+        case WAV_SAMPLE_INT24:
+            return 3;
+        case WAV_SAMPLE_INT32:
+        case WAV_SAMPLE_FLOAT32:
+            return 4;
+        default:
+            return 0;
+    }
+}
+
+/**
+ * Decode frames with arguments that have already been checked.
+ */
+static void decode_frames(const uint8_t *src, size_t frames, int channels, int format,
+                          int channel, int16_t *dst) {
+    size_t done = 0;
+    switch (format) {
+        case WAV_SAMPLE_INT16:
+            done = decode_int16_simd(src, frames, channels, channel, dst);
+            break;
+        case WAV_SAMPLE_INT32:
+            done = decode_int32_simd(src, frames, channels, dst);
+            break;
+        case WAV_SAMPLE_FLOAT32:
+            done = decode_float_simd(src, frames, channels, channel, dst);
+            break;
+        default:
+            // 24 bit data has no natural SIMD lane size, so it is left to the compiler.
+            break;
+    }
+
+    decode_scalar(src, done, frames, channels, format, channel, dst);
+}
+
+/**
+ * The number of chunks to decode frames in, one per thread that takes part.
+ */
+static int decode_chunks(size_t frames) {
+    return (int) std::min<size_t>(frames / WAV_DECODE_MIN_CHUNK_FRAMES,
+                                  work_pool_workers(work_pool_shared()) + 1);
+}
+
+int wav_decode_to_int16(const uint8_t *src, size_t frames, int channels, int format,
+                        int channel, int16_t *dst) {
+    if (src == nullptr || dst == nullptr || wav_bytes_per_value(format) == 0)
+        return -1;
+    if (channels < 1 || channels > WAV_MAX_CHANNELS)
+        return -1;
+    if (channel != WAV_CHANNEL_DOWNMIX && (channel < 0 || channel >= channels))
+        return -1;
+
+    // Downmixing a single channel is the same as selecting it:
+    if (channels == 1)
+        channel = 0;
+
+    // Large reads, such as a page of a file, are decoded in chunks on the work pool:
+    const size_t bytes_per_frame = (size_t) channels * wav_bytes_per_value(format);
+    const int chunks = decode_chunks(frames);
+    if (chunks <= 1) {
+        decode_frames(src, frames, channels, format, channel, dst);
+    } else {
+        work_pool_parallel_for(work_pool_shared(), work_current_priority(), chunks, [&](int c) {
+            const size_t first = frames * c / chunks;
+            const size_t last = frames * (c + 1) / chunks;
+            decode_frames(src + first * bytes_per_frame, last - first, channels, format,
+                          channel, dst + first);
+        });
+    }
+
+    return static_cast<int>(frames);
+}
+
+bool wav_decode_is_parallel(size_t frames) {
+    return decode_chunks(frames) > 1;
+}
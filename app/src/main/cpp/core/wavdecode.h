@@ -0,0 +1,74 @@
+/*
+ * Copyright (c) 2025 John Mears
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef BATGIZMO_WAVDECODE_H
+#define BATGIZMO_WAVDECODE_H
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * Conversion of interleaved wav file sample data to the 16 bit mono samples that the
+ * rest of the pipeline works with. Multichannel data is either reduced to a single
+ * selected channel, or downmixed by averaging the channels, in the same pass.
+ *
+ * This is plain C++ with no JNI or Android dependencies.
+ */
+
+// Sample encodings we can decode. The values are shared with WavFileParser.kt.
+enum wav_sample_format {
+    WAV_SAMPLE_INT16 = 0,       // 16 bit signed little endian PCM.
+    WAV_SAMPLE_INT24 = 1,       // 24 bit signed little endian PCM, packed in 3 bytes.
+    WAV_SAMPLE_INT32 = 2,       // 32 bit signed little endian PCM.
+    WAV_SAMPLE_FLOAT32 = 3,     // 32 bit IEEE float, nominally in the range -1 to 1.
+};
+
+#define WAV_MAX_CHANNELS 8
+
+// Pass this as the channel to average all channels instead of selecting one:
+#define WAV_CHANNEL_DOWNMIX (-1)
+
+/**
+ * Return the number of bytes used by one value in the format supplied, or 0 if the
+ * format is unknown.
+ */
+int wav_bytes_per_value(int format);
+
+/**
+ * Decode frames of interleaved sample data from src into dst, one int16_t per frame.
+ * channel selects the channel to extract, or is WAV_CHANNEL_DOWNMIX.
+ *
+ * Higher resolution data is reduced to 16 bits by discarding the low order bits; float data
+ * is scaled and saturated.
+ *
+ * Returns the number of frames decoded, or -1 if the arguments are not supported.
+ */
+int wav_decode_to_int16(const uint8_t *src, size_t frames, int channels, int format,
+                        int channel, int16_t *dst);
+
+/**
+ * Return true if wav_decode_to_int16 would decode this many frames in chunks on the work
+ * pool, rather than on the calling thread alone.
+ */
+bool wav_decode_is_parallel(size_t frames);
+
+#endif //BATGIZMO_WAVDECODE_H
@@ -0,0 +1,257 @@
+/*
+ * Copyright (c) 2025 John Mears
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "wavreader.h"
+#include "wavdecode.h"
+
+#include <algorithm>
+#include <cctype>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <sys/types.h>
+
+static const uint32_t RF64_SIZE_PLACEHOLDER = 0xFFFFFFFF;
+
+static const int FORMAT_PCM = 1;
+static const int FORMAT_IEEE_FLOAT = 3;
+static const int FORMAT_EXTENSIBLE = 0xFFFE;
+
+static bool read_bytes(FILE *f, void *target, size_t count) {
+    return fread(target, 1, count, f) == count;
+}
+
+static bool read_u16(FILE *f, uint16_t *value) {
+    uint8_t b[2];
+    if (!read_bytes(f, b, sizeof(b)))
+        return false;
+    *value = static_cast<uint16_t>(b[0] | (b[1] << 8));
+    return true;
+}
+
+static bool read_u32(FILE *f, uint32_t *value) {
+    uint8_t b[4];
+    if (!read_bytes(f, b, sizeof(b)))
+        return false;
+    *value = static_cast<uint32_t>(b[0]) | (static_cast<uint32_t>(b[1]) << 8)
+             | (static_cast<uint32_t>(b[2]) << 16) | (static_cast<uint32_t>(b[3]) << 24);
+    return true;
+}
+
+static bool read_u64(FILE *f, uint64_t *value) {
+    uint32_t low, high;
+    if (!read_u32(f, &low) || !read_u32(f, &high))
+        return false;
+    *value = (static_cast<uint64_t>(high) << 32) | low;
+    return true;
+}
+
+static int fail(wav_reader *reader, std::string *error, const std::string &message) {
+    if (error != nullptr)
+        *error = message;
+    wav_reader_close(reader);
+    return -1;
+}
+
+static int parse_fmt(FILE *f, uint32_t chunk_size, wav_reader *reader, std::string *error) {
+    uint16_t format_tag, channels, block_align, bits;
+    uint32_t rate, byte_rate;
+    if (chunk_size < 16 || !read_u16(f, &format_tag) || !read_u16(f, &channels)
+        || !read_u32(f, &rate) || !read_u32(f, &byte_rate) || !read_u16(f, &block_align)
+        || !read_u16(f, &bits)) {
+        *error = "truncated fmt chunk";
+        return -1;
+    }
+    uint32_t consumed = 16;
+
+    if (format_tag == FORMAT_EXTENSIBLE) {
+        uint8_t extension[24];
+        if (chunk_size < 16 + sizeof(extension) || !read_bytes(f, extension, sizeof(extension))) {
+            *error = "truncated extensible fmt chunk";
+            return -1;
+        }
+        consumed += sizeof(extension);
+        // The sub format GUID starts with the format tag:
+        format_tag = static_cast<uint16_t>(extension[8] | (extension[9] << 8));
+    }
+
+    int sample_format;
+    if (format_tag == FORMAT_IEEE_FLOAT && bits == 32)
+        sample_format = WAV_SAMPLE_FLOAT32;
+    else if (format_tag == FORMAT_PCM && bits == 16)
+        sample_format = WAV_SAMPLE_INT16;
+    else if (format_tag == FORMAT_PCM && bits == 24)
+        sample_format = WAV_SAMPLE_INT24;
+    else if (format_tag == FORMAT_PCM && bits == 32)
+        sample_format = WAV_SAMPLE_INT32;
+    else {
+        *error = "unsupported sample format " + std::to_string(format_tag) + ", "
+                 + std::to_string(bits) + " bits";
+        return -1;
+    }
+
+    if (channels < 1 || channels > WAV_MAX_CHANNELS || rate == 0) {
+        *error = "unsupported channel count or sample rate";
+        return -1;
+    }
+
+    reader->channels = channels;
+    reader->sample_rate = static_cast<int>(rate);
+    reader->bits_per_sample = bits;
+    reader->sample_format = sample_format;
+
+    // Skip anything else, and any padding:
+    return fseeko(f, static_cast<off_t>(chunk_size - consumed + (chunk_size & 1)), SEEK_CUR);
+}
+
+// Look for a GUANO Samplerate, which overrides the header when present.
+static void parse_guano(FILE *f, uint32_t chunk_size, wav_reader *reader) {
+    std::string text(chunk_size, '\0');
+    if (!read_bytes(f, text.data(), chunk_size))
+        return;
+    if (chunk_size & 1)
+        fseeko(f, 1, SEEK_CUR);
+
+    size_t start = 0;
+    while (start < text.size()) {
+        size_t end = text.find('\n', start);
+        if (end == std::string::npos)
+            end = text.size();
+        const std::string line = text.substr(start, end - start);
+        const size_t colon = line.find(':');
+        if (colon != std::string::npos) {
+            std::string key = line.substr(0, colon);
+            key.erase(std::remove_if(key.begin(), key.end(), ::isspace), key.end());
+            std::transform(key.begin(), key.end(), key.begin(), ::tolower);
+            if (key == "samplerate") {
+                const int rate = atoi(line.c_str() + colon + 1);
+                if (rate > 0)
+                    reader->sample_rate = rate;
+            }
+        }
+        start = end + 1;
+    }
+}
+
+int wav_reader_open(wav_reader *reader, const char *path, std::string *error) {
+    wav_reader_close(reader);
+
+    FILE *f = fopen(path, "rb");
+    if (f == nullptr)
+        return fail(reader, error, std::string("unable to open: ") + strerror(errno));
+    reader->file = f;
+
+    fseeko(f, 0, SEEK_END);
+    const int64_t file_length = ftello(f);
+    fseeko(f, 0, SEEK_SET);
+
+    char id[4];
+    uint32_t riff_size;
+    char wave[4];
+    if (!read_bytes(f, id, 4) || !read_u32(f, &riff_size) || !read_bytes(f, wave, 4))
+        return fail(reader, error, "file too short");
+    if ((memcmp(id, "RIFF", 4) != 0 && memcmp(id, "RF64", 4) != 0 && memcmp(id, "BW64", 4) != 0)
+        || memcmp(wave, "WAVE", 4) != 0)
+        return fail(reader, error, "not a wav file");
+
+    uint64_t ds64_data_size = 0;
+    bool have_ds64 = false, have_fmt = false, have_data = false;
+    int64_t data_bytes = 0;
+
+    while (ftello(f) + 8 <= file_length) {
+        char chunk_id[4];
+        uint32_t chunk_size;
+        if (!read_bytes(f, chunk_id, 4) || !read_u32(f, &chunk_size))
+            break;
+
+        if (memcmp(chunk_id, "ds64", 4) == 0) {
+            uint64_t riff64;
+            if (chunk_size < 28 || !read_u64(f, &riff64) || !read_u64(f, &ds64_data_size))
+                return fail(reader, error, "bad ds64 chunk");
+            have_ds64 = true;
+            fseeko(f, static_cast<off_t>(chunk_size - 16 + (chunk_size & 1)), SEEK_CUR);
+        } else if (memcmp(chunk_id, "fmt ", 4) == 0 && !have_fmt) {
+            std::string fmt_error;
+            if (parse_fmt(f, chunk_size, reader, &fmt_error) != 0)
+                return fail(reader, error, fmt_error);
+            have_fmt = true;
+        } else if (memcmp(chunk_id, "guan", 4) == 0) {
+            parse_guano(f, chunk_size, reader);
+        } else if (memcmp(chunk_id, "data", 4) == 0 && !have_data) {
+            if (!have_fmt)
+                return fail(reader, error, "data chunk found without fmt header");
+            reader->data_start = ftello(f);
+            data_bytes = chunk_size;
+            if (chunk_size == RF64_SIZE_PLACEHOLDER && have_ds64)
+                data_bytes = static_cast<int64_t>(ds64_data_size);
+            // Recorders sometimes write the header in advance and never correct it:
+            data_bytes = std::min(data_bytes, file_length - reader->data_start);
+            have_data = true;
+            fseeko(f, static_cast<off_t>(data_bytes + (data_bytes & 1)), SEEK_CUR);
+        } else {
+            fseeko(f, static_cast<off_t>(chunk_size) + (chunk_size & 1), SEEK_CUR);
+        }
+    }
+
+    if (!have_fmt || !have_data)
+        return fail(reader, error, "both fmt and data chunks must be present");
+
+    const int frame_bytes = wav_bytes_per_value(reader->sample_format) * reader->channels;
+    reader->frame_count = data_bytes / frame_bytes;
+    return 0;
+}
+
+int wav_reader_read(wav_reader *reader, int64_t first_frame, int frames, int channel,
+                    int16_t *target) {
+    if (reader->file == nullptr || first_frame < 0 || frames < 0)
+        return -1;
+
+    const int64_t available = reader->frame_count - first_frame;
+    if (available <= 0)
+        return 0;
+    if (frames > available)
+        frames = static_cast<int>(available);
+
+    const int frame_bytes = wav_bytes_per_value(reader->sample_format) * reader->channels;
+    const size_t byte_count = static_cast<size_t>(frames) * frame_bytes;
+    if (reader->buffer.size() < byte_count)
+        reader->buffer.resize(byte_count);
+
+    if (fseeko(reader->file, static_cast<off_t>(reader->data_start + first_frame * frame_bytes),
+               SEEK_SET) != 0)
+        return -1;
+    const size_t bytes_read = fread(reader->buffer.data(), 1, byte_count, reader->file);
+    const int frames_read = static_cast<int>(bytes_read / frame_bytes);
+
+    if (channel != WAV_CHANNEL_DOWNMIX)
+        channel = std::min(channel, reader->channels - 1);
+    return wav_decode_to_int16(reader->buffer.data(), frames_read, reader->channels,
+                               reader->sample_format, channel, target);
+}
+
+void wav_reader_close(wav_reader *reader) {
+    if (reader->file != nullptr) {
+        fclose(reader->file);
+        reader->file = nullptr;
+    }
+    reader->frame_count = 0;
+}
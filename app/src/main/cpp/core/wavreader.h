@@ -0,0 +1,65 @@
+/*
+ * Copyright (c) 2025 John Mears
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef BATGIZMO_WAVREADER_H
+#define BATGIZMO_WAVREADER_H
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+
+/**
+ * A minimal wav file reader for use off the device, by host tools. It understands the same
+ * files as WavFileParser.kt - RIFF, RF64 and BW64, with any sample format supported by
+ * wavdecode - and likewise lets a GUANO Samplerate override the header.
+ *
+ * On the device, files are read by the Kotlin code.
+ */
+
+struct wav_reader {
+    FILE *file = nullptr;
+    int channels = 0;
+    int sample_rate = 0;
+    int bits_per_sample = 0;
+    int sample_format = 0;          // One of wav_sample_format.
+    int64_t data_start = 0;         // File offset of the first sample.
+    int64_t frame_count = 0;        // Frames actually present, which may be fewer than the header says.
+    std::vector<uint8_t> buffer;    // Reused for raw data between reads.
+};
+
+/**
+ * Open and parse the file. Returns 0 on success, or -1 with a description in *error.
+ */
+int wav_reader_open(wav_reader *reader, const char *path, std::string *error);
+
+/**
+ * Read up to frames frames starting at first_frame, converting them to one 16 bit value each,
+ * selecting channel or downmixing (WAV_CHANNEL_DOWNMIX). Returns the number of frames read,
+ * which is fewer than requested at the end of the data, or -1 on error.
+ */
+int wav_reader_read(wav_reader *reader, int64_t first_frame, int frames, int channel,
+                    int16_t *target);
+
+void wav_reader_close(wav_reader *reader);
+
+#endif //BATGIZMO_WAVREADER_H
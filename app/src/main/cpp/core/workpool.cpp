@@ -0,0 +1,279 @@
+/*
+ * Copyright (c) 2025 John Mears
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include "workpool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdio>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#define WORK_POOL_MAX_WORKERS 16
+
+struct work_queue {
+    std::mutex mutex;
+    std::deque<std::function<void()>> tasks[WORK_PRIORITY_COUNT];
+};
+
+struct work_pool {
+    cpu_topology topology = {};
+    std::vector<std::unique_ptr<work_queue>> queues;    // One per worker.
+    std::vector<std::thread> threads;
+    std::atomic<int> queued{0};
+    std::atomic<unsigned> next_queue{0};
+    std::mutex sleep_mutex;
+    std::condition_variable wake;
+    bool stopping = false;                              // Guarded by sleep_mutex.
+};
+
+/**
+ * State shared between the threads taking part in a parallel loop. It is reference counted,
+ * as helper tasks may only get to run after the loop has finished.
+ */
+struct work_loop {
+    int count = 0;
+    const std::function<void(int)> *body = nullptr;     // Only used while the loop runs.
+    std::atomic<int> next{0};
+    std::atomic<int> unfinished{0};
+    std::mutex mutex;
+    std::condition_variable done;
+};
+
+// The pool and worker index of the calling thread, if it is a worker:
+static thread_local work_pool *t_pool = nullptr;
+static thread_local int t_worker = -1;
+static thread_local int t_priority = WORK_PRIORITY_DISPLAY;
+
+cpu_topology cpu_topology_detect() {
+    cpu_topology topology = {};
+    topology.cores = std::max(1, (int) std::thread::hardware_concurrency());
+
+    // The big cores are any faster than the slowest:
+    long max_freqs[256];
+    const int cpus = std::min(topology.cores, 256);
+    long min_freq = 0;
+    bool known = true;
+    for (int cpu = 0; cpu < cpus && known; cpu++) {
+        char path[96];
+        snprintf(path, sizeof(path), "/sys/devices/system/cpu/cpu%d/cpufreq/cpuinfo_max_freq", cpu);
+        FILE *f = fopen(path, "r");
+        known = f != nullptr && fscanf(f, "%ld", &max_freqs[cpu]) == 1 && max_freqs[cpu] > 0;
+        if (f != nullptr)
+            fclose(f);
+        if (known)
+            min_freq = cpu == 0 ? max_freqs[cpu] : std::min(min_freq, max_freqs[cpu]);
+    }
+
+    topology.big_cores = 0;
+    if (known) {
+        for (int cpu = 0; cpu < cpus; cpu++) {
+            if (max_freqs[cpu] > min_freq)
+                topology.big_cores++;
+        }
+    }
+    if (topology.big_cores == 0)
+        topology.big_cores = topology.cores;
+    return topology;
+}
+
+/**
+ * Take the highest priority task available to a worker: the newest on its own queue, or
+ * the oldest on another worker's.
+ */
+static bool take_task(work_pool *pool, int worker, std::function<void()> *task, int *priority) {
+    const int n = (int) pool->queues.size();
+    for (int p = 0; p < WORK_PRIORITY_COUNT; p++) {
+        for (int i = 0; i < n; i++) {
+            work_queue *queue = pool->queues[(worker + i) % n].get();
+            std::lock_guard<std::mutex> lock(queue->mutex);
+            std::deque<std::function<void()>> &tasks = queue->tasks[p];
+            if (tasks.empty())
+                continue;
+            if (i == 0) {
+                *task = std::move(tasks.back());
+                tasks.pop_back();
+            } else {
+                *task = std::move(tasks.front());
+                tasks.pop_front();
+            }
+            pool->queued.fetch_sub(1);
+            *priority = p;
+            return true;
+        }
+    }
+    return false;
+}
+
+static void worker_main(work_pool *pool, int worker) {
+    t_pool = pool;
+    t_worker = worker;
+    for (;;) {
+        std::function<void()> task;
+        int priority;
+        if (take_task(pool, worker, &task, &priority)) {
+            t_priority = priority;
+            task();
+            t_priority = WORK_PRIORITY_DISPLAY;
+            continue;
+        }
+
+        std::unique_lock<std::mutex> lock(pool->sleep_mutex);
+        pool->wake.wait(lock, [pool] { return pool->stopping || pool->queued.load() > 0; });
+        if (pool->stopping && pool->queued.load() == 0)
+            return;
+    }
+}
+
+work_pool *work_pool_create(int workers, const cpu_topology *topology) {
+    auto *pool = new(std::nothrow) work_pool;
+    if (pool == nullptr)
+        return nullptr;
+    pool->topology = *topology;
+    workers = std::clamp(workers, 0, WORK_POOL_MAX_WORKERS);
+    try {
+        for (int w = 0; w < workers; w++)
+            pool->queues.push_back(std::make_unique<work_queue>());
+        for (int w = 0; w < workers; w++)
+            pool->threads.emplace_back(worker_main, pool, w);
+    } catch (...) {
+        work_pool_destroy(pool);
+        return nullptr;
+    }
+    return pool;
+}
+
+void work_pool_destroy(work_pool *pool) {
+    if (pool == nullptr)
+        return;
+    {
+        std::lock_guard<std::mutex> lock(pool->sleep_mutex);
+        pool->stopping = true;
+    }
+    pool->wake.notify_all();
+    for (std::thread &thread: pool->threads)
+        thread.join();
+    delete pool;
+}
+
+work_pool *work_pool_shared() {
+    // Never destroyed: the workers last as long as the process.
+    static work_pool *s_shared = [] {
+        const cpu_topology topology = cpu_topology_detect();
+        return work_pool_create(topology.cores - 1, &topology);
+    }();
+    return s_shared;
+}
+
+int work_pool_workers(const work_pool *pool) {
+    return pool == nullptr ? 0 : (int) pool->threads.size();
+}
+
+void work_pool_submit(work_pool *pool, int priority, std::function<void()> task) {
+    // With no workers, there is nothing for it but to run the task now:
+    if (work_pool_workers(pool) == 0) {
+        const int previous = t_priority;
+        t_priority = priority;
+        task();
+        t_priority = previous;
+        return;
+    }
+
+    priority = std::clamp(priority, 0, WORK_PRIORITY_COUNT - 1);
+    const int n = (int) pool->queues.size();
+    const int index = t_pool == pool ? t_worker : (int) (pool->next_queue.fetch_add(1) % n);
+    {
+        std::lock_guard<std::mutex> lock(pool->queues[index]->mutex);
+        pool->queues[index]->tasks[priority].push_back(std::move(task));
+    }
+    pool->queued.fetch_add(1);
+
+    // Take the lock so that a worker can't miss the wake up between checking for work
+    // and waiting:
+    { std::lock_guard<std::mutex> lock(pool->sleep_mutex); }
+    pool->wake.notify_one();
+}
+
+/**
+ * Run iterations of a loop until there are none left to start.
+ */
+static void run_loop(const std::shared_ptr<work_loop> &loop) {
+    for (;;) {
+        const int i = loop->next.fetch_add(1);
+        if (i >= loop->count)
+            return;
+        (*loop->body)(i);
+        if (loop->unfinished.fetch_sub(1) == 1) {
+            std::lock_guard<std::mutex> lock(loop->mutex);
+            loop->done.notify_all();
+        }
+    }
+}
+
+void work_pool_parallel_for(work_pool *pool, int priority, int count,
+                            const std::function<void(int)> &body) {
+    if (count <= 0)
+        return;
+
+    int helpers = std::min(count - 1, work_pool_workers(pool));
+    if (priority == WORK_PRIORITY_DISPLAY && pool != nullptr)
+        helpers = std::min(helpers, pool->topology.big_cores - 1);
+
+    const int previous = t_priority;
+    t_priority = priority;
+
+    if (helpers <= 0) {
+        for (int i = 0; i < count; i++)
+            body(i);
+    } else {
+        auto loop = std::make_shared<work_loop>();
+        loop->count = count;
+        loop->body = &body;
+        loop->unfinished = count;
+
+        for (int h = 0; h < helpers; h++)
+            work_pool_submit(pool, priority, [loop] { run_loop(loop); });
+        run_loop(loop);
+
+        // Wait for iterations that other threads started:
+        std::unique_lock<std::mutex> lock(loop->mutex);
+        loop->done.wait(lock, [&loop] { return loop->unfinished.load() == 0; });
+    }
+
+    t_priority = previous;
+}
+
+int work_current_priority() {
+    return t_priority;
+}
+
+work_priority_scope::work_priority_scope(int priority) : previous(t_priority) {
+    t_priority = priority;
+}
+
+work_priority_scope::~work_priority_scope() {
+    t_priority = previous;
+}
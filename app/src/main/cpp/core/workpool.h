@@ -0,0 +1,125 @@
+/*
+ * Copyright (c) 2025 John Mears
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#ifndef BATGIZMO_WORKPOOL_H
+#define BATGIZMO_WORKPOOL_H
+
+#include <functional>
+
+/**
+ * A work stealing thread pool shared by all native DSP work: FFT batches, colour map
+ * stripes, BnC searches, file decoding, and background jobs.
+ *
+ * Each worker has its own queue for each priority. Tasks submitted from a worker go on its
+ * own queue, and others are spread across the workers. An idle worker takes the newest task
+ * from its own queue, or steals the oldest from another worker's. Display work is always
+ * taken before background work, so a long background job never delays the live display by
+ * more than the time to finish one of its tasks; background jobs should therefore be split
+ * into short tasks.
+ *
+ * A thread that waits for a parallel loop helps with it, so loops may be nested, and may be
+ * used from threads outside the pool. Nested work inherits the priority of the task it runs
+ * in; a thread outside the pool is display priority unless it declares otherwise with a
+ * work_priority_scope.
+ *
+ * The CPU topology only limits how many workers help with display work. No thread affinity
+ * is set, so the scheduler still decides which cores the workers run on.
+ *
+ * This is plain C++ with no JNI or Android dependencies.
+ */
+
+enum work_priority {
+    WORK_PRIORITY_DISPLAY,      // Work the user is waiting to see, live or in the viewer.
+    WORK_PRIORITY_BACKGROUND,   // Anything that can wait.
+    WORK_PRIORITY_COUNT
+};
+
+/**
+ * The cores available, and how many of them are the fastest ("big") cores on a big.LITTLE
+ * device. big_cores equals cores on devices where all cores are the same.
+ */
+struct cpu_topology {
+    int cores;
+    int big_cores;
+};
+
+struct work_pool;
+
+/**
+ * Find the CPU topology from the maximum frequency of each core in sysfs, falling back to
+ * treating every core as big if that isn't available.
+ */
+cpu_topology cpu_topology_detect();
+
+/**
+ * Create a pool with the number of worker threads supplied, for a device with the topology
+ * supplied. Returns null on failure.
+ */
+work_pool *work_pool_create(int workers, const cpu_topology *topology);
+
+/**
+ * Run any tasks still queued, stop the workers and free the pool.
+ */
+void work_pool_destroy(work_pool *pool);
+
+/**
+ * The pool shared by the whole process, created on first use with a worker for each core
+ * apart from the one the calling thread uses.
+ */
+work_pool *work_pool_shared();
+
+int work_pool_workers(const work_pool *pool);
+
+/**
+ * Queue a task to run on a worker, without waiting for it.
+ */
+void work_pool_submit(work_pool *pool, int priority, std::function<void()> task);
+
+/**
+ * Call body(i) for each i from 0 to count - 1, in parallel, returning when all have
+ * finished. The calling thread takes part. Display work is limited to the number of big
+ * cores, as a share of a loop on a little core would finish last and hold up the display.
+ */
+void work_pool_parallel_for(work_pool *pool, int priority, int count,
+                            const std::function<void(int)> &body);
+
+/**
+ * The priority of the task running on the calling thread, so that nested work can inherit
+ * it. Threads outside the pool are display priority, unless in a work_priority_scope.
+ */
+int work_current_priority();
+
+/**
+ * Run the calling thread's work at a priority for the life of the scope, so that pool work it
+ * submits, directly or from nested kernels, is queued at that priority.
+ */
+struct work_priority_scope {
+    explicit work_priority_scope(int priority);
+    ~work_priority_scope();
+
+    work_priority_scope(const work_priority_scope &) = delete;
+    work_priority_scope &operator=(const work_priority_scope &) = delete;
+
+    int previous;
+};
+
+#endif //BATGIZMO_WORKPOOL_H
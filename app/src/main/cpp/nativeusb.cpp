@@ -38,6 +38,16 @@
 #include <aaudio/AAudio.h>
 #include <assert.h>
 #include <memory.h>
+#include <stddef.h>
+#include <time.h>
+#include <sched.h>
+#include <atomic>
+
+#include "core/heterodyne.h"
+#include "core/synthsource.h"
+#include "core/telemetry.h"
+#include "core/urbcapture.h"
+#include "core/usbpacket.h"
 
 extern "C" {
 }
@@ -54,6 +64,11 @@ extern "C" {
 // Aim for about 20 URBs per second to give a reasonable UI update rate
 // while minimizing overheads:
 #define URBS_TO_JUGGLE 10        // At least 2 required. More allows a greater queuing depth without loss.
+// Synthetic streaming isn't paced by URBs, so it cycles through more buffers: more than
+// LiveDataBridge's rendering and file writer channels (10 each) and their consumers can hold
+// between them, so a buffer is never rewritten while it is still queued:
+#define RENDERING_CHANNEL_CAPACITY 10
+#define AUDIO_BUFFERS (2 * (RENDERING_CHANNEL_CAPACITY + 1) + 2)
 #define PACKETS_PER_URB (1000 / URBS_PER_SECOND)   // One packet (frame) is 1 ms.
 #define MAX_DATA_POINTS_PER_URB (MAX_SAMPLES_PER_FRAME * MAX_CHANNELS * PACKETS_PER_URB)
 
@@ -61,7 +76,10 @@ extern "C" {
 
 #define STREAM_TO_WAV 0
 
-//#define FAKE_DATA 1
+// The synthetic source generates mono data at rates beyond full speed USB, which still fits
+// in the URB buffers:
+static_assert(SYNTH_MAX_SAMPLE_RATE / 1000 * PACKETS_PER_URB <= MAX_DATA_POINTS_PER_URB,
+              "URB buffers too small for the synthetic source");
 
 // A type representing the audio data we handle:
 typedef int16_t data_t;
@@ -85,13 +103,6 @@ static AAudioStream *s_android_stream = nullptr;      // The output stream.
 static volatile int s_decimation_factor = 0;
 static volatile int s_audio_out_rate = 0;
 
-static int32_t calculate_iir_coefficient(double cutoff_hz, double sample_rate_hz) {
-    double exponent = -2.0 * M_PI * cutoff_hz / sample_rate_hz;
-    double a = 1.0 - exp(exponent);
-    auto s_downsampling_iir_coefficient = (int32_t) lround(a * (1LL << 31));
-    return s_downsampling_iir_coefficient;
-}
-
 /*
  * This mutex protects static data in this module.
  */
@@ -101,34 +112,19 @@ static pthread_mutex_t s_mutex = PTHREAD_RECURSIVE_MUTEX_INITIALIZER_NP;
 #define CANARY_VALUE_32 0xFABDECAF
 #define CANARY_DATA_VALUE ((data_t) 0xFACE)
 
-// Any array to hold the heterodyne reference signal:
-#define MAX_REFERENCE_LEN 512
-static int16_t s_reference_data[MAX_REFERENCE_LEN + CANARY_COUNT];
-static int s_reference_len = 0;
-static volatile int s_reference1_index = 0, s_reference2_index = 0;
-static int s_heterodyne1_kHz = 0, s_heterodyne2_kHz = 0;
-static int s_audio_boost_shift = 0;
-
-// Adjust this so that there is no heterodyned audio output visible over
-// about 10 kHz:
-#define DOWNSAMPLING_AA_CUTOFF_HZ 3000      // Conservative (low) value to minimize bleed through/feedback.
-#define DOWNSAMPLING_AA_STAGES 4            // Order of the LPF
-
-typedef struct {
-    int32_t previous[DOWNSAMPLING_AA_STAGES];
-} aa_filter_state_t;
-
-static int32_t s_downsampling_iir_coefficient = 0;
-static aa_filter_state_t s_downsampling_filter_state;
+// The heterodyne reference signal, filter and decimation state for audio output:
+static heterodyne_state s_heterodyne;
 
-static void downsampling_filter_reset() {
-    memset(&s_downsampling_filter_state, 0, sizeof(s_downsampling_filter_state));
-}
+// The file descriptor we are capturing raw URBs to for later replay, or -1 if we aren't:
+static int s_fd_capture = -1;
+static bool s_capture_started = false;
+static int64_t s_capture_start_ns = 0;
 
 static bool start_audio_output(jint output_device_id);
 static void stop_audio_output();
 static void write_audio_output(const data_t *pBuffer, uint32_t sample_count, jint num_channels);
 static void stop_recording();
+static void stop_urb_capture();
 
 /*
  * Workaround for usbdevfs_iso_packet_desc having size 0 in usbdevfs_urb:
@@ -138,6 +134,11 @@ struct my_usbdevfs_urb {
     struct usbdevfs_iso_packet_desc packet_desc[PACKETS_PER_URB];
 };
 
+// The packet descriptors are passed to the core as they are:
+static_assert(sizeof(usb_packet_desc) == sizeof(usbdevfs_iso_packet_desc), "packet descriptor size");
+static_assert(offsetof(usb_packet_desc, length) == offsetof(usbdevfs_iso_packet_desc, length), "packet length offset");
+static_assert(offsetof(usb_packet_desc, actual_length) == offsetof(usbdevfs_iso_packet_desc, actual_length), "packet actual_length offset");
+
 
 /***********************************************************************************/
 /* Basic data stream from USB.                                                     */
@@ -152,14 +153,17 @@ struct my_usbdevfs_urb {
  * This data has to be statically allocated as it may be referenced after a stream has
  * been closed, due to asynchronous processing
  */
-static int16_t audio_buffer[URBS_TO_JUGGLE][MAX_DATA_POINTS_PER_URB + CANARY_COUNT];
+static int16_t audio_buffer[AUDIO_BUFFERS][MAX_DATA_POINTS_PER_URB + CANARY_COUNT];
+
+// When each buffer was passed to kotlin, for telemetry of the channel latency, or 0:
+static std::atomic<int64_t> s_published_ns[AUDIO_BUFFERS];
 //static int16_t urb_audio_buffer[MAX_DATA_POINTS_PER_URB + CANARY_COUNT];
 static my_usbdevfs_urb urbRequests[URBS_TO_JUGGLE];
 
 static void initialiseRequests(jint endpointAddress, int requested_bytes_per_frame)
 {
     memset(audio_buffer, 0, sizeof(audio_buffer));
-    for (int i = 0; i < URBS_TO_JUGGLE; i++) {
+    for (int i = 0; i < AUDIO_BUFFERS; i++) {
         audio_buffer[i][MAX_DATA_POINTS_PER_URB] = CANARY_DATA_VALUE;
     }
 
@@ -188,6 +192,152 @@ static void initialiseRequests(jint endpointAddress, int requested_bytes_per_fra
     }
 }
 
+/**
+ * Write a reaped URB to the capture file, if there is one, starting with the file header
+ * for the first URB. On failure, capture stops but streaming continues.
+ */
+static void capture_urb(const usbdevfs_urb *urb, const usb_packet_desc *packet_descs,
+                        int requested_bytes_per_frame) {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    const int64_t now_ns = (int64_t) now.tv_sec * 1000000000LL + now.tv_nsec;
+
+    int rc = 0;
+    if (!s_capture_started) {
+        urb_capture_header header;
+        header.sample_rate = s_sample_rate;
+        header.channels = s_num_channels;
+        header.packets_per_urb = PACKETS_PER_URB;
+        header.requested_bytes_per_packet = requested_bytes_per_frame;
+        rc = urb_capture_write_header(s_fd_capture, &header);
+        s_capture_start_ns = now_ns;
+        s_capture_started = true;
+    }
+
+    if (rc == 0) {
+        // The whole buffer, including any padding after short packets:
+        uint32_t payload_bytes = PACKETS_PER_URB * requested_bytes_per_frame;
+        if (payload_bytes > MAX_DATA_POINTS_PER_URB * sizeof(data_t))     // Paranoia.
+            payload_bytes = MAX_DATA_POINTS_PER_URB * sizeof(data_t);
+        rc = urb_capture_write_urb(s_fd_capture, now_ns - s_capture_start_ns, urb->status,
+                                   urb->actual_length, packet_descs, PACKETS_PER_URB,
+                                   urb->buffer, payload_bytes);
+    }
+
+    if (rc != 0) {
+        __android_log_print(ANDROID_LOG_ERROR, __FILE__, "URB capture failed, errno %d: stopping capture", errno);
+        stop_urb_capture();
+    }
+}
+
+/**
+ * Look up the kotlin callback that signals that a buffer is ready. Returns null on failure,
+ * otherwise the caller must delete the local reference returned in *bridge_class.
+ */
+static jmethodID find_buffer_ready_method(JNIEnv *env, jclass *bridge_class) {
+    jmethodID onDataBufferReadyMethod = nullptr;
+    const char *kotlinClassName = "org/batgizmo/app/LiveDataBridge";
+    const char *kotlinMethodName = "onDataBufferReady";
+    jclass bridgeClass = env->FindClass(kotlinClassName);
+    if (bridgeClass != nullptr)
+        onDataBufferReadyMethod = env->GetStaticMethodID(bridgeClass, kotlinMethodName, "(JI)V");
+    if (onDataBufferReadyMethod == nullptr) {
+        if (bridgeClass != nullptr)
+            env->DeleteLocalRef(bridgeClass);
+        bridgeClass = nullptr;
+        __android_log_print(ANDROID_LOG_ERROR, __FILE__,
+                            "find_buffer_ready_method unable to find LiveDataBridge.onDataBufferReady method");
+    }
+    *bridge_class = bridgeClass;
+    return onDataBufferReadyMethod;
+}
+
+/**
+ * Look up LiveDataBridge.renderingBacklog, the number of buffers waiting in the rendering
+ * channel. Returns null on failure, otherwise the caller must delete the local reference returned.
+ */
+static jobject find_rendering_backlog(JNIEnv *env, jclass bridgeClass, jmethodID *get_method) {
+    jobject backlog = nullptr;
+    const char *atomicClassName = "java/util/concurrent/atomic/AtomicInteger";
+    jfieldID field = env->GetStaticFieldID(bridgeClass, "renderingBacklog",
+                                           "Ljava/util/concurrent/atomic/AtomicInteger;");
+    jclass atomicClass = env->FindClass(atomicClassName);
+    if (field != nullptr && atomicClass != nullptr) {
+        *get_method = env->GetMethodID(atomicClass, "get", "()I");
+        if (*get_method != nullptr)
+            backlog = env->GetStaticObjectField(bridgeClass, field);
+    }
+    if (atomicClass != nullptr)
+        env->DeleteLocalRef(atomicClass);
+    if (backlog == nullptr) {
+        env->ExceptionClear();
+        __android_log_print(ANDROID_LOG_ERROR, __FILE__,
+                            "find_rendering_backlog unable to find LiveDataBridge.renderingBacklog");
+    }
+    return backlog;
+}
+
+/**
+ * Set up the module state for a stream of the format supplied, including the parameters
+ * for audio output.
+ */
+static void set_stream_format(int num_channels, int sample_rate) {
+    s_num_channels = num_channels;
+    s_sample_rate = sample_rate;
+    s_nominal_samples_per_frame = sample_rate / 1000;      // Samples per ms.
+
+    // Important: often the sample rate will be a multiple of 48kHz, but in rare
+    // cases it might not be.
+    // Find a downsampling rate the gets us close to 48 kHz audio rate:
+    s_decimation_factor = lround((double) sample_rate / TARGET_AUDIO_OUT_RATE);
+    if (s_decimation_factor == 0)
+        s_decimation_factor = 1;
+    // The actual audio out rate may be different from the nominal target value:
+    s_audio_out_rate = sample_rate / s_decimation_factor;   // What if this is fractional?
+    s_heterodyne.decimation_factor = s_decimation_factor;
+    s_heterodyne.iir_coefficient = heterodyne_iir_coefficient(HETERODYNE_AA_CUTOFF_HZ, sample_rate);
+    __android_log_print(ANDROID_LOG_INFO, __FILE__, "Audio parameters: s_audio_out_rate = %d, s_decimation_factor = %d",
+                        s_audio_out_rate, s_decimation_factor);
+}
+
+/**
+ * The index in audio_buffer of a buffer address passed to kotlin.
+ */
+static int audio_buffer_index(const data_t *pData) {
+    return (int) ((pData - &audio_buffer[0][0]) / (MAX_DATA_POINTS_PER_URB + CANARY_COUNT));
+}
+
+/**
+ * Notify kotlin that a buffer of mono samples is ready for processing, and optionally write
+ * it to the audio output if there is one. ready_ns is when the buffer was reaped, for
+ * telemetry, or 0 if telemetry isn't active.
+ */
+static void publish_buffer(JNIEnv *env, jclass bridgeClass, jmethodID onDataBufferReadyMethod,
+                           data_t *pData, int sample_count, bool to_audio, int64_t ready_ns) {
+    if (ready_ns != 0) {
+        telemetry_trace_begin(TELEMETRY_REAP);
+        s_published_ns[audio_buffer_index(pData)].store(telemetry_now_ns(), std::memory_order_relaxed);
+    }
+
+    env->CallStaticVoidMethod(bridgeClass, onDataBufferReadyMethod,
+                              (jlong) pData, (jint) sample_count);
+
+    if (ready_ns != 0) {
+        telemetry_record(TELEMETRY_REAP, telemetry_now_ns() - ready_ns);
+        telemetry_trace_end();
+    }
+
+    if (to_audio) {
+        // Grab the lock to avoid races accessing s_android_stream.
+        pthread_mutex_lock(&s_mutex);
+        if (s_android_stream) {
+            // Number of channels is 1 by this point:
+            write_audio_output(pData, sample_count, 1);
+        }
+        pthread_mutex_unlock(&s_mutex);
+    }
+}
+
 /**
  * Do audio streaming via isochronous USB.
  * This function is called from a worker thread.
@@ -219,33 +369,11 @@ Java_org_batgizmo_app_pipeline_NativeUSB_stream(JNIEnv* env, jobject thiz,
 
 
     // Prepare to call a kotlin callback to signal buffers ready:
-    jmethodID onDataBufferReadyMethod = nullptr;
-    const char *kotlinClassName = "org/batgizmo/app/LiveDataBridge";
-    const char *kotlinMethodName = "onDataBufferReady";
-    jclass bridgeClass = env->FindClass(kotlinClassName);
-    if (bridgeClass != nullptr)
-        onDataBufferReadyMethod = env->GetStaticMethodID(bridgeClass, kotlinMethodName, "(JI)V");
-    if (onDataBufferReadyMethod == nullptr) {
-        env->DeleteLocalRef(bridgeClass);
-        __android_log_print(ANDROID_LOG_ERROR, __FILE__,
-                            "Java_org_batgizmo_app_pipeline_NativeUSB_stream unable to find LiveDataBridge.onDataBufferReady method");
-    }
+    jclass bridgeClass = nullptr;
+    jmethodID onDataBufferReadyMethod = find_buffer_ready_method(env, &bridgeClass);
 
     s_cancel_pending = false;
-    s_num_channels = num_channels;
-    s_sample_rate = sample_rate;
-
-    // Important: often the sample rate will be a multiple of 48kHz, but in rare
-    // cases it might not be.
-    // Find a downsampling rate the gets us close to 48 kHz audio rate:
-    s_decimation_factor = lround((double) sample_rate / TARGET_AUDIO_OUT_RATE);
-    if (s_decimation_factor == 0)
-        s_decimation_factor = 1;
-    // The actual audio out rate may be different from the nominal target value:
-    s_audio_out_rate = sample_rate / s_decimation_factor;   // What if this is fractional?
-    s_downsampling_iir_coefficient = calculate_iir_coefficient(DOWNSAMPLING_AA_CUTOFF_HZ, sample_rate);
-    __android_log_print(ANDROID_LOG_INFO, __FILE__, "Audio parameters: s_audio_out_rate = %d, s_decimation_factor = %d",
-                        s_audio_out_rate, s_decimation_factor);
+    set_stream_format(num_channels, sample_rate);
 
 #if 0   // This doesn't seem to be needed if we have claimed all interfaces on the device.
     // Wrench control away from anyone else who may have it. Android itself
@@ -291,10 +419,6 @@ Java_org_batgizmo_app_pipeline_NativeUSB_stream(JNIEnv* env, jobject thiz,
     const uint32_t requested_bytes_per_frame = max_packet_size;
     initialiseRequests(endpointAddress, requested_bytes_per_frame);
 
-#ifdef FAKE_DATA
-    init_fake_data();
-#endif
-
     __android_log_print(ANDROID_LOG_INFO, __FILE__, "starting streaming");
 
     int balls_in_the_air = 0;
@@ -340,6 +464,7 @@ Java_org_batgizmo_app_pipeline_NativeUSB_stream(JNIEnv* env, jobject thiz,
             ret = ioctl(fd_usb, USBDEVFS_REAPURB, &urbReaped);
             pthread_mutex_lock(&s_mutex);
             if (ret == 0) {
+                const int64_t reaped_ns = telemetry_active() ? telemetry_now_ns() : 0;
                 s_counter++;
                 balls_in_the_air--;     // We caught one.
                 auto *req = (usbdevfs_urb *) urbReaped->usercontext;
@@ -351,50 +476,25 @@ Java_org_batgizmo_app_pipeline_NativeUSB_stream(JNIEnv* env, jobject thiz,
                 // Check the canary value at the end of the buffer:
                 assert(pData[MAX_DATA_POINTS_PER_URB] == CANARY_DATA_VALUE);
 
+                const auto *packet_descs = reinterpret_cast<const usb_packet_desc *>(urbReaped->iso_frame_desc);
+
+                // Capture the URB as reaped, before it is modified in place below:
+                if (s_fd_capture >= 0)
+                    capture_urb(urbReaped, packet_descs, requested_bytes_per_frame);
+
                 if (!s_paused) {
 
                     if (bridgeClass && onDataBufferReadyMethod) {
-                        // Take account of the fact that we often get back fewer data samples
-                        // then we requested - the data buffer contains corresponding padding
-                        // entries that we need to remove.
-
-                        unsigned int dst_byte_offset = 0, source_byte_offset = 0;
-                        auto frame_desc= urbReaped->iso_frame_desc;
-                        for (int frame = 0; frame < PACKETS_PER_URB; frame++, frame_desc++) {
-                            // memmove because the source and destination overlap:
-                            auto actual_length = frame_desc->actual_length;
-                            if (frame > 0 && actual_length > 0)
-                                memmove((char*) pData + dst_byte_offset, (char*) pData + source_byte_offset, actual_length);
-                            dst_byte_offset += frame_desc->actual_length;   // Bytes
-                            source_byte_offset += frame_desc->length;       // Bytes
-                        }
-
-                        // For stereo data, combine the two channels into a single channel:
-                        if (s_num_channels == 2) {
-                            // Sample index, not bytes.
-                            for (int i = 0, j = 0; i < actual_samples_read; i += 1, j += 2) {
-                                // Average of the stereo channel values:
-                                pData[i] = (short) (((int) pData[j] + (int) pData[j + 1]) >> 1);
-                            }
-                            actual_samples_read >>= 1;   // We've just halved the the number of samples.
-                        }
+                        // Remove the padding left by packets shorter than requested, and
+                        // combine stereo channels into a single channel:
+                        actual_samples_read = usb_urb_to_mono(pData, packet_descs, PACKETS_PER_URB,
+                                                              s_num_channels);
 
                         // Some microphones send empty packets on buffer under run. Avoid wasting time
                         // on them:
-                        if (actual_samples_read > 0) {
-                            // Notify kotlin that the URB buffer is ready for processing:
-                            env->CallStaticVoidMethod(bridgeClass, onDataBufferReadyMethod,
-                                                      (jlong) pData, (jint) actual_samples_read);
-
-                            // Write the URB data to the audio output.
-                            // Grab the lock to avoid races accessing s_android_stream.
-                            pthread_mutex_lock(&s_mutex);
-                            if (s_android_stream) {
-                                // Number of channels is 1 by this point:
-                                write_audio_output((data_t *) pData, actual_samples_read, 1);
-                            }
-                            pthread_mutex_unlock(&s_mutex);
-                        }
+                        if (actual_samples_read > 0)
+                            publish_buffer(env, bridgeClass, onDataBufferReadyMethod, pData,
+                                           actual_samples_read, true, reaped_ns);
                     }
                 }
 
@@ -436,6 +536,7 @@ Java_org_batgizmo_app_pipeline_NativeUSB_stream(JNIEnv* env, jobject thiz,
     // These do nothing if the activity wasn't in progress:
     stop_audio_output();
     stop_recording();
+    stop_urb_capture();
 
     if (bridgeClass != nullptr)
         env->DeleteLocalRef(bridgeClass);   // This also cleans up onDataBufferReadyMethod.
@@ -451,6 +552,128 @@ Java_org_batgizmo_app_pipeline_NativeUSB_stream(JNIEnv* env, jobject thiz,
     return ret < 0 ? errno : 0;
 }
 
+/***********************************************************************************/
+/* Synthetic data stream, for load testing without a microphone.                   */
+/***********************************************************************************/
+
+/**
+ * Stream synthetic bat-like data in place of USB, through the same buffers and callback,
+ * until cancelled. Each buffer holds the same length of data as a URB would.
+ *
+ * speed is the multiple of real time to generate data at, or 0 to generate data as fast as
+ * possible. Audio output can't go faster than real time, so it is only written to when
+ * speed is 1.
+ *
+ * This function is called from a worker thread. Returns 0, or EINVAL if the parameters
+ * are out of range.
+ */
+extern "C" JNIEXPORT jint JNICALL
+Java_org_batgizmo_app_pipeline_NativeUSB_streamSynthetic(JNIEnv *env, jobject thiz,
+                                                         jint sample_rate,
+                                                         jfloat calls_per_second,
+                                                         jfloat speed) {
+    synth_source_config config;
+    config.sample_rate = sample_rate;
+    config.calls_per_second = calls_per_second;
+    config.clicks_per_second = calls_per_second / 4;
+    config.noise_level = 0.002f;
+    config.seed = 1;
+
+    static synth_source_state source;
+    if (speed < 0 || synth_source_init(&source, &config) != 0) {
+        __android_log_print(ANDROID_LOG_ERROR, __FILE__,
+                            "Java_org_batgizmo_app_pipeline_NativeUSB_streamSynthetic invalid parameters: %d Hz, speed %f",
+                            sample_rate, speed);
+        return EINVAL;
+    }
+
+    pthread_mutex_lock(&s_mutex);
+
+    __android_log_print(ANDROID_LOG_INFO, __FILE__,
+                        "Java_org_batgizmo_app_pipeline_NativeUSB_streamSynthetic %d Hz, %.1f calls/s, speed %.1f",
+                        sample_rate, calls_per_second, speed);
+
+    jclass bridgeClass = nullptr;
+    jmethodID onDataBufferReadyMethod = find_buffer_ready_method(env, &bridgeClass);
+
+    jmethodID backlogGetMethod = nullptr;
+    jobject renderingBacklog = bridgeClass ? find_rendering_backlog(env, bridgeClass, &backlogGetMethod) : nullptr;
+
+    s_cancel_pending = false;
+    set_stream_format(1, sample_rate);
+
+    memset(audio_buffer, 0, sizeof(audio_buffer));
+    for (int i = 0; i < AUDIO_BUFFERS; i++) {
+        audio_buffer[i][MAX_DATA_POINTS_PER_URB] = CANARY_DATA_VALUE;
+    }
+
+    struct timespec start;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    // Recycle the buffers in order, as URBs would be:
+    int64_t samples_generated = 0;
+    for (int64_t buffer_count = 0; !s_cancel_pending; buffer_count++) {
+        // Release the lock on every pass, as cancel, pause and the audio and recording controls
+        // all wait for it. While rendering is a full channel behind, wait for it to catch up, so
+        // that we don't overwrite buffers it has yet to copy:
+        pthread_mutex_unlock(&s_mutex);
+        if (speed == 0)
+            sched_yield();
+        while (!s_cancel_pending && renderingBacklog
+               && env->CallIntMethod(renderingBacklog, backlogGetMethod) >= RENDERING_CHANNEL_CAPACITY) {
+            const struct timespec backoff = {0, 1000000};
+            nanosleep(&backoff, nullptr);
+        }
+        pthread_mutex_lock(&s_mutex);
+        if (s_cancel_pending)
+            break;
+
+        data_t *pData = audio_buffer[buffer_count % AUDIO_BUFFERS];
+
+        // Track the exact total, so that rates that aren't a multiple of URBS_PER_SECOND
+        // come out right on average:
+        const int64_t samples_due = (buffer_count + 1) * sample_rate / URBS_PER_SECOND;
+        const int sample_count = (int) (samples_due - samples_generated);
+        synth_source_generate(&source, pData, sample_count);
+        samples_generated = samples_due;
+        assert(pData[MAX_DATA_POINTS_PER_URB] == CANARY_DATA_VALUE);
+
+        if (speed > 0) {
+            // Deliver the buffer when it would have been complete at the speed requested.
+            // Release the lock while we wait, as the reap loop does. After a wait for rendering,
+            // this catches up in a burst, as the USB stream would:
+            const int64_t due_ns = (int64_t) ((buffer_count + 1) * (1000000000.0 / URBS_PER_SECOND) / speed);
+            struct timespec due;
+            due.tv_sec = start.tv_sec + (time_t) ((start.tv_nsec + due_ns) / 1000000000LL);
+            due.tv_nsec = (long) ((start.tv_nsec + due_ns) % 1000000000LL);
+            pthread_mutex_unlock(&s_mutex);
+            while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &due, nullptr) == EINTR)
+                ;
+            pthread_mutex_lock(&s_mutex);
+        }
+
+        if (!s_paused && bridgeClass && onDataBufferReadyMethod)
+            publish_buffer(env, bridgeClass, onDataBufferReadyMethod, pData, sample_count,
+                           speed == 1.0f, telemetry_active() ? telemetry_now_ns() : 0);
+    }
+
+    // These do nothing if the activity wasn't in progress:
+    stop_audio_output();
+    stop_recording();
+
+    if (renderingBacklog != nullptr)
+        env->DeleteLocalRef(renderingBacklog);
+    if (bridgeClass != nullptr)
+        env->DeleteLocalRef(bridgeClass);
+
+    __android_log_print(ANDROID_LOG_INFO, __FILE__, "ending synthetic streaming after %lld samples",
+                        (long long) samples_generated);
+
+    pthread_mutex_unlock(&s_mutex);
+
+    return 0;
+}
+
 extern "C" JNIEXPORT void JNICALL
 Java_org_batgizmo_app_pipeline_NativeUSB_cancelStream(JNIEnv* env, jobject thiz) {
     pthread_mutex_lock(&s_mutex);
@@ -486,7 +709,7 @@ JNIEXPORT jint JNICALL
 Java_org_batgizmo_app_pipeline_NativeUSB_copyURBBufferData(JNIEnv *env, jobject thiz,
                                                            jlong source_native_offset,
                                                            jint source_samples,
-                                                           jshortArray target_buffer,
+                                                           jobject target_buffer,
                                                            jint target_buffer_offset,
                                                            jint target_buffer_size) {
 
@@ -504,37 +727,22 @@ Java_org_batgizmo_app_pipeline_NativeUSB_copyURBBufferData(JNIEnv *env, jobject
     jint rc = -1;
 
     auto pSource = reinterpret_cast<const data_t *>(source_native_offset);
-    int samples_to_copy = source_samples;
-
-    jshort *pBuffer = env->GetShortArrayElements(target_buffer, nullptr);
-    if (target_buffer) {
-        data_t *pTarget = pBuffer + target_buffer_offset;
 
-        // We need to copy to the destination target_buffer with wrap, so there may be two parts to the copy.
-
-        const int part1Space = target_buffer_size - target_buffer_offset;
-        const int part1Count = samples_to_copy > part1Space ? part1Space : samples_to_copy;
-        for (int i = 0; i < part1Count; i++) {
-            *pTarget++ = *pSource;
-            // *(data_t *)pSource = 0;     // TODO remove this.
-            pSource++;
-        }
-        samples_to_copy -= part1Count;
-
-        if (samples_to_copy > 0) {
-            pTarget = pBuffer;  // Wrap to start of target_buffer.
-            const int part2Required = samples_to_copy;
-            const int part2Count = part2Required > target_buffer_size ? target_buffer_size : part2Required;
-            for (int i = 0; i < part2Count; i++) {
-                *pTarget++ = *pSource++;
-            }
-            samples_to_copy -= part2Count;
-        }
-
-        // samples_to_copy should be 0 now.
-        rc = source_samples - samples_to_copy;
+    // The first copy of a buffer ends its time in the channel:
+    const int index = audio_buffer_index(pSource);
+    if (index >= 0 && index < AUDIO_BUFFERS) {
+        const int64_t published_ns = s_published_ns[index].exchange(0, std::memory_order_relaxed);
+        if (published_ns != 0)
+            telemetry_record(TELEMETRY_CHANNEL, telemetry_now_ns() - published_ns);
+    }
 
-        env->ReleaseShortArrayElements(target_buffer, pBuffer, 0);
+    telemetry_scope scope(TELEMETRY_COPY);
+    // The target is a direct buffer from NativeArena, so we write to it in place:
+    auto *pBuffer = static_cast<int16_t *>(env->GetDirectBufferAddress(target_buffer));
+    if (pBuffer && target_buffer_size >= 0
+        && env->GetDirectBufferCapacity(target_buffer) >= (jlong) target_buffer_size * (jlong) sizeof(int16_t)) {
+        rc = usb_copy_to_ring(pSource, source_samples, pBuffer, target_buffer_offset,
+                              target_buffer_size);
     }
 
     // pthread_mutex_unlock(&s_mutex);
@@ -591,6 +799,44 @@ Java_org_batgizmo_app_pipeline_NativeUSB_stopRecording(JNIEnv *env, jobject thiz
     stop_recording();
 }
 
+/***********************************************************************************/
+/* Support for capturing raw URBs to file, for replay off the device.              */
+/***********************************************************************************/
+
+static void stop_urb_capture() {
+    pthread_mutex_lock(&s_mutex);
+    if (s_fd_capture >= 0) {
+        close(s_fd_capture);
+        s_fd_capture = -1;
+    }
+    pthread_mutex_unlock(&s_mutex);
+}
+
+/**
+ * This function takes ownership of the fd passed in, and closes it in due course. Capture
+ * continues until it is stopped or streaming ends.
+ */
+extern "C" JNIEXPORT jboolean JNICALL
+Java_org_batgizmo_app_pipeline_NativeUSB_startURBCapture(JNIEnv *env, jobject thiz, jint fd) {
+    if (fd < 0)
+        return false;
+
+    pthread_mutex_lock(&s_mutex);
+    // In case we were already capturing, restart:
+    stop_urb_capture();
+    s_capture_started = false;
+    s_fd_capture = fd;
+    pthread_mutex_unlock(&s_mutex);
+
+    return true;
+}
+
+extern "C"
+JNIEXPORT void JNICALL
+Java_org_batgizmo_app_pipeline_NativeUSB_stopURBCapture(JNIEnv *env, jobject thiz) {
+    stop_urb_capture();
+}
+
 /***********************************************************************************/
 /* Support for forwarding streamed data to audio output.                           */
 /***********************************************************************************/
@@ -604,44 +850,22 @@ Java_org_batgizmo_app_pipeline_NativeUSB_startAudio(JNIEnv *env, jobject thiz,
                                               jint audio_boost_shift) {
     pthread_mutex_lock(&s_mutex);
 
-    downsampling_filter_reset();
+    heterodyne_filter_reset(&s_heterodyne);
 
     // In case we are already doing audio:
     stop_audio_output();
 
     // For now, we only support heterodyne.
 
-    int n = s_nominal_samples_per_frame;
-    if (n > MAX_REFERENCE_LEN)      // Paranoia.
-        n = MAX_REFERENCE_LEN;
-
-    if (heterodyne1_kHz > n || heterodyne2_kHz > n) {
+    if (heterodyne_start(&s_heterodyne, s_nominal_samples_per_frame, heterodyne1_kHz,
+                         heterodyne2_kHz, audio_boost_shift) != 0) {
         __android_log_print(ANDROID_LOG_INFO, __FILE__,
-                            "Heterodyne reference outside the valid range for the frame length (%d)", n);
+                            "Heterodyne reference outside the valid range for the frame length (%d)",
+                            s_nominal_samples_per_frame);
+        pthread_mutex_unlock(&s_mutex);
         return false;
     }
 
-    // Don't recalculate this unnecessarily:
-    if (n != s_reference_len) {
-        /*
-         * Set up the correct number of heterodyne data points in a single
-         * cycle of a cosine. Having the same number of points as the sampling rate
-         * makes it easy to generated references for multiples of kHz.
-         */
-        const double pi2 = 3.1415927 * 2;
-        int i = 0;
-        for (i = 0; i < n; i++) {
-            double x = ((double) i) * pi2 / n;
-            s_reference_data[i] = cos(x) * 0x7FFE;
-        }
-        s_reference_data[i] = CANARY_DATA_VALUE;
-        s_reference_len = n;
-    }
-    s_heterodyne1_kHz = heterodyne1_kHz;
-    s_heterodyne2_kHz = heterodyne2_kHz;
-    s_audio_boost_shift = audio_boost_shift;
-    s_reference1_index = s_reference2_index = 0;
-
     jboolean rc = start_audio_output(audio_device_id);
 
     pthread_mutex_unlock(&s_mutex);
@@ -746,58 +970,8 @@ static void write_audio_output(const data_t *pBuffer, uint32_t sample_count, jin
 
     static int16_t downsampled_buffer[MAX_DATA_POINTS_PER_URB];
 
-    int decimation_counter = 0;
-    int decimated_sample_count = 0;
-
-    // Should this be split into multiple loops that it is more likely to
-    // handled entirely in CPU registers? But then we would need more intermediate storage, and
-    // more memory accesses.
-
-    for (int i = 0; i < sample_count; i++) {
-
-        // Multiply the raw data by the reference(s).
-        int32_t mixed = pBuffer[i] * s_reference_data[s_reference1_index];
-        if (s_heterodyne2_kHz != 0)
-            mixed += pBuffer[i] * s_reference_data[s_reference2_index];
-
-        // Apply a low pass antialiasing filter. This is important to prevent audio feedback:
-        int64_t filtered = mixed;
-        for (int order = 0; order < DOWNSAMPLING_AA_STAGES; order++) {
-            filtered = (int64_t) s_downsampling_iir_coefficient * filtered +
-                               (int64_t) ((1LL << 31) - s_downsampling_iir_coefficient) *
-                               s_downsampling_filter_state.previous[order];
-            filtered >>= 31;
-            s_downsampling_filter_state.previous[order] = (int32_t) filtered;
-        }
-
-        // Down sample:
-        if (++decimation_counter == s_decimation_factor) {
-            decimation_counter = 0;
-
-            // Reduce the result to the range of 16 bit signed. 15 rather than 16 to gain a factor of 2,
-            // because 0.5 * 0.5 is 0.25. Note that it remains a 32 bit signed for the moment:
-            filtered >>= (15 - s_audio_boost_shift);
-
-#define DO_SATURATION 1
-#if DO_SATURATION
-            if (filtered > INT16_MAX)
-                filtered = INT16_MAX;
-            if (filtered < INT16_MIN)
-                filtered = INT16_MIN;
-#endif
-
-            downsampled_buffer[decimated_sample_count++] = static_cast<int16_t>(filtered);
-        }
-
-        // Step through the reference waveforms:
-        s_reference1_index += s_heterodyne1_kHz;
-        if (s_reference1_index >= s_reference_len)
-            s_reference1_index -= s_reference_len;
-
-        s_reference2_index += s_heterodyne2_kHz;
-        if (s_reference2_index >= s_reference_len)
-            s_reference2_index -= s_reference_len;
-    }
+    const int decimated_sample_count = heterodyne_process(&s_heterodyne, pBuffer, sample_count,
+                                                          downsampled_buffer);
 
 #ifdef CAPTURE  // Debug buffer
     static int16_t debug_capture_buffer[MAX_SAMPLES_PER_FRAME * MAX_CHANNELS];     // Bigger than we will ever need.
@@ -835,6 +1009,6 @@ JNIEXPORT void JNICALL
 Java_org_batgizmo_app_pipeline_NativeUSB_setHeterodyne(JNIEnv *env, jobject thiz,
                                                        jint heterodyne1_kHz, jint heterodyne2_kHz) {
     // A smooth change to the heterodyne frequency, no step:
-    s_heterodyne1_kHz = heterodyne1_kHz;
-    s_heterodyne2_kHz = heterodyne2_kHz;
+    s_heterodyne.heterodyne1_kHz = heterodyne1_kHz;
+    s_heterodyne.heterodyne2_kHz = heterodyne2_kHz;
 }
\ No newline at end of file
@@ -0,0 +1,84 @@
+/*
+ * Copyright (c) 2025 John Mears
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+#include <jni.h>
+
+#include <vector>
+
+#include "core/wavdecode.h"
+
+/**
+ * JNI entry points used by WavFileParser. The decoding itself is in wavdecode.cpp.
+ */
+
+extern "C"
+JNIEXPORT jint JNICALL
+Java_org_batgizmo_app_WavFileParser_00024Companion_decodeSamples(JNIEnv *env, jobject thiz,
+                                                                jbyteArray source,
+                                                                jint frames,
+                                                                jint channels,
+                                                                jint format,
+                                                                jint channel,
+                                                                jobject target,
+                                                                jint target_offset) {
+    const jsize source_size = env->GetArrayLength(source);
+    // The target is a direct buffer, so we decode straight into it:
+    auto *dst = static_cast<int16_t *>(env->GetDirectBufferAddress(target));
+    if (dst == nullptr)
+        return -1;
+    const jlong target_size = env->GetDirectBufferCapacity(target) / (jlong) sizeof(int16_t);
+    const int bytes_per_value = wav_bytes_per_value(format);
+
+    // Paranoia: check the arrays are big enough for what we have been asked to do.
+    if (frames < 0 || target_offset < 0 || bytes_per_value == 0)
+        return -1;
+    if (static_cast<int64_t>(frames) * channels * bytes_per_value > source_size)
+        return -1;
+    if (static_cast<int64_t>(target_offset) + frames > target_size)
+        return -1;
+
+    jint rc = -1;
+    if (wav_decode_is_parallel(static_cast<size_t>(frames))) {
+        // The work pool's threads can take a while, and other threads may need the garbage
+        // collector meanwhile, so a large read is copied out rather than accessed critically.
+        // The copy is cheap next to the decoding:
+        std::vector<uint8_t> scratch(static_cast<size_t>(frames) * channels * bytes_per_value);
+        env->GetByteArrayRegion(source, 0, static_cast<jsize>(scratch.size()),
+                                reinterpret_cast<jbyte *>(scratch.data()));
+        if (!env->ExceptionCheck())
+            rc = wav_decode_to_int16(scratch.data(), static_cast<size_t>(frames), channels,
+                                     format, channel, dst + target_offset);
+    } else {
+        // Critical access avoids copying the array. This thread decodes alone, and we make no
+        // JNI calls until it is released.
+        auto *src = static_cast<uint8_t *>(env->GetPrimitiveArrayCritical(source, nullptr));
+        if (src != nullptr) {
+            rc = wav_decode_to_int16(src, static_cast<size_t>(frames), channels, format,
+                                     channel, dst + target_offset);
+
+            // JNI_ABORT means don't copy elements back, just free the memory:
+            env->ReleasePrimitiveArrayCritical(source, src, JNI_ABORT);
+        }
+    }
+
+    return rc;
+}
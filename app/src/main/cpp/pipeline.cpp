@@ -22,26 +22,272 @@
 
 #include <jni.h>
 #include <android/bitmap.h>
+#include <android/log.h>
+#include <android/native_window_jni.h>
+#include <android/trace.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "core/amplitude.h"
+#include "core/arena.h"
+#include "core/bnc.h"
+#include "core/colourmap.h"
+#include "core/fftwisdom.h"
+#include "core/governor.h"
+#include "core/kernels.h"
+#include "core/telemetry.h"
+#include "core/transform.h"
+#include "core/workpool.h"
 
-extern "C" {
-#include "kissfft/kiss_fftr.h"
-}
+/**
+ * JNI adapters for the pipeline steps. The DSP kernels themselves are in core/.
+ */
+
+static transform_state s_transform;
+
+// Scratch space for the windows of a slice, unwrapped ready for the FFT, from the shared
+// arena. Allocated by initFft:
+static float *s_slice_buffer = nullptr;
+static int s_slice_buffer_windows = 0;
 
-static void cleanup_fft();
+// The transform plans tuned for this device, and the file they persist in. The path is empty
+// until loadFftWisdom is called, in which case initFft just uses the default plan. Guarded by
+// s_fft_wisdom_mutex, as tuning runs on its own thread:
+static std::mutex s_fft_wisdom_mutex;
+static fft_wisdom s_fft_wisdom;
+static std::string s_fft_wisdom_path;
+static bool s_fft_autotune_running = false;
 
-static size_t XYToBitmapOffset(int x, int y, int max_y, uint32_t indexStride);
+// Enough to time each candidate plan several times. Tuning runs in the background, so this
+// only bounds how long the default plan is used for a new FFT configuration:
+#define FFT_AUTOTUNE_BUDGET_MS 150
 
-static kiss_fftr_cfg kfft_cfg = nullptr;
-static int s_fft_window_size = 0;
-static int s_fft_frequency_buckets = 0;
-static kiss_fft_cpx *s_fft_temp_buffer = nullptr;
-static kiss_fft_scalar canaryValue = -1.0;
+// The live quality governor. It outlives each pipeline, as a change of quality rebuilds the
+// pipeline. Only used from the live rendering thread, apart from reset between streams:
+static governor_state s_governor;
+
+// A second transform, for the speculative work of TransformCache on a background thread,
+// so that it never disturbs the pipeline's own. It uses the default single thread plan:
+static transform_state s_precompute_transform;
+static std::vector<float> s_precompute_slice_buffer;
+
+// The frequency bucket to row table for colour mapping into a bitmap with fewer rows:
+static std::vector<int> s_pool_row_first;
+static int s_pool_rows = 0;
+static int s_pool_buckets = 0;
 
 static bool s_already_initialized = false;
 static uint16_t *s_colourMapData = nullptr;
 static int s_colourMapDataSize = 0;
 static uint16_t s_amplitude_graph_colour = 0xFFFF;
 
+/**
+ * The address of a direct buffer allocated by NativeArena, or null if it isn't one or holds
+ * fewer than count values of type T.
+ */
+template<typename T>
+static T *direct_buffer(JNIEnv *env, jobject buffer, int64_t count) {
+    auto *data = static_cast<T *>(env->GetDirectBufferAddress(buffer));
+    if (data == nullptr || count < 0
+        || env->GetDirectBufferCapacity(buffer) < count * (int64_t) sizeof(T))
+        return nullptr;
+    return data;
+}
+
+/**
+ * Called when the library is loaded, before any other native code runs. Select the DSP
+ * kernels for this CPU now, rather than on first use in the middle of rendering.
+ */
+extern "C"
+JNIEXPORT jint JNICALL
+JNI_OnLoad(JavaVM *vm, void *reserved) {
+    // Mark the pipeline stages in system traces, for Perfetto:
+    static const telemetry_trace_hooks trace_hooks = {
+            ATrace_beginSection,
+            ATrace_endSection,
+            ATrace_isEnabled
+    };
+    telemetry_set_trace_hooks(&trace_hooks);
+
+    kernels_select(nullptr);
+    __android_log_print(ANDROID_LOG_INFO, __FILE__, "Using the %s DSP kernels", kernels()->name);
+    return JNI_VERSION_1_6;
+}
+
+extern "C"
+JNIEXPORT void JNICALL
+Java_org_batgizmo_app_Telemetry_00024Companion_enableNative(JNIEnv *env, jobject thiz,
+                                                           jboolean enabled) {
+    telemetry_set_enabled(enabled);
+}
+
+extern "C"
+JNIEXPORT void JNICALL
+Java_org_batgizmo_app_Telemetry_00024Companion_record(JNIEnv *env, jobject thiz, jint stage,
+                                                     jlong duration_ns) {
+    telemetry_record(static_cast<telemetry_stage>(stage), duration_ns);
+}
+
+extern "C"
+JNIEXPORT void JNICALL
+Java_org_batgizmo_app_Telemetry_00024Companion_reset(JNIEnv *env, jobject thiz) {
+    telemetry_reset();
+}
+
+/**
+ * Return the count, p50, p99 and maximum in ns for each stage in turn, or null if there
+ * is no memory.
+ */
+extern "C"
+JNIEXPORT jlongArray JNICALL
+Java_org_batgizmo_app_Telemetry_00024Companion_snapshot(JNIEnv *env, jobject thiz) {
+    telemetry_stats stats[TELEMETRY_STAGE_COUNT];
+    telemetry_snapshot(stats);
+
+    jlong values[TELEMETRY_STAGE_COUNT * 4];
+    for (int i = 0; i < TELEMETRY_STAGE_COUNT; i++) {
+        values[i * 4] = (jlong) stats[i].count;
+        values[i * 4 + 1] = stats[i].p50_ns;
+        values[i * 4 + 2] = stats[i].p99_ns;
+        values[i * 4 + 3] = stats[i].max_ns;
+    }
+
+    jlongArray result = env->NewLongArray(TELEMETRY_STAGE_COUNT * 4);
+    if (result != nullptr)
+        env->SetLongArrayRegion(result, 0, TELEMETRY_STAGE_COUNT * 4, values);
+    return result;
+}
+
+/**
+ * Start governing at full quality, with the number of levels supplied. Returns 0, or -1 if
+ * levels is invalid.
+ */
+extern "C"
+JNIEXPORT jint JNICALL
+Java_org_batgizmo_app_pipeline_QualityGovernor_00024Companion_reset(JNIEnv *env, jobject thiz,
+                                                                   jint levels) {
+    governor_config config = governor_default_config(levels);
+    return governor_init(&s_governor, &config);
+}
+
+extern "C"
+JNIEXPORT jint JNICALL
+Java_org_batgizmo_app_pipeline_QualityGovernor_00024Companion_update(JNIEnv *env, jobject thiz,
+                                                                    jlong processing_ns,
+                                                                    jlong data_ns,
+                                                                    jint backlog,
+                                                                    jint dropped,
+                                                                    jfloat up_cost_ratio) {
+    return governor_update(&s_governor, processing_ns, data_ns, backlog, dropped, up_cost_ratio);
+}
+
+extern "C"
+JNIEXPORT void JNICALL
+Java_org_batgizmo_app_pipeline_NativeArena_00024Companion_setBudget(JNIEnv *env, jobject thiz,
+                                                                   jlong bytes) {
+    arena_set_budget(arena_shared(), bytes > 0 ? (size_t) bytes : 0);
+}
+
+/**
+ * Get the slot's block from the shared arena as a direct buffer of the size requested, or
+ * null if that would exceed the budget.
+ */
+extern "C"
+JNIEXPORT jobject JNICALL
+Java_org_batgizmo_app_pipeline_NativeArena_00024Companion_acquire(JNIEnv *env, jobject thiz,
+                                                                 jint slot, jlong bytes) {
+    if (bytes <= 0)
+        return nullptr;
+    void *data = arena_acquire(arena_shared(), slot, (size_t) bytes);
+    return data == nullptr ? nullptr : env->NewDirectByteBuffer(data, bytes);
+}
+
+extern "C"
+JNIEXPORT void JNICALL
+Java_org_batgizmo_app_pipeline_NativeArena_00024Companion_release(JNIEnv *env, jobject thiz,
+                                                                 jint slot) {
+    arena_release(arena_shared(), slot);
+}
+
+extern "C"
+JNIEXPORT void JNICALL
+Java_org_batgizmo_app_pipeline_NativeArena_00024Companion_trim(JNIEnv *env, jobject thiz) {
+    arena_trim(arena_shared());
+}
+
+extern "C"
+JNIEXPORT void JNICALL
+Java_org_batgizmo_app_pipeline_NativeArena_00024Companion_freeRetired(JNIEnv *env, jobject thiz) {
+    arena_free_retired(arena_shared());
+}
+
+/**
+ * Return the budget, capacity, bytes in use and high-water mark for the shared arena,
+ * followed by the size, capacity and high-water mark of each slot in turn, or null if there
+ * is no memory.
+ */
+extern "C"
+JNIEXPORT jlongArray JNICALL
+Java_org_batgizmo_app_pipeline_NativeArena_00024Companion_snapshot(JNIEnv *env, jobject thiz) {
+    arena_stats stats;
+    arena_get_stats(arena_shared(), &stats);
+
+    const int count = 4 + ARENA_SLOT_COUNT * 3;
+    jlong values[count] = {
+            (jlong) stats.budget, (jlong) stats.capacity,
+            (jlong) stats.in_use, (jlong) stats.high_water
+    };
+    for (int i = 0; i < ARENA_SLOT_COUNT; i++) {
+        values[4 + i * 3] = (jlong) stats.slots[i].size;
+        values[4 + i * 3 + 1] = (jlong) stats.slots[i].capacity;
+        values[4 + i * 3 + 2] = (jlong) stats.slots[i].high_water;
+    }
+
+    jlongArray result = env->NewLongArray(count);
+    if (result != nullptr)
+        env->SetLongArrayRegion(result, 0, count, values);
+    return result;
+}
+
+extern "C"
+JNIEXPORT void JNICALL
+Java_org_batgizmo_app_pipeline_NativeArena_00024Companion_fillShort(JNIEnv *env, jobject thiz,
+                                                                   jobject buffer, jshort value) {
+    auto *data = static_cast<int16_t *>(env->GetDirectBufferAddress(buffer));
+    if (data != nullptr)
+        std::fill_n(data, env->GetDirectBufferCapacity(buffer) / sizeof(int16_t), value);
+}
+
+extern "C"
+JNIEXPORT void JNICALL
+Java_org_batgizmo_app_pipeline_NativeArena_00024Companion_fillFloat(JNIEnv *env, jobject thiz,
+                                                                   jobject buffer, jfloat value) {
+    auto *data = static_cast<float *>(env->GetDirectBufferAddress(buffer));
+    if (data != nullptr)
+        std::fill_n(data, env->GetDirectBufferCapacity(buffer) / sizeof(float), value);
+}
+
+extern "C"
+JNIEXPORT jint JNICALL
+Java_org_batgizmo_app_pipeline_NativeArena_00024Companion_move(JNIEnv *env, jobject thiz,
+                                                              jobject buffer, jlong from,
+                                                              jlong to, jlong bytes) {
+    auto *data = static_cast<uint8_t *>(env->GetDirectBufferAddress(buffer));
+    const jlong capacity = env->GetDirectBufferCapacity(buffer);
+    if (data == nullptr || from < 0 || to < 0 || bytes < 0
+        || from + bytes > capacity || to + bytes > capacity)
+        return -1;
+
+    memmove(data + to, data + from, (size_t) bytes);
+    return 0;
+}
+
 /**
  * This is invoked from the ViewModel so should only get called once, regardless of
  * screen reconfiguration etc. So one off leaks from this function are OK.
@@ -86,316 +332,336 @@ Java_org_batgizmo_app_UIModel_00024Companion_nativeInitialize(JNIEnv *env, jobje
 }
 
 
-// One day, merge the following function with doFft, to avoid a JNI call overhead.
 extern "C"
 JNIEXPORT jint JNICALL
-Java_org_batgizmo_app_pipeline_TransformStep_00024Companion_unwrapSlices(JNIEnv *env, jobject thiz,
-                                                                     jshortArray raw_data_buffer,
-                                                                     jint raw_data_entries,
-                                                                     jint start_index,
-                                                                     jint window_count,
-                                                                     jint fft_stride,
-                                                                     jfloatArray window,
-                                                                     jint fft_window_size,
-                                                                     jfloatArray input_slice_buffer) {
-
-    jint rc = 0;
-    jshort *rawData = env->GetShortArrayElements(raw_data_buffer, nullptr);
-    jfloat *sliceBufferData = env->GetFloatArrayElements(input_slice_buffer, nullptr);
-    jfloat *windowData = env->GetFloatArrayElements(window, nullptr);
-    if (rawData == nullptr || sliceBufferData == nullptr || sliceBufferData == windowData) {
-        rc = -1;
-    } else {
-        int unwrapped_index = 0;
-        for (int i = 0; i < window_count; i++) {
-            int end_index = start_index + fft_window_size;  // Half open range.
-            // The last window may extend beyond the range of raw data. That's expected because the final slice
-            // is truncated to the file size. In that case, skip it.
-            if (end_index <= raw_data_entries) {
-                int window_index = 0;
-                for (int j = start_index; j < end_index; j++) {
-                    sliceBufferData[unwrapped_index++] =
-                        static_cast<float>(rawData[j]) * windowData[window_index++];
-                }
-            }
-
-            start_index += fft_stride;
-        }
+Java_org_batgizmo_app_pipeline_TransformStep_00024Companion_loadFftWisdom(JNIEnv *env, jobject thiz,
+                                                                      jstring path,
+                                                                      jstring fingerprint) {
+    const char *pPath = env->GetStringUTFChars(path, nullptr);
+    const char *pFingerprint = env->GetStringUTFChars(fingerprint, nullptr);
+    jint rc = -1;
+    if (pPath != nullptr && pFingerprint != nullptr) {
+        std::lock_guard<std::mutex> lock(s_fft_wisdom_mutex);
+        s_fft_wisdom_path = pPath;
+        // If this fails, for example on first run, tuning happens as each case is first used:
+        rc = fft_wisdom_load(pPath, pFingerprint, &s_fft_wisdom);
+        __android_log_print(ANDROID_LOG_INFO, __FILE__, "Loaded %zu FFT wisdom entries",
+                            s_fft_wisdom.entries.size());
     }
+    if (pPath)
+        env->ReleaseStringUTFChars(path, pPath);
+    if (pFingerprint)
+        env->ReleaseStringUTFChars(fingerprint, pFingerprint);
+    return rc;
+}
 
-    if (rawData) {
-        // JNI_ABORT means don't copy elements back, just free the memory:
-        env->ReleaseShortArrayElements(raw_data_buffer, rawData, JNI_ABORT);
-    }
-    if (sliceBufferData) {
-        // 0 means copy changes back and free memory:
-        env->ReleaseFloatArrayElements(input_slice_buffer, sliceBufferData, 0);
-    }
-    if (windowData) {
-        // JNI_ABORT means don't copy elements back, just free the memory:
-        env->ReleaseFloatArrayElements(window, windowData, JNI_ABORT);
+extern "C"
+JNIEXPORT void JNICALL
+Java_org_batgizmo_app_pipeline_TransformStep_00024Companion_resetFftWisdom(JNIEnv *env, jobject thiz) {
+    // Each case will be tuned again when it is next used:
+    std::lock_guard<std::mutex> lock(s_fft_wisdom_mutex);
+    s_fft_wisdom.entries.clear();
+    if (!s_fft_wisdom_path.empty())
+        remove(s_fft_wisdom_path.c_str());
+}
+
+/**
+ * Tune the FFT plan for a case and remember the result. This takes up to
+ * FFT_AUTOTUNE_BUDGET_MS, so it runs on its own thread rather than during pipeline setup.
+ */
+static void fft_autotune_in_background(int fft_window_size, int fft_stride,
+                                       int windows_per_slice) {
+    fft_wisdom_entry best;
+    // The transform runs on the shared work pool, with the calling thread taking part:
+    const int max_threads = work_pool_workers(work_pool_shared()) + 1;
+    int rc;
+    {
+        // Below the display work of the pipeline being tuned for, so as not to hold it up:
+        work_priority_scope background(WORK_PRIORITY_BACKGROUND);
+        rc = fft_autotune(fft_window_size, fft_stride, windows_per_slice, max_threads,
+                          FFT_AUTOTUNE_BUDGET_MS, &best, nullptr);
     }
 
-    return rc;
+    std::lock_guard<std::mutex> lock(s_fft_wisdom_mutex);
+    s_fft_autotune_running = false;
+    // The default plan carries on being used if anything went wrong:
+    if (rc != 0 || s_fft_wisdom_path.empty())
+        return;
+    fft_wisdom_set(&s_fft_wisdom, best);
+    if (fft_wisdom_save(s_fft_wisdom_path.c_str(), &s_fft_wisdom) != 0)
+        __android_log_print(ANDROID_LOG_WARN, __FILE__, "Unable to save FFT wisdom to %s",
+                            s_fft_wisdom_path.c_str());
+    __android_log_print(ANDROID_LOG_INFO, __FILE__,
+                        "Tuned FFT plan for %d/%d: batch %d, threads %d (%.0f ns per window)",
+                        fft_window_size, fft_stride, best.plan.batch_windows, best.plan.threads,
+                        best.ns_per_window);
 }
 
 extern "C"
 JNIEXPORT jint JNICALL
 Java_org_batgizmo_app_pipeline_TransformStep_00024Companion_initFft(JNIEnv *env, jobject thiz,
-                                                                jint fft_window_size) {
-
-    cleanup_fft();  // Paranoia.
-
-    s_fft_window_size = fft_window_size;
-    kfft_cfg = kiss_fftr_alloc(fft_window_size, false, nullptr, nullptr);
-
-    s_fft_frequency_buckets = fft_window_size / 2 + 1;
-    const size_t allocation_buckets =
-            s_fft_frequency_buckets + 1; // Additional +1 for canary value.
-    s_fft_temp_buffer = (kiss_fft_cpx *) malloc(sizeof(kiss_fft_cpx) * allocation_buckets);
+                                                                jint fft_window_size,
+                                                                jint fft_stride,
+                                                                jint windows_per_slice) {
+    // Reuse the memory of the previous pipeline, if there was one:
+    s_transform.scratch_arena = arena_shared();
+    jint rc = transform_init(&s_transform, fft_window_size);
+    if (rc != 0)
+        return rc;
 
-    if (kfft_cfg == nullptr || s_fft_temp_buffer == nullptr) {
-        cleanup_fft();
+    s_slice_buffer = static_cast<float *>(arena_acquire(
+            arena_shared(), ARENA_SLOT_SLICE,
+            (size_t) windows_per_slice * fft_window_size * sizeof(float)));
+    if (s_slice_buffer == nullptr) {
+        transform_cleanup(&s_transform);
         return -1;
     }
+    s_slice_buffer_windows = windows_per_slice;
+
+    std::lock_guard<std::mutex> lock(s_fft_wisdom_mutex);
+    if (s_fft_wisdom_path.empty())
+        return 0;
+
+    const fft_wisdom_entry *entry = fft_wisdom_find(&s_fft_wisdom, fft_window_size, fft_stride);
+    if (entry == nullptr) {
+        // First use of this case on this device. Tune it in the background, one case at a
+        // time, and use the default plan until a later pipeline picks up the result:
+        if (!s_fft_autotune_running) {
+            s_fft_autotune_running = true;
+            std::thread(fft_autotune_in_background, (int) fft_window_size, (int) fft_stride,
+                        (int) windows_per_slice).detach();
+        }
+        return 0;
+    }
 
-    memset(s_fft_temp_buffer, 0, allocation_buckets * sizeof(kiss_fft_cpx));
-    s_fft_temp_buffer[allocation_buckets - 1].r = canaryValue;
-    s_fft_temp_buffer[allocation_buckets - 1].i = canaryValue;
-
+    transform_set_plan(&s_transform, &entry->plan);
+    __android_log_print(ANDROID_LOG_INFO, __FILE__,
+                        "FFT plan for %d/%d: batch %d, threads %d (%.0f ns per window)",
+                        fft_window_size, fft_stride, entry->plan.batch_windows,
+                        entry->plan.threads, entry->ns_per_window);
     return 0;
 }
 
 extern "C"
 JNIEXPORT void JNICALL
 Java_org_batgizmo_app_pipeline_TransformStep_00024Companion_cleanupFft(JNIEnv *env, jobject thiz) {
-    cleanup_fft();
-}
-
-static void cleanup_fft() {
-    if (kfft_cfg != nullptr) {
-        // The client code has forgotten to call cleanupFft if we get here.
-        kiss_fftr_free(kfft_cfg);
-        kfft_cfg = nullptr;
-    }
-
-    if (s_fft_temp_buffer != nullptr) {
-        free(s_fft_temp_buffer);
-        s_fft_temp_buffer = nullptr;
-    }
+    transform_cleanup(&s_transform);
+    arena_release(arena_shared(), ARENA_SLOT_SLICE);
+    s_slice_buffer = nullptr;
+    s_slice_buffer_windows = 0;
 }
 
-/*
- * Scaling factor used in scaling the squared amplitude to dB.
- *dB is 10 log10(power).
- *  - We have already squared the signal level so it represents power.
- *  - We use log2 below for efficiency, so scale it to result in log10.
+/**
+ * Transform window_count windows, spaced by fft_stride from start_index in the raw data,
+ * writing the results to the transformed data buffer from transformed_time_bucket_index on,
+ * and drawing them in the amplitude bitmap. The windows are unwrapped into the slice buffer
+ * in chunks of windows_per_slice, its capacity, so that a run of contiguous slices takes a
+ * single JNI call, with the bitmap locked only once.
+ *
+ * The raw and transformed data buffers are direct buffers from NativeArena, so they are
+ * used in place rather than copied.
+ *
+ * trigger_flag[0] is set to 1 if the trigger threshold was reached in any window.
+ *
+ * Returns the number of windows processed, or -1 if it didn't work out.
  */
-const static float s_dB_factor = 10.0f / log2(10.0f);
-
 extern "C"
 JNIEXPORT jint JNICALL
-Java_org_batgizmo_app_pipeline_TransformStep_00024Companion_doFft(JNIEnv *env, jobject thiz,
-                                                              jint num_windows,
-                                                              jfloatArray input_slice_buffer,
-                                                              jfloatArray output_slice_buffer,
-                                                              jint transformed_buffer_index,
-                                                              jfloat minDB,
-                                                              jintArray trigger_flag,
-                                                              jint min_trigger_bucket,
-                                                              jint max_trigger_bucket,
-                                                              jfloat trigger_threshold) {
-    int rc = 0;
-    const float *pWindowData = nullptr;
+Java_org_batgizmo_app_pipeline_TransformStep_00024Companion_doSlices(JNIEnv *env, jobject thiz,
+                                                                 jobject raw_data_buffer,
+                                                                 jint raw_data_entries,
+                                                                 jint start_index,
+                                                                 jint window_count,
+                                                                 jint fft_stride,
+                                                                 jfloatArray window,
+                                                                 jint fft_window_size,
+                                                                 jint windows_per_slice,
+                                                                 jint column_step,
+                                                                 jobject transformed_data_buffer,
+                                                                 jint transformed_time_bucket_index,
+                                                                 jfloat minDB,
+                                                                 jintArray trigger_flag,
+                                                                 jint min_trigger_bucket,
+                                                                 jint max_trigger_bucket,
+                                                                 jfloat trigger_threshold,
+                                                                 jobject amplitude_bitmap) {
+    // Check everything that would otherwise lead to writing beyond the end of a buffer:
+    const int frequency_buckets = s_transform.frequency_buckets;
+    if (fft_window_size != s_transform.window_size || s_slice_buffer == nullptr
+        || windows_per_slice <= 0 || windows_per_slice > s_slice_buffer_windows || column_step < 1
+        || window_count < 0 || env->GetArrayLength(window) < fft_window_size)
+        return -1;
 
-    jfloat *unwrappedRawData = env->GetFloatArrayElements(input_slice_buffer, nullptr);
-    jfloat *transformedData = env->GetFloatArrayElements(output_slice_buffer, nullptr);
+    const auto *rawData = direct_buffer<int16_t>(env, raw_data_buffer, raw_data_entries);
+    auto *transformedData = direct_buffer<float>(
+            env, transformed_data_buffer,
+            (int64_t) (transformed_time_bucket_index + window_count) * frequency_buckets);
+    if (rawData == nullptr || transformedData == nullptr)
+        return -1;
+
+    AndroidBitmapInfo info;
+    if (AndroidBitmap_getInfo(env, amplitude_bitmap, &info) < 0)
+        return -1;
+    if (info.format != ANDROID_BITMAP_FORMAT_RGB_565)
+        return -1;
+
+    // Lock the bitmap for writing:
+    uint16_t *rgb565Pixels = nullptr;
+    if (AndroidBitmap_lockPixels(env, amplitude_bitmap, (void**) &rgb565Pixels) < 0)
+        return -1;
+
+    jfloat *windowData = env->GetFloatArrayElements(window, nullptr);
     jint *triggerFlag = env->GetIntArrayElements(trigger_flag, nullptr);
 
-    // jsize length = env->GetArrayLength(output_slice_buffer);
-    if (unwrappedRawData == nullptr || transformedData == nullptr || triggerFlag == nullptr) {
+    int rc = 0;
+    if (windowData == nullptr || triggerFlag == nullptr || rgb565Pixels == nullptr) {
         rc = -1;
     } else {
-        pWindowData = unwrappedRawData;
-        int windowIndex = 0;
-        int transformedIndex = 0;  // Index within the output array.
-        jfloat *transformedDataTarget = nullptr;
-
-        // We will normalize the result so that it is independent of window size
-        // the maximum frequency bin value is A x nFFT / 2, which A is the input magnitude.
-        float normalizer = 2.0f / static_cast<float>(s_fft_window_size);
-        float normalizer2 = normalizer * normalizer;
-        bool triggered = false;
+        const uint32_t indexStride = info.stride / sizeof(uint16_t);
+        bool anyTriggered = false;
+
+        // Process a slice's worth of windows at a time, which is what the slice buffer holds.
+        // A coarse pass transforms every column_step'th window only, spreading each result
+        // over the columns up to the next:
+        while (rc < window_count) {
+            const int remaining = window_count - rc;
+            const int windows = std::min((int) windows_per_slice,
+                                         (remaining + column_step - 1) / column_step);
+            const int columns = std::min(windows * column_step, remaining);
+            const int first_x = transformed_time_bucket_index + rc;
+
+            transform_unwrap_slices(rawData, raw_data_entries, start_index + rc * fft_stride,
+                                    windows, fft_stride * column_step, windowData,
+                                    fft_window_size, s_slice_buffer);
+
+            bool triggered = false;
+            const int transformed = transform_fft(
+                    &s_transform, windows, s_slice_buffer,
+                    transformedData + (size_t) first_x * frequency_buckets, minDB,
+                    min_trigger_bucket, max_trigger_bucket, trigger_threshold, &triggered);
+            if (transformed != windows) {
+                rc = -1;
+                break;
+            }
+            anyTriggered = anyTriggered || triggered;
 
-        for (windowIndex = 0;
-             windowIndex < num_windows; windowIndex++, pWindowData += s_fft_window_size) {
-            // Do the SFFT:
-            kiss_fftr(kfft_cfg, pWindowData, s_fft_temp_buffer);
-
-            // Potential for performance improvement: move the magnitude calculate to a separate loop,
-            // and use a larger temp buffer, to reduce cache misses.
-
-            // Convert the complex spectral results to a square magnitude:
-            transformedDataTarget = transformedData + transformed_buffer_index;
-            for (int j = 0; j < s_fft_frequency_buckets; j++) {
-                float re = s_fft_temp_buffer[j].r;
-                float im = s_fft_temp_buffer[j].i;
-                const float mag_squared = (re * re + im * im) * normalizer2;
-
-                /**
-                 * This is probably the most expensive calculation per pixel. This version
-                 * of log2 is based on floats, so hopefully faster than the one based on doubles,
-                 * and faster than log10 because it avoids a division.
-                 *
-                 * I did try assigning the value into a 64 bit integer and using the compiler
-                 * built-in to count the number of leading zeroes. This was truly very fast, but
-                 * has the problem that brightness/contrast scaling would have to be done previously,
-                 * in linear rather than log space, and would have resulted in only 64 levels
-                 * of colour mapping which is a bit coarse. So, I settled for a proper log calculation,
-                 * which is actually plenty fast enough.
-                 *
-                 * Multiple by 10 to get a db value, as the square has already given us x 2.
-                 */
-                float db_value = minDB;
-                if (mag_squared > 0.0) { // Avoid log(0).
-                    db_value = s_dB_factor * log2(mag_squared);
-                }
-
-                transformedDataTarget[transformedIndex++] = db_value;
-
-                // See if the value results in a trigger:
-                if (j >= min_trigger_bucket && j <= max_trigger_bucket) {
-                    if (db_value >= trigger_threshold)
-                        triggered = true;
-                }
+            if (column_step > 1) {
+                // The amplitude is left for the full resolution pass:
+                transform_spread_columns(transformedData + (size_t) first_x * frequency_buckets,
+                                         windows, column_step, columns, frequency_buckets);
+            } else {
+                amplitude_render(s_slice_buffer, windows, fft_window_size, first_x,
+                                 s_amplitude_graph_colour, rgb565Pixels, info.height, indexStride);
             }
+            rc += columns;
         }
-        triggerFlag[0] = triggered;
-        rc = windowIndex;
+        triggerFlag[0] = anyTriggered;
     }
 
-    if (unwrappedRawData) {
+    if (windowData) {
         // JNI_ABORT means don't copy elements back, just free the memory:
-        env->ReleaseFloatArrayElements(input_slice_buffer, unwrappedRawData, 0);    // Change back to JNI_ABORT
-    }
-    if (transformedData) {
-        // 0 means copy changes back and free memory:
-        env->ReleaseFloatArrayElements(output_slice_buffer, transformedData, 0);
+        env->ReleaseFloatArrayElements(window, windowData, JNI_ABORT);
     }
     if (triggerFlag) {
+        // 0 means copy changes back and free memory:
         env->ReleaseIntArrayElements(trigger_flag, triggerFlag, 0);
     }
+    if (rgb565Pixels != nullptr) {
+        telemetry_scope scope(TELEMETRY_BITMAP_UNLOCK);
+        AndroidBitmap_unlockPixels(env, amplitude_bitmap);
+    }
 
     return rc;
 }
 
-size_t XYToBitmapOffset(int x, int y, int max_y, uint32_t indexStride) {
-    uint32_t row_start = (max_y - y - 1) * indexStride;
-    uint32_t pixel_index = row_start + x;
-    return pixel_index;
+extern "C"
+JNIEXPORT jint JNICALL
+Java_org_batgizmo_app_pipeline_TransformCache_00024Companion_initPrecompute(JNIEnv *env, jobject thiz,
+                                                                          jint fft_window_size,
+                                                                          jint windows_per_slice) {
+    if (windows_per_slice <= 0 || transform_init(&s_precompute_transform, fft_window_size) != 0)
+        return -1;
+    s_precompute_slice_buffer.resize((size_t) windows_per_slice * fft_window_size);
+    return 0;
 }
 
-/*
-static inline int coerceRange(int v, int min, int max) {
-    if (v < min)
-        v = min;
-    if (v > max)
-        v = max;
-    return v;
+extern "C"
+JNIEXPORT void JNICALL
+Java_org_batgizmo_app_pipeline_TransformCache_00024Companion_cleanupPrecompute(JNIEnv *env, jobject thiz) {
+    transform_cleanup(&s_precompute_transform);
+    std::vector<float>().swap(s_precompute_slice_buffer);
 }
-*/
 
+/**
+ * As doSlices, for up to one slice of windows, but with the precompute transform and without
+ * any trigger detection. The transformed data buffer and amplitude bitmap are the cache's
+ * rather than the pipeline's.
+ */
 extern "C"
 JNIEXPORT jint JNICALL
-Java_org_batgizmo_app_pipeline_TransformStep_00024Companion_doAmplitude(JNIEnv *env, jobject thiz,
-                                                                  jint num_windows,
-                                                                  jint fftWindowSize,
-                                                                  jfloatArray input_slice_buffer,
-                                                                  jint transformed_time_bucket_index,
-                                                                  jint transformed_time_bucket_size,
-                                                                  jint transformed_slice_time_bucket_size,
-                                                                  jobject bitmap
-                                                          ) {
-    int rc = 0;
-    const float *pWindowData = nullptr;
+Java_org_batgizmo_app_pipeline_TransformCache_00024Companion_precomputeSlice(JNIEnv *env, jobject thiz,
+                                                                           jobject raw_data_buffer,
+                                                                           jint raw_data_entries,
+                                                                           jint start_index,
+                                                                           jint window_count,
+                                                                           jint fft_stride,
+                                                                           jfloatArray window,
+                                                                           jobject transformed_data_buffer,
+                                                                           jint transformed_time_bucket_index,
+                                                                           jfloat minDB,
+                                                                           jobject amplitude_bitmap) {
+    const int fft_window_size = s_precompute_transform.window_size;
+    const int frequency_buckets = s_precompute_transform.frequency_buckets;
+    if (fft_window_size == 0 || window_count < 0
+        || (size_t) window_count * fft_window_size > s_precompute_slice_buffer.size()
+        || env->GetArrayLength(window) < fft_window_size)
+        return -1;
 
-    AndroidBitmapInfo info;
+    const auto *rawData = direct_buffer<int16_t>(env, raw_data_buffer, raw_data_entries);
+    auto *transformedData = direct_buffer<float>(
+            env, transformed_data_buffer,
+            (int64_t) (transformed_time_bucket_index + window_count) * frequency_buckets);
+    if (rawData == nullptr || transformedData == nullptr)
+        return -1;
 
-    if (AndroidBitmap_getInfo(env, bitmap, &info) < 0)
+    AndroidBitmapInfo info;
+    if (AndroidBitmap_getInfo(env, amplitude_bitmap, &info) < 0)
         return -1;
     if (info.format != ANDROID_BITMAP_FORMAT_RGB_565)
         return -1;
 
-    // Lock the bitmap for writing:
     uint16_t *rgb565Pixels = nullptr;
-    if (AndroidBitmap_lockPixels(env, bitmap, (void**) &rgb565Pixels) < 0)
-        return - 1;
+    if (AndroidBitmap_lockPixels(env, amplitude_bitmap, (void**) &rgb565Pixels) < 0)
+        return -1;
+
+    jfloat *windowData = env->GetFloatArrayElements(window, nullptr);
 
-    jfloat *unwrappedRawData = env->GetFloatArrayElements(input_slice_buffer, nullptr);
-    if (unwrappedRawData == nullptr || rgb565Pixels == nullptr) {
+    int rc = window_count;
+    if (windowData == nullptr || rgb565Pixels == nullptr) {
         rc = -1;
     } else {
-        pWindowData = unwrappedRawData;
-        int windowIndex = 0;
-        const uint32_t indexStride = info.stride / sizeof(uint16_t);
-        const uint32_t height = info.height;
-
-        const float range_min = -0x7FFF;
-        const float range_max = 0x7FFF;
-        const float range_delta = range_max - range_min;
-        const size_t maxOffset = height * indexStride - 1;
-        const float scaling = (float) height / range_delta;
-
-        // For each window:
-        int x = transformed_time_bucket_index;
-        for (windowIndex = 0; windowIndex < num_windows; windowIndex++, pWindowData += s_fft_window_size) {
-            const float *pValue = pWindowData;
-            // Initialize based on the first point in the window:
-            float min = *pValue++, max = min;
-            // Work out the range of values in the window:
-            for (int i = 1; i < fftWindowSize; i++, pValue++) {
-                float v = *pValue;
-                if (v < min)
-                    min = v;
-                if (v > max)
-                    max = v;
-            }
+        // Speculative, so any pool work gives way to the display:
+        work_priority_scope background(WORK_PRIORITY_BACKGROUND);
+        float *slice_buffer = s_precompute_slice_buffer.data();
+        transform_unwrap_slices(rawData, raw_data_entries, start_index, window_count, fft_stride,
+                                windowData, fft_window_size, slice_buffer);
 
-            // Scale those values into the height of the bitmap:
-            int y_min = (int) ((min - range_min) * scaling);
-            int y_max = (int) ((max - range_min) * scaling);
-
-            size_t offset = XYToBitmapOffset(x, height - 1, (int) height, indexStride);
-            x += 1;
-
-            // We need to draw the black as well as the colour so that we overwrite
-            // previous amplitudes.
-
-            const uint16_t black = 0;
-            int colour = black;
-            for (int y = height; y > 0; y--) {
-                if (y == y_max)
-                    colour = s_amplitude_graph_colour;
-                if (y + 1 == y_min)
-                    colour = black;
-                // Paranoia:
-                if (offset >= 0 && offset <= maxOffset)
-                    rgb565Pixels[offset] = colour;
-                offset += indexStride;
-            }
+        bool triggered = false;
+        if (transform_fft(&s_precompute_transform, window_count, slice_buffer,
+                          transformedData + (size_t) transformed_time_bucket_index * frequency_buckets,
+                          minDB, 0, -1, 0.0f, &triggered) != window_count) {
+            rc = -1;
+        } else {
+            amplitude_render(slice_buffer, window_count, fft_window_size,
+                             transformed_time_bucket_index, s_amplitude_graph_colour,
+                             rgb565Pixels, info.height, info.stride / sizeof(uint16_t));
         }
-
-        rc = windowIndex;
-    }
-
-    if (unwrappedRawData) {
-        // JNI_ABORT means don't copy elements back, just free the memory:
-        env->ReleaseFloatArrayElements(input_slice_buffer, unwrappedRawData, 0);    // Change back to JNI_ABORT
-    }
-    if (rgb565Pixels != nullptr) {
-        AndroidBitmap_unlockPixels(env, bitmap);
     }
 
+    if (windowData)
+        env->ReleaseFloatArrayElements(window, windowData, JNI_ABORT);
+    if (rgb565Pixels != nullptr)
+        AndroidBitmap_unlockPixels(env, amplitude_bitmap);
 
     return rc;
 }
@@ -406,12 +672,18 @@ extern "C"
 JNIEXPORT jint JNICALL
 Java_org_batgizmo_app_pipeline_ColourMapStep_00024Companion_doColourMapping(JNIEnv *env, jobject thiz,
                                                                         jint first, jint second,
-                                                                        jfloatArray transformed_data_buffer,
+                                                                        jobject transformed_data_buffer,
                                                                         jint transformed_time_bucket_count,
                                                                         jint transformed_frequency_bucket_count,
                                                                         jobject bitmap,
                                                                         jfloat offset, jfloat multiplier) {
 
+    const float *transformedData = direct_buffer<float>(
+            env, transformed_data_buffer,
+            (int64_t) transformed_time_bucket_count * transformed_frequency_bucket_count);
+    if (transformedData == nullptr || first < 0 || second > transformed_time_bucket_count)
+        return -1;
+
     AndroidBitmapInfo info;
 
     if (AndroidBitmap_getInfo(env, bitmap, &info) < 0)
@@ -424,102 +696,214 @@ Java_org_batgizmo_app_pipeline_ColourMapStep_00024Companion_doColourMapping(JNIE
     if (AndroidBitmap_lockPixels(env, bitmap, (void**) &rgb565Pixels) < 0)
         return - 1;
 
-    jfloat *transformedData = env->GetFloatArrayElements(transformed_data_buffer, nullptr);
-
     int rc = 0;
-    if (transformedData == nullptr || rgb565Pixels == nullptr) {
+    const int rows = (int) info.height;
+    if (rgb565Pixels == nullptr || rows < 1 || rows > transformed_frequency_bucket_count) {
         rc = -1;
+    } else if (rows < transformed_frequency_bucket_count) {
+        // A bitmap with fewer rows than frequency buckets has them max pooled into it. The
+        // table is only rebuilt when the shape changes:
+        if (s_pool_rows != rows || s_pool_buckets != transformed_frequency_bucket_count) {
+            s_pool_row_first.resize(rows + 1);
+            colour_map_pool_table(transformed_frequency_bucket_count, rows,
+                                  s_pool_row_first.data());
+            s_pool_rows = rows;
+            s_pool_buckets = transformed_frequency_bucket_count;
+        }
+        colour_map_apply_pooled(transformedData, first, second,
+                                transformed_frequency_bucket_count, s_pool_row_first.data(),
+                                rows, s_colourMapData, s_colourMapDataSize, offset, multiplier,
+                                rgb565Pixels, info.stride / sizeof(uint16_t));
     } else {
         const uint32_t indexStride = info.stride / sizeof(uint16_t);
+        colour_map_apply(transformedData, first, second, transformed_frequency_bucket_count,
+                         s_colourMapData, s_colourMapDataSize, offset, multiplier,
+                         rgb565Pixels, indexStride);
+    }
 
-        float *inputPtr = transformedData + first * transformed_frequency_bucket_count;
-        for (int timeBucket = first; timeBucket < second; timeBucket++) {
-            for (int frequencyBucket = 0; frequencyBucket < transformed_frequency_bucket_count; frequencyBucket++) {
-
-                float value = *inputPtr++;
-
-                // Apply brightness and contrast:
-                value = (value - offset) * multiplier;
-
-                int int_value = static_cast<int>(value);
-
-                // Do the colour map:
-                if (int_value > s_colourMapDataSize - 1)
-                    int_value = s_colourMapDataSize - 1;
-                else if (int_value < 0)
-                    int_value = 0;
-                int_value = s_colourMapData[int_value];
-
-                /**
-                 * I'd love to find a way of having the following code do sequential
-                 * access in both the source and destination locations, but the FFT generates
-                 * data in the opposite sequencing than bitmap buffer requires. I don't
-                 * think there is anything I can do about this. Hopefully both the source and
-                 * destination can be served by cache reasonably efficiently.
-                 */
-                const size_t index = XYToBitmapOffset(timeBucket, frequencyBucket,
-                                                       transformed_frequency_bucket_count, indexStride);
-                rgb565Pixels[index] = static_cast<jshort>(int_value);
-            }
-        }
+    if (rgb565Pixels != nullptr) {
+        telemetry_scope scope(TELEMETRY_BITMAP_UNLOCK);
+        AndroidBitmap_unlockPixels(env, bitmap);
     }
 
-    if (transformedData) {
-        // JNI_ABORT means don't copy elements back, just free the memory:
-        env->ReleaseFloatArrayElements(transformed_data_buffer, transformedData, JNI_ABORT);
+    return rc;
+}
+
+extern "C"
+JNIEXPORT jint JNICALL
+Java_org_batgizmo_app_pipeline_AbstractPipeline_00024Companion_shiftBitmapColumns(JNIEnv *env, jobject thiz,
+                                                                                jobject bitmap,
+                                                                                jint columns) {
+    AndroidBitmapInfo info;
+    if (AndroidBitmap_getInfo(env, bitmap, &info) < 0)
+        return -1;
+    if (info.format != ANDROID_BITMAP_FORMAT_RGB_565)
+        return -1;
+
+    uint16_t *rgb565Pixels = nullptr;
+    if (AndroidBitmap_lockPixels(env, bitmap, (void**) &rgb565Pixels) < 0)
+        return -1;
+
+    int rc = 0;
+    if (rgb565Pixels == nullptr) {
+        rc = -1;
+    } else {
+        colour_map_shift_columns(rgb565Pixels, (int) info.width, (int) info.height,
+                                 info.stride / sizeof(uint16_t), columns);
     }
+
     if (rgb565Pixels != nullptr) {
+        telemetry_scope scope(TELEMETRY_BITMAP_UNLOCK);
         AndroidBitmap_unlockPixels(env, bitmap);
     }
 
     return rc;
 }
 
+/**
+ * A surface that a DrawThread draws natively.
+ */
+struct native_display {
+    ANativeWindow *window = nullptr;
+};
+
+/**
+ * Take the surface's native window, set up for RGB565 buffers of the window's own size.
+ * Returns a handle for drawFrameNative, or 0 on failure.
+ */
+extern "C"
+JNIEXPORT jlong JNICALL
+Java_org_batgizmo_app_pipeline_DrawThread_00024Companion_attachNativeSurface(JNIEnv *env, jobject thiz,
+                                                                           jobject surface) {
+    ANativeWindow *window = ANativeWindow_fromSurface(env, surface);
+    if (window == nullptr)
+        return 0;
+    auto *display = new(std::nothrow) native_display();
+    if (display == nullptr || ANativeWindow_setBuffersGeometry(window, 0, 0, WINDOW_FORMAT_RGB_565) != 0) {
+        delete display;
+        ANativeWindow_release(window);
+        return 0;
+    }
+    display->window = window;
+    return reinterpret_cast<jlong>(display);
+}
+
+extern "C"
+JNIEXPORT void JNICALL
+Java_org_batgizmo_app_pipeline_DrawThread_00024Companion_detachNativeSurface(JNIEnv *env, jobject thiz,
+                                                                           jlong handle) {
+    auto *display = reinterpret_cast<native_display *>(handle);
+    if (display == nullptr)
+        return;
+    ANativeWindow_release(display->window);
+    delete display;
+}
+
+/**
+ * Lock the pixels of the frame's tiles, in place, into tile_pixels and tile_strides, adding
+ * each tile locked to locked. Returns -1 if a tile isn't RGB565 of the frame's height, or
+ * can't be locked; the caller unlocks those locked either way.
+ */
+static int lock_tiles(JNIEnv *env, jobjectArray tiles, int tile_columns, int width, int height,
+                      std::vector<jobject> &locked, std::vector<const uint16_t *> &tile_pixels,
+                      std::vector<uint32_t> &tile_strides) {
+    for (int t = 0; t < (int) tile_pixels.size(); t++) {
+        jobject bitmap = env->GetObjectArrayElement(tiles, t);
+        if (bitmap == nullptr)
+            return -1;
+        AndroidBitmapInfo info;
+        void *pixels = nullptr;
+        const int columns = std::min(tile_columns, width - t * tile_columns);
+        if (AndroidBitmap_getInfo(env, bitmap, &info) < 0
+            || info.format != ANDROID_BITMAP_FORMAT_RGB_565 || (int) info.height != height
+            || (int) info.width < columns
+            || AndroidBitmap_lockPixels(env, bitmap, &pixels) < 0) {
+            env->DeleteLocalRef(bitmap);
+            return -1;
+        }
+        locked.push_back(bitmap);
+        if (pixels == nullptr)
+            return -1;
+        tile_pixels[t] = static_cast<const uint16_t *>(pixels);
+        tile_strides[t] = info.stride / sizeof(uint16_t);
+    }
+    return 0;
+}
+
+/**
+ * Draw the visible part of a frame to a surface from attachNativeSurface, as
+ * colour_map_scale_tiles, or black if there are no tiles. The tiles are scaled from where
+ * they are, locked for the draw, rather than copied, on the work pool.
+ */
+extern "C"
+JNIEXPORT jint JNICALL
+Java_org_batgizmo_app_pipeline_DrawThread_00024Companion_drawFrameNative(JNIEnv *env, jobject thiz,
+                                                                       jlong handle,
+                                                                       jobjectArray tiles,
+                                                                       jint tile_columns,
+                                                                       jint width, jint height,
+                                                                       jfloat x_first, jfloat x_last,
+                                                                       jfloat y_first, jfloat y_last,
+                                                                       jint ring_head,
+                                                                       jint ring_columns) {
+    auto *display = reinterpret_cast<native_display *>(handle);
+    const int tile_count = tiles != nullptr ? env->GetArrayLength(tiles) : 0;
+    if (display == nullptr || tile_columns < 1 || width < 0 || height < 0
+        || (int64_t) tile_count * tile_columns < width)
+        return -1;
+
+    std::vector<jobject> locked;
+    std::vector<const uint16_t *> tile_pixels(tile_count);
+    std::vector<uint32_t> tile_strides(tile_count);
+    int rc = lock_tiles(env, tiles, tile_columns, width, height, locked, tile_pixels, tile_strides);
+
+    // Scale the frame straight into the window's buffer, in the window's own size:
+    ANativeWindow_Buffer buffer;
+    if (rc == 0 && ANativeWindow_lock(display->window, &buffer, nullptr) == 0) {
+        if (buffer.format == WINDOW_FORMAT_RGB_565) {
+            colour_map_scale_tiles(tile_pixels.data(), tile_strides.data(), tile_columns,
+                                   width, height, x_first, x_last, y_first, y_last,
+                                   ring_head, ring_columns, (uint16_t *) buffer.bits,
+                                   buffer.width, buffer.height, buffer.stride);
+        } else {
+            rc = -1;
+        }
+        ANativeWindow_unlockAndPost(display->window);
+    } else {
+        rc = -1;
+    }
+
+    for (jobject bitmap: locked) {
+        AndroidBitmap_unlockPixels(env, bitmap);
+        env->DeleteLocalRef(bitmap);
+    }
+    return rc;
+}
+
 extern "C"
 JNIEXPORT jfloatArray JNICALL
 Java_org_batgizmo_app_pipeline_AbstractPipeline_00024Companion_findBnCRange(JNIEnv *env, jobject thiz,
                                                                           jint x_min, jint x_max,
                                                                           jint y_min, jint y_max,
                                                                           jint frequency_buckets,
-                                                                          jfloatArray transformed_data_buffer) {
+                                                                          jobject transformed_data_buffer) {
 
     if (x_min == x_max || y_min == y_max)
         return nullptr;     // No data available.
 
-    // Convert Java float array to C++ array
-    jfloat *data = env->GetFloatArrayElements(transformed_data_buffer, nullptr);
-    if (data == nullptr) {
-        return nullptr;     // Memory allocation failure
+    // The x range is inclusive, but callers pass the end of the assigned data, which can be
+    // the end of the buffer, so keep within it:
+    const auto *data = static_cast<const float *>(env->GetDirectBufferAddress(transformed_data_buffer));
+    if (data == nullptr || frequency_buckets <= 0) {
+        return nullptr;     // Not a direct buffer.
     }
+    const int64_t columns = env->GetDirectBufferCapacity(transformed_data_buffer)
+                            / ((int64_t) sizeof(float) * frequency_buckets);
+    x_max = (jint) std::min((int64_t) x_max, columns - 1);
 
     float minDB = std::numeric_limits<float>::max();
     float maxDB = std::numeric_limits<float>::lowest();
-    bool first = true;
-
-    // Loop through the range
-    for (int timeIndex = x_min; timeIndex <= x_max; ++timeIndex) {
-        int offset = timeIndex * frequency_buckets;
-        // Reflect the Y indices:
-        const jint y1 = frequency_buckets - y_max - 1;
-        const jint y2 = frequency_buckets - y_min - 1;
-        for (int frequencyIndex = y1; frequencyIndex <= y2; frequencyIndex++) {
-            float dB = data[offset + frequencyIndex];
-
-            if (first) {
-                minDB = dB;
-                maxDB = dB;
-                first = false;
-            } else {
-                if (dB < minDB)
-                    minDB = dB;
-                if (dB > maxDB)
-                    maxDB = dB;
-            }
-        }
-    }
-
-    // Release memory
-    env->ReleaseFloatArrayElements(transformed_data_buffer, data, JNI_ABORT);
+    bnc_find_range(x_min, x_max, y_min, y_max, frequency_buckets, data, &minDB, &maxDB);
 
     // Create a float array to return the result
     jfloatArray result = env->NewFloatArray(2);
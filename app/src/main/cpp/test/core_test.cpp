@@ -0,0 +1,983 @@
+/*
+ * Copyright (c) 2025 John Mears
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * Host tests for the DSP core. Run with ctest after a host (non Android) CMake build.
+ */
+
+#include "core/amplitude.h"
+#include "core/arena.h"
+#include "core/bnc.h"
+#include "core/colourmap.h"
+#include "core/fftwisdom.h"
+#include "core/governor.h"
+#include "core/heterodyne.h"
+#include "core/kernels.h"
+#include "core/synthsource.h"
+#include "core/telemetry.h"
+#include "core/transform.h"
+#include "core/urbcapture.h"
+#include "core/usbpacket.h"
+#include "core/wavdecode.h"
+#include "core/wavreader.h"
+#include "core/workpool.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <unistd.h>
+#include <thread>
+#include <vector>
+
+static int s_failures = 0;
+
+#define CHECK(condition) \
+    do { \
+        if (!(condition)) { \
+            fprintf(stderr, "%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+            s_failures++; \
+        } \
+    } while (0)
+
+static std::vector<int16_t> make_tone(int count, double cycles_per_sample, double amplitude) {
+    std::vector<int16_t> data(count);
+    for (int i = 0; i < count; i++)
+        data[i] = static_cast<int16_t>(lround(amplitude * sin(2.0 * M_PI * cycles_per_sample * i)));
+    return data;
+}
+
+static void test_transform() {
+    const int nfft = 256;
+    const int stride = 64;
+    const int buckets = nfft / 2 + 1;
+    const int tone_bucket = 32;
+    transform_state state;
+    CHECK(transform_init(&state, nfft) == 0);
+    CHECK(state.frequency_buckets == buckets);
+
+    std::vector<float> window(nfft);
+    transform_hann_window(window.data(), nfft);
+    CHECK(window[0] == 0.0f);
+    CHECK(fabsf(window[nfft / 2] - 1.0f) < 1e-3f);
+
+    // Four windows fit; a fifth would extend beyond the data so must be skipped:
+    const int raw_count = 3 * stride + nfft;
+    auto raw = make_tone(raw_count, static_cast<double>(tone_bucket) / nfft, 10000.0);
+    std::vector<float> unwrapped(5 * nfft, 12345.0f);
+    transform_unwrap_slices(raw.data(), raw_count, 0, 5, stride, window.data(), nfft,
+                            unwrapped.data());
+    CHECK(unwrapped[nfft + 10] == static_cast<float>(raw[stride + 10]) * window[10]);
+    CHECK(unwrapped[4 * nfft] == 12345.0f);
+
+    std::vector<float> output(4 * buckets);
+    bool triggered = false;
+    CHECK(transform_fft(&state, 4, unwrapped.data(), output.data(), BNC_DB_RANGE_MIN,
+                        0, buckets - 1, 40.0f, &triggered) == 4);
+    CHECK(triggered);
+    for (int w = 0; w < 4; w++) {
+        const float *column = output.data() + w * buckets;
+        int peak = 0;
+        for (int f = 1; f < buckets; f++) {
+            if (column[f] > column[peak])
+                peak = f;
+        }
+        CHECK(peak == tone_bucket);
+    }
+
+    // Nothing reaches the threshold away from the tone:
+    CHECK(transform_fft(&state, 1, unwrapped.data(), output.data(), BNC_DB_RANGE_MIN,
+                        tone_bucket + 8, buckets - 1, 40.0f, &triggered) == 1);
+    CHECK(!triggered);
+
+    // Silence maps to the minimum dB value rather than log(0):
+    std::vector<float> silence(nfft, 0.0f);
+    transform_fft(&state, 1, silence.data(), output.data(), BNC_DB_RANGE_MIN, 0, buckets - 1,
+                  40.0f, &triggered);
+    CHECK(output[0] == BNC_DB_RANGE_MIN);
+
+    // Three coarse windows of two values spread over seven columns, three at a time:
+    std::vector<float> spread(7 * 2, -1.0f);
+    for (int i = 0; i < 6; i++)
+        spread[i] = static_cast<float>(i);
+    transform_spread_columns(spread.data(), 3, 3, 7, 2);
+    const float spread_expected[] = {0, 1, 0, 1, 0, 1, 2, 3, 2, 3, 2, 3, 4, 5};
+    CHECK(memcmp(spread.data(), spread_expected, sizeof(spread_expected)) == 0);
+
+    transform_cleanup(&state);
+    CHECK(state.cfg == nullptr && state.temp_buffer == nullptr);
+    transform_cleanup(&state);
+}
+
+static void test_transform_plans() {
+    // Every plan must give exactly the same results as the default one:
+    const int nfft = 256, stride = 64, windows = 37;
+    const std::vector<int16_t> raw = make_tone((windows - 1) * stride + nfft, 0.1, 10000.0);
+    std::vector<float> window(nfft);
+    transform_hann_window(window.data(), nfft);
+    std::vector<float> input(windows * nfft);
+    transform_unwrap_slices(raw.data(), static_cast<int>(raw.size()), 0, windows, stride,
+                            window.data(), nfft, input.data());
+
+    transform_state state;
+    CHECK(transform_init(&state, nfft) == 0);
+    const int buckets = state.frequency_buckets;
+    std::vector<float> expected(windows * buckets);
+    bool expected_triggered = false;
+    CHECK(transform_fft(&state, windows, input.data(), expected.data(), BNC_DB_RANGE_MIN,
+                        20, 30, 40.0f, &expected_triggered) == windows);
+
+    transform_plan bad;
+    bad.threads = TRANSFORM_MAX_THREADS + 1;
+    CHECK(transform_set_plan(&state, &bad) == -1);
+    CHECK(state.plan.threads == 1);
+
+    for (const auto &plan: fft_autotune_candidates(4)) {
+        CHECK(transform_set_plan(&state, &plan) == 0);
+        std::vector<float> output(windows * buckets + 1, 12345.0f);
+        bool triggered = !expected_triggered;
+        CHECK(transform_fft(&state, windows, input.data(), output.data(), BNC_DB_RANGE_MIN,
+                            20, 30, 40.0f, &triggered) == windows);
+        CHECK(triggered == expected_triggered);
+        CHECK(memcmp(output.data(), expected.data(), expected.size() * sizeof(float)) == 0);
+        CHECK(output[windows * buckets] == 12345.0f);
+    }
+    transform_cleanup(&state);
+}
+
+static void test_fft_wisdom() {
+    fft_wisdom_entry best;
+    std::vector<fft_wisdom_entry> results;
+    CHECK(fft_autotune(512, 128, 20, 2, 5.0, &best, &results) == 0);
+    CHECK(results.size() == fft_autotune_candidates(2).size());
+    CHECK(best.fft_window_size == 512 && best.fft_stride == 128 && best.ns_per_window > 0.0);
+    for (const auto &r: results)
+        CHECK(best.ns_per_window <= r.ns_per_window);
+
+    char path[] = "/tmp/batgizmo-wisdom-test-XXXXXX";
+    const int fd = mkstemp(path);
+    CHECK(fd >= 0);
+    if (fd < 0)
+        return;
+    close(fd);
+
+    fft_wisdom wisdom;
+    wisdom.fingerprint = "test device 1";
+    fft_wisdom_set(&wisdom, best);
+    best.fft_stride = 256;
+    best.plan.batch_windows = 8;
+    fft_wisdom_set(&wisdom, best);
+    best.plan.threads = 2;
+    fft_wisdom_set(&wisdom, best);      // Replaces the previous entry.
+    CHECK(wisdom.entries.size() == 2);
+    CHECK(fft_wisdom_save(path, &wisdom) == 0);
+
+    fft_wisdom loaded;
+    CHECK(fft_wisdom_load(path, "test device 1", &loaded) == 0);
+    CHECK(loaded.entries.size() == 2);
+    const fft_wisdom_entry *entry = fft_wisdom_find(&loaded, 512, 256);
+    CHECK(entry != nullptr && entry->plan.batch_windows == 8 && entry->plan.threads == 2);
+    CHECK(fft_wisdom_find(&loaded, 1024, 256) == nullptr);
+
+    // Wisdom from another device or software version is discarded:
+    CHECK(fft_wisdom_load(path, "test device 2", &loaded) == -1);
+    CHECK(loaded.entries.empty() && loaded.fingerprint == "test device 2");
+    remove(path);
+    CHECK(fft_wisdom_load(path, "test device 1", &loaded) == -1);
+}
+
+static void test_governor() {
+    const int64_t slice_ns = 25000000;     // 25 ms of data per slice.
+    governor_state state;
+    governor_config config = governor_default_config(0);
+    CHECK(governor_init(&state, &config) == -1);
+    config = governor_default_config(3);
+    CHECK(governor_init(&state, &config) == 0);
+    CHECK(state.level == 0);
+
+    // A brief overload is tolerated:
+    for (int i = 0; i < 5; i++)
+        CHECK(governor_update(&state, slice_ns, slice_ns, 0, 0, 2.0f) == 0);
+
+    // A sustained one steps down, once:
+    int slices = 0;
+    while (governor_update(&state, slice_ns, slice_ns, 0, 0, 2.0f) == 0 && slices < 100)
+        slices++;
+    CHECK(state.level == 1);
+    CHECK(slices * slice_ns < config.down_after_ns);
+
+    // Nothing changes while settling, even with drops:
+    CHECK(governor_update(&state, slice_ns * 2, slice_ns, 10, 5, 2.0f) == 1);
+    for (int64_t t = slice_ns; t < config.settle_ns; t += slice_ns)
+        governor_update(&state, slice_ns, slice_ns, 0, 0, 2.0f);
+
+    // Dropped buffers step down at once, but not beyond the last level:
+    CHECK(governor_update(&state, slice_ns / 10, slice_ns, 0, 1, 2.0f) == 2);
+    for (int64_t t = 0; t < config.settle_ns; t += slice_ns)
+        governor_update(&state, slice_ns / 10, slice_ns, 0, 0, 2.0f);
+    CHECK(governor_update(&state, slice_ns, slice_ns, 0, 1, 2.0f) == 2);
+
+    // Headroom that wouldn't survive the cost of the next level up holds the level:
+    for (int i = 0; i < 1000; i++)
+        governor_update(&state, slice_ns / 2, slice_ns, 0, 0, 2.0f);
+    CHECK(state.level == 2);
+
+    // Sustained headroom steps up, after a while:
+    slices = 0;
+    while (governor_update(&state, slice_ns / 10, slice_ns, 0, 0, 2.0f) == 2 && slices < 1000)
+        slices++;
+    CHECK(state.level == 1);
+    CHECK(slices * slice_ns >= config.up_after_ns);
+
+    // A backlog counts as overload:
+    for (int i = 0; i < 1000 && state.level == 1; i++)
+        governor_update(&state, slice_ns / 10, slice_ns, config.backlog_limit + 1, 0, 2.0f);
+    CHECK(state.level == 2);
+}
+
+static void test_work_pool() {
+    const cpu_topology topology = cpu_topology_detect();
+    CHECK(topology.cores >= 1);
+    CHECK(topology.big_cores >= 1 && topology.big_cores <= topology.cores);
+
+    // Force parallelism even on a single core machine:
+    const cpu_topology four = {4, 4};
+    work_pool *pool = work_pool_create(3, &four);
+    CHECK(pool != nullptr && work_pool_workers(pool) == 3);
+
+    // Every iteration runs exactly once, including in nested loops:
+    std::vector<std::atomic<int>> counts(1000);
+    work_pool_parallel_for(pool, WORK_PRIORITY_DISPLAY, 100, [&](int i) {
+        work_pool_parallel_for(pool, WORK_PRIORITY_DISPLAY, 10, [&](int j) {
+            counts[i * 10 + j]++;
+        });
+    });
+    CHECK(std::all_of(counts.begin(), counts.end(), [](const std::atomic<int> &c) {
+        return c.load() == 1;
+    }));
+
+    // Nested work inherits the priority of the task it is part of:
+    std::atomic<int> background_nested(0);
+    work_pool_parallel_for(pool, WORK_PRIORITY_BACKGROUND, 4, [&](int) {
+        if (work_current_priority() == WORK_PRIORITY_BACKGROUND)
+            background_nested++;
+    });
+    CHECK(background_nested == 4);
+    CHECK(work_current_priority() == WORK_PRIORITY_DISPLAY);
+
+    // A thread outside the pool can declare its work background for a scope:
+    {
+        work_priority_scope background(WORK_PRIORITY_BACKGROUND);
+        background_nested = 0;
+        work_pool_parallel_for(pool, work_current_priority(), 4, [&](int) {
+            if (work_current_priority() == WORK_PRIORITY_BACKGROUND)
+                background_nested++;
+        });
+        CHECK(background_nested == 4);
+    }
+    CHECK(work_current_priority() == WORK_PRIORITY_DISPLAY);
+    work_pool_destroy(pool);
+
+    // With the only worker busy, queued display work goes ahead of background work
+    // that was queued first:
+    pool = work_pool_create(1, &four);
+    std::atomic<bool> release(false);
+    std::mutex order_mutex;
+    std::vector<int> order;
+    work_pool_submit(pool, WORK_PRIORITY_BACKGROUND, [&] {
+        while (!release)
+            std::this_thread::yield();
+    });
+    for (int i = 0; i < 3; i++) {
+        work_pool_submit(pool, WORK_PRIORITY_BACKGROUND, [&] {
+            std::lock_guard<std::mutex> lock(order_mutex);
+            order.push_back(WORK_PRIORITY_BACKGROUND);
+        });
+    }
+    work_pool_submit(pool, WORK_PRIORITY_DISPLAY, [&] {
+        std::lock_guard<std::mutex> lock(order_mutex);
+        order.push_back(WORK_PRIORITY_DISPLAY);
+    });
+    release = true;
+    work_pool_destroy(pool);    // Runs everything queued first.
+    CHECK(order.size() == 4 && order[0] == WORK_PRIORITY_DISPLAY);
+
+    // A pool without workers runs submitted tasks at once:
+    pool = work_pool_create(0, &four);
+    bool ran = false;
+    work_pool_submit(pool, WORK_PRIORITY_BACKGROUND, [&] { ran = true; });
+    CHECK(ran);
+    work_pool_destroy(pool);
+
+    // Regions big enough to be searched in parallel give the same answer:
+    const int time_buckets = 2000, frequency_buckets = 257;
+    std::vector<float> transformed((size_t) time_buckets * frequency_buckets);
+    for (size_t i = 0; i < transformed.size(); i++)
+        transformed[i] = (float) ((i * 7919) % 1000) - 500.0f;
+    transformed[(size_t) 1500 * frequency_buckets + 100] = 900.0f;
+    float min_db = 0.0f, max_db = 0.0f;
+    CHECK(bnc_find_range(0, time_buckets - 1, 0, frequency_buckets - 1, frequency_buckets,
+                         transformed.data(), &min_db, &max_db));
+    CHECK(min_db == -500.0f && max_db == 900.0f);
+}
+
+static void test_arena() {
+    arena *a = arena_create(1 << 20);
+    CHECK(a != nullptr);
+
+    // Blocks are aligned, and reused when big enough:
+    void *raw = arena_acquire(a, ARENA_SLOT_RAW, 1000);
+    CHECK(raw != nullptr && (uintptr_t) raw % ARENA_ALIGNMENT == 0);
+    CHECK(arena_acquire(a, ARENA_SLOT_RAW, 500) == raw);
+    CHECK(arena_acquire(a, ARENA_SLOT_RAW, 1000) == raw);
+    CHECK(arena_acquire(a, ARENA_SLOT_COUNT, 100) == nullptr);
+
+    // Nothing may take the arena over budget, and a failure keeps the existing block:
+    CHECK(arena_acquire(a, ARENA_SLOT_RAW, (1 << 20) + 1) == nullptr);
+    CHECK(arena_acquire(a, ARENA_SLOT_TRANSFORMED, (1 << 20) - 4096) != nullptr);
+    CHECK(arena_acquire(a, ARENA_SLOT_SLICE, 4096) == nullptr);
+    arena_stats stats;
+    arena_get_stats(a, &stats);
+    CHECK(stats.slots[ARENA_SLOT_RAW].size == 1000 && stats.slots[ARENA_SLOT_RAW].capacity == 1024);
+    CHECK(stats.capacity == (1 << 20) - 3072 && stats.in_use == (1 << 20) - 3096);
+
+    // Released blocks give way to others if need be, but are kept otherwise:
+    arena_release(a, ARENA_SLOT_TRANSFORMED);
+    CHECK(arena_acquire(a, ARENA_SLOT_SLICE, 64) != nullptr);
+    arena_get_stats(a, &stats);
+    CHECK(stats.slots[ARENA_SLOT_TRANSFORMED].capacity == (1 << 20) - 4096);
+    CHECK(stats.in_use == 1000 + 64);
+
+    // Retired memory counts against the budget, so a released block that gives way only
+    // makes room once the retired blocks are freed:
+    CHECK(arena_acquire(a, ARENA_SLOT_SLICE, 4096) == nullptr);
+    arena_get_stats(a, &stats);
+    CHECK(stats.slots[ARENA_SLOT_TRANSFORMED].capacity == 0);
+    CHECK(stats.retired == (1 << 20) - 4096 && stats.slots[ARENA_SLOT_SLICE].capacity == 64);
+    arena_free_retired(a);
+    void *slice = arena_acquire(a, ARENA_SLOT_SLICE, 4096);
+    CHECK(slice != nullptr && (uintptr_t) slice % ARENA_ALIGNMENT == 0);
+    arena_get_stats(a, &stats);
+    CHECK(stats.retired == 64 && stats.capacity == 1024 + 4096 + 64);
+    CHECK(stats.high_water == (1 << 20) - 3096);
+    CHECK(stats.slots[ARENA_SLOT_TRANSFORMED].high_water == (1 << 20) - 4096);
+
+    // A lower budget retires released blocks, but not those in use. Retired blocks, as
+    // well as those that were outgrown, stay allocated until a trim:
+    arena_release(a, ARENA_SLOT_SLICE);
+    arena_set_budget(a, 512);
+    arena_get_stats(a, &stats);
+    CHECK(stats.budget == 512 && stats.in_use == 1000);
+    CHECK(stats.retired == 4096 + 64 && stats.capacity == stats.retired + 1024);
+    CHECK(arena_acquire(a, ARENA_SLOT_RAW, 1000) == raw);
+    arena_release(a, ARENA_SLOT_RAW);
+    arena_trim(a);
+    arena_get_stats(a, &stats);
+    CHECK(stats.capacity == 0 && stats.retired == 0 && stats.in_use == 0);
+    CHECK(strcmp(arena_slot_name(ARENA_SLOT_FFT_SCRATCH), "fft_scratch") == 0);
+
+    // A buffer still held when its slot grows keeps its memory, and contents, until a trim:
+    arena_set_budget(a, 1 << 20);
+    auto *held = static_cast<uint8_t *>(arena_acquire(a, ARENA_SLOT_RAW, 256));
+    CHECK(held != nullptr);
+    memset(held, 0x5A, 256);
+    void *grown = arena_acquire(a, ARENA_SLOT_RAW, 4096);
+    CHECK(grown != nullptr && grown != held);
+    memset(grown, 0, 4096);
+    CHECK(held[0] == 0x5A && held[255] == 0x5A);
+    arena_get_stats(a, &stats);
+    CHECK(stats.retired == 256 && stats.capacity == 4096 + 256);
+    arena_trim(a);
+    arena_get_stats(a, &stats);
+    CHECK(stats.retired == 0 && stats.capacity == 4096);
+    arena_destroy(a);
+
+    // A transform with its scratch space in an arena gives the same results, and leaves
+    // the space for the next one:
+    const int nfft = 512, stride = 128, windows = 20;
+    const std::vector<int16_t> samples = make_tone((windows - 1) * stride + nfft, 0.2, 10000.0);
+    std::vector<float> window(nfft);
+    transform_hann_window(window.data(), nfft);
+    std::vector<float> input(windows * nfft);
+    transform_unwrap_slices(samples.data(), static_cast<int>(samples.size()), 0, windows, stride,
+                            window.data(), nfft, input.data());
+
+    transform_state plain;
+    CHECK(transform_init(&plain, nfft) == 0);
+    CHECK((uintptr_t) plain.temp_buffer % ARENA_ALIGNMENT == 0);
+    std::vector<float> expected(windows * plain.frequency_buckets);
+    bool triggered = false;
+    CHECK(transform_fft(&plain, windows, input.data(), expected.data(), BNC_DB_RANGE_MIN,
+                        0, 0, 1000.0f, &triggered) == windows);
+    transform_cleanup(&plain);
+
+    a = arena_create(1 << 20);
+    transform_state state;
+    state.scratch_arena = a;
+    CHECK(transform_init(&state, nfft) == 0);
+    transform_plan plan;
+    plan.batch_windows = 4;
+    plan.threads = 2;
+    CHECK(transform_set_plan(&state, &plan) == 0);
+    std::vector<float> output(expected.size());
+    CHECK(transform_fft(&state, windows, input.data(), output.data(), BNC_DB_RANGE_MIN,
+                        0, 0, 1000.0f, &triggered) == windows);
+    CHECK(memcmp(output.data(), expected.data(), expected.size() * sizeof(float)) == 0);
+    transform_cleanup(&state);
+    arena_get_stats(a, &stats);
+    CHECK(stats.slots[ARENA_SLOT_FFT_SCRATCH].size == 0);
+    CHECK(stats.slots[ARENA_SLOT_FFT_SCRATCH].capacity
+          >= sizeof(kiss_fft_cpx) * (nfft / 2 + 1) * plan.batch_windows * plan.threads);
+    arena_destroy(a);
+}
+
+static void test_colour_map_and_bnc() {
+    // Two time buckets of three frequency buckets:
+    const float transformed[] = {0.0f, 10.0f, 20.0f, 30.0f, -100.0f, 100.0f};
+    const uint16_t colour_map[] = {0, 1, 2, 3};
+    uint16_t pixels[6] = {};
+    colour_map_apply(transformed, 0, 2, 3, colour_map, 4, 0.0f, 0.1f, pixels, 2);
+    // Rows are reflected, so frequency bucket 0 is the bottom row:
+    CHECK(pixels[xy_to_bitmap_offset(0, 0, 3, 2)] == 0);
+    CHECK(pixels[xy_to_bitmap_offset(0, 1, 3, 2)] == 1);
+    CHECK(pixels[xy_to_bitmap_offset(0, 2, 3, 2)] == 2);
+    CHECK(pixels[xy_to_bitmap_offset(1, 0, 3, 2)] == 3);
+    CHECK(pixels[xy_to_bitmap_offset(1, 1, 3, 2)] == 0);   // Clamped low.
+    CHECK(pixels[xy_to_bitmap_offset(1, 2, 3, 2)] == 3);   // Clamped high.
+    CHECK(xy_to_bitmap_offset(0, 2, 3, 2) == 0);
+
+    float min_db = 0.0f, max_db = 0.0f;
+    CHECK(bnc_find_range(0, 1, 0, 2, 3, transformed, &min_db, &max_db));
+    CHECK(min_db == -100.0f && max_db == 100.0f);
+    CHECK(!bnc_find_range(0, 0, 0, 2, 3, transformed, &min_db, &max_db));
+
+    float low_db, high_db;
+    bnc_auto_range(0.0f, 80.0f, &low_db, &high_db);
+    CHECK(low_db == 20.0f && high_db == 80.0f);
+    bnc_auto_range(-200.0f, 200.0f, &low_db, &high_db);
+    CHECK(low_db >= BNC_DB_RANGE_MIN && high_db == BNC_DB_RANGE_MAX);
+
+    float offset, multiplier;
+    bnc_offset_multiplier(10.0f, 10.0f, 256, &offset, &multiplier);
+    CHECK(offset == 10.0f && std::isfinite(multiplier));
+
+    // A 4 x 2 image, with rows 5 pixels apart, shifted both ways:
+    uint16_t image[] = {1, 2, 3, 4, 99, 5, 6, 7, 8, 99};
+    colour_map_shift_columns(image, 4, 2, 5, 1);
+    const uint16_t left[] = {2, 3, 4, 4, 99, 6, 7, 8, 8, 99};
+    CHECK(memcmp(image, left, sizeof(image)) == 0);
+    colour_map_shift_columns(image, 4, 2, 5, -2);
+    const uint16_t right[] = {2, 3, 2, 3, 99, 6, 7, 6, 7, 99};
+    CHECK(memcmp(image, right, sizeof(image)) == 0);
+    colour_map_shift_columns(image, 4, 2, 5, 4);   // Nothing kept.
+    CHECK(memcmp(image, right, sizeof(image)) == 0);
+
+    // Five buckets pooled into two rows, of buckets 0 to 1 and 2 to 4, keep the peak of each:
+    int row_first[3];
+    colour_map_pool_table(5, 2, row_first);
+    CHECK(row_first[0] == 0 && row_first[1] == 2 && row_first[2] == 5);
+    const float pooled_data[] = {-100.0f, 100.0f, -100.0f, -100.0f, -100.0f};
+    const uint16_t pool_map[] = {1, 2, 3};
+    uint16_t pooled[2] = {};
+    colour_map_apply_pooled(pooled_data, 0, 1, 5, row_first, 2, pool_map, 3, 0.0f, 1.0f,
+                            pooled, 1);
+    CHECK(pooled[1] == 3 && pooled[0] == 1);   // Row 0 is the bottom.
+
+    // A 3 x 2 image in tiles of 2 columns, scaled to 6 x 2 and drawn as a ring from column 1:
+    const uint16_t tile0[] = {1, 2, 4, 5};
+    const uint16_t tile1[] = {3, 99, 6, 99};
+    const uint16_t *const tiles[] = {tile0, tile1};
+    const uint32_t tile_strides[] = {2, 2};
+    uint16_t scaled[14];
+    memset(scaled, 0xFF, sizeof(scaled));
+    colour_map_scale_tiles(tiles, tile_strides, 2, 3, 2, 0.0f, 3.0f, 0.0f, 2.0f, -1, 0,
+                           scaled, 6, 2, 7);
+    const uint16_t expected[] = {1, 1, 2, 2, 3, 3, 0xFFFF, 4, 4, 5, 5, 6, 6, 0xFFFF};
+    CHECK(memcmp(scaled, expected, sizeof(scaled)) == 0);
+    colour_map_scale_tiles(tiles, tile_strides, 2, 3, 2, 0.0f, 3.0f, 1.0f, 3.0f, 1, 3,
+                           scaled, 3, 2, 7);
+    CHECK(scaled[0] == 5 && scaled[1] == 6 && scaled[2] == 4);
+    CHECK(scaled[7] == 0 && scaled[9] == 0);   // Below the image.
+
+    // A screen sized output is scaled in stripes on the work pool, with the same result:
+    const int big_width = 600, big_height = 100, out_width = 800, out_height = 600;
+    std::vector<uint16_t> big_image((size_t) big_width * big_height);
+    for (size_t i = 0; i < big_image.size(); i++)
+        big_image[i] = (uint16_t) (i * 31);
+    const uint16_t *const big_tiles[] = {big_image.data(), big_image.data() + 256, big_image.data() + 512};
+    const uint32_t big_strides[] = {big_width, big_width, big_width};
+    std::vector<uint16_t> big_scaled((size_t) out_width * out_height);
+    colour_map_scale_tiles(big_tiles, big_strides, 256, big_width, big_height,
+                           0.0f, big_width, 0.0f, big_height, -1, 0,
+                           big_scaled.data(), out_width, out_height, out_width);
+    bool big_match = true;
+    for (int y = 0; y < out_height; y++) {
+        for (int x = 0; x < out_width; x++) {
+            const int column = (int) floorf((x + 0.5f) * big_width / out_width);
+            const int row = (int) floorf((y + 0.5f) * big_height / out_height);
+            big_match &= big_scaled[(size_t) y * out_width + x] == big_image[(size_t) row * big_width + column];
+        }
+    }
+    CHECK(big_match);
+
+    uint8_t rgb[3];
+    colour_map_rgb565_to_rgb(colour_map_rgb_to_rgb565(255, 255, 255), rgb);
+    CHECK(rgb[0] == 255 && rgb[1] == 255 && rgb[2] == 255);
+}
+
+static void test_amplitude() {
+    const int nfft = 4;
+    const uint32_t height = 8;
+    const uint32_t stride = 3;
+    // A quiet window and a full scale one:
+    const float input[] = {-10.0f, 0.0f, 10.0f, 0.0f, -32767.0f, 0.0f, 32767.0f, 0.0f};
+    std::vector<uint16_t> pixels(height * stride, 0x1234);
+    CHECK(amplitude_render(input, 2, nfft, 1, 0xFFFF, pixels.data(), height, stride) == 2);
+
+    int quiet_lit = 0, loud_lit = 0;
+    for (uint32_t y = 0; y < height; y++) {
+        quiet_lit += pixels[y * stride + 1] == 0xFFFF;
+        loud_lit += pixels[y * stride + 2] == 0xFFFF;
+        CHECK(pixels[y * stride] == 0x1234);   // Other columns are untouched.
+    }
+    CHECK(quiet_lit >= 1 && quiet_lit <= 2);
+    CHECK(loud_lit == static_cast<int>(height));
+}
+
+static void test_heterodyne() {
+    const int sample_rate = 384000;
+    const int reference_len = sample_rate / 1000;
+    heterodyne_state state = {};
+    state.decimation_factor = 8;
+    state.iir_coefficient = heterodyne_iir_coefficient(HETERODYNE_AA_CUTOFF_HZ, sample_rate);
+    CHECK(state.iir_coefficient > 0);
+
+    CHECK(heterodyne_start(&state, reference_len, reference_len + 1, 0, 0) == -1);
+    CHECK(heterodyne_start(&state, reference_len, 40, 0, 0) == 0);
+    CHECK(state.reference_data[reference_len] == HETERODYNE_CANARY_VALUE);
+
+    // Silence in, silence out:
+    std::vector<int16_t> input(reference_len * 10, 0);
+    std::vector<int16_t> output(input.size() / state.decimation_factor);
+    CHECK(heterodyne_process(&state, input.data(), input.size(), output.data())
+          == static_cast<int>(output.size()));
+    for (int16_t v: output)
+        CHECK(v == 0);
+
+    // A tone 1 kHz from the reference is mixed down to an audible 1 kHz:
+    heterodyne_filter_reset(&state);
+    input = make_tone(reference_len * 10, 41.0 / reference_len, 8000.0);
+    heterodyne_process(&state, input.data(), input.size(), output.data());
+    int peak = 0;
+    for (size_t i = output.size() / 2; i < output.size(); i++)
+        peak = std::max(peak, abs(output[i]));
+    CHECK(peak > 100);
+
+    // A tone far from the reference is filtered out:
+    heterodyne_filter_reset(&state);
+    input = make_tone(reference_len * 10, 100.0 / reference_len, 8000.0);
+    heterodyne_process(&state, input.data(), input.size(), output.data());
+    int residual = 0;
+    for (size_t i = output.size() / 2; i < output.size(); i++)
+        residual = std::max(residual, abs(output[i]));
+    CHECK(residual < peak / 20);
+}
+
+static void test_kernels() {
+    const std::vector<const kernel_table *> supported = kernels_supported();
+    const kernel_table *reference = supported.back();
+    CHECK(strcmp(reference->name, "reference") == 0);
+    CHECK(kernels_select("no such kernels") == -1);
+    CHECK(kernels() != nullptr);
+
+    const int nfft = 256;
+    const int buckets = nfft / 2 + 1;
+    const std::vector<int16_t> raw = make_tone(nfft, 0.1, 20000.0);
+    std::vector<float> window(nfft);
+    transform_hann_window(window.data(), nfft);
+
+    std::vector<kiss_fft_cpx> spectrum(buckets);
+    for (int j = 0; j < buckets; j++) {
+        spectrum[j].r = static_cast<float>(raw[j]) * (j % 7 == 0 ? 0.0f : 1e-3f * j);
+        spectrum[j].i = static_cast<float>(raw[j + 1]) * 1e-2f;
+    }
+    spectrum[3].r = spectrum[3].i = 0.0f;
+    spectrum[4].r = 1e-25f;     // Squares to a denormal.
+
+    const int colour_map_size = 100;
+    std::vector<uint16_t> colour_map(colour_map_size);
+    for (int i = 0; i < colour_map_size; i++)
+        colour_map[i] = static_cast<uint16_t>(i * 7);
+
+    std::vector<float> expected_unwrapped(nfft), expected_db(buckets);
+    std::vector<uint16_t> expected_pixels(2 * buckets);
+    const int pooled_rows = 50;
+    std::vector<int> row_first(pooled_rows + 1);
+    colour_map_pool_table(buckets, pooled_rows, row_first.data());
+    std::vector<uint16_t> expected_pooled(2 * pooled_rows);
+    reference->unwrap_window(raw.data(), window.data(), nfft, expected_unwrapped.data());
+    reference->power_to_db(spectrum.data(), buckets, 1e-6f, BNC_DB_RANGE_MIN, expected_db.data());
+    reference->colour_map(expected_db.data(), 0, 1, buckets, colour_map.data(), colour_map_size,
+                          -60.0f, 1.5f, expected_pixels.data(), 2);
+    reference->colour_map_pooled(expected_db.data(), 0, 1, buckets, row_first.data(), pooled_rows,
+                                 colour_map.data(), colour_map_size, -60.0f, 1.5f,
+                                 expected_pooled.data(), 2);
+    CHECK(expected_db[3] == BNC_DB_RANGE_MIN);
+
+    // Every variant gives the same results as the reference, except for rounding in the log:
+    for (const kernel_table *table: supported) {
+        std::vector<float> unwrapped(nfft), db(buckets);
+        table->unwrap_window(raw.data(), window.data(), nfft, unwrapped.data());
+        CHECK(unwrapped == expected_unwrapped);
+
+        table->power_to_db(spectrum.data(), buckets, 1e-6f, BNC_DB_RANGE_MIN, db.data());
+        for (int j = 0; j < buckets; j++)
+            CHECK(fabsf(db[j] - expected_db[j]) < 1e-3f);
+
+        std::vector<uint16_t> pixels(2 * buckets);
+        table->colour_map(expected_db.data(), 0, 1, buckets, colour_map.data(), colour_map_size,
+                          -60.0f, 1.5f, pixels.data(), 2);
+        CHECK(pixels == expected_pixels);
+
+        std::vector<uint16_t> pooled(2 * pooled_rows);
+        table->colour_map_pooled(expected_db.data(), 0, 1, buckets, row_first.data(), pooled_rows,
+                                 colour_map.data(), colour_map_size, -60.0f, 1.5f, pooled.data(), 2);
+        CHECK(pooled == expected_pooled);
+
+        const int sample_rate = 384000;
+        heterodyne_state state = {}, expected_state = {};
+        state.decimation_factor = expected_state.decimation_factor = 8;
+        state.iir_coefficient = expected_state.iir_coefficient =
+                heterodyne_iir_coefficient(HETERODYNE_AA_CUTOFF_HZ, sample_rate);
+        CHECK(heterodyne_start(&state, sample_rate / 1000, 40, 45, 1) == 0);
+        CHECK(heterodyne_start(&expected_state, sample_rate / 1000, 40, 45, 1) == 0);
+        const std::vector<int16_t> input = make_tone(sample_rate / 100, 0.11, 8000.0);
+        std::vector<int16_t> output(input.size() / 8), expected_output(input.size() / 8);
+        CHECK(table->heterodyne(&state, input.data(), input.size(), output.data()) ==
+              reference->heterodyne(&expected_state, input.data(), input.size(),
+                                    expected_output.data()));
+        CHECK(output == expected_output);
+
+        CHECK(kernels_select(table->name) == 0);
+        CHECK(kernels() == table);
+    }
+
+    CHECK(kernels_select(nullptr) == 0);
+}
+
+static int s_trace_depth = 0;
+static int s_trace_sections = 0;
+
+static void test_telemetry() {
+    telemetry_reset();
+    telemetry_set_enabled(false);
+    CHECK(!telemetry_active());
+    { telemetry_scope scope(TELEMETRY_UNWRAP); }
+
+    telemetry_stats stats[TELEMETRY_STAGE_COUNT];
+    telemetry_snapshot(stats);
+    CHECK(stats[TELEMETRY_UNWRAP].count == 0);
+
+    // 1..1000 us: the percentiles are bucket limits, so up to a quarter high:
+    for (int i = 1; i <= 1000; i++)
+        telemetry_record(TELEMETRY_FFT, i * 1000LL);
+    telemetry_snapshot(stats);
+    CHECK(stats[TELEMETRY_FFT].count == 1000);
+    CHECK(stats[TELEMETRY_FFT].max_ns == 1000000);
+    CHECK(stats[TELEMETRY_FFT].p50_ns >= 500000 && stats[TELEMETRY_FFT].p50_ns <= 625000);
+    CHECK(stats[TELEMETRY_FFT].p99_ns >= 990000 && stats[TELEMETRY_FFT].p99_ns <= 1000000);
+    CHECK(stats[TELEMETRY_DB].count == 0 && stats[TELEMETRY_DB].p99_ns == 0);
+
+    // Timed sections are recorded and traced when enabled:
+    static const telemetry_trace_hooks hooks = {
+            [](const char *) { s_trace_depth++; s_trace_sections++; },
+            []() { s_trace_depth--; },
+            []() { return true; }
+    };
+    telemetry_set_trace_hooks(&hooks);
+    CHECK(telemetry_active());
+    transform_state state = {};
+    CHECK(transform_init(&state, 256) == 0);
+    std::vector<float> input(256 * 4, 1.0f), output(129 * 4);
+    bool triggered;
+    CHECK(transform_fft(&state, 4, input.data(), output.data(), BNC_DB_RANGE_MIN, 0, 0, 0.0f,
+                        &triggered) == 4);
+    transform_cleanup(&state);
+    telemetry_set_trace_hooks(nullptr);
+    CHECK(s_trace_depth == 0 && s_trace_sections == 8);
+
+    telemetry_snapshot(stats);
+    CHECK(stats[TELEMETRY_FFT].count == 1001 && stats[TELEMETRY_DB].count == 1);
+
+    telemetry_set_enabled(true);
+    CHECK(telemetry_active());
+    { telemetry_scope scope(TELEMETRY_UNWRAP); }
+    telemetry_set_enabled(false);
+    telemetry_snapshot(stats);
+    CHECK(stats[TELEMETRY_UNWRAP].count == 1);
+    CHECK(strcmp(telemetry_stage_name(TELEMETRY_DRAW), "draw") == 0);
+
+    telemetry_reset();
+    telemetry_snapshot(stats);
+    for (const telemetry_stats &s: stats)
+        CHECK(s.count == 0 && s.max_ns == 0);
+}
+
+static void test_usb_packets() {
+    // Three packets of four samples requested; the second arrived short, the third empty:
+    int16_t data[12] = {1, 2, 3, 4, 5, 6, 0, 0, 0, 0, 0, 0};
+    const usb_packet_desc packets[] = {{8, 8, 0}, {8, 4, 0}, {8, 0, 0}};
+    CHECK(usb_compact_packets(reinterpret_cast<uint8_t *>(data), packets, 3) == 12);
+    CHECK(data[4] == 5 && data[5] == 6);
+
+    int16_t stereo[6] = {100, 200, -1, -2, 7, 7};
+    CHECK(usb_mix_stereo(stereo, 6) == 3);
+    CHECK(stereo[0] == 150 && stereo[1] == -2 && stereo[2] == 7);
+
+    // Stereo packets of two frames, the second short by one frame:
+    int16_t urb[8] = {10, 20, 30, 40, 50, 60, 0, 0};
+    const usb_packet_desc stereo_packets[] = {{8, 8, 0}, {8, 4, 0}};
+    CHECK(usb_urb_to_mono(urb, stereo_packets, 2, 2) == 3);
+    CHECK(urb[0] == 15 && urb[1] == 35 && urb[2] == 55);
+
+    // Copying into a circular buffer wraps to the start:
+    int16_t ring[4] = {0, 0, 0, 0};
+    const int16_t source[3] = {1, 2, 3};
+    CHECK(usb_copy_to_ring(source, 3, ring, 3, 4) == 3);
+    CHECK(ring[3] == 1 && ring[0] == 2 && ring[1] == 3 && ring[2] == 0);
+}
+
+static void test_urb_capture() {
+    char path[] = "/tmp/batgizmo-urb-test-XXXXXX";
+    const int fd = mkstemp(path);
+    CHECK(fd >= 0);
+    if (fd < 0)
+        return;
+
+    const urb_capture_header header = {384000, 1, 2, 8};
+    const usb_packet_desc packets[] = {{8, 8, 0}, {8, 2, 0}};
+    const int16_t payload[8] = {1, 2, 3, 4, 5, 0, 0, 0};
+    CHECK(urb_capture_write_header(fd, &header) == 0);
+    CHECK(urb_capture_write_urb(fd, 0, 0, 10, packets, 2, payload, sizeof(payload)) == 0);
+    CHECK(urb_capture_write_urb(fd, 25000000, -18, 0, packets, 2, payload, 0) == 0);
+    close(fd);
+
+    FILE *f = fopen(path, "rb");
+    CHECK(f != nullptr);
+    if (f == nullptr)
+        return;
+    urb_capture_header read_header;
+    std::string error;
+    CHECK(urb_capture_read_header(f, &read_header, &error) == 0);
+    CHECK(read_header.sample_rate == 384000 && read_header.packets_per_urb == 2);
+
+    urb_capture_record record;
+    CHECK(urb_capture_read_urb(f, &record) == 1);
+    CHECK(record.timestamp_ns == 0 && record.actual_length == 10);
+    CHECK(record.packets.size() == 2 && record.packets[1].actual_length == 2);
+    CHECK(record.payload.size() == sizeof(payload));
+    CHECK(memcmp(record.payload.data(), payload, sizeof(payload)) == 0);
+    CHECK(urb_capture_read_urb(f, &record) == 1);
+    CHECK(record.timestamp_ns == 25000000 && record.status == -18 && record.payload.empty());
+    CHECK(urb_capture_read_urb(f, &record) == 0);
+    fclose(f);
+
+    // Not a capture file:
+    f = fopen(path, "r+b");
+    fputc('X', f);
+    rewind(f);
+    CHECK(urb_capture_read_header(f, &read_header, &error) == -1);
+    CHECK(!error.empty());
+    fclose(f);
+    remove(path);
+}
+
+static void test_synth_source() {
+    synth_source_state source;
+    synth_source_config config = {SYNTH_MAX_SAMPLE_RATE + 1, 20.0f, 5.0f, 0.002f, 1};
+    CHECK(synth_source_init(&source, &config) == -1);
+
+    // Dense calls at the highest rate, checking for energy where the calls should be:
+    config.sample_rate = SYNTH_MAX_SAMPLE_RATE;
+    config.calls_per_second = 200.0f;
+    CHECK(synth_source_init(&source, &config) == 0);
+    std::vector<int16_t> data(config.sample_rate / 2);
+    synth_source_generate(&source, data.data(), static_cast<int>(data.size()));
+    int peak = 0;
+    for (int16_t v: data)
+        peak = std::max(peak, abs(v));
+    CHECK(peak > 1000);
+
+    const int nfft = 1024;
+    const int windows = static_cast<int>(data.size()) / nfft;
+    transform_state transform;
+    CHECK(transform_init(&transform, nfft) == 0);
+    std::vector<float> window(nfft);
+    transform_hann_window(window.data(), nfft);
+    std::vector<float> unwrapped(static_cast<size_t>(windows) * nfft);
+    std::vector<float> output(static_cast<size_t>(windows) * transform.frequency_buckets);
+    transform_unwrap_slices(data.data(), static_cast<int>(data.size()), 0, windows, nfft,
+                            window.data(), nfft, unwrapped.data());
+    bool triggered = false;
+    const double bucket_hz = static_cast<double>(config.sample_rate) / nfft;
+    transform_fft(&transform, windows, unwrapped.data(), output.data(), BNC_DB_RANGE_MIN,
+                  static_cast<int>(20000 / bucket_hz), static_cast<int>(100000 / bucket_hz),
+                  20.0f, &triggered);
+    CHECK(triggered);
+    transform_cleanup(&transform);
+
+    // Deterministic for a given configuration:
+    std::vector<int16_t> again(data.size());
+    CHECK(synth_source_init(&source, &config) == 0);
+    synth_source_generate(&source, again.data(), 1000);
+    synth_source_generate(&source, again.data() + 1000, static_cast<int>(again.size()) - 1000);
+    CHECK(again == data);
+
+    // Calls are scaled down to fit low sample rates:
+    config.sample_rate = 48000;
+    CHECK(synth_source_init(&source, &config) == 0);
+    CHECK(source.frequency_scale < 0.25);
+}
+
+static void test_wav_decode() {
+    const int16_t stereo[] = {100, -100, 2000, 4000, -32768, -32768};
+    int16_t mono[3];
+    CHECK(wav_decode_to_int16(reinterpret_cast<const uint8_t *>(stereo), 3, 2,
+                              WAV_SAMPLE_INT16, 1, mono) == 3);
+    CHECK(mono[0] == -100 && mono[1] == 4000 && mono[2] == -32768);
+    CHECK(wav_decode_to_int16(reinterpret_cast<const uint8_t *>(stereo), 3, 2,
+                              WAV_SAMPLE_INT16, WAV_CHANNEL_DOWNMIX, mono) == 3);
+    CHECK(mono[0] == 0 && mono[1] == 3000 && mono[2] == -32768);
+
+    const float floats[] = {0.5f, -2.0f, 2.0f};
+    CHECK(wav_decode_to_int16(reinterpret_cast<const uint8_t *>(floats), 3, 1,
+                              WAV_SAMPLE_FLOAT32, 0, mono) == 3);
+    CHECK(mono[0] > 16000 && mono[0] < 16500);
+    CHECK(mono[1] == -32768 && mono[2] == 32767);
+
+    CHECK(wav_decode_to_int16(reinterpret_cast<const uint8_t *>(floats), 1, 1, 99, 0, mono) == -1);
+    CHECK(wav_bytes_per_value(WAV_SAMPLE_INT24) == 3);
+
+    // Small reads are decoded on the calling thread alone:
+    CHECK(!wav_decode_is_parallel(3));
+}
+
+static void put_u32(std::vector<uint8_t> *v, uint32_t x) {
+    for (int i = 0; i < 4; i++)
+        v->push_back(static_cast<uint8_t>(x >> (8 * i)));
+}
+
+static void put_u16(std::vector<uint8_t> *v, uint16_t x) {
+    v->push_back(static_cast<uint8_t>(x));
+    v->push_back(static_cast<uint8_t>(x >> 8));
+}
+
+static void put_id(std::vector<uint8_t> *v, const char *id) {
+    v->insert(v->end(), id, id + 4);
+}
+
+static void test_wav_reader() {
+    // A stereo 16 bit file with a GUANO sample rate that overrides the header:
+    const char *guano = "GUANO|Version: 1.0\nSamplerate: 384000\n";
+    const uint32_t guano_size = static_cast<uint32_t>(strlen(guano));
+    const int frames = 100;
+
+    std::vector<uint8_t> file;
+    put_id(&file, "RIFF");
+    put_u32(&file, 0);
+    put_id(&file, "WAVE");
+    put_id(&file, "fmt ");
+    put_u32(&file, 16);
+    put_u16(&file, 1);
+    put_u16(&file, 2);
+    put_u32(&file, 38400);
+    put_u32(&file, 38400 * 4);
+    put_u16(&file, 4);
+    put_u16(&file, 16);
+    put_id(&file, "guan");
+    put_u32(&file, guano_size);
+    file.insert(file.end(), guano, guano + guano_size);
+    if (guano_size & 1)
+        file.push_back(0);
+    put_id(&file, "data");
+    put_u32(&file, frames * 4);
+    for (int i = 0; i < frames; i++) {
+        put_u16(&file, static_cast<uint16_t>(i));
+        put_u16(&file, static_cast<uint16_t>(-i));
+    }
+
+    char path[] = "/tmp/batgizmo-core-test-XXXXXX";
+    const int fd = mkstemp(path);
+    CHECK(fd >= 0);
+    if (fd < 0)
+        return;
+    FILE *f = fdopen(fd, "wb");
+    fwrite(file.data(), 1, file.size(), f);
+    fclose(f);
+
+    wav_reader reader;
+    std::string error;
+    CHECK(wav_reader_open(&reader, path, &error) == 0);
+    CHECK(reader.channels == 2);
+    CHECK(reader.sample_rate == 384000);
+    CHECK(reader.frame_count == frames);
+
+    int16_t target[frames];
+    CHECK(wav_reader_read(&reader, 90, 20, 1, target) == 10);
+    CHECK(target[0] == -90 && target[9] == -99);
+    CHECK(wav_reader_read(&reader, frames, 1, 0, target) == 0);
+    wav_reader_close(&reader);
+
+    remove(path);
+    CHECK(wav_reader_open(&reader, path, &error) == -1);
+    CHECK(!error.empty());
+}
+
+int main() {
+    test_transform();
+    test_transform_plans();
+    test_fft_wisdom();
+    test_governor();
+    test_colour_map_and_bnc();
+    test_work_pool();
+    test_arena();
+    test_amplitude();
+    test_heterodyne();
+    test_kernels();
+    test_telemetry();
+    test_usb_packets();
+    test_urb_capture();
+    test_synth_source();
+    test_wav_decode();
+    test_wav_reader();
+
+    if (s_failures != 0) {
+        fprintf(stderr, "%d checks failed\n", s_failures);
+        return 1;
+    }
+    printf("All core tests passed\n");
+    return 0;
+}
@@ -0,0 +1,610 @@
+/*
+ * Copyright (c) 2025 John Mears
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * batgizmo-batch: render directories of wav files to spectrogram images off the device,
+ * using the same transform, BnC and colour map code as the app, so that the results match
+ * what the phone shows.
+ *
+ * For each file this writes one PNG per data page, an overview PNG of the whole file, and
+ * appends any auto trigger detections to detections.csv in the output directory. Files are
+ * processed in parallel as background jobs on the shared work pool, one per core by default.
+ */
+
+#include "core/bnc.h"
+#include "core/colourmap.h"
+#include "core/transform.h"
+#include "core/wavdecode.h"
+#include "core/wavreader.h"
+#include "core/workpool.h"
+
+#include <png.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <mutex>
+#include <string>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+#ifndef BATGIZMO_DEFAULT_COLOUR_MAP
+#define BATGIZMO_DEFAULT_COLOUR_MAP "kindlmann-256.csv"
+#endif
+
+// As AbstractPipeline: the raw data is transformed in slices of about this many samples.
+static const int NOMINAL_SLICE_ENTRIES = 10000;
+
+struct batch_options {
+    std::string output_dir = ".";
+    std::string colour_map_path = BATGIZMO_DEFAULT_COLOUR_MAP;
+    int nfft = 512;
+    int overlap_percent = 75;
+    int page_seconds = 5;
+    int threads = 0;                    // 0 means one per core.
+    int channel = WAV_CHANNEL_DOWNMIX;
+    bool fixed_bnc = false;
+    float bnc_low_db = 0.0f;
+    float bnc_high_db = 0.0f;
+    float trigger_threshold_db = 40.0f; // The auto trigger defaults from Settings.
+    float trigger_min_khz = 16.0f;
+    float trigger_max_khz = 120.0f;
+    int detection_gap_ms = 10;
+    int overview_width = 1600;
+    bool write_pages = true;
+};
+
+struct detection {
+    double start_s;
+    double end_s;
+    float peak_db;
+    float peak_khz;
+};
+
+struct file_result {
+    bool ok = false;
+    std::string error;
+    double audio_seconds = 0.0;
+    int64_t data_bytes = 0;
+    int pages = 0;
+    std::vector<detection> detections;
+};
+
+static void usage(const char *name) {
+    fprintf(stderr,
+            "Usage: %s [options] <file or directory>...\n"
+            "\n"
+            "Renders wav files to spectrogram PNGs. Directories are searched recursively.\n"
+            "\n"
+            "Options:\n"
+            "  -o, --output DIR          output directory (default .)\n"
+            "  -j, --threads N           files processed at once (default and maximum: one per core)\n"
+            "  --nfft N                  FFT window size (default 512)\n"
+            "  --overlap PERCENT         FFT window overlap (default 75)\n"
+            "  --page-seconds N          length of each page image (default 5)\n"
+            "  --channel N               channel to use, from 1, or 0 to mix (default 0)\n"
+            "  --bnc LOW:HIGH            fixed dB range instead of auto BnC per page\n"
+            "  --colour-map FILE         colour map CSV (default the app's)\n"
+            "  --trigger-db DB           detection threshold (default 40)\n"
+            "  --trigger-range MIN:MAX   detection frequency range in kHz (default 16:120)\n"
+            "  --detection-gap-ms N      merge detections closer than this (default 10)\n"
+            "  --overview-width N        overview image width in pixels (default 1600)\n"
+            "  --no-pages                only write overviews and detections\n",
+            name);
+}
+
+static bool parse_int(const char *text, int min_value, int max_value, int *value) {
+    char *end = nullptr;
+    long v = strtol(text, &end, 10);
+    if (end == text || *end != '\0' || v < min_value || v > max_value)
+        return false;
+    *value = static_cast<int>(v);
+    return true;
+}
+
+static bool parse_float(const char *text, float *value) {
+    char *end = nullptr;
+    float v = strtof(text, &end);
+    if (end == text || *end != '\0' || !std::isfinite(v))
+        return false;
+    *value = v;
+    return true;
+}
+
+static bool parse_float_pair(const char *text, float *first, float *second) {
+    const char *colon = strchr(text, ':');
+    if (colon == nullptr)
+        return false;
+    std::string a(text, colon - text);
+    return parse_float(a.c_str(), first) && parse_float(colon + 1, second) && *first < *second;
+}
+
+/**
+ * Load a colour map in the same CSV format as the app's assets: position, red, green, blue.
+ * Returns 0 on success or -1 on failure.
+ */
+static int load_colour_map(const std::string &path, std::vector<uint16_t> *colour_map) {
+    FILE *f = fopen(path.c_str(), "r");
+    if (f == nullptr)
+        return -1;
+
+    std::vector<std::pair<float, uint16_t>> rows;
+    char line[256];
+    while (fgets(line, sizeof(line), f) != nullptr) {
+        float position;
+        int r, g, b;
+        if (sscanf(line, "%f,%d,%d,%d", &position, &r, &g, &b) == 4)
+            rows.emplace_back(position, colour_map_rgb_to_rgb565(r, g, b));
+    }
+    fclose(f);
+
+    // As UIModel, it's prudent to sort the rows into ascending order:
+    std::stable_sort(rows.begin(), rows.end(),
+                     [](const auto &a, const auto &b) { return a.first < b.first; });
+    colour_map->clear();
+    for (const auto &row: rows)
+        colour_map->push_back(row.second);
+
+    return colour_map->size() >= 64 ? 0 : -1;
+}
+
+/**
+ * Write an RGB565 image to a PNG file. Returns 0 on success or -1 on failure.
+ */
+static int write_png(const fs::path &path, const uint16_t *pixels, int width, int height) {
+    FILE *f = fopen(path.c_str(), "wb");
+    if (f == nullptr)
+        return -1;
+
+    png_structp png = png_create_write_struct(PNG_LIBPNG_VER_STRING, nullptr, nullptr, nullptr);
+    png_infop info = png != nullptr ? png_create_info_struct(png) : nullptr;
+    if (info == nullptr) {
+        png_destroy_write_struct(&png, nullptr);
+        fclose(f);
+        return -1;
+    }
+
+    std::vector<uint8_t> row(static_cast<size_t>(width) * 3);
+    if (setjmp(png_jmpbuf(png))) {
+        png_destroy_write_struct(&png, &info);
+        fclose(f);
+        return -1;
+    }
+
+    png_init_io(png, f);
+    png_set_IHDR(png, info, width, height, 8, PNG_COLOR_TYPE_RGB, PNG_INTERLACE_NONE,
+                 PNG_COMPRESSION_TYPE_DEFAULT, PNG_FILTER_TYPE_DEFAULT);
+    png_write_info(png, info);
+    for (int y = 0; y < height; y++) {
+        const uint16_t *source = pixels + static_cast<size_t>(y) * width;
+        for (int x = 0; x < width; x++)
+            colour_map_rgb565_to_rgb(source[x], &row[static_cast<size_t>(x) * 3]);
+        png_write_row(png, row.data());
+    }
+    png_write_end(png, nullptr);
+    png_destroy_write_struct(&png, &info);
+
+    return fclose(f) == 0 ? 0 : -1;
+}
+
+/**
+ * Colour map some transformed data and write it as a PNG, time buckets as columns.
+ */
+static int render_png(const fs::path &path, const float *transformed, int time_buckets,
+                      int frequency_buckets, const batch_options &options,
+                      const std::vector<uint16_t> &colour_map, std::vector<uint16_t> *pixels) {
+    float low_db = options.bnc_low_db;
+    float high_db = options.bnc_high_db;
+    if (!options.fixed_bnc) {
+        float data_min_db, data_max_db;
+        if (!bnc_find_range(0, time_buckets - 1, 0, frequency_buckets - 1, frequency_buckets,
+                            transformed, &data_min_db, &data_max_db))
+            return -1;
+        bnc_auto_range(data_min_db, data_max_db, &low_db, &high_db);
+    }
+
+    float offset, multiplier;
+    bnc_offset_multiplier(low_db, high_db, static_cast<int>(colour_map.size()),
+                          &offset, &multiplier);
+
+    pixels->resize(static_cast<size_t>(time_buckets) * frequency_buckets);
+    colour_map_apply(transformed, 0, time_buckets, frequency_buckets, colour_map.data(),
+                     static_cast<int>(colour_map.size()), offset, multiplier, pixels->data(),
+                     static_cast<uint32_t>(time_buckets));
+    return write_png(path, pixels->data(), time_buckets, frequency_buckets);
+}
+
+/**
+ * Per worker thread state, reused from one file to the next.
+ */
+struct worker_state {
+    transform_state transform;
+    std::vector<float> window;
+    std::vector<int16_t> raw;
+    std::vector<float> unwrapped;
+    std::vector<float> page;
+    std::vector<float> overview;
+    std::vector<uint16_t> pixels;
+};
+
+static void process_file(const fs::path &path, const batch_options &options,
+                         const std::vector<uint16_t> &colour_map, worker_state *worker,
+                         file_result *result) {
+    wav_reader reader;
+    std::string error;
+    if (wav_reader_open(&reader, path.c_str(), &error) != 0) {
+        result->error = error;
+        return;
+    }
+
+    if (options.channel != WAV_CHANNEL_DOWNMIX && options.channel >= reader.channels) {
+        result->error = "the file has only " + std::to_string(reader.channels) + " channels";
+        wav_reader_close(&reader);
+        return;
+    }
+
+    const int nfft = options.nfft;
+    const int frequency_buckets = nfft / 2 + 1;
+    const int overlap_count = static_cast<int>(options.overlap_percent * nfft / 100.0f + 0.5f);
+    const int fft_stride = std::clamp(nfft - overlap_count, 1, nfft);
+    const double rate = reader.sample_rate;
+
+    result->audio_seconds = static_cast<double>(reader.frame_count) / rate;
+    result->data_bytes = reader.frame_count * reader.channels
+                         * wav_bytes_per_value(reader.sample_format);
+
+    if (reader.frame_count < nfft) {
+        result->error = "the file contains too few samples";
+        wav_reader_close(&reader);
+        return;
+    }
+
+    // Windows are spaced by the stride across the whole file; each page image holds the
+    // windows that start within it, so that the pages join up without gaps or overlaps.
+    const int64_t total_windows = (reader.frame_count - nfft) / fft_stride + 1;
+    const int64_t page_frames = static_cast<int64_t>(options.page_seconds) * reader.sample_rate;
+    const int windows_per_page = static_cast<int>(std::max<int64_t>(1, page_frames / fft_stride));
+    const int slice_windows = std::max(1, (NOMINAL_SLICE_ENTRIES - nfft) / fft_stride + 1);
+
+    // Map the trigger frequency range to frequency buckets, as TransformStep does:
+    const double frequency_interval = rate / nfft;
+    const int min_trigger_bucket = std::clamp(
+            static_cast<int>(std::lround(options.trigger_min_khz * 1000 / frequency_interval)),
+            0, frequency_buckets - 1);
+    const int max_trigger_bucket = std::clamp(
+            static_cast<int>(std::lround(options.trigger_max_khz * 1000 / frequency_interval)),
+            0, frequency_buckets - 1);
+    const int64_t detection_gap_windows =
+            static_cast<int64_t>(options.detection_gap_ms * rate / 1000.0 / fft_stride);
+
+    if (worker->transform.window_size != nfft) {
+        if (transform_init(&worker->transform, nfft) != 0) {
+            result->error = "unable to initialize the FFT";
+            wav_reader_close(&reader);
+            return;
+        }
+        worker->window.resize(nfft);
+        transform_hann_window(worker->window.data(), nfft);
+    }
+
+    const int overview_width =
+            static_cast<int>(std::min<int64_t>(options.overview_width, total_windows));
+    worker->overview.assign(static_cast<size_t>(overview_width) * frequency_buckets,
+                            BNC_DB_RANGE_MIN);
+    worker->page.resize(static_cast<size_t>(windows_per_page) * frequency_buckets);
+    worker->unwrapped.resize(static_cast<size_t>(slice_windows) * nfft);
+    worker->raw.resize(static_cast<size_t>(windows_per_page - 1) * fft_stride + nfft);
+
+    const std::string stem = path.stem().string();
+    bool in_detection = false;
+    int64_t last_triggered = 0;
+    detection current = {};
+
+    for (int64_t first_window = 0; first_window < total_windows; first_window += windows_per_page) {
+        const int page_windows =
+                static_cast<int>(std::min<int64_t>(windows_per_page, total_windows - first_window));
+        const int raw_count = (page_windows - 1) * fft_stride + nfft;
+        const int read = wav_reader_read(&reader, first_window * fft_stride, raw_count,
+                                         options.channel, worker->raw.data());
+        if (read != raw_count) {
+            result->error = "error reading sample data";
+            wav_reader_close(&reader);
+            return;
+        }
+
+        for (int w = 0; w < page_windows; w += slice_windows) {
+            const int count = std::min(slice_windows, page_windows - w);
+            transform_unwrap_slices(worker->raw.data(), raw_count, w * fft_stride, count,
+                                    fft_stride, worker->window.data(), nfft,
+                                    worker->unwrapped.data());
+            bool triggered = false;
+            transform_fft(&worker->transform, count, worker->unwrapped.data(),
+                          worker->page.data() + static_cast<size_t>(w) * frequency_buckets,
+                          BNC_DB_RANGE_MIN, min_trigger_bucket, max_trigger_bucket,
+                          options.trigger_threshold_db, &triggered);
+        }
+
+        for (int w = 0; w < page_windows; w++) {
+            const float *column = worker->page.data() + static_cast<size_t>(w) * frequency_buckets;
+            const int64_t window_index = first_window + w;
+
+            // Max pool into the overview, so that short calls remain visible:
+            float *target = worker->overview.data()
+                            + static_cast<size_t>(window_index * overview_width / total_windows)
+                              * frequency_buckets;
+            for (int f = 0; f < frequency_buckets; f++)
+                target[f] = std::max(target[f], column[f]);
+
+            // Detections are runs of windows that reach the trigger threshold:
+            int peak_bucket = min_trigger_bucket;
+            for (int f = min_trigger_bucket; f <= max_trigger_bucket; f++) {
+                if (column[f] > column[peak_bucket])
+                    peak_bucket = f;
+            }
+            const float peak_db = column[peak_bucket];
+            if (peak_db < options.trigger_threshold_db)
+                continue;
+
+            if (in_detection && window_index - last_triggered > detection_gap_windows + 1) {
+                result->detections.push_back(current);
+                in_detection = false;
+            }
+            if (!in_detection) {
+                in_detection = true;
+                current.start_s = static_cast<double>(window_index * fft_stride) / rate;
+                current.peak_db = BNC_DB_RANGE_MIN;
+            }
+            last_triggered = window_index;
+            current.end_s = static_cast<double>(window_index * fft_stride + nfft) / rate;
+            if (peak_db >= current.peak_db) {
+                current.peak_db = peak_db;
+                current.peak_khz = static_cast<float>(peak_bucket * frequency_interval / 1000.0);
+            }
+        }
+
+        if (options.write_pages) {
+            char suffix[32];
+            snprintf(suffix, sizeof(suffix), "_p%03d.png", result->pages + 1);
+            if (render_png(fs::path(options.output_dir) / (stem + suffix), worker->page.data(),
+                           page_windows, frequency_buckets, options, colour_map,
+                           &worker->pixels) != 0) {
+                result->error = "unable to write a page image";
+                wav_reader_close(&reader);
+                return;
+            }
+        }
+        result->pages++;
+    }
+
+    if (in_detection)
+        result->detections.push_back(current);
+
+    wav_reader_close(&reader);
+
+    if (render_png(fs::path(options.output_dir) / (stem + "_overview.png"),
+                   worker->overview.data(), overview_width, frequency_buckets, options,
+                   colour_map, &worker->pixels) != 0) {
+        result->error = "unable to write the overview image";
+        return;
+    }
+
+    result->ok = true;
+}
+
+static bool is_wav_file(const fs::path &path) {
+    std::string extension = path.extension().string();
+    std::transform(extension.begin(), extension.end(), extension.begin(),
+                   [](unsigned char c) { return static_cast<char>(tolower(c)); });
+    return extension == ".wav";
+}
+
+static int find_files(const std::vector<std::string> &inputs, std::vector<fs::path> *files) {
+    for (const auto &input: inputs) {
+        std::error_code ec;
+        if (fs::is_directory(input, ec)) {
+            std::vector<fs::path> found;
+            for (fs::recursive_directory_iterator it(input, ec), end; !ec && it != end;
+                 it.increment(ec)) {
+                if (it->is_regular_file(ec) && is_wav_file(it->path()))
+                    found.push_back(it->path());
+            }
+            if (ec) {
+                fprintf(stderr, "Unable to search %s: %s\n", input.c_str(), ec.message().c_str());
+                return -1;
+            }
+            std::sort(found.begin(), found.end());
+            files->insert(files->end(), found.begin(), found.end());
+        } else if (fs::is_regular_file(input, ec)) {
+            files->emplace_back(input);
+        } else {
+            fprintf(stderr, "No such file or directory: %s\n", input.c_str());
+            return -1;
+        }
+    }
+    return 0;
+}
+
+int main(int argc, char *argv[]) {
+    batch_options options;
+    std::vector<std::string> inputs;
+
+    for (int i = 1; i < argc; i++) {
+        const std::string arg = argv[i];
+        const bool has_value = i + 1 < argc;
+        const char *value = has_value ? argv[i + 1] : nullptr;
+        bool ok = true;
+
+        if (arg == "-h" || arg == "--help") {
+            usage(argv[0]);
+            return 0;
+        } else if (arg == "--no-pages") {
+            options.write_pages = false;
+            continue;
+        } else if (arg.size() > 1 && arg[0] == '-') {
+            if (!has_value) {
+                fprintf(stderr, "Missing value for %s\n", arg.c_str());
+                return 2;
+            }
+            i++;
+            if (arg == "-o" || arg == "--output") {
+                options.output_dir = value;
+            } else if (arg == "-j" || arg == "--threads") {
+                ok = parse_int(value, 1, 1024, &options.threads);
+            } else if (arg == "--nfft") {
+                ok = parse_int(value, 16, 65536, &options.nfft) && options.nfft % 2 == 0;
+            } else if (arg == "--overlap") {
+                ok = parse_int(value, 0, 95, &options.overlap_percent);
+            } else if (arg == "--page-seconds") {
+                ok = parse_int(value, 1, 3600, &options.page_seconds);
+            } else if (arg == "--channel") {
+                int channel;
+                ok = parse_int(value, 0, WAV_MAX_CHANNELS, &channel);
+                options.channel = channel == 0 ? WAV_CHANNEL_DOWNMIX : channel - 1;
+            } else if (arg == "--bnc") {
+                ok = parse_float_pair(value, &options.bnc_low_db, &options.bnc_high_db);
+                options.fixed_bnc = true;
+            } else if (arg == "--colour-map") {
+                options.colour_map_path = value;
+            } else if (arg == "--trigger-db") {
+                ok = parse_float(value, &options.trigger_threshold_db);
+            } else if (arg == "--trigger-range") {
+                ok = parse_float_pair(value, &options.trigger_min_khz, &options.trigger_max_khz);
+            } else if (arg == "--detection-gap-ms") {
+                ok = parse_int(value, 0, 60000, &options.detection_gap_ms);
+            } else if (arg == "--overview-width") {
+                ok = parse_int(value, 16, 65536, &options.overview_width);
+            } else {
+                fprintf(stderr, "Unknown option %s\n", arg.c_str());
+                usage(argv[0]);
+                return 2;
+            }
+        } else {
+            inputs.push_back(arg);
+        }
+
+        if (!ok) {
+            fprintf(stderr, "Invalid value for %s: %s\n", arg.c_str(), value);
+            return 2;
+        }
+    }
+
+    if (inputs.empty()) {
+        usage(argv[0]);
+        return 2;
+    }
+
+    std::vector<uint16_t> colour_map;
+    if (load_colour_map(options.colour_map_path, &colour_map) != 0) {
+        fprintf(stderr, "Unable to load a colour map from %s\n", options.colour_map_path.c_str());
+        return 1;
+    }
+
+    std::error_code ec;
+    fs::create_directories(options.output_dir, ec);
+    if (ec) {
+        fprintf(stderr, "Unable to create %s: %s\n", options.output_dir.c_str(),
+                ec.message().c_str());
+        return 1;
+    }
+
+    std::vector<fs::path> files;
+    if (find_files(inputs, &files) != 0)
+        return 1;
+
+    int threads = options.threads;
+    if (threads == 0 || threads > work_pool_workers(work_pool_shared()) + 1)
+        threads = work_pool_workers(work_pool_shared()) + 1;
+    threads = std::min<int>(threads, static_cast<int>(std::max<size_t>(1, files.size())));
+
+    /*
+     * A simple work queue: each worker takes the next file index until there are none left.
+     * Results are stored by index so that the output order doesn't depend on timing.
+     */
+    std::vector<file_result> results(files.size());
+    std::atomic<size_t> next_file(0);
+    std::mutex log_mutex;
+
+    const auto start_time = std::chrono::steady_clock::now();
+
+    auto worker_main = [&]() {
+        worker_state worker;
+        for (size_t i = next_file++; i < files.size(); i = next_file++) {
+            process_file(files[i], options, colour_map, &worker, &results[i]);
+            std::lock_guard<std::mutex> lock(log_mutex);
+            if (results[i].ok)
+                fprintf(stderr, "%s: %.1f s, %d pages, %zu detections\n", files[i].c_str(),
+                        results[i].audio_seconds, results[i].pages, results[i].detections.size());
+            else
+                fprintf(stderr, "%s: %s\n", files[i].c_str(), results[i].error.c_str());
+        }
+        transform_cleanup(&worker.transform);
+    };
+
+    // The workers are background jobs on the shared work pool, which is also where their
+    // FFTs, colour mapping and decoding run in parallel:
+    work_pool_parallel_for(work_pool_shared(), WORK_PRIORITY_BACKGROUND, threads,
+                           [&](int) { worker_main(); });
+
+    const double wall_seconds =
+            std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+
+    const fs::path detections_path = fs::path(options.output_dir) / "detections.csv";
+    FILE *detections_file = fopen(detections_path.c_str(), "w");
+    if (detections_file == nullptr) {
+        fprintf(stderr, "Unable to write %s\n", detections_path.c_str());
+        return 1;
+    }
+    fprintf(detections_file, "file,start_s,end_s,peak_db,peak_khz\n");
+
+    int failed = 0;
+    double audio_seconds = 0.0;
+    int64_t data_bytes = 0;
+    for (size_t i = 0; i < files.size(); i++) {
+        const file_result &result = results[i];
+        if (!result.ok) {
+            failed++;
+            continue;
+        }
+        audio_seconds += result.audio_seconds;
+        data_bytes += result.data_bytes;
+        for (const auto &d: result.detections)
+            fprintf(detections_file, "\"%s\",%.4f,%.4f,%.1f,%.1f\n", files[i].c_str(),
+                    d.start_s, d.end_s, d.peak_db, d.peak_khz);
+    }
+    fclose(detections_file);
+
+    const double elapsed = std::max(wall_seconds, 1e-9);
+    fprintf(stderr,
+            "%zu files (%d failed) on %d threads: %.1f s of audio in %.2f s, "
+            "%.1fx realtime, %.1f MB/s, %.1f files/s\n",
+            files.size(), failed, threads, audio_seconds, wall_seconds,
+            audio_seconds / elapsed, data_bytes / 1e6 / elapsed,
+            (files.size() - failed) / elapsed);
+
+    return failed == 0 ? 0 : 1;
+}
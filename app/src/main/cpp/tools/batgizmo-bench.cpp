@@ -0,0 +1,360 @@
+/*
+ * Copyright (c) 2025 John Mears
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * batgizmo-bench: microbenchmarks for each DSP core kernel, across the range of settings
+ * the app actually uses, so that regressions show up when kernels are optimised.
+ *
+ * Results are written to stdout as CSV, one row per kernel and setting combination:
+ *
+ *   kernel,sample_rate,nfft,overlap,height,channels,iterations,ns_per_op,bytes_per_s
+ *
+ * Columns that don't apply to a kernel are 0. ns_per_op is the median of several timed
+ * runs, each long enough to swamp timer resolution. bytes_per_s counts the kernel's input,
+ * or for the synthetic source, its output.
+ *
+ * Options, in the style of kissfft's benchkiss:
+ *   -n LIST    FFT sizes (default 64,128,256,512,1024,2048,4096)
+ *   -o LIST    overlap percentages (default 25,50,75,90,95)
+ *   -H LIST    amplitude bitmap heights (default 64,128,256,512)
+ *   -s LIST    live sample rates (default 48000,192000,250000,384000,500000)
+ *   -k NAME    only run kernels whose name contains NAME
+ *   -t MS      minimum time per run (default 20)
+ *   -r N       runs per result (default 5)
+ */
+
+#include "core/amplitude.h"
+#include "core/bnc.h"
+#include "core/colourmap.h"
+#include "core/heterodyne.h"
+#include "core/synthsource.h"
+#include "core/transform.h"
+#include "core/usbpacket.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+static const int NOMINAL_SLICE_ENTRIES = 10000;    // As AbstractPipeline.
+static const int URBS_PER_SECOND = 40;             // As nativeusb.cpp.
+static const int TARGET_AUDIO_OUT_RATE = 48000;
+static const int COLOUR_MAP_SIZE = 256;
+
+struct bench_options {
+    std::vector<int> nffts = {64, 128, 256, 512, 1024, 2048, 4096};
+    std::vector<int> overlaps = {25, 50, 75, 90, 95};
+    std::vector<int> heights = {64, 128, 256, 512};
+    std::vector<int> sample_rates = {48000, 192000, 250000, 384000, 500000};
+    std::string kernel_filter;
+    double min_run_ms = 20.0;
+    int runs = 5;
+};
+
+struct bench_case {
+    const char *kernel;
+    int sample_rate;
+    int nfft;
+    int overlap;
+    int height;
+    int channels;
+    size_t bytes_per_op;
+};
+
+typedef std::chrono::steady_clock bench_clock;
+
+// Results are accumulated here so that the compiler can't discard the work:
+static volatile float s_sink = 0.0f;
+
+static bool parse_list(char *arg, std::vector<int> *values) {
+    values->clear();
+    for (char *s = strtok(arg, ","); s != nullptr; s = strtok(nullptr, ",")) {
+        const int v = atoi(s);
+        if (v <= 0)
+            return false;
+        values->push_back(v);
+    }
+    return !values->empty();
+}
+
+/**
+ * Time op, calibrating the number of iterations per run to the minimum run time, and print
+ * the median of the runs.
+ */
+static void run_case(const bench_options &options, const bench_case &c,
+                     const std::function<void()> &op) {
+    if (!options.kernel_filter.empty() && strstr(c.kernel, options.kernel_filter.c_str()) == nullptr)
+        return;
+
+    // Warm up caches and branch predictors, and calibrate:
+    long iterations = 1;
+    for (;;) {
+        auto start = bench_clock::now();
+        for (long i = 0; i < iterations; i++)
+            op();
+        const double ms = std::chrono::duration<double, std::milli>(bench_clock::now() - start).count();
+        if (ms >= options.min_run_ms || iterations >= (1L << 30))
+            break;
+        iterations = ms > 0.01 ? std::max(iterations * 2, static_cast<long>(iterations * options.min_run_ms / ms) + 1)
+                               : iterations * 10;
+    }
+
+    std::vector<double> ns_per_op;
+    for (int r = 0; r < options.runs; r++) {
+        auto start = bench_clock::now();
+        for (long i = 0; i < iterations; i++)
+            op();
+        const double ns = std::chrono::duration<double, std::nano>(bench_clock::now() - start).count();
+        ns_per_op.push_back(ns / iterations);
+    }
+    std::sort(ns_per_op.begin(), ns_per_op.end());
+    const double median = ns_per_op[ns_per_op.size() / 2];
+
+    printf("%s,%d,%d,%d,%d,%d,%ld,%.1f,%.0f\n", c.kernel, c.sample_rate, c.nfft, c.overlap,
+           c.height, c.channels, iterations, median, c.bytes_per_op * 1e9 / median);
+    fflush(stdout);
+}
+
+static std::vector<int16_t> make_signal(size_t count) {
+    // Noise plus a tone, so that the data isn't trivially uniform:
+    std::vector<int16_t> data(count);
+    srand(1);
+    for (size_t i = 0; i < count; i++)
+        data[i] = static_cast<int16_t>(8000.0 * sin(i * 0.3) + (rand() % 2001) - 1000);
+    return data;
+}
+
+/**
+ * The file pipeline kernels, which work a slice at a time as TransformStep does.
+ */
+static void bench_transform_kernels(const bench_options &options) {
+    for (int nfft: options.nffts) {
+        transform_state transform;
+        if (transform_init(&transform, nfft) != 0) {
+            fprintf(stderr, "transform_init failed for nfft %d\n", nfft);
+            continue;
+        }
+        const int buckets = transform.frequency_buckets;
+        std::vector<float> window(nfft);
+        transform_hann_window(window.data(), nfft);
+
+        std::vector<uint16_t> colour_map(COLOUR_MAP_SIZE);
+        for (int i = 0; i < COLOUR_MAP_SIZE; i++)
+            colour_map[i] = colour_map_rgb_to_rgb565(i, 255 - i, i / 2);
+
+        for (int overlap: options.overlaps) {
+            // As AbstractPipeline.calculateParams:
+            const int overlap_count = static_cast<int>(overlap * nfft / 100.0f + 0.5f);
+            const int stride = std::clamp(nfft - overlap_count, 1, nfft);
+            const int slice_windows = std::max(1, (NOMINAL_SLICE_ENTRIES - nfft) / stride + 1);
+            const int slice_entries = (slice_windows - 1) * stride + nfft;
+
+            const std::vector<int16_t> raw = make_signal(slice_entries);
+            std::vector<float> unwrapped(static_cast<size_t>(slice_windows) * nfft);
+            std::vector<float> transformed(static_cast<size_t>(slice_windows) * buckets);
+            std::vector<uint16_t> pixels(static_cast<size_t>(slice_windows) * buckets);
+
+            const size_t unwrapped_bytes = unwrapped.size() * sizeof(float);
+            const size_t transformed_bytes = transformed.size() * sizeof(float);
+
+            run_case(options, {"unwrap", 0, nfft, overlap, 0, 1, raw.size() * sizeof(int16_t)},
+                     [&]() {
+                         transform_unwrap_slices(raw.data(), slice_entries, 0, slice_windows,
+                                                 stride, window.data(), nfft, unwrapped.data());
+                         s_sink = s_sink + unwrapped[nfft / 2];
+                     });
+
+            // Make sure the later kernels see real data, whether or not unwrap was run:
+            transform_unwrap_slices(raw.data(), slice_entries, 0, slice_windows, stride,
+                                    window.data(), nfft, unwrapped.data());
+
+            run_case(options, {"fft", 0, nfft, overlap, 0, 1, unwrapped_bytes}, [&]() {
+                bool triggered = false;
+                transform_fft(&transform, slice_windows, unwrapped.data(), transformed.data(),
+                              BNC_DB_RANGE_MIN, 0, buckets - 1, 40.0f, &triggered);
+                s_sink = s_sink + transformed[buckets / 2] + triggered;
+            });
+
+            bool triggered = false;
+            transform_fft(&transform, slice_windows, unwrapped.data(), transformed.data(),
+                          BNC_DB_RANGE_MIN, 0, buckets - 1, 40.0f, &triggered);
+
+            float min_db = 0.0f, max_db = 0.0f;
+            run_case(options, {"bnc", 0, nfft, overlap, 0, 1, transformed_bytes}, [&]() {
+                bnc_find_range(0, slice_windows - 1, 0, buckets - 1, buckets,
+                               transformed.data(), &min_db, &max_db);
+                s_sink = s_sink + min_db + max_db;
+            });
+
+            bnc_find_range(0, slice_windows - 1, 0, buckets - 1, buckets, transformed.data(),
+                           &min_db, &max_db);
+            float low_db, high_db, offset, multiplier;
+            bnc_auto_range(min_db, max_db, &low_db, &high_db);
+            bnc_offset_multiplier(low_db, high_db, COLOUR_MAP_SIZE, &offset, &multiplier);
+
+            // The bitmap height is the number of frequency buckets:
+            run_case(options, {"colour_map", 0, nfft, overlap, buckets, 1, transformed_bytes},
+                     [&]() {
+                         colour_map_apply(transformed.data(), 0, slice_windows, buckets,
+                                          colour_map.data(), COLOUR_MAP_SIZE, offset,
+                                          multiplier, pixels.data(), slice_windows);
+                         s_sink = s_sink + pixels[pixels.size() / 2];
+                     });
+
+            // The amplitude pane height is independent of the FFT size:
+            for (int height: options.heights) {
+                std::vector<uint16_t> amplitude(static_cast<size_t>(slice_windows) * height);
+                run_case(options, {"amplitude", 0, nfft, overlap, height, 1, unwrapped_bytes},
+                         [&]() {
+                             amplitude_render(unwrapped.data(), slice_windows, nfft, 0, 0xFFFF,
+                                              amplitude.data(), height, slice_windows);
+                             s_sink = s_sink + amplitude[amplitude.size() / 2];
+                         });
+            }
+        }
+
+        transform_cleanup(&transform);
+    }
+}
+
+/**
+ * The live data kernels, which work a URB at a time as nativeusb.cpp does.
+ */
+static void bench_live_kernels(const bench_options &options) {
+    for (int sample_rate: options.sample_rates) {
+        const int samples_per_packet = sample_rate / 1000;
+        const int packets_per_urb = 1000 / URBS_PER_SECOND;
+
+        for (int channels = 1; channels <= 2; channels++) {
+            const int packet_bytes = samples_per_packet * channels * static_cast<int>(sizeof(int16_t));
+            const size_t urb_bytes = static_cast<size_t>(packet_bytes) * packets_per_urb;
+            const std::vector<int16_t> source = make_signal(urb_bytes / sizeof(int16_t));
+            std::vector<int16_t> urb(source.size());
+
+            // Some microphones send an occasional short packet:
+            std::vector<usb_packet_desc> packets(packets_per_urb);
+            for (int p = 0; p < packets_per_urb; p++) {
+                const int actual = p % 5 == 0 ? packet_bytes - 2 * channels : packet_bytes;
+                packets[p] = {static_cast<unsigned int>(packet_bytes),
+                              static_cast<unsigned int>(actual), 0};
+            }
+
+            run_case(options, {"usb_compaction", sample_rate, 0, 0, 0, channels, urb_bytes},
+                     [&]() {
+                         memcpy(urb.data(), source.data(), urb_bytes);
+                         size_t bytes = usb_compact_packets(reinterpret_cast<uint8_t *>(urb.data()),
+                                                            packets.data(), packets_per_urb);
+                         int samples = static_cast<int>(bytes / sizeof(int16_t));
+                         if (channels == 2)
+                             samples = usb_mix_stereo(urb.data(), samples);
+                         s_sink = s_sink + urb[samples / 2];
+                     });
+        }
+
+        // Audio output works on mono data:
+        const int urb_samples = samples_per_packet * packets_per_urb;
+        const std::vector<int16_t> input = make_signal(urb_samples);
+        std::vector<int16_t> output(urb_samples);
+        heterodyne_state heterodyne = {};
+        heterodyne.decimation_factor =
+                std::max(1, static_cast<int>(lround(static_cast<double>(sample_rate) / TARGET_AUDIO_OUT_RATE)));
+        heterodyne.iir_coefficient = heterodyne_iir_coefficient(HETERODYNE_AA_CUTOFF_HZ, sample_rate);
+        if (heterodyne_start(&heterodyne, samples_per_packet, std::min(40, samples_per_packet / 2),
+                             0, 0) != 0) {
+            fprintf(stderr, "heterodyne_start failed for sample rate %d\n", sample_rate);
+            continue;
+        }
+        run_case(options, {"heterodyne", sample_rate, 0, 0, 0, 1, urb_samples * sizeof(int16_t)},
+                 [&]() {
+                     const int count = heterodyne_process(&heterodyne, input.data(), urb_samples,
+                                                          output.data());
+                     s_sink = s_sink + output[count / 2];
+                 });
+
+        // The synthetic source must be well ahead of real time for load testing:
+        synth_source_config config = {sample_rate, 20.0f, 5.0f, 0.002f, 1};
+        synth_source_state source;
+        if (synth_source_init(&source, &config) != 0)
+            continue;
+        run_case(options, {"synth_source", sample_rate, 0, 0, 0, 1, urb_samples * sizeof(int16_t)},
+                 [&]() {
+                     synth_source_generate(&source, output.data(), urb_samples);
+                     s_sink = s_sink + output[urb_samples / 2];
+                 });
+    }
+}
+
+int main(int argc, char *argv[]) {
+    bench_options options;
+
+    for (;;) {
+        const int c = getopt(argc, argv, "n:o:H:s:k:t:r:h");
+        if (c == -1)
+            break;
+        bool ok = true;
+        switch (c) {
+            case 'n':
+                ok = parse_list(optarg, &options.nffts);
+                break;
+            case 'o':
+                ok = parse_list(optarg, &options.overlaps);
+                break;
+            case 'H':
+                ok = parse_list(optarg, &options.heights);
+                break;
+            case 's':
+                ok = parse_list(optarg, &options.sample_rates);
+                break;
+            case 'k':
+                options.kernel_filter = optarg;
+                break;
+            case 't':
+                options.min_run_ms = atof(optarg);
+                ok = options.min_run_ms > 0.0;
+                break;
+            case 'r':
+                options.runs = atoi(optarg);
+                ok = options.runs > 0;
+                break;
+            default:
+                ok = false;
+                break;
+        }
+        if (!ok) {
+            fprintf(stderr, "Usage: %s [-n nffts] [-o overlaps] [-H heights] [-s sample rates] "
+                            "[-k kernel] [-t ms] [-r runs]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    printf("kernel,sample_rate,nfft,overlap,height,channels,iterations,ns_per_op,bytes_per_s\n");
+    bench_transform_kernels(options);
+    bench_live_kernels(options);
+
+    return 0;
+}
@@ -0,0 +1,142 @@
+/*
+ * Copyright (c) 2025 John Mears
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * batgizmo-fft-tune: run the FFT autotuner that the app runs on first use of each FFT
+ * configuration, across the app's fixed window sizes and overlaps, and report every candidate
+ * plan. This shows how the best plan differs between machines, and can write a wisdom file.
+ *
+ * Results are written to stdout as CSV, one row per candidate:
+ *
+ *   nfft,overlap,stride,windows,batch_windows,threads,ns_per_window,best
+ *
+ * Usage: batgizmo-fft-tune [options]
+ *   -n LIST    FFT window sizes (default 64,...,4096)
+ *   -o LIST    overlap percentages (default 25,50,75,90,95)
+ *   -j N       maximum threads (default: the number of CPUs)
+ *   -b MS      time budget per configuration (default 150, as the app)
+ *   -w FILE    write the winners to FILE as wisdom
+ *   -f TEXT    the fingerprint to write with the wisdom (default "host")
+ */
+
+#include "core/fftwisdom.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+static const int NOMINAL_SLICE_ENTRIES = 10000;    // As AbstractPipeline.
+
+static bool parse_list(char *arg, std::vector<int> *values) {
+    values->clear();
+    for (char *s = strtok(arg, ","); s != nullptr; s = strtok(nullptr, ",")) {
+        const int v = atoi(s);
+        if (v <= 0)
+            return false;
+        values->push_back(v);
+    }
+    return !values->empty();
+}
+
+int main(int argc, char *argv[]) {
+    std::vector<int> nffts = {64, 128, 256, 512, 1024, 2048, 4096};
+    std::vector<int> overlaps = {25, 50, 75, 90, 95};
+    int max_threads = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+    double budget_ms = 150.0;
+    const char *wisdom_path = nullptr;
+    std::string fingerprint = "host";
+
+    for (;;) {
+        const int c = getopt(argc, argv, "n:o:j:b:w:f:h");
+        if (c == -1)
+            break;
+        bool ok = true;
+        switch (c) {
+            case 'n':
+                ok = parse_list(optarg, &nffts);
+                break;
+            case 'o':
+                ok = parse_list(optarg, &overlaps);
+                break;
+            case 'j':
+                max_threads = atoi(optarg);
+                ok = max_threads > 0;
+                break;
+            case 'b':
+                budget_ms = atof(optarg);
+                ok = budget_ms > 0.0;
+                break;
+            case 'w':
+                wisdom_path = optarg;
+                break;
+            case 'f':
+                fingerprint = optarg;
+                break;
+            default:
+                ok = false;
+        }
+        if (!ok) {
+            fprintf(stderr, "Usage: %s [-n nffts] [-o overlaps] [-j threads] [-b ms] [-w wisdom] "
+                            "[-f fingerprint]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    fft_wisdom wisdom;
+    wisdom.fingerprint = fingerprint;
+
+    printf("nfft,overlap,stride,windows,batch_windows,threads,ns_per_window,best\n");
+    for (int nfft: nffts) {
+        for (int overlap: overlaps) {
+            // As AbstractPipeline.calculateFftParameters and the slice size calculation:
+            const int overlap_count = std::clamp(static_cast<int>(overlap * nfft / 100.0f + 0.5f), 1, nfft);
+            const int stride = std::clamp(nfft - overlap_count, 1, nfft);
+            const int windows = std::max(1, (NOMINAL_SLICE_ENTRIES - nfft) / stride + 1);
+
+            fft_wisdom_entry best;
+            std::vector<fft_wisdom_entry> results;
+            if (fft_autotune(nfft, stride, windows, max_threads, budget_ms, &best, &results) != 0) {
+                fprintf(stderr, "Unable to tune nfft %d, overlap %d%%\n", nfft, overlap);
+                continue;
+            }
+            for (const auto &r: results) {
+                const bool is_best = r.plan.batch_windows == best.plan.batch_windows
+                                     && r.plan.threads == best.plan.threads;
+                printf("%d,%d,%d,%d,%d,%d,%.1f,%d\n", nfft, overlap, stride, windows,
+                       r.plan.batch_windows, r.plan.threads, r.ns_per_window, is_best ? 1 : 0);
+            }
+            fflush(stdout);
+            fft_wisdom_set(&wisdom, best);
+        }
+    }
+
+    if (wisdom_path != nullptr && fft_wisdom_save(wisdom_path, &wisdom) != 0) {
+        fprintf(stderr, "Unable to write %s\n", wisdom_path);
+        return 1;
+    }
+    return 0;
+}
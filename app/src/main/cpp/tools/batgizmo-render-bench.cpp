@@ -0,0 +1,423 @@
+/*
+ * Copyright (c) 2025 John Mears
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * batgizmo-render-bench: end to end throughput of the file rendering pipeline, as the user
+ * experiences it when opening or paging through a file: read -> unwrap -> FFT -> dB ->
+ * BnC -> colour map -> bitmap, a page at a time and a slice at a time, as the app does.
+ *
+ * Every combination of the app's NFftOptions and FftOverlapOptions is run against each
+ * file, including the auto options, which are resolved for a notional screen as
+ * AbstractPipeline.calculateFftParameters does. Each combination runs in its own process
+ * so that its peak RSS is its own.
+ *
+ * Results are written to stdout as CSV:
+ *
+ *   file,sample_rate,nfft_option,overlap_option,nfft,overlap,pages,audio_s,wall_s,
+ *   audio_s_per_s,peak_rss_kb,allocs_per_page,alloc_bytes_per_page
+ *
+ * Allocations are those made through operator new while rendering pages, so exclude the
+ * one off setup of buffers and FFT state.
+ *
+ * Usage: batgizmo-render-bench [options] [wav file...]
+ *   --synthetic-seconds N   length of the synthetic files (default 20, 0 for none)
+ *   --page-seconds N        the data page interval (default 5, as Settings)
+ *   --screen WxH            the spectrogram canvas size in dp (default 800x360)
+ *   --nfft LIST             only these nFFT options, 0 being auto
+ *   --overlap LIST          only these overlap options, 0 and -1 being the auto ones
+ */
+
+#include "core/bnc.h"
+#include "core/colourmap.h"
+#include "core/transform.h"
+#include "core/wavdecode.h"
+#include "core/wavreader.h"
+
+#include <sys/resource.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include <string>
+#include <vector>
+
+/*
+ * Count allocations made through operator new. That covers everything the pipeline
+ * allocates other than the FFT state, which kissfft mallocs once at initialisation.
+ */
+static std::atomic<long> s_allocation_count(0);
+static std::atomic<long> s_allocation_bytes(0);
+
+void *operator new(size_t size) {
+    s_allocation_count++;
+    s_allocation_bytes += static_cast<long>(size);
+    void *p = malloc(size == 0 ? 1 : size);
+    if (p == nullptr)
+        throw std::bad_alloc();
+    return p;
+}
+
+void operator delete(void *p) noexcept {
+    free(p);
+}
+
+void operator delete(void *p, size_t) noexcept {
+    free(p);
+}
+
+// As Settings.NFftOptions and Settings.FftOverlapOptions:
+static const int NFFT_AUTO = 0;
+static const int NFFT_OPTIONS[] = {NFFT_AUTO, 64, 128, 256, 512, 1024, 2048, 4096};
+static const int OVERLAP_AUTO75 = 0;
+static const int OVERLAP_AUTO90 = -1;
+static const int OVERLAP_OPTIONS[] = {OVERLAP_AUTO75, OVERLAP_AUTO90, 25, 50, 75, 90, 95};
+
+static const int NOMINAL_SLICE_ENTRIES = 10000;    // As AbstractPipeline.
+static const int COLOUR_MAP_SIZE = 256;
+
+struct render_options {
+    int page_seconds = 5;
+    float screen_width_dp = 800.0f;
+    float screen_height_dp = 360.0f;
+    std::vector<int> nfft_options;
+    std::vector<int> overlap_options;
+};
+
+struct render_params {
+    int nfft;
+    int overlap_count;
+    int stride;
+};
+
+/**
+ * Resolve the FFT window size and overlap as AbstractPipeline.calculateFftParameters does,
+ * for a page shown across the full width of the screen, from 0 to Nyquist.
+ */
+static render_params calculate_fft_parameters(const render_options &options, int nfft_option,
+                                              int overlap_option, int sample_rate) {
+    const float x_axis_span = static_cast<float>(options.page_seconds);
+    const float y_axis_span = sample_rate / 2.0f;
+    const float aspect_factor = (options.screen_height_dp * x_axis_span)
+                                / (options.screen_width_dp * y_axis_span);
+    const float pixels_per_second = options.screen_width_dp / x_axis_span;
+
+    int nfft = nfft_option;
+    if (nfft == NFFT_AUTO) {
+        const float samples_squared =
+                static_cast<float>(sample_rate) * static_cast<float>(sample_rate) * aspect_factor;
+        const int samples = static_cast<int>(sqrt(static_cast<double>(samples_squared)) + 0.5);
+        int calculated = static_cast<int>(pow(2.0, static_cast<int>(log2(static_cast<double>(samples)) + 0.5)));
+        calculated *= 2;
+        nfft = std::clamp(calculated, 64, 4096);     // As Settings.coerceNFft.
+    }
+
+    int overlap_percent = overlap_option;
+    if (overlap_option == OVERLAP_AUTO75 || overlap_option == OVERLAP_AUTO90) {
+        const float window_time = static_cast<float>(nfft) / sample_rate;
+        const float window_pixels = pixels_per_second * window_time;
+        const float multiplier = 2.0f / window_pixels;
+        const float calculated = 100.0f / multiplier;
+        const float max_overlap = overlap_option == OVERLAP_AUTO75 ? 75.0f : 90.0f;
+        overlap_percent = static_cast<int>(std::clamp(calculated, 0.0f, max_overlap));
+    }
+
+    render_params params;
+    params.nfft = nfft;
+    params.overlap_count = std::clamp(static_cast<int>(overlap_percent * nfft / 100.0f + 0.5), 1, nfft);
+    params.stride = std::clamp(nfft - params.overlap_count, 1, nfft);
+    return params;
+}
+
+static long peak_rss_kb() {
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return usage.ru_maxrss;     // Kilobytes on Linux.
+}
+
+/**
+ * Render every page of the file with one combination of settings and print the result.
+ * Returns 0 on success or -1 on failure.
+ */
+static int render_file(const std::string &path, const render_options &options, int nfft_option,
+                       int overlap_option) {
+    wav_reader reader;
+    std::string error;
+    if (wav_reader_open(&reader, path.c_str(), &error) != 0) {
+        fprintf(stderr, "%s: %s\n", path.c_str(), error.c_str());
+        return -1;
+    }
+
+    const render_params params = calculate_fft_parameters(options, nfft_option, overlap_option,
+                                                          reader.sample_rate);
+    const int nfft = params.nfft;
+    const int stride = params.stride;
+    const int64_t page_entries = static_cast<int64_t>(options.page_seconds) * reader.sample_rate;
+
+    // As AbstractPipeline.doCalculations:
+    const int slice_windows = (NOMINAL_SLICE_ENTRIES - nfft) / stride + 1;
+    const int raw_slice_entries = (slice_windows - 1) * stride + nfft;
+    const int raw_slice_overlap = nfft - stride;
+    const int max_page_windows = static_cast<int>((page_entries - nfft) / stride + 1);
+
+    // Buffers are allocated once, as the pipeline steps do:
+    transform_state transform;
+    if (transform_init(&transform, nfft) != 0) {
+        wav_reader_close(&reader);
+        return -1;
+    }
+    const int buckets = transform.frequency_buckets;
+    std::vector<float> window(nfft);
+    transform_hann_window(window.data(), nfft);
+    std::vector<int16_t> raw(page_entries);
+    std::vector<float> unwrapped(static_cast<size_t>(slice_windows) * nfft);
+    std::vector<float> transformed(static_cast<size_t>(std::max(max_page_windows, 1)) * buckets);
+    std::vector<uint16_t> bitmap(transformed.size());
+    std::vector<uint16_t> colour_map(COLOUR_MAP_SIZE);
+    for (int i = 0; i < COLOUR_MAP_SIZE; i++)
+        colour_map[i] = colour_map_rgb_to_rgb565(i, 255 - i, i / 2);
+
+    const long start_allocations = s_allocation_count;
+    const long start_allocation_bytes = s_allocation_bytes;
+    const auto start_time = std::chrono::steady_clock::now();
+
+    int pages = 0;
+    int64_t samples_rendered = 0;
+    for (int64_t page_start = 0; page_start < reader.frame_count; page_start += page_entries) {
+        const int page_count = wav_reader_read(&reader, page_start,
+                                               static_cast<int>(page_entries),
+                                               WAV_CHANNEL_DOWNMIX, raw.data());
+        if (page_count < 0) {
+            transform_cleanup(&transform);
+            wav_reader_close(&reader);
+            return -1;
+        }
+        if (page_count < nfft)
+            break;
+
+        const int page_windows = (page_count - nfft) / stride + 1;
+
+        // Transform a slice at a time, as TransformStep does:
+        int transformed_index = 0;
+        for (int slice_start = 0; transformed_index < page_windows;
+             slice_start += raw_slice_entries - raw_slice_overlap) {
+            const int slice_end = std::min(slice_start + raw_slice_entries, page_count);
+            const int windows = slice_end - slice_start < nfft ? 0
+                                : (slice_end - slice_start - nfft) / stride + 1;
+            if (windows == 0)
+                break;
+            transform_unwrap_slices(raw.data(), page_count, slice_start, windows, stride,
+                                    window.data(), nfft, unwrapped.data());
+            bool triggered = false;
+            transform_fft(&transform, windows, unwrapped.data(),
+                          transformed.data() + static_cast<size_t>(transformed_index) * buckets,
+                          BNC_DB_RANGE_MIN, 0, buckets - 1, 40.0f, &triggered);
+            transformed_index += windows;
+        }
+
+        // Auto BnC over the page, then colour map it into the bitmap:
+        float min_db = 0.0f, max_db = 0.0f, low_db = 0.0f, high_db = 0.0f;
+        float offset, multiplier;
+        if (bnc_find_range(0, transformed_index - 1, 0, buckets - 1, buckets, transformed.data(),
+                           &min_db, &max_db))
+            bnc_auto_range(min_db, max_db, &low_db, &high_db);
+        bnc_offset_multiplier(low_db, high_db, COLOUR_MAP_SIZE, &offset, &multiplier);
+        colour_map_apply(transformed.data(), 0, transformed_index, buckets, colour_map.data(),
+                         COLOUR_MAP_SIZE, offset, multiplier, bitmap.data(),
+                         static_cast<uint32_t>(max_page_windows));
+
+        samples_rendered += page_count;
+        pages++;
+    }
+
+    const double wall_s = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+    const long allocations = s_allocation_count - start_allocations;
+    const long allocation_bytes = s_allocation_bytes - start_allocation_bytes;
+    const double audio_s = static_cast<double>(samples_rendered) / reader.sample_rate;
+    const int per_page = std::max(pages, 1);
+
+    printf("\"%s\",%d,%d,%d,%d,%d,%d,%.3f,%.4f,%.1f,%ld,%.2f,%.0f\n", path.c_str(),
+           reader.sample_rate, nfft_option, overlap_option, nfft,
+           static_cast<int>(100.0 * params.overlap_count / nfft + 0.5), pages, audio_s, wall_s,
+           audio_s / std::max(wall_s, 1e-9), peak_rss_kb(),
+           static_cast<double>(allocations) / per_page,
+           static_cast<double>(allocation_bytes) / per_page);
+    fflush(stdout);
+
+    transform_cleanup(&transform);
+    wav_reader_close(&reader);
+    return 0;
+}
+
+/**
+ * Write a synthetic 16 bit mono wav file of noise with a train of FM sweeps, something like
+ * a pipistrelle pass. Returns 0 on success or -1 on failure.
+ */
+static int write_synthetic_wav(const std::string &path, int sample_rate, int seconds) {
+    FILE *f = fopen(path.c_str(), "wb");
+    if (f == nullptr)
+        return -1;
+
+    const uint32_t frames = static_cast<uint32_t>(sample_rate) * seconds;
+    const uint32_t data_bytes = frames * 2;
+    uint8_t header[44];
+    auto put32 = [&](int offset, uint32_t v) {
+        for (int i = 0; i < 4; i++)
+            header[offset + i] = static_cast<uint8_t>(v >> (8 * i));
+    };
+    memcpy(header, "RIFF", 4);
+    put32(4, 36 + data_bytes);
+    memcpy(header + 8, "WAVEfmt ", 8);
+    put32(16, 16);
+    put32(20, 1 | (1 << 16));                  // PCM, mono.
+    put32(24, sample_rate);
+    put32(28, sample_rate * 2);
+    put32(32, 2 | (16 << 16));                 // Block align, bits per sample.
+    memcpy(header + 36, "data", 4);
+    put32(40, data_bytes);
+    bool ok = fwrite(header, 1, sizeof(header), f) == sizeof(header);
+
+    std::vector<int16_t> block(sample_rate);
+    srand(1);
+    const double call_interval_s = 0.1, call_length_s = 0.005;
+    for (int s = 0; s < seconds && ok; s++) {
+        for (int i = 0; i < sample_rate; i++) {
+            const double t = s + static_cast<double>(i) / sample_rate;
+            const double in_call = fmod(t, call_interval_s);
+            double v = (rand() % 401) - 200;
+            if (in_call < call_length_s) {
+                // Sweep from 80 kHz down to 45 kHz:
+                const double phase = 2.0 * M_PI * (80000.0 * in_call - 3.5e6 * in_call * in_call);
+                v += 12000.0 * sin(phase);
+            }
+            block[i] = static_cast<int16_t>(v);
+        }
+        ok = fwrite(block.data(), sizeof(int16_t), block.size(), f) == block.size();
+    }
+
+    return fclose(f) == 0 && ok ? 0 : -1;
+}
+
+static bool parse_list(const char *arg, std::vector<int> *values) {
+    values->clear();
+    std::string text(arg);
+    size_t start = 0;
+    while (start <= text.size()) {
+        const size_t end = std::min(text.find(',', start), text.size());
+        char *parse_end = nullptr;
+        const std::string item = text.substr(start, end - start);
+        const long v = strtol(item.c_str(), &parse_end, 10);
+        if (item.empty() || *parse_end != '\0')
+            return false;
+        values->push_back(static_cast<int>(v));
+        start = end + 1;
+    }
+    return !values->empty();
+}
+
+int main(int argc, char *argv[]) {
+    render_options options;
+    options.nfft_options.assign(std::begin(NFFT_OPTIONS), std::end(NFFT_OPTIONS));
+    options.overlap_options.assign(std::begin(OVERLAP_OPTIONS), std::end(OVERLAP_OPTIONS));
+    int synthetic_seconds = 20;
+    std::vector<std::string> files;
+
+    for (int i = 1; i < argc; i++) {
+        const std::string arg = argv[i];
+        const char *value = i + 1 < argc ? argv[i + 1] : nullptr;
+        bool ok = true;
+        if (arg.rfind("--", 0) == 0) {
+            if (value == nullptr) {
+                ok = false;
+            } else if (arg == "--synthetic-seconds") {
+                synthetic_seconds = atoi(value);
+                ok = synthetic_seconds >= 0;
+            } else if (arg == "--page-seconds") {
+                options.page_seconds = atoi(value);
+                ok = options.page_seconds > 0;
+            } else if (arg == "--screen") {
+                ok = sscanf(value, "%fx%f", &options.screen_width_dp, &options.screen_height_dp) == 2
+                     && options.screen_width_dp > 0 && options.screen_height_dp > 0;
+            } else if (arg == "--nfft") {
+                ok = parse_list(value, &options.nfft_options);
+            } else if (arg == "--overlap") {
+                ok = parse_list(value, &options.overlap_options);
+            } else {
+                ok = false;
+            }
+            i++;
+        } else {
+            files.push_back(arg);
+        }
+        if (!ok) {
+            fprintf(stderr, "Usage: %s [--synthetic-seconds N] [--page-seconds N] [--screen WxH] "
+                            "[--nfft LIST] [--overlap LIST] [wav file...]\n", argv[0]);
+            return 2;
+        }
+    }
+
+    // Synthetic files at common bat detector sample rates:
+    std::vector<std::string> synthetic_files;
+    if (synthetic_seconds > 0) {
+        for (int rate: {256000, 384000}) {
+            char path[64];
+            snprintf(path, sizeof(path), "/tmp/batgizmo-render-bench-%d-%d.wav", rate, (int) getpid());
+            if (write_synthetic_wav(path, rate, synthetic_seconds) != 0) {
+                fprintf(stderr, "Unable to write %s\n", path);
+                return 1;
+            }
+            synthetic_files.push_back(path);
+        }
+        files.insert(files.begin(), synthetic_files.begin(), synthetic_files.end());
+    }
+
+    printf("file,sample_rate,nfft_option,overlap_option,nfft,overlap,pages,audio_s,wall_s,"
+           "audio_s_per_s,peak_rss_kb,allocs_per_page,alloc_bytes_per_page\n");
+    fflush(stdout);
+
+    int failures = 0;
+    for (const auto &file: files) {
+        for (int nfft_option: options.nfft_options) {
+            for (int overlap_option: options.overlap_options) {
+                // A process per combination, so that peak RSS isn't carried over:
+                const pid_t pid = fork();
+                if (pid == 0)
+                    _exit(render_file(file, options, nfft_option, overlap_option) == 0 ? 0 : 1);
+                int status = 0;
+                if (pid < 0 || waitpid(pid, &status, 0) < 0 || !WIFEXITED(status)
+                    || WEXITSTATUS(status) != 0)
+                    failures++;
+            }
+        }
+    }
+
+    for (const auto &path: synthetic_files)
+        remove(path.c_str());
+
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,331 @@
+/*
+ * Copyright (c) 2025 John Mears
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+/**
+ * batgizmo-urb-replay: replay URBs captured by the app ("Capture raw USB data for replay")
+ * through the same code as the live data path, on any Linux host, so that live throughput
+ * and jitter can be measured and regression tested without a microphone.
+ *
+ * Each URB goes through packet compaction and stereo mixdown, is copied into a circular
+ * buffer as USBSourceStep does, and is transformed a slice at a time with auto trigger
+ * detection as TransformStep does. Optionally, it is also heterodyned for audio output.
+ *
+ * URBs are delivered at their original timing scaled by --speed, or as fast as possible
+ * with --speed 0. Results are written to stdout as key=value lines.
+ *
+ * Usage: batgizmo-urb-replay [options] capture.bgurb
+ *   --speed X           timing multiplier (default 1, original timing; 0 for flat out)
+ *   --loops N           replay the capture N times (default 1)
+ *   --nfft N            FFT window size (default 512)
+ *   --overlap PERCENT   FFT window overlap (default 75)
+ *   --heterodyne KHZ    also heterodyne for audio output at this reference frequency
+ */
+
+#include "core/heterodyne.h"
+#include "core/transform.h"
+#include "core/urbcapture.h"
+#include "core/usbpacket.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+typedef std::chrono::steady_clock replay_clock;
+
+static const int NOMINAL_SLICE_ENTRIES = 10000;    // As AbstractPipeline.
+static const int RING_SECONDS = 5;                 // As the default live data page.
+static const int TARGET_AUDIO_OUT_RATE = 48000;    // As nativeusb.cpp.
+static const float TRIGGER_THRESHOLD_DB = 40.0f;   // The auto trigger defaults from Settings.
+static const float TRIGGER_MIN_KHZ = 16.0f;
+static const float TRIGGER_MAX_KHZ = 120.0f;
+
+struct replay_options {
+    double speed = 1.0;
+    int loops = 1;
+    int nfft = 512;
+    int overlap_percent = 75;
+    int heterodyne_khz = 0;
+};
+
+struct distribution {
+    std::vector<double> values;
+
+    void add(double v) { values.push_back(v); }
+
+    void print(const char *name, double scale) {
+        if (values.empty()) {
+            printf("%s_mean=0\n%s_p99=0\n%s_max=0\n", name, name, name);
+            return;
+        }
+        std::sort(values.begin(), values.end());
+        double sum = 0.0;
+        for (double v: values)
+            sum += v;
+        const double p99 = values[std::min(values.size() - 1, values.size() * 99 / 100)];
+        printf("%s_mean=%.3f\n%s_p99=%.3f\n%s_max=%.3f\n", name, sum / values.size() * scale,
+               name, p99 * scale, name, values.back() * scale);
+    }
+};
+
+/**
+ * Check that a record's lengths are consistent with its payload, so that compaction stays
+ * within the buffer.
+ */
+static bool record_is_valid(const urb_capture_record &record) {
+    size_t total = 0;
+    for (const auto &packet: record.packets) {
+        if (packet.actual_length > packet.length || packet.length % sizeof(int16_t) != 0)
+            return false;
+        total += packet.length;
+    }
+    return total <= record.payload.size();
+}
+
+int main(int argc, char *argv[]) {
+    replay_options options;
+    const char *path = nullptr;
+
+    for (int i = 1; i < argc; i++) {
+        const std::string arg = argv[i];
+        const char *value = i + 1 < argc ? argv[i + 1] : nullptr;
+        bool ok = true;
+        if (arg.rfind("--", 0) == 0) {
+            if (value == nullptr) {
+                ok = false;
+            } else if (arg == "--speed") {
+                options.speed = atof(value);
+                ok = options.speed >= 0.0;
+            } else if (arg == "--loops") {
+                options.loops = atoi(value);
+                ok = options.loops > 0;
+            } else if (arg == "--nfft") {
+                options.nfft = atoi(value);
+                ok = options.nfft >= 16 && options.nfft % 2 == 0;
+            } else if (arg == "--overlap") {
+                options.overlap_percent = atoi(value);
+                ok = options.overlap_percent >= 0 && options.overlap_percent < 100;
+            } else if (arg == "--heterodyne") {
+                options.heterodyne_khz = atoi(value);
+                ok = options.heterodyne_khz > 0;
+            } else {
+                ok = false;
+            }
+            i++;
+        } else if (path == nullptr) {
+            path = argv[i];
+        } else {
+            ok = false;
+        }
+        if (!ok) {
+            fprintf(stderr, "Usage: %s [--speed X] [--loops N] [--nfft N] [--overlap PERCENT] "
+                            "[--heterodyne KHZ] capture.bgurb\n", argv[0]);
+            return 2;
+        }
+    }
+    if (path == nullptr) {
+        fprintf(stderr, "Usage: %s [options] capture.bgurb\n", argv[0]);
+        return 2;
+    }
+
+    /*
+     * Load the whole capture up front, so that file I/O doesn't disturb the timing.
+     */
+    FILE *f = fopen(path, "rb");
+    if (f == nullptr) {
+        fprintf(stderr, "Unable to open %s\n", path);
+        return 1;
+    }
+    urb_capture_header header;
+    std::string error;
+    if (urb_capture_read_header(f, &header, &error) != 0) {
+        fprintf(stderr, "%s: %s\n", path, error.c_str());
+        fclose(f);
+        return 1;
+    }
+    std::vector<urb_capture_record> records;
+    for (;;) {
+        urb_capture_record record;
+        const int rc = urb_capture_read_urb(f, &record);
+        if (rc == 0)
+            break;
+        if (rc < 0 || !record_is_valid(record)) {
+            fprintf(stderr, "%s: malformed record %zu, ignoring the rest of the file\n", path,
+                    records.size());
+            break;
+        }
+        records.push_back(std::move(record));
+    }
+    fclose(f);
+    if (records.empty()) {
+        fprintf(stderr, "%s: no URBs\n", path);
+        return 1;
+    }
+
+    const int sample_rate = static_cast<int>(header.sample_rate);
+
+    // The capture's own timing, as the microphone and host delivered it:
+    distribution capture_interval_ms;
+    int error_urbs = 0, empty_urbs = 0;
+    long short_packets = 0;
+    for (size_t i = 0; i < records.size(); i++) {
+        if (i > 0)
+            capture_interval_ms.add((records[i].timestamp_ns - records[i - 1].timestamp_ns) / 1e6);
+        error_urbs += records[i].status != 0;
+        bool any = false;
+        for (const auto &packet: records[i].packets) {
+            short_packets += packet.actual_length < packet.length;
+            any = any || packet.actual_length > 0;
+        }
+        empty_urbs += !any;
+    }
+
+    /*
+     * The live pipeline state: a circular buffer of samples, transformed a slice at a time.
+     */
+    const int nfft = options.nfft;
+    const int overlap_count = static_cast<int>(options.overlap_percent * nfft / 100.0f + 0.5f);
+    const int stride = std::clamp(nfft - overlap_count, 1, nfft);
+    const int slice_windows = std::max(1, (NOMINAL_SLICE_ENTRIES - nfft) / stride + 1);
+    const int slice_entries = (slice_windows - 1) * stride + nfft;
+    const int slice_advance = slice_windows * stride;
+
+    transform_state transform;
+    if (transform_init(&transform, nfft) != 0) {
+        fprintf(stderr, "Unable to initialise the FFT\n");
+        return 1;
+    }
+    const int buckets = transform.frequency_buckets;
+    const double frequency_interval = static_cast<double>(sample_rate) / nfft;
+    const int min_trigger_bucket = std::clamp(static_cast<int>(lround(TRIGGER_MIN_KHZ * 1000 / frequency_interval)), 0, buckets - 1);
+    const int max_trigger_bucket = std::clamp(static_cast<int>(lround(TRIGGER_MAX_KHZ * 1000 / frequency_interval)), 0, buckets - 1);
+
+    std::vector<float> window(nfft);
+    transform_hann_window(window.data(), nfft);
+    const int ring_size = sample_rate * RING_SECONDS;
+    std::vector<int16_t> ring(ring_size);
+    std::vector<int16_t> slice(slice_entries);
+    std::vector<float> unwrapped(static_cast<size_t>(slice_windows) * nfft);
+    std::vector<float> transformed(static_cast<size_t>(slice_windows) * buckets);
+
+    heterodyne_state heterodyne = {};
+    std::vector<int16_t> audio_out;
+    if (options.heterodyne_khz > 0) {
+        heterodyne.decimation_factor = std::max(1, static_cast<int>(lround(static_cast<double>(sample_rate) / TARGET_AUDIO_OUT_RATE)));
+        heterodyne.iir_coefficient = heterodyne_iir_coefficient(HETERODYNE_AA_CUTOFF_HZ, sample_rate);
+        if (heterodyne_start(&heterodyne, sample_rate / 1000, options.heterodyne_khz, 0, 0) != 0) {
+            fprintf(stderr, "Heterodyne frequency out of range for the sample rate\n");
+            return 1;
+        }
+    }
+
+    size_t max_payload = 0;
+    for (const auto &record: records)
+        max_payload = std::max(max_payload, record.payload.size());
+    std::vector<int16_t> urb_buffer(max_payload / sizeof(int16_t) + 1);
+    audio_out.resize(urb_buffer.size());
+
+    long samples_delivered = 0;
+    long slices_transformed = 0, triggered_slices = 0;
+    int ring_offset = 0;
+    long samples_pending = 0;          // Received but not yet transformed.
+    distribution lateness_ms, processing_us;
+
+    const auto start_time = replay_clock::now();
+    int64_t loop_offset_ns = 0;
+    const int64_t capture_span_ns = records.back().timestamp_ns - records.front().timestamp_ns
+                                    + (records.size() > 1 ? (records.back().timestamp_ns - records.front().timestamp_ns) / static_cast<int64_t>(records.size() - 1) : 0);
+
+    for (int loop = 0; loop < options.loops; loop++, loop_offset_ns += capture_span_ns) {
+        for (const auto &record: records) {
+            if (options.speed > 0.0) {
+                const auto due = start_time + std::chrono::nanoseconds(
+                        static_cast<int64_t>((loop_offset_ns + record.timestamp_ns - records.front().timestamp_ns) / options.speed));
+                std::this_thread::sleep_until(due);
+                lateness_ms.add(std::chrono::duration<double, std::milli>(replay_clock::now() - due).count());
+            }
+
+            const auto urb_start = replay_clock::now();
+
+            // As the reap loop: compact, mix down, then hand the samples on:
+            memcpy(urb_buffer.data(), record.payload.data(), record.payload.size());
+            const int samples = usb_urb_to_mono(urb_buffer.data(), record.packets.data(),
+                                                static_cast<int>(record.packets.size()),
+                                                static_cast<int>(header.channels));
+            if (samples > 0) {
+                usb_copy_to_ring(urb_buffer.data(), samples, ring.data(), ring_offset, ring_size);
+                ring_offset = (ring_offset + samples) % ring_size;
+                samples_delivered += samples;
+                samples_pending += samples;
+
+                if (options.heterodyne_khz > 0)
+                    heterodyne_process(&heterodyne, urb_buffer.data(), samples, audio_out.data());
+            }
+
+            // Transform each complete slice, as TransformStep does for live data:
+            while (samples_pending >= slice_entries) {
+                const long slice_start = (ring_offset - samples_pending + 2L * ring_size) % ring_size;
+                for (int i = 0; i < slice_entries; i++)
+                    slice[i] = ring[(slice_start + i) % ring_size];
+                transform_unwrap_slices(slice.data(), slice_entries, 0, slice_windows, stride,
+                                        window.data(), nfft, unwrapped.data());
+                bool triggered = false;
+                transform_fft(&transform, slice_windows, unwrapped.data(), transformed.data(),
+                              -30.0f, min_trigger_bucket, max_trigger_bucket,
+                              TRIGGER_THRESHOLD_DB, &triggered);
+                slices_transformed++;
+                triggered_slices += triggered;
+                samples_pending -= slice_advance;
+            }
+
+            processing_us.add(std::chrono::duration<double, std::micro>(replay_clock::now() - urb_start).count());
+        }
+    }
+
+    const double wall_s = std::chrono::duration<double>(replay_clock::now() - start_time).count();
+    const double audio_s = static_cast<double>(samples_delivered) / sample_rate;
+    const double capture_s = capture_span_ns / 1e9;
+
+    printf("file=%s\n", path);
+    printf("sample_rate=%d\nchannels=%u\npackets_per_urb=%u\n", sample_rate, header.channels,
+           header.packets_per_urb);
+    printf("urbs=%zu\nloops=%d\nerror_urbs=%d\nempty_urbs=%d\nshort_packets=%ld\n",
+           records.size(), options.loops, error_urbs, empty_urbs, short_packets);
+    // Samples delivered against those expected from the capture duration shows clock drift:
+    printf("samples=%ld\nexpected_samples=%.0f\n", samples_delivered,
+           capture_s * sample_rate * options.loops);
+    printf("slices=%ld\ntriggered_slices=%ld\n", slices_transformed, triggered_slices);
+    capture_interval_ms.print("capture_interval_ms", 1.0);
+    if (options.speed > 0.0)
+        lateness_ms.print("replay_lateness_ms", 1.0);
+    processing_us.print("processing_us", 1.0);
+    printf("wall_s=%.4f\naudio_s=%.3f\nrealtime_factor=%.2f\n", wall_s, audio_s,
+           audio_s / std::max(wall_s, 1e-9));
+
+    transform_cleanup(&transform);
+    return 0;
+}
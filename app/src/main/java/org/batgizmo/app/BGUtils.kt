@@ -27,3 +27,9 @@ package org.batgizmo.app
  */
 typealias HORange = Pair<Int, Int>
 
+/**
+ * A half open range of 64 bit sample indexes, used to address raw data in
+ * files that can exceed 2^31 samples.
+ */
+typealias LongHORange = Pair<Long, Long>
+
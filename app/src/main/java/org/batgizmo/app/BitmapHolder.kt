@@ -23,7 +23,13 @@
 package org.batgizmo.app
 
 import android.graphics.Bitmap
+import android.graphics.Canvas
+import android.graphics.Color
+import android.graphics.Rect
+import androidx.core.graphics.createBitmap
 import java.util.concurrent.Semaphore
+import java.util.concurrent.atomic.AtomicLong
+import java.util.concurrent.atomic.AtomicReference
 
 /**
  * This class has a simple job which is to own the bitmap, if any, that is currently
@@ -31,26 +37,211 @@ import java.util.concurrent.Semaphore
  * to the bitmap, which can therefore be updated an become immediately available to
  * parts of the code that need it.
  *
- * Client code that accesses bitmapHolders from multiple threads need to provide
- * synchronization - this class doesn't provide it.
+ * The pipeline writes the bitmap, then publishes the columns it changed. The renderer draws
+ * frames, each a copy of the bitmap split into tiles of TILE_COLUMNS columns, so that a
+ * hardware canvas only uploads the tiles that have changed since it last drew the frame.
+ *
+ * The frames are triple buffered so that the pipeline and the renderer never wait for each
+ * other. Publishing copies the changed columns, and any the back frame missed while it was
+ * elsewhere, into the back frame's tiles, then swaps it with the latest published frame.
+ * The renderer swaps the latest published frame for the one it last drew. Neither swap
+ * takes a lock, and a frame is only ever in one of the three roles.
+ *
+ * The pipeline side, meaning bitmap, the ring, publish, publishAll and obtainBitmap, must be
+ * used while synchronized on the holder. Only the renderer uses acquireFront.
  */
 class BitmapHolder {
+    companion object {
+        const val TILE_COLUMNS = 256
+
+        // Bitmaps kept for reuse beyond this are left to the garbage collector:
+        private const val MAX_RECYCLED = 64
+    }
+
     /** Used to signal that the bitmap has been updated and a redraw is therefore due. */
     private val spectrogramUpdateSemaphore = Semaphore(0)
 
+    /** When the oldest update not yet drawn was signalled, for telemetry, or 0. */
+    private val updateSignalledNs = AtomicLong(0)
+
     /**
-     * The bitmap, if any, that is being shared between the pipeline and the graph
-     * renderer.
-     *
-     * The bitmap is accessed from both the pipeline thread and the renderer thread.
-     * Therefore, both those threads must synchronize access based on the holder object
-     * (not the bitmap object, as we might be able to null it).
-     *
-     *  synchronized (holder) {
-     *      // Access the bitmap here for read and write.
-     *  }
+     * A published copy of the bitmap, for the renderer to draw. Tile i holds the columns
+     * from i * TILE_COLUMNS.
+     */
+    class Frame internal constructor(
+        val width: Int,
+        val height: Int,
+        val tiles: List<Bitmap>,
+        internal val generation: Int
+    ) {
+        // Columns of the bitmap that have changed since they were copied to this frame:
+        internal var stale: HORange? = HORange(0, width)
+
+        /** The ring, if any, as it was when this frame was published. */
+        var ringHead = -1
+            internal set
+        var ringColumns = 0
+            internal set
+    }
+
+    // The latest published frame, and whether the renderer has yet to take it:
+    private class Published(val frame: Frame?, val fresh: Boolean)
+
+    private val published = AtomicReference(Published(null, false))
+
+    // The pipeline side. The generation changes with each new bitmap, and the frames of
+    // older generations are recycled as they come back from the renderer:
+    private var generation = 0
+    private var back: Frame? = null
+    private val frames = ArrayList<Frame>(3)
+    private val recycled = ArrayList<Bitmap>()
+
+    // The renderer side:
+    private var front: Frame? = null
+
+    /**
+     * The bitmap, which the pipeline writes. Setting it starts a new image, of the new
+     * bitmap's size, with frames to match; the renderer keeps drawing the last published
+     * image until the new one is first published. Setting it to null, then publishing,
+     * blanks the display.
      */
     var bitmap: Bitmap? = null
+        set(value) {
+            if (value === field)
+                return
+            field?.let { addRecycled(it) }
+            field = value
+            back?.let { addRecycled(it.tiles) }
+            back = null
+            frames.clear()
+            generation++
+            ringHead = -1
+        }
+
+    /**
+     * Set these to have the image drawn as a ring, for a scrolling display: the first
+     * ringColumns columns are drawn oldest first, starting from column ringHead, so that
+     * the column before ringHead is drawn last. A ringHead of -1 draws the image as it is.
+     * They take effect when next published.
+     */
+    var ringHead = -1
+    var ringColumns = 0
+
+    /**
+     * Publish the bitmap, after writing columns first until second of it, so that the
+     * renderer draws it next.
+     */
+    fun publish(first: Int, second: Int) {
+        val source = bitmap
+        if (source == null) {
+            recycle(published.getAndSet(Published(null, true)).frame)
+            return
+        }
+
+        // Every frame of this image is now missing the changed columns:
+        val changed = HORange(first.coerceAtLeast(0), second.coerceAtMost(source.width))
+        for (frame in frames) {
+            val stale = frame.stale
+            frame.stale = if (stale == null) changed
+                else HORange(minOf(stale.first, changed.first), maxOf(stale.second, changed.second))
+        }
+
+        val current = back ?: createFrame(source).also { frames.add(it) }
+        current.stale?.let { copyColumns(source, current, it) }
+        current.stale = null
+        current.ringHead = ringHead
+        current.ringColumns = ringColumns
+
+        val previous = published.getAndSet(Published(current, true)).frame
+        back = if (previous != null && previous.generation == generation)
+            previous
+        else {
+            recycle(previous)
+            null
+        }
+    }
+
+    fun publishAll() {
+        publish(0, bitmap?.width ?: 0)
+    }
+
+    /**
+     * An RGB_565 bitmap of the size required, black, reusing the smallest recycled one whose
+     * allocation is big enough.
+     */
+    fun obtainBitmap(width: Int, height: Int): Bitmap {
+        val reusable = recycled
+            .filter { it.allocationByteCount >= width * height * 2 }
+            .minByOrNull { it.allocationByteCount }
+        val result = if (reusable != null) {
+            recycled.remove(reusable)
+            reusable.apply { reconfigure(width, height, Bitmap.Config.RGB_565) }
+        } else
+            createBitmap(width, height, Bitmap.Config.RGB_565)
+        result.eraseColor(Color.BLACK)
+        return result
+    }
+
+    /**
+     * Forget any recycled bitmaps, so that their memory can be reclaimed.
+     */
+    fun trim() {
+        recycled.clear()
+    }
+
+    private fun createFrame(source: Bitmap): Frame {
+        val tiles = (0 until source.width step TILE_COLUMNS).map {
+            obtainBitmap(minOf(TILE_COLUMNS, source.width - it), source.height)
+        }
+        return Frame(source.width, source.height, tiles, generation)
+    }
+
+    // Copy a range of columns from the bitmap to the tiles of a frame that they fall in:
+    private fun copyColumns(source: Bitmap, frame: Frame, columns: HORange) {
+        if (columns.second <= columns.first)
+            return
+        for (tile in columns.first / TILE_COLUMNS..(columns.second - 1) / TILE_COLUMNS) {
+            val tileStart = tile * TILE_COLUMNS
+            val first = maxOf(columns.first, tileStart)
+            val second = minOf(columns.second, tileStart + TILE_COLUMNS)
+            Canvas(frame.tiles[tile]).drawBitmap(
+                source,
+                Rect(first, 0, second, source.height),
+                Rect(first - tileStart, 0, second - tileStart, source.height),
+                null
+            )
+        }
+    }
+
+    // A frame of an older image that has come back from the renderer, so is no longer drawn:
+    private fun recycle(frame: Frame?) {
+        if (frame != null && frame.generation != generation)
+            addRecycled(frame.tiles)
+    }
+
+    private fun addRecycled(bitmaps: List<Bitmap>) {
+        bitmaps.forEach { addRecycled(it) }
+    }
+
+    private fun addRecycled(bitmap: Bitmap) {
+        if (recycled.size >= MAX_RECYCLED)
+            recycled.removeAt(0)
+        recycled.add(bitmap)
+    }
+
+    /**
+     * This method is thread safe, for the renderer only.
+     *
+     * The frame to draw: the latest published one, or null to draw nothing. It is not
+     * written while the renderer has it, until the next call.
+     */
+    fun acquireFront(): Frame? {
+        if (published.get().fresh) {
+            // Hand back the frame drawn last time, for the pipeline to reuse:
+            front = published.getAndSet(Published(front, false)).frame
+        }
+        return front
+    }
 
     /**
      * If a cursor should be displayed, set this to the time position required.
@@ -65,6 +256,8 @@ class BitmapHolder {
      */
     fun signalUpdate() {
         // Log.d(this::class.simpleName, "signalUpdate called")
+        if (Telemetry.enabled)
+            updateSignalledNs.compareAndSet(0, System.nanoTime())
         spectrogramUpdateSemaphore.release()
     }
 
@@ -82,4 +275,16 @@ class BitmapHolder {
         // Log.d(this::class.simpleName, "Semaphore queue length is ${dataUpdateSemaphore.queueLength}")
     }
 
+    /**
+     * This method is thread safe.
+     *
+     * This method is called by the code that renders the bitmap to the screen once it has
+     * drawn an update, to record the latency from the update being signalled.
+     */
+    fun onDrawn() {
+        val signalledNs = updateSignalledNs.getAndSet(0)
+        if (signalledNs != 0L)
+            Telemetry.record(Telemetry.Stage.DRAW, System.nanoTime() - signalledNs)
+    }
+
 }
\ No newline at end of file
@@ -48,6 +48,8 @@ import java.io.File
 import java.io.FileInputStream
 import java.io.FileOutputStream
 import java.io.OutputStream
+import java.nio.ByteBuffer
+import java.nio.ByteOrder
 import java.text.SimpleDateFormat
 import java.time.Instant
 import java.time.format.DateTimeFormatterBuilder
@@ -68,9 +70,106 @@ class FileWriter(
 ) {
 
     companion object {
+        // Sizes larger than this need an RF64 header:
+        private const val RF64_MAX_32_BIT_SIZE = 0xFFFFFFFFL
+        // RIFF size, data size and sample count (8 bytes each), and table length (4 bytes):
+        private const val DS64_CHUNK_SIZE = 28
+
         public fun prettyFloat3Dps(value: Float) : String {
             return "%.3f".format(value).trimEnd('0').trimEnd('.')
         }
+
+        /**
+         * Create the header for a wav file. A classic RIFF header is used when the sizes fit
+         * in 32 bits, otherwise an RF64 header with a ds64 chunk carrying the 64 bit sizes
+         * (EBU Tech 3306).
+         */
+        internal fun createWavHeaderWithGuano(
+            dataEntries: Long,
+            sampleRate: Int,
+            bitsPerSample: Int,
+            guanoData: ByteArray,
+            channels: Int = 1,
+        ): ByteArray {
+            val byteRate = sampleRate * channels * bitsPerSample / 8
+            val blockAlign = channels * bitsPerSample / 8
+            val totalAudioLen = dataEntries * blockAlign
+
+            val guanoChunkSize = guanoData.size
+            val guanoChunkTotalSize = 8 + guanoChunkSize
+
+            // Total = PCM data + standard header (36) + Guano chunk + data header (8)
+            val classicTotalDataLen = totalAudioLen + 36 + guanoChunkTotalSize
+            val isRf64 = classicTotalDataLen > RF64_MAX_32_BIT_SIZE
+            val ds64ChunkTotalSize = if (isRf64) 8 + DS64_CHUNK_SIZE else 0
+            val totalDataLen = classicTotalDataLen + ds64ChunkTotalSize
+
+            // 44 includes standard + fmt + data headers
+            val header = ByteArray(44 + ds64ChunkTotalSize + guanoChunkTotalSize)
+
+            // --- RIFF Header ---
+            writeTextBytes(header, 0, if (isRf64) "RF64" else "RIFF")
+            // RF64 sizes that don't fit are set to all ones, and the real value is in ds64:
+            writeIntLE(header, 4, if (isRf64) -1 else totalDataLen.toInt())
+            writeTextBytes(header, 8, "WAVE")
+            var offset = 12
+
+            // --- ds64 chunk, which must immediately follow the WAVE ID ---
+            if (isRf64) {
+                writeTextBytes(header, offset, "ds64")
+                writeIntLE(header, offset + 4, DS64_CHUNK_SIZE)
+                writeLongLE(header, offset + 8, totalDataLen)       // RIFF size
+                writeLongLE(header, offset + 16, totalAudioLen)     // data size
+                writeLongLE(header, offset + 24, dataEntries)       // sample count
+                writeIntLE(header, offset + 32, 0)                  // No table entries.
+                offset += 8 + DS64_CHUNK_SIZE
+            }
+
+            // --- fmt chunk (always 16 bytes for PCM) ---
+            writeTextBytes(header, offset, "fmt ")
+            writeIntLE(header, offset + 4, 16) // Subchunk1Size
+            writeShortLE(header, offset + 8, 1) // PCM format
+            writeShortLE(header, offset + 10, channels.toShort())
+            writeIntLE(header, offset + 12, sampleRate)
+            writeIntLE(header, offset + 16, byteRate)
+            writeShortLE(header, offset + 20, blockAlign.toShort())
+            writeShortLE(header, offset + 22, bitsPerSample.toShort())
+            offset += 24
+
+            writeTextBytes(header, offset, "guan")
+            writeIntLE(header, offset + 4, guanoChunkSize)
+            System.arraycopy(guanoData, 0, header, offset + 8, guanoChunkSize)
+            offset += 8 + guanoChunkSize
+
+            // --- data chunk (must come after Guano) ---
+            writeTextBytes(header, offset, "data")
+            writeIntLE(header, offset + 4, if (isRf64) -1 else totalAudioLen.toInt())
+
+            return header
+        }
+
+        private fun writeTextBytes(buffer: ByteArray, offset: Int, text: String) {
+            for ((i, c) in text.withIndex()) {
+                buffer[offset + i] = c.code.toByte()
+            }
+        }
+
+        private fun writeIntLE(buffer: ByteArray, offset: Int, value: Int) {
+            buffer[offset] = (value and 0xff).toByte()
+            buffer[offset + 1] = ((value shr 8) and 0xff).toByte()
+            buffer[offset + 2] = ((value shr 16) and 0xff).toByte()
+            buffer[offset + 3] = ((value shr 24) and 0xff).toByte()
+        }
+
+        private fun writeLongLE(buffer: ByteArray, offset: Int, value: Long) {
+            writeIntLE(buffer, offset, (value and 0xFFFFFFFFL).toInt())
+            writeIntLE(buffer, offset + 4, (value ushr 32).toInt())
+        }
+
+        private fun writeShortLE(buffer: ByteArray, offset: Int, value: Short) {
+            buffer[offset] = (value.toInt() and 0xff).toByte()
+            buffer[offset + 1] = ((value.toInt() shr 8) and 0xff).toByte()
+        }
     }
 
     enum class TriggerType(val value: Int, val str: String) {
@@ -108,20 +207,23 @@ class FileWriter(
 
     // private val bufferLengthS = 1f
     private val maxFileWriteChunkEntries = 9600          // A bit arbitrary - big enough to get batching efficiency.
-    private val maxFileEntries = sampleRate * model.settings.maxFileTimeMs / 1000
+    private val maxFileEntries = sampleRate.toLong() * model.settings.maxFileTimeMs / 1000
     private val preTriggerEntries = sampleRate * model.settings.preTriggerTimeMs / 1000
     private val postTriggerEntries = sampleRate * model.settings.postTriggerTimeMs / 1000
     // Padding buffer size to allow for some latency when written data from trigger:
     private val bufferLengthEntries =
         sampleRate * (Settings.PreTriggerTimeOptions.PRETRIGGER_TIME_MAX.value + 500) / 1000
-    private val buffer = ShortArray(bufferLengthEntries)
+    // Direct, so that the native layer can copy into it in place:
+    private val buffer = ByteBuffer.allocateDirect(bufferLengthEntries * Short.SIZE_BYTES)
+        .order(ByteOrder.nativeOrder())
 
     private val bufferDataAvailable = Channel<Unit>(capacity = 0)
 
     private var entriesAvailable =
         0                // Total entries available in the buffer, capped at the buffer size.
-    private var entriesActuallyWrittenToFile = 0
-    private var entriesToBeWrittenToFile: Int? = null
+    // Long, as a long recording can exceed 4 GiB and needs an RF64 header:
+    private var entriesActuallyWrittenToFile = 0L
+    private var entriesToBeWrittenToFile: Long? = null
     private var nextWriteIndex = 0              // Next entry that will be written to buffer.
     private var nextReadIndex = 0               // Next entry that will be read for writing file.
     private var iso8601DateTime: String? = null
@@ -585,7 +687,7 @@ class FileWriter(
 
             entriesToBeWrittenToFile = if (isTriggered) {
                 // Calculate an end index based on the same reference point as the read index:
-                preTriggerEntriesAvailable + postTriggerEntries
+                (preTriggerEntriesAvailable + postTriggerEntries).toLong()
             } else {
                 // Indefinite:
                 null
@@ -594,7 +696,7 @@ class FileWriter(
 
 
         // Track how many entries to write to each file:
-        entriesActuallyWrittenToFile = 0
+        entriesActuallyWrittenToFile = 0L
 
         /*
         Log.d(
@@ -666,7 +768,7 @@ class FileWriter(
                         // I don't *think* this is necessary, but just in case we need it to consume the event:
                         val dummy = result.getOrNull()
 
-                        val currentlyRemainingEntries = maxOf(0, it - entriesActuallyWrittenToFile)
+                        val currentlyRemainingEntries = maxOf(0L, it - entriesActuallyWrittenToFile)
                         entriesToBeWrittenToFile =
                             it - currentlyRemainingEntries + postTriggerEntries
 
@@ -691,14 +793,14 @@ class FileWriter(
                 // Limit based on the maximum file size:
                 val spaceRemainingInFile = maxFileEntries - entriesActuallyWrittenToFile
                 if (entriesToWrite > spaceRemainingInFile) {
-                    entriesToWrite = spaceRemainingInFile
+                    entriesToWrite = spaceRemainingInFile.toInt()
                     finished = true
                 }
 
                 // Limit based on the number of entries we planned to write:
                 entriesToBeWrittenToFile?.let {
                     if (entriesActuallyWrittenToFile + entriesToWrite >= it) {
-                        entriesToWrite = it - entriesActuallyWrittenToFile
+                        entriesToWrite = (it - entriesActuallyWrittenToFile).toInt()
                         continuationFileNeeded = false
                         finished = true
                     }
@@ -924,19 +1026,20 @@ class FileWriter(
 
     private fun writePcm16LeToStream(
         output: OutputStream,
-        samples: ShortArray,
+        samples: ByteBuffer,
         offset: Int,
         length: Int
     ) {
-        require(offset >= 0 && length >= 0 && offset + length <= samples.size) {
-            "Invalid offset/length ($offset/$length) for the given sample array size of ${samples.size}"
+        val size = samples.capacity() / Short.SIZE_BYTES
+        require(offset >= 0 && length >= 0 && offset + length <= size) {
+            "Invalid offset/length ($offset/$length) for the given sample array size of $size"
         }
 
         val byteBuffer = ByteArray(length * 2)
 
         var j = 0
         for (i in offset until offset + length) {
-            val sample = samples[i].toInt()
+            val sample = samples.getShort(i * Short.SIZE_BYTES).toInt()
             byteBuffer[j++] = (sample and 0xFF).toByte()          // low byte (little endian)
             byteBuffer[j++] = ((sample shr 8) and 0xFF).toByte() // high byte
         }
@@ -944,82 +1047,6 @@ class FileWriter(
         output.write(byteBuffer, 0, byteBuffer.size)
     }
 
-    private fun createWavHeaderWithGuano(
-        dataEntries: Int,
-        sampleRate: Int,
-        bitsPerSample: Int,
-        guanoData: ByteArray,
-        channels: Int = 1,
-    ): ByteArray {
-        val byteRate = sampleRate * channels * bitsPerSample / 8
-        val blockAlign = channels * bitsPerSample / 8
-        val totalAudioLen = dataEntries * 2
-
-        val guanoChunkSize = guanoData.size
-        val guanoChunkTotalSize = 8 + guanoChunkSize
-
-        // Total = PCM data + standard header (36) + Guano chunk + data header (8)
-        val totalDataLen = totalAudioLen + 36 + guanoChunkTotalSize
-
-        44 + guanoChunkTotalSize  // 44 includes standard + fmt + data headers
-        val header = ByteArray(44 + guanoChunkTotalSize)
-
-        // --- RIFF Header ---
-        header[0] = 'R'.code.toByte()
-        header[1] = 'I'.code.toByte()
-        header[2] = 'F'.code.toByte()
-        header[3] = 'F'.code.toByte()
-        writeIntLE(header, 4, totalDataLen)
-        header[8] = 'W'.code.toByte()
-        header[9] = 'A'.code.toByte()
-        header[10] = 'V'.code.toByte()
-        header[11] = 'E'.code.toByte()
-
-        // --- fmt chunk (always 16 bytes for PCM) ---
-        header[12] = 'f'.code.toByte()
-        header[13] = 'm'.code.toByte()
-        header[14] = 't'.code.toByte()
-        header[15] = ' '.code.toByte()
-        writeIntLE(header, 16, 16) // Subchunk1Size
-        writeShortLE(header, 20, 1) // PCM format
-        writeShortLE(header, 22, channels.toShort())
-        writeIntLE(header, 24, sampleRate)
-        writeIntLE(header, 28, byteRate)
-        writeShortLE(header, 32, blockAlign.toShort())
-        writeShortLE(header, 34, bitsPerSample.toShort())
-
-        var offset = 36
-
-        header[offset] = 'g'.code.toByte()
-        header[offset + 1] = 'u'.code.toByte()
-        header[offset + 2] = 'a'.code.toByte()
-        header[offset + 3] = 'n'.code.toByte()
-        writeIntLE(header, offset + 4, guanoChunkSize)
-        System.arraycopy(guanoData, 0, header, offset + 8, guanoChunkSize)
-        offset += 8 + guanoChunkSize
-
-        // --- data chunk (must come after Guano) ---
-        header[offset] = 'd'.code.toByte()
-        header[offset + 1] = 'a'.code.toByte()
-        header[offset + 2] = 't'.code.toByte()
-        header[offset + 3] = 'a'.code.toByte()
-        writeIntLE(header, offset + 4, totalAudioLen)
-
-        return header
-    }
-
-    private fun writeIntLE(buffer: ByteArray, offset: Int, value: Int) {
-        buffer[offset] = (value and 0xff).toByte()
-        buffer[offset + 1] = ((value shr 8) and 0xff).toByte()
-        buffer[offset + 2] = ((value shr 16) and 0xff).toByte()
-        buffer[offset + 3] = ((value shr 24) and 0xff).toByte()
-    }
-
-    private fun writeShortLE(buffer: ByteArray, offset: Int, value: Short) {
-        buffer[offset] = (value.toInt() and 0xff).toByte()
-        buffer[offset + 1] = ((value.toInt() shr 8) and 0xff).toByte()
-    }
-
     private fun addAndWrap(value: Int, delta: Int, modulus: Int): Int {
         var result = value + delta
         if (result >= modulus)
@@ -43,6 +43,7 @@ import kotlinx.coroutines.Dispatchers
 import kotlinx.coroutines.Job
 import kotlinx.coroutines.channels.Channel
 import kotlinx.coroutines.coroutineScope
+import kotlinx.coroutines.delay
 import kotlinx.coroutines.flow.Flow
 import kotlinx.coroutines.flow.MutableStateFlow
 import kotlinx.coroutines.flow.StateFlow
@@ -57,12 +58,15 @@ import org.batgizmo.app.pipeline.AbstractPipeline
 import org.batgizmo.app.pipeline.ColourMapStep
 import org.batgizmo.app.pipeline.FileViewerPipeline
 import org.batgizmo.app.pipeline.LiveUSBPipeline
+import org.batgizmo.app.pipeline.TransformCache
+import org.batgizmo.app.pipeline.TransformStep
 import org.batgizmo.app.pipeline.UsbService
 import org.batgizmo.app.ui.GraphBase
 import org.batgizmo.app.ui.SpectrogramUI
 import org.batgizmo.app.ui.TopLevelUI
 import org.batgizmo.app.ui.TopLevelUI.AppMode
 import uk.org.gimell.batgimzoapp.BuildConfig
+import java.util.concurrent.atomic.AtomicInteger
 import java.util.concurrent.atomic.AtomicReference
 import kotlin.math.abs
 
@@ -86,10 +90,16 @@ object LiveDataBridge {
     data class BufferDescriptor(val nativeAddress: Long, val samples: Int)
 
     // Provide finite capacity for buffering and decoupling.
-    // Should probably match the URBS_TO_JUGGLE in the native layer.
+    // Should probably match the URBS_TO_JUGGLE in the native layer, and must match its
+    // RENDERING_CHANNEL_CAPACITY, which sizes the synthetic stream's buffers and back-pressure.
     val renderingChannel = Channel<BufferDescriptor>(capacity = 10)
     val fileWriterChannel = Channel<BufferDescriptor>(capacity = 10)
 
+    // Buffers waiting in renderingChannel, and those dropped because it was full, which
+    // the quality governor uses to detect that rendering isn't keeping up:
+    val renderingBacklog = AtomicInteger(0)
+    val renderingDropped = AtomicInteger(0)
+
     /**
      * This method is called from the native layer in thread it uses for data
      * acquisition, which is originally created and therefore owned by kotlin.
@@ -103,7 +113,10 @@ object LiveDataBridge {
         // This is the synchronous method for send an event in a channel.
         // It may fail, for example, if the channel is full, which is OK.
 
-        renderingChannel.trySend(BufferDescriptor(nativeAddress, samples))
+        if (renderingChannel.trySend(BufferDescriptor(nativeAddress, samples)).isSuccess)
+            renderingBacklog.incrementAndGet()
+        else
+            renderingDropped.incrementAndGet()
         fileWriterChannel.trySend(BufferDescriptor(nativeAddress, samples))
     }
 }
@@ -258,6 +271,10 @@ class UIModel(application: Application,
     private val mutableDetailsTextFlow = MutableStateFlow<String?>(null)
     val detailsTextFlow: StateFlow<String?> = mutableDetailsTextFlow.asStateFlow()
 
+    // The live quality level, 0 for full quality, for display:
+    private val mutableQualityLevelFlow = MutableStateFlow(0)
+    val qualityLevelFlow: StateFlow<Int> = mutableQualityLevelFlow.asStateFlow()
+
     var colourMapSize: Int? = null
 
     // Used to notify back to the UI that an attempt at opening a file
@@ -285,6 +302,9 @@ class UIModel(application: Application,
     private var amplitudeSizeDp: DpSize? = null
     private var sizeGeneration =
         -1          // Track the UI Compose generation that sizes relate to.
+    // A UI generation that followed a configuration change, such as a rotation, with the
+    // pipeline already rendered. Size changes in that generation only redo the display:
+    private var displayOnlyGeneration = -1
 
     // Single global instance of the bitmap holder we will use for rendering the
     // spectrogram and amplitude:
@@ -341,6 +361,9 @@ class UIModel(application: Application,
     // pipeline potentially treading on the heels of the previous one@
     var pipelineCloseJob: Job? = null
 
+    // Transforms for neighbouring zoom levels, done while the user is idle:
+    private var precomputeJob: Job? = null
+
 
     // Location things:
     private val locationMutableFlow = MutableStateFlow<Location?>(null)
@@ -404,6 +427,9 @@ class UIModel(application: Application,
         val rc = nativeInitialize(colourMap, mapRows.size, amplitudeGraphColour)
         check(rc == 0) { "native layer initialization must succeed" }
 
+        // Use the transform plans previously tuned for this device, if any:
+        TransformStep.initFftWisdom(application)
+
         /**
          * Get the preference values from storage asynchronously. When the values arrive, they
          * will overwrite the default settings values. If the value is not present in storage,
@@ -493,7 +519,7 @@ class UIModel(application: Application,
 
                     val wfr = WavFileReader(context)
                     wavFileReader = wfr
-                    val wfi: WavFileReader.WavFileInfo = wfr.open(uri, filename)
+                    val wfi: WavFileReader.WavFileInfo = wfr.open(uri, filename, settings.fileChannel)
 
                     // Reset these directly before the first pipeline rendering:
                     mutableTimeVisibleRangeFlow.value = defaultTimeVisibleRange
@@ -518,7 +544,8 @@ class UIModel(application: Application,
                     // Do a full render from file:
                     p.fullExecute(
                         fftParameters = fftParameters,
-                        amplitudeSizeDp = amplitudeSizeDp
+                        amplitudeSizeDp = amplitudeSizeDp,
+                        spectrogramSizeDp = spectrogramSizeDp
                     )
 
                     pipeline = p
@@ -629,7 +656,7 @@ class UIModel(application: Application,
                             spectrogramBitmapHolder, amplitudeBitmapHolder,
                             mutableTimeAxisRangeFlow, mutableFrequencyAxisRangeFlow,
                             mutableDetailsTextFlow, result.sampleRate,
-                            result.sampleRate * settings.dataPageIntervalS
+                            result.sampleRate.toLong() * settings.dataPageIntervalS
                         ) {
                             // This lambda is called if a trigger was detected in the live data.
 
@@ -639,6 +666,9 @@ class UIModel(application: Application,
                             triggerMonitorChannel.trySend(Unit)
                         }
 
+                        // The pipeline starts the quality governor at full quality:
+                        mutableQualityLevelFlow.value = 0
+
                         // Initial values for the FFT parameters (window, overlap):
                         val defaultSize = DpSize(100.dp, 100.dp) // Square by default.
                         Log.d(logTag, "spectrogramSizeDp = $spectrogramSizeDp in openLive()")
@@ -651,7 +681,8 @@ class UIModel(application: Application,
                         p.fullExecute(
                             fftParameters = fftParameters,
                             amplitudeSizeDp = amplitudeSizeDp,
-                            doRender = false
+                            doRender = false,
+                            spectrogramSizeDp = spectrogramSizeDp
                         )
 
                         pipeline = p
@@ -929,7 +960,7 @@ class UIModel(application: Application,
      *
      * The visible data range has changed, so reload to take that into account.
      */
-    fun onVisibleRangeChange(settings: Settings, shouldAutoBnC: Boolean, rawPageRange: HORange?) {
+    fun onVisibleRangeChange(settings: Settings, shouldAutoBnC: Boolean, rawPageRange: LongHORange?) {
         // Heavy calculations to CPU worker thread:
         viewModelScope.launch(Dispatchers.Default + CoroutineName("onRescale coroutine")) {
             mutex.withLock {
@@ -938,6 +969,21 @@ class UIModel(application: Application,
         }
     }
 
+    /**
+     * Called from the live data thread when the quality governor changes level.
+     *
+     * Reload asynchronously: the reload rebuilds the pipeline, which waits for the
+     * calling thread to finish.
+     */
+    fun onQualityLevelChange(level: Int) {
+        mutableQualityLevelFlow.value = level
+        viewModelScope.launch(Dispatchers.Default + CoroutineName("onQualityLevelChange coroutine")) {
+            mutex.withLock {
+                reload(settings, null, autoBnCRequiredFlow.value)
+            }
+        }
+    }
+
     /**
      * Call from the UI thread.
      *
@@ -947,7 +993,7 @@ class UIModel(application: Application,
      * This method is called from the UI so heavy calculations are offloaded to
      * another thread.
      */
-    fun onSettingsUpdate(settings: Settings, previousSettings: Settings?, rawPageRange: HORange?) {
+    fun onSettingsUpdate(settings: Settings, previousSettings: Settings?, rawPageRange: LongHORange?) {
         viewModelScope.launch(CoroutineName("onSettingsUpdate coroutine")) {
             mutex.withLock {
                 if (BuildConfig.DEBUG)
@@ -983,7 +1029,7 @@ class UIModel(application: Application,
     suspend fun onUISizeChange(
         generation: Int, spectrogramSizeDp: DpSize?,
         amplitudeSizeDp: DpSize?, settings: Settings,
-        rawPageRange: HORange?
+        rawPageRange: LongHORange?
     ) {
         mutex.withLock {
             if (BuildConfig.DEBUG)
@@ -992,6 +1038,10 @@ class UIModel(application: Application,
             // If we are on to a new UI generation, reset the cached sizes to avoid using stale data
             // or mixing sizes between generations:
             if (generation != sizeGeneration) {
+                // The pipeline, its buffers and the bitmaps belong to this model, so survive
+                // the Activity being recreated. The new UI just needs to show them:
+                if (this.spectrogramSizeDp != null && pipeline != null)
+                    displayOnlyGeneration = generation
                 sizeGeneration = generation
                 this.spectrogramSizeDp = null
                 this.amplitudeSizeDp = null
@@ -1016,9 +1066,14 @@ class UIModel(application: Application,
                         logTag,
                         "onUISizeChange applying UI size: $generation ${this.spectrogramSizeDp}, ${this.amplitudeSizeDp}"
                     )
+                val displayOnly = generation == displayOnlyGeneration
                 viewModelScope.launch(Dispatchers.Default + CoroutineName("onRescale coroutine")) {
                     mutex.withLock {
-                        reload(settings, rawPageRange, autoBnCRequiredFlow.value)
+                        reload(
+                            settings, rawPageRange,
+                            autoBnCRequiredFlow.value && !displayOnly,
+                            keepFftParameters = displayOnly
+                        )
                     }
                 }
             }
@@ -1031,7 +1086,7 @@ class UIModel(application: Application,
      * The method is called from the UI to change the region of the source file
      * this is transformed (the page).
      */
-    fun onPageChange(settings: Settings, rawPageRange: HORange) {
+    fun onPageChange(settings: Settings, rawPageRange: LongHORange) {
         if (BuildConfig.DEBUG)
             Log.d(logTag, "onPageChange called: $rawPageRange")
         pipeline?.let {
@@ -1041,7 +1096,8 @@ class UIModel(application: Application,
                         settings,
                         rawPageRange,
                         autoBnCRequiredFlow.value,
-                        resetVisibleRange = true
+                        resetVisibleRange = true,
+                        pageChanged = true
                     )
                 }
             }
@@ -1054,15 +1110,19 @@ class UIModel(application: Application,
      */
     private suspend fun reload(
         settings: Settings,
-        rawPageRange: HORange?,
+        rawPageRange: LongHORange?,
         shouldAutoBnC: Boolean,
-        resetVisibleRange: Boolean = false
+        resetVisibleRange: Boolean = false,
+        pageChanged: Boolean = false,
+        keepFftParameters: Boolean = false
     ) {
         pipeline?.let { p ->
             if (BuildConfig.DEBUG)
                 Log.d(logTag, "reload called for rawPageRange = ${rawPageRange}")
 
-            val newFftParameters = getFftParameters(settings)
+            // Keeping the FFT parameters leaves the transformed data as it is. Any better
+            // parameters for the new layout are precomputed, ready for the next change of view:
+            val newFftParameters = if (keepFftParameters) null else getFftParameters(settings)
             var fftParametersChanged = false
             newFftParameters?.let { fftp ->
                 fftParametersChanged = shouldRenderForFft(fftp)
@@ -1071,21 +1131,55 @@ class UIModel(application: Application,
                 currentFftParameters = fftp
             }
 
-            if (fftParametersChanged) {
+            // A page change with the same FFT parameters only renders the columns it uncovers:
+            if (fftParametersChanged || pageChanged) {
                 p.fullExecute(
                     fftParameters = currentFftParameters,
                     rawPageRange = rawPageRange,
-                    amplitudeSizeDp = amplitudeSizeDp
+                    amplitudeSizeDp = amplitudeSizeDp,
+                    spectrogramSizeDp = spectrogramSizeDp
                 )
             }
 
             if (resetVisibleRange)
                 internalSetSpectrogramVisibleRange(FloatRange(0f, 1f), FloatRange(0f, 1f))
 
+            // The spectrogram's rows depend on the visible frequency range, so a frequency
+            // zoom alone may need them pooling differently:
+            p.refitSpectrogramRows(spectrogramSizeDp)
+
             if (shouldAutoBnC) {
                 doAutoBnC(p)
             } else
                 internalRerender()
+
+            schedulePrecompute(settings)
+        }
+    }
+
+    /**
+     * Once the view has been left alone for a moment, precompute the transforms for the zoom
+     * levels either side of the current one, so that zooming to them is a cache hit. Any
+     * precompute already scheduled or running is cancelled.
+     */
+    private fun schedulePrecompute(settings: Settings) {
+        precomputeJob?.cancel()
+        val p = pipeline ?: return
+        precomputeJob = viewModelScope.launch(Dispatchers.Default + CoroutineName("precompute coroutine")) {
+            delay(TransformCache.PRECOMPUTE_IDLE_MS)
+
+            val xAxisSpan = timeAxisRangeFlow.value.difference()
+            val yAxisSpan = frequencyAxisRangeFlow.value.difference()
+
+            // The parameters for the view as it is, if they have been kept from an earlier
+            // layout, then the nearest different ones zooming in, then zooming out:
+            for (zoomFactors in listOf(listOf(1f), listOf(0.5f, 0.25f), listOf(2f, 4f))) {
+                val fftParameters = zoomFactors.firstNotNullOfOrNull { factor ->
+                    calculateFftParameters(xAxisSpan * factor, yAxisSpan, null, settings)
+                        ?.takeIf { it != currentFftParameters }
+                }
+                fftParameters?.let { p.precompute(it) }
+            }
         }
     }
 
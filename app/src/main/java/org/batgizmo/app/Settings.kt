@@ -33,14 +33,24 @@ data class Settings(
     var amplitudePaneVisibility: Int = VisibilityOptions.AUTO.value,
     var showGrid: Boolean = true,
     var dataPageIntervalS: Int = DataBufferIntervalOptions.DATABUFFER_5S.value,
+    var memoryBudgetMb: Int = MemoryBudgetOptions.MEMORY_BUDGET_256MB.value,
     var pageOverlapPercent: Int = PagingOverlapOptions.PAGINGOVERLAP_25.value,
+    var fileChannel: Int = FileChannelOptions.FILECHANNEL_MIX.value,
     var fftOverlapPercent: Int = FftOverlapOptions.OVERLAP_AUTO75.value,
     var autoBnCEnabledViewer: Boolean = true,
     var autoBnCEnabledLive: Boolean = false,
     var nFft: Int = NFftOptions.NFFT_AUTO.value,
+    var adaptiveQuality: Boolean = true,
+    var scrollingLive: Boolean = true,
+    var nativeDisplay: Boolean = false,
     var showParameterOverlay: Boolean = true,
     var leftHandButtons: Boolean = true,
     var enableLogging: Boolean = false,
+    var captureURBs: Boolean = false,
+    var showLatencyOverlay: Boolean = false,
+    var syntheticSampleRate: Int = SyntheticSourceOptions.SYNTHETIC_OFF.value,
+    var syntheticCallsPerSecond: Int = SyntheticDensityOptions.SYNTHETIC_DENSITY_20.value,
+    var syntheticSpeed: Int = SyntheticSpeedOptions.SYNTHETIC_SPEED_1.value,
     var heterodyneDual: Boolean = false,
     var heterodyneRef1kHz: Int = 50,
     var heterodyneRef2kHz: Int = 83,
@@ -106,6 +116,18 @@ data class Settings(
         override fun theLabel(): String = label
     }
 
+    // The limit on native memory for the pipeline buffers, see NativeArena:
+    enum class MemoryBudgetOptions(val value: Int, val label: String) : EnumHelper {
+        MEMORY_BUDGET_64MB(64, "64 MB"),
+        MEMORY_BUDGET_128MB(128, "128 MB"),
+        MEMORY_BUDGET_256MB(256, "256 MB"),
+        MEMORY_BUDGET_512MB(512, "512 MB"),
+        MEMORY_BUDGET_1024MB(1024, "1 GB");
+
+        override fun theValue(): Int = value
+        override fun theLabel(): String = label
+    }
+
     enum class PagingOverlapOptions(val value: Int, val label: String) : EnumHelper {
         PAGINGOVERLAP_0(0, "0%"),
         PAGINGOVERLAP_10(10, "10%"),
@@ -116,6 +138,22 @@ data class Settings(
         override fun theLabel(): String = label
     }
 
+    // The value is the zero based channel to view in multichannel files, or -1 to mix them:
+    enum class FileChannelOptions(val value: Int, val label: String) : EnumHelper {
+        FILECHANNEL_MIX(-1, "Mix"),
+        FILECHANNEL_1(0, "1 (left)"),
+        FILECHANNEL_2(1, "2 (right)"),
+        FILECHANNEL_3(2, "3"),
+        FILECHANNEL_4(3, "4"),
+        FILECHANNEL_5(4, "5"),
+        FILECHANNEL_6(5, "6"),
+        FILECHANNEL_7(6, "7"),
+        FILECHANNEL_8(7, "8");
+
+        override fun theValue(): Int = value
+        override fun theLabel(): String = label
+    }
+
     // The value is the shift required to achieve the factor:
     enum class AudioBoostOptions(val value: Int, val label: String) : EnumHelper {
         AUDIOBOOST_NONE(0, "none"),
@@ -174,6 +212,40 @@ data class Settings(
         override fun theValue(): Int = value
         override fun theLabel(): String = label    }
 
+    // The value is the sample rate of synthetic data to stream in place of a microphone, for
+    // load testing, or 0 to use the microphone:
+    enum class SyntheticSourceOptions(val value: Int, val label: String) : EnumHelper {
+        SYNTHETIC_OFF(0, "off"),
+        SYNTHETIC_256K(256000, "256 kHz"),
+        SYNTHETIC_384K(384000, "384 kHz"),
+        SYNTHETIC_500K(500000, "500 kHz"),
+        SYNTHETIC_768K(768000, "768 kHz");
+
+        override fun theValue(): Int = value
+        override fun theLabel(): String = label
+    }
+
+    enum class SyntheticDensityOptions(val value: Int, val label: String) : EnumHelper {
+        SYNTHETIC_DENSITY_5(5, "5/s"),
+        SYNTHETIC_DENSITY_20(20, "20/s"),
+        SYNTHETIC_DENSITY_100(100, "100/s"),
+        SYNTHETIC_DENSITY_500(500, "500/s");
+
+        override fun theValue(): Int = value
+        override fun theLabel(): String = label
+    }
+
+    // The value is the multiple of real time, or 0 for as fast as possible:
+    enum class SyntheticSpeedOptions(val value: Int, val label: String) : EnumHelper {
+        SYNTHETIC_SPEED_1(1, "real time"),
+        SYNTHETIC_SPEED_2(2, "2x"),
+        SYNTHETIC_SPEED_4(4, "4x"),
+        SYNTHETIC_SPEED_MAX(0, "max");
+
+        override fun theValue(): Int = value
+        override fun theLabel(): String = label
+    }
+
     companion object {
         /**
          * Coerce the FFT window size provided to the range supported.
@@ -194,12 +266,22 @@ data class Settings(
     private val keyAutoBnCViewer = booleanPreferencesKey("autoBnCViewer")
     private val keyAutoBnCLive = booleanPreferencesKey("autoBnCLive")
     private val keyNFft = intPreferencesKey("nFft")
+    private val keyAdaptiveQuality = booleanPreferencesKey("adaptiveQuality")
+    private val keyScrollingLive = booleanPreferencesKey("scrollingLive")
+    private val keyNativeDisplay = booleanPreferencesKey("nativeDisplay")
     private val keyShowParameterOverlay = booleanPreferencesKey("showParameterOverlay")
     private val keyFftOverlapPercent = intPreferencesKey("fftOverlapPercent")
     private val keyDataBufferIntervalS = intPreferencesKey("keyDataBufferIntervalS")
+    private val keyMemoryBudgetMb = intPreferencesKey("memoryBudgetMb")
     private val keyPageOverlapPercent = intPreferencesKey("keyPageOverlapPercent")
+    private val keyFileChannel = intPreferencesKey("fileChannel")
     private val keyLeftHandedMode = booleanPreferencesKey("keyLeftHandedMode")
     private val keyEnableLogging = booleanPreferencesKey("enableLogging")
+    private val keyCaptureURBs = booleanPreferencesKey("captureURBs")
+    private val keyShowLatencyOverlay = booleanPreferencesKey("showLatencyOverlay")
+    private val keySyntheticSampleRate = intPreferencesKey("syntheticSampleRate")
+    private val keySyntheticCallsPerSecond = intPreferencesKey("syntheticCallsPerSecond")
+    private val keySyntheticSpeed = intPreferencesKey("syntheticSpeed")
     private val keyAudioRef1kHz = intPreferencesKey("audioRef1kHz")
     private val keyAudioRef2kHz = intPreferencesKey("audioRef2kHz")
     private val keyAudioDualHeterodyne = booleanPreferencesKey("audioDualHeterodyne")
@@ -222,11 +304,21 @@ data class Settings(
         prefs[keyAutoBnCViewer] = autoBnCEnabledViewer
         prefs[keyAutoBnCLive] = autoBnCEnabledLive
         prefs[keyNFft] = nFft
+        prefs[keyAdaptiveQuality] = adaptiveQuality
+        prefs[keyScrollingLive] = scrollingLive
+        prefs[keyNativeDisplay] = nativeDisplay
         prefs[keyFftOverlapPercent] = fftOverlapPercent
         prefs[keyDataBufferIntervalS] = dataPageIntervalS
+        prefs[keyMemoryBudgetMb] = memoryBudgetMb
         prefs[keyPageOverlapPercent] = pageOverlapPercent
+        prefs[keyFileChannel] = fileChannel
         prefs[keyLeftHandedMode] = leftHandButtons
         prefs[keyEnableLogging] = enableLogging
+        prefs[keyCaptureURBs] = captureURBs
+        prefs[keyShowLatencyOverlay] = showLatencyOverlay
+        prefs[keySyntheticSampleRate] = syntheticSampleRate
+        prefs[keySyntheticCallsPerSecond] = syntheticCallsPerSecond
+        prefs[keySyntheticSpeed] = syntheticSpeed
         prefs[keyAudioDualHeterodyne] = heterodyneDual
         prefs[keyAudioRef1kHz] = heterodyneRef1kHz
         prefs[keyAudioRef2kHz] = heterodyneRef2kHz
@@ -255,16 +347,36 @@ data class Settings(
             autoBnCEnabledLive = requireNotNull(prefs[keyAutoBnCLive])
         if (prefs[keyNFft] != null)
             nFft = requireNotNull(prefs[keyNFft])
+        if (prefs[keyAdaptiveQuality] != null)
+            adaptiveQuality = requireNotNull(prefs[keyAdaptiveQuality])
+        if (prefs[keyScrollingLive] != null)
+            scrollingLive = requireNotNull(prefs[keyScrollingLive])
+        if (prefs[keyNativeDisplay] != null)
+            nativeDisplay = requireNotNull(prefs[keyNativeDisplay])
         if (prefs[keyFftOverlapPercent] != null)
             fftOverlapPercent = requireNotNull(prefs[keyFftOverlapPercent])
         if (prefs[keyDataBufferIntervalS] != null)
             dataPageIntervalS = requireNotNull(prefs[keyDataBufferIntervalS])
+        if (prefs[keyMemoryBudgetMb] != null)
+            memoryBudgetMb = requireNotNull(prefs[keyMemoryBudgetMb])
         if (prefs[keyPageOverlapPercent] != null)
             pageOverlapPercent = requireNotNull(prefs[keyPageOverlapPercent])
+        if (prefs[keyFileChannel] != null)
+            fileChannel = requireNotNull(prefs[keyFileChannel])
         if (prefs[keyLeftHandedMode] != null)
             leftHandButtons = requireNotNull(prefs[keyLeftHandedMode])
         if (prefs[keyEnableLogging] != null)
             enableLogging = requireNotNull(prefs[keyEnableLogging])
+        if (prefs[keyCaptureURBs] != null)
+            captureURBs = requireNotNull(prefs[keyCaptureURBs])
+        if (prefs[keyShowLatencyOverlay] != null)
+            showLatencyOverlay = requireNotNull(prefs[keyShowLatencyOverlay])
+        if (prefs[keySyntheticSampleRate] != null)
+            syntheticSampleRate = requireNotNull(prefs[keySyntheticSampleRate])
+        if (prefs[keySyntheticCallsPerSecond] != null)
+            syntheticCallsPerSecond = requireNotNull(prefs[keySyntheticCallsPerSecond])
+        if (prefs[keySyntheticSpeed] != null)
+            syntheticSpeed = requireNotNull(prefs[keySyntheticSpeed])
         if (prefs[keyAudioDualHeterodyne] != null)
             heterodyneDual = requireNotNull(prefs[keyAudioDualHeterodyne])
         if (prefs[keyAudioRef1kHz] != null)
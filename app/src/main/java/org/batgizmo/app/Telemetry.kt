@@ -0,0 +1,109 @@
+/*
+ * Copyright (c) 2025 John Mears
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+package org.batgizmo.app
+
+import java.util.Locale
+
+/**
+ * Access to the native per stage latency telemetry, which a debug overlay can show.
+ * See core/telemetry.h.
+ */
+class Telemetry {
+    // Keep in step with telemetry_stage in the native code:
+    enum class Stage(val value: Int, val label: String) {
+        REAP(0, "reap"),
+        CHANNEL(1, "channel"),
+        COPY(2, "copy"),
+        UNWRAP(3, "unwrap"),
+        FFT(4, "fft"),
+        DB(5, "dB"),
+        COLOUR_MAP(6, "colour map"),
+        BITMAP_UNLOCK(7, "unlock"),
+        DRAW(8, "draw")
+    }
+
+    data class StageStats(
+        val stage: Stage,
+        val count: Long,
+        val p50Ns: Long,
+        val p99Ns: Long,
+        val maxNs: Long
+    )
+
+    companion object {
+        /**
+         * Whether telemetry is being collected, so that kotlin code can avoid the cost of
+         * timing when it isn't.
+         */
+        @Volatile
+        var enabled = false
+            private set
+
+        private external fun enableNative(enabled: Boolean)
+
+        /**
+         * Add a duration measured in kotlin to the histogram for a stage.
+         */
+        private external fun record(stage: Int, durationNs: Long)
+
+        /**
+         * Clear the histograms.
+         */
+        external fun reset()
+
+        /**
+         * The count, p50, p99 and maximum in ns for each stage in turn.
+         */
+        private external fun snapshot(): LongArray?
+
+        fun enable(enable: Boolean) {
+            enabled = enable
+            enableNative(enable)
+        }
+
+        fun record(stage: Stage, durationNs: Long) {
+            if (enabled)
+                record(stage.value, durationNs)
+        }
+
+        fun stats(): List<StageStats> {
+            val values = snapshot() ?: return emptyList()
+            return Stage.entries.filter { it.value * 4 + 3 < values.size }.map {
+                val i = it.value * 4
+                StageStats(it, values[i], values[i + 1], values[i + 2], values[i + 3])
+            }
+        }
+
+        /**
+         * One line per stage that has been seen, with p50 and p99 in ms.
+         */
+        fun statsText(): String {
+            return stats().filter { it.count > 0 }.joinToString("\n") {
+                String.format(
+                    Locale.US, "%-10s p50 %7.2f  p99 %7.2f ms",
+                    it.stage.label, it.p50Ns / 1e6, it.p99Ns / 1e6
+                )
+            }
+        }
+    }
+}
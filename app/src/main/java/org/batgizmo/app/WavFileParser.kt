@@ -33,20 +33,25 @@ class WavFileException(message: String) : Exception(message)
 /**
  *  See http://soundfile.sapp.org/doc/WaveFormat/
  *  See https://github.com/riggsd/guano-spec/blob/master/guano_specification.md
+ *  See EBU Tech 3306 (RF64) and ITU-R BS.2088 (BW64) for files larger than 4 GB.
  */
-class WavFileParser {
+class WavFileParser(
+    // The channel to read from multichannel files, or CHANNEL_DOWNMIX to average them.
+    private val channel: Int = CHANNEL_DOWNMIX
+) {
 
     // Interesting things extracted form the "wav " chunk.
     data class FmtChunkInfo(
         val numChannels: Short,
         val sampleRateHz: Int,
-        val bitsPerSample: Short
+        val bitsPerSample: Short,
+        val sampleFormat: Int = SAMPLE_INT16    // One of the SAMPLE_ values below.
     )
 
     data class DataChunkInfo(
-        val actualSampleCount: Int = 0,
+        val actualSampleCount: Long = 0,
         val dataRange: Pair<Short, Short> = Pair(Short.MIN_VALUE, Short.MAX_VALUE),
-        val dataByteCount: Int = 0
+        val dataByteCount: Long = 0
     )
 
     data class GuanoEntry(val key: String, val value: String)
@@ -64,9 +69,43 @@ class WavFileParser {
     )
 
     private var startOfData: Long? = null           // Offset to the start of the data chunk.
+    private var ds64DataSize: Long? = null          // The 64 bit data chunk size from an RF64/BW64 ds64 chunk.
+
+    // Reused between reads of raw file data to avoid garbage:
+    private var readBuffer = ByteArray(0)
+
+    companion object {
+        // 32 bit chunk sizes set to this value in RF64/BW64 files mean "see the ds64 chunk":
+        const val RF64_SIZE_PLACEHOLDER = 0xFFFFFFFFL
+
+        // Sample formats, which must match wav_sample_format in wavdecode.h:
+        const val SAMPLE_INT16 = 0
+        const val SAMPLE_INT24 = 1
+        const val SAMPLE_INT32 = 2
+        const val SAMPLE_FLOAT32 = 3
+
+        const val CHANNEL_DOWNMIX = -1
+        const val MAX_CHANNELS = 8
+
+        private const val FORMAT_PCM: Short = 1
+        private const val FORMAT_IEEE_FLOAT: Short = 3
+        private const val FORMAT_EXTENSIBLE: Short = -2     // 0xFFFE
+
+        /**
+         * Decode interleaved wav data of any supported format into one 16 bit value per
+         * frame, selecting or downmixing channels as we go. The target is a direct buffer
+         * in native byte order, and targetOffset is in samples. Returns the number of frames
+         * decoded, or -1 on failure.
+         */
+        external fun decodeSamples(
+            source: ByteArray, frames: Int, channels: Int, format: Int, channel: Int,
+            target: ByteBuffer, targetOffset: Int
+        ): Int
+    }
 
     private fun reset() {
         startOfData = 0
+        ds64DataSize = null
     }
 
     /**
@@ -82,8 +121,14 @@ class WavFileParser {
         // Find the actual file length:
         val fileLength = raFile.length()
 
-        readTextBytes(raFile, filename, 4, "ChunkID", "RIFF")
-        readInt32(raFile, filename, "ChunkSize") // Sometimes off by 8. No idea.
+        // RF64 and BW64 are identical for our purposes: a RIFF file with 64 bit sizes in a ds64 chunk.
+        val chunkId = readTextBytes(raFile, filename, 4, "ChunkID")
+        if (chunkId != "RIFF" && chunkId != "RF64" && chunkId != "BW64") {
+            throw WavFileException(
+                "Unexpected value for ChunkID in $filename: found $chunkId, expected RIFF, RF64 or BW64."
+            )
+        }
+        readUInt32(raFile, filename, "ChunkSize") // Sometimes off by 8. No idea.
         readTextBytes(raFile, filename, 4, "Format", "WAVE")
 
         /**
@@ -92,7 +137,9 @@ class WavFileParser {
          */
         while (raFile.filePointer < fileLength) {
             val subChunkId = readTextBytes(raFile, filename, 4, "SubchunkID")
-            if (subChunkId == "fmt ") {        // Note: the space is important.
+            if (subChunkId == "ds64") {
+                readDs64Chunk(raFile, filename)
+            } else if (subChunkId == "fmt ") {        // Note: the space is important.
                 if (fmtChunk != null)
                     Log.i(this::class.simpleName, "Ignoring extra fmt chunk")
                 else
@@ -136,6 +183,9 @@ class WavFileParser {
          *  https://github.com/riggsd/guano-py/blob/master/guano.py
          */
         val chunkSizeBytes = readInt32(raFile, filename, "ChunkSize")
+        checkValue(filename, "guan ChunkSize", chunkSizeBytes, "must be >= 0") { v: Int ->
+            v >= 0
+        }
         val byteArray = ByteArray(chunkSizeBytes)
         raFile.readFully(byteArray)
         val guanoString = String(byteArray, Charsets.UTF_8)
@@ -173,21 +223,29 @@ class WavFileParser {
     /**
      * Read value values according to the half open range provided.
      * Write the data to the buffer supplied, and the number of samples actually read.
-     * The caller guarantees the buffer is big enough.
+     * The caller guarantees the buffer is big enough. It must be a direct buffer, such as
+     * those from NativeArena, and bufferOffset is in samples.
+     *
+     * The range is in 64 bit sample indexes so that any part of a large file can be reached
+     * with a single seek.
+     *
+     * Whatever the format and number of channels in the file, one 16 bit value is written
+     * per sample: the conversion and channel selection or downmix are done natively.
      */
     fun readData(
         raFile: RandomAccessFile,
         fmtChunk: FmtChunkInfo,
-        range: HORange,
-        dataBuffer: ShortArray,
+        range: LongHORange,
+        dataBuffer: ByteBuffer,
         bufferOffset: Int = 0
     ): Int {
         val bytesPerValue = (fmtChunk.bitsPerSample / 8).toInt()
         val bytesPerSample = bytesPerValue * fmtChunk.numChannels
 
         val (start, end) = range
-        val sampleCount = end - start
-        val valueCount = sampleCount * fmtChunk.numChannels
+        // The caller's buffer bounds how many samples can be requested, so this fits in an Int:
+        val sampleCount = (end - start).toInt()
+        val byteCount = sampleCount * bytesPerSample
 
         // Seek to the data we are interested in:
         check(startOfData != null)
@@ -201,37 +259,32 @@ class WavFileParser {
          * amount of data in the file.
          */
 
-        val byteArray = ByteArray(valueCount * 2)
-        try {
-            // Throws EOFException when we hit the end of the file. This is intentional
-            // to read the number of bytes we want.
-            raFile.readFully(byteArray)
-        } catch (e: EOFException) {
-            // If we hit EOF we'll return fewer data values than expect, either
-            // on this call or the next one.
+        if (readBuffer.size < byteCount) {
+            readBuffer = ByteArray(byteCount)
+        }
+        val byteArray = readBuffer
+        var bytesRead = 0
+        while (bytesRead < byteCount) {
+            val count = raFile.read(byteArray, bytesRead, byteCount - bytesRead)
+            if (count < 0) {
+                // If we hit EOF we'll return fewer data values than expect, either
+                // on this call or the next one.
+                break
+            }
+            bytesRead += count
         }
 
-        val actualValuesRead = (byteArray.size / 2).toInt()
-        // This will be different from actualValuesRead when we do channels != 1:
-        val actualSamplesRead = actualValuesRead
-        // TODO: check this endianism:
-        // Access the ByteArray as a Buffer:
-        val byteBuffer = ByteBuffer.wrap(byteArray).order(ByteOrder.LITTLE_ENDIAN)
-        // Create a ShortArray of the right size:
-        // val shortArray = ShortArray(actualValuesRead)
-        // Populate the shortArray using a bulk get for efficiency:
-        byteBuffer.asShortBuffer().get(dataBuffer, bufferOffset, valueCount)
+        // Ignore any trailing partial sample:
+        val actualSamplesRead = bytesRead / bytesPerSample
 
-        /*
-        // TODO support for multiple channels.
-        if (fmtChunk.numChannels > 1) {
-            /*
-                if self._fmt_header.num_channels > 1:
-                    actual_samples_read = int(actual_values_read / self._fmt_header.num_channels)
-                    data = data.reshape((actual_samples_read, self._fmt_header.num_channels))
-             */
+        // Tolerate a channel setting beyond the channels present by using the last one:
+        val effectiveChannel = if (channel == CHANNEL_DOWNMIX) channel
+            else minOf(channel, fmtChunk.numChannels - 1)
+        val rc = decodeSamples(byteArray, actualSamplesRead, fmtChunk.numChannels.toInt(),
+            fmtChunk.sampleFormat, effectiveChannel, dataBuffer, bufferOffset)
+        if (rc < 0) {
+            throw WavFileException("Unable to decode wav data.")
         }
-         */
 
         if ((actualSamplesRead * bytesPerSample) % 2 == 1) {
             raFile.skipBytes(1)
@@ -242,14 +295,24 @@ class WavFileParser {
 
     private fun skimDataChunk(raFile: RandomAccessFile, filename: String, fmtChunk: FmtChunkInfo)
             : DataChunkInfo {
-        val dataByteCount = readInt32(raFile, filename, "ChunkSize")
+        var dataByteCount = readUInt32(raFile, filename, "ChunkSize")
 
         // Note where the data starts so we can come back for it later.
-        startOfData = raFile.filePointer
+        val dataStart = raFile.filePointer
+        startOfData = dataStart
+
+        // In RF64/BW64 files the real size is in the ds64 chunk:
+        if (dataByteCount == RF64_SIZE_PLACEHOLDER) {
+            ds64DataSize?.let { dataByteCount = it }
+        }
+
+        // Some recorders write a placeholder size and never come back to fix it up, so
+        // don't believe a size that runs past the end of the file:
+        dataByteCount = minOf(dataByteCount, raFile.length() - dataStart)
 
         // Figure out the number of values we expect to find:
-        val valueCount: Int = (dataByteCount * 8 / fmtChunk.bitsPerSample).toInt()
-        val expectedSampleCount: Int = (valueCount / fmtChunk.numChannels).toInt()
+        val valueCount: Long = dataByteCount * 8 / fmtChunk.bitsPerSample
+        val expectedSampleCount: Long = valueCount / fmtChunk.numChannels
         var (minValue, maxValue) = Pair<Short?, Short?>(null, null)
 
         /**
@@ -257,26 +320,30 @@ class WavFileParser {
          * Track the min and max values as we go.
          */
         val portionSize = 50000 // # 50000 x 2 bytes is about 100K
-        var samplesRead = 0
+        var samplesRead = 0L
 
-        // Preallocate a buffer that is big enough:
-        val dataBuffer = ShortArray(portionSize * fmtChunk.numChannels)
+        // Preallocate a buffer that is big enough. readData returns one value per sample:
+        val dataBuffer = ByteBuffer.allocateDirect(portionSize * Short.SIZE_BYTES)
+            .order(ByteOrder.nativeOrder())
 
         while (samplesRead < expectedSampleCount) {
-            val count = minOf(expectedSampleCount - samplesRead, portionSize)
+            val count = minOf(expectedSampleCount - samplesRead, portionSize.toLong()).toInt()
             val actualPortionCount = readData(
                 raFile,
                 fmtChunk,
-                Pair(samplesRead, samplesRead + count),
+                LongHORange(samplesRead, samplesRead + count),
                 dataBuffer
             )
             samplesRead += actualPortionCount
 
-            val (min, max) = Pair(dataBuffer.minOrNull(), dataBuffer.maxOrNull())
-            min?.let { minValue = minOf<Short>(minValue ?: it, it) }
-            max?.let { maxValue = maxOf<Short>(maxValue ?: it, it) }
+            // Only consider the values actually read in this portion:
+            for (i in 0 until actualPortionCount) {
+                val v = dataBuffer.getShort(i * Short.SIZE_BYTES)
+                minValue = minOf<Short>(minValue ?: v, v)
+                maxValue = maxOf<Short>(maxValue ?: v, v)
+            }
 
-            if (dataBuffer.size < count) {
+            if (actualPortionCount < count) {
                 break      // We hit the end.
             }
         }
@@ -289,7 +356,7 @@ class WavFileParser {
         // to seek to the end of data chunk now to not confuse the caller:
         startOfData?.let {
             raFile.seek(it + dataByteCount)
-            if (dataByteCount % 2 == 1) {
+            if (dataByteCount % 2 == 1L) {
                 // Allow for padding to an even length. Actually this should never happen.
                 raFile.skipBytes(1)
             }
@@ -302,6 +369,30 @@ class WavFileParser {
         )
     }
 
+    /**
+     * Read the ds64 chunk that RF64 and BW64 files place immediately after the WAVE ID.
+     * We only need the 64 bit data chunk size: the RIFF size is not used, and the sample
+     * count is recalculated from the data actually present.
+     */
+    private fun readDs64Chunk(raFile: RandomAccessFile, filename: String) {
+        val chunkSize = readUInt32(raFile, filename, "ds64 ChunkSize")
+        val requiredChunkSize = 8 + 8 + 8 + 4L
+        checkValue(filename, "ds64 ChunkSize", chunkSize, "must be >= $requiredChunkSize") { v: Long ->
+            v >= requiredChunkSize
+        }
+        val chunkStart = raFile.filePointer
+
+        /* val riffSize = */ readInt64(raFile, filename, "ds64 RiffSize")
+        val dataSize = readInt64(raFile, filename, "ds64 DataSize")
+        checkValue(filename, "ds64 DataSize", dataSize, "must be >= 0") { v: Long ->
+            v >= 0
+        }
+        ds64DataSize = dataSize
+
+        // Skip the sample count and the optional table of other chunk sizes, which we don't need:
+        raFile.seek(chunkStart + chunkSize + chunkSize % 2)
+    }
+
     private fun readFormatChunk(raFile: RandomAccessFile, filename: String): FmtChunkInfo {
         val chunkSize = readInt32(raFile, filename, "fmt SubchunkSize")
         val formatTag = readInt16(raFile, filename, "AudioFormat")
@@ -312,10 +403,12 @@ class WavFileParser {
         var blockAlign = 0.toShort()
         var bitsPerSample = 0.toShort()
         var requiredChunkSize = 0
+        var isFloat = false
 
         when (formatTag) {
-            1.toShort() -> {
-                // PCM no compression.
+            FORMAT_PCM, FORMAT_IEEE_FLOAT -> {
+                // PCM no compression, or IEEE float, which has the same layout.
+                isFloat = formatTag == FORMAT_IEEE_FLOAT
                 requiredChunkSize = 14 + 2  // More data may be supplied, we will ignore it.
                 checkValue(
                     filename,
@@ -333,7 +426,7 @@ class WavFileParser {
 
             }
 
-            65534.toShort() -> {
+            FORMAT_EXTENSIBLE -> {
                 // WAVE_FORMAT_EXTENSIBLE
                 // This limited support is reverse engineered from sample files,
                 // and from https://www.jensign.com/riffparse/
@@ -356,13 +449,13 @@ class WavFileParser {
                 /*val cbSize = */ readInt16(raFile, filename, "ExtraSize")
                 /*val validBitsPerSample = */ readInt16(raFile, filename, "validBitsPerSample")
                 /* val channelMask = */ readInt32(raFile, filename, "ChannelMask")
-                // Read and validate the 12 byte sub format in 3 pieces:
-                /*val subformat1 = */ readInt32(
-                    raFile,
-                    filename,
-                    "Subformat1",
-                    expected = 0x00000001
-                )
+                // Read and validate the 12 byte sub format in 3 pieces. The first
+                // piece is the format tag: PCM or IEEE float.
+                val subformat1 = readInt32(raFile, filename, "Subformat1")
+                checkValue(filename, "Subformat1", subformat1, "must be PCM or IEEE float") { v: Int ->
+                    v == FORMAT_PCM.toInt() || v == FORMAT_IEEE_FLOAT.toInt()
+                }
+                isFloat = subformat1 == FORMAT_IEEE_FLOAT.toInt()
                 /* val subformat2 = */ readInt32(
                     raFile,
                     filename,
@@ -384,14 +477,26 @@ class WavFileParser {
          * Sanity checks.
          */
 
-        checkValue(filename, "NumChannels", numChannels, "must be > 0") { v: Short ->
-            v > 0
+        checkValue(filename, "NumChannels", numChannels, "must be 1 to $MAX_CHANNELS") { v: Short ->
+            v in 1..MAX_CHANNELS
         }
         checkValue(filename, "SampleRate", sampleRateHz, "must be > 0") { v: Int ->
             v > 0
         }
-        checkValue(filename, "BitsPerSample", bitsPerSample, "must be 16 bits") { v: Short ->
-            v == 16.toShort()
+        val sampleFormat = if (isFloat) {
+            checkValue(filename, "BitsPerSample", bitsPerSample, "must be 32 bits for float data") { v: Short ->
+                v == 32.toShort()
+            }
+            SAMPLE_FLOAT32
+        } else {
+            checkValue(filename, "BitsPerSample", bitsPerSample, "must be 16, 24 or 32 bits") { v: Short ->
+                v == 16.toShort() || v == 24.toShort() || v == 32.toShort()
+            }
+            when (bitsPerSample.toInt()) {
+                16 -> SAMPLE_INT16
+                24 -> SAMPLE_INT24
+                else -> SAMPLE_INT32
+            }
         }
 
         // Does it really matter if we get unexpected values for the following?
@@ -429,7 +534,7 @@ class WavFileParser {
             raFile.skipBytes(1)
         }
 
-        return FmtChunkInfo(numChannels, sampleRateHz, bitsPerSample)
+        return FmtChunkInfo(numChannels, sampleRateHz, bitsPerSample, sampleFormat)
     }
 
     private fun <T> checkValue(
@@ -490,6 +595,27 @@ class WavFileParser {
         return found
     }
 
+    /**
+     * Read an unsigned 32 bit value, such as a chunk size, which can exceed Int.MAX_VALUE.
+     */
+    private fun readUInt32(
+        raFile: RandomAccessFile,
+        filename: String,
+        fieldName: String
+    ): Long {
+        return readInt32(raFile, filename, fieldName).toLong() and 0xFFFFFFFFL
+    }
+
+    private fun readInt64(
+        raFile: RandomAccessFile,
+        filename: String,
+        fieldName: String
+    ): Long {
+        val low = readUInt32(raFile, filename, fieldName)
+        val high = readUInt32(raFile, filename, fieldName)
+        return (high shl 32) or low
+    }
+
     private fun readInt16(
         raFile: RandomAccessFile,
         filename: String,
@@ -518,12 +644,13 @@ class WavFileParser {
      *  Consume and ignore an entire WAV file chunk - for example, because its type is unknown.
      */
     private fun skipChunk(raFile: RandomAccessFile, filename: String) {
-        var bytesToSkip = readInt32(raFile, filename, "fmt SubchunkSize")
-        if (bytesToSkip % 2 == 1) {
+        var bytesToSkip = readUInt32(raFile, filename, "fmt SubchunkSize")
+        if (bytesToSkip % 2 == 1L) {
             // Wav standard says to round up to even lengths:
             bytesToSkip += 1
         }
 
-        raFile.skipBytes(bytesToSkip)
+        // Seek rather than skipBytes, which is limited to an Int:
+        raFile.seek(raFile.filePointer + bytesToSkip)
     }
 }
\ No newline at end of file
@@ -23,11 +23,13 @@
 package org.batgizmo.app
 
 import android.content.Context
+import android.content.res.AssetFileDescriptor
 import android.net.Uri
 import java.io.File
 import java.io.FileOutputStream
 import java.io.IOException
 import java.io.RandomAccessFile
+import java.nio.ByteBuffer
 
 class WavFileReader(private val ctx: Context) {
 
@@ -37,11 +39,12 @@ class WavFileReader(private val ctx: Context) {
         val sampleRate: Int,
         val numChannels: Short,
         val lengthSeconds: Float,
-        val sampleCount: Int,
+        val sampleCount: Long,
         val valueRange: Short,
         val timeRange: FloatRange,
         val frequencyRange: FloatRange,
-        val bytesPerValue: Int,
+        val bytesPerValue: Int,             // As stored in the file, before conversion to 16 bits.
+        val isFloat: Boolean,
         val guanoChunkInfo: WavFileParser.GuanoChunkInfo?
     )
 
@@ -64,7 +67,11 @@ class WavFileReader(private val ctx: Context) {
         openState = null
     }
 
-    fun open(uri: Uri, fileName: String?): WavFileInfo {
+    /**
+     * Open the file. Multichannel files are reduced to a single channel as they are read:
+     * channel selects which one, or is WavFileParser.CHANNEL_DOWNMIX to average them all.
+     */
+    fun open(uri: Uri, fileName: String?, channel: Int = WavFileParser.CHANNEL_DOWNMIX): WavFileInfo {
         // Free any file and resources already open. No harm done if none were.
         close()
 
@@ -81,16 +88,14 @@ class WavFileReader(private val ctx: Context) {
             // Copy the content to a temporary file that allows us relatively
             // fast access with seek. The source might be over slow USB or remote
             // HTTP connection.
+            // There is no fixed size limit: data is read a page at a time, using 64 bit
+            // offsets, so RF64/BW64 files larger than 4 GB are fine.
             val file: File = copyUriToCache(uri)
-            val maxFileLength = 50000000
-            if (file.length() > maxFileLength) {
-                throw IllegalArgumentException("File is greater than the maximum supported ($maxFileLength bytes),")
-            }
             val safeRaFile = RandomAccessFile(file, "r")
             raFile = safeRaFile
 
             // Parse the file as a wav file, to extract what metadata we can:
-            wavFileParser = WavFileParser()
+            wavFileParser = WavFileParser(channel)
             val safeWavFileParser: WavFileParser = wavFileParser
 
             // Can throw an Exception, which is caught higher up:
@@ -109,13 +114,7 @@ class WavFileReader(private val ctx: Context) {
              * Do some sanity checks.
              */
 
-            if (safeWavChunks.fmtChunk.bitsPerSample != 16.toShort()) {
-                throw IllegalArgumentException("Support is currently limited to 16 bit PCM - found ${safeWavChunks.fmtChunk.bitsPerSample} bit data.")
-            }
-
-            if (safeWavChunks.fmtChunk.numChannels != 1.toShort()) {
-                throw IllegalArgumentException("Support is currently limited to one channel. ${safeWavChunks.fmtChunk.numChannels} channels are present.")
-            }
+            // The sample format and number of channels have already been validated by the parser.
 
             if (safeWavChunks.fmtChunk.sampleRateHz <= 0) {
                 throw IllegalArgumentException("The sample rate must be a positive number - it is actually ${safeWavChunks.fmtChunk.sampleRateHz}.")
@@ -151,7 +150,7 @@ class WavFileReader(private val ctx: Context) {
                 maxOf<Short>((-maxOf<Short>(dataRange.first, -32767)).toShort(), dataRange.second)
 
             // What are the maximum ranges for time and frequency that this data can support:
-            val lengthSeconds = sampleCount.toFloat() / sampleRate
+            val lengthSeconds = (sampleCount.toDouble() / sampleRate).toFloat()
             val timeRange = if (lengthSeconds > 0) {
                 FloatRange(0f, lengthSeconds)
             } else {
@@ -171,6 +170,7 @@ class WavFileReader(private val ctx: Context) {
                 timeRange = timeRange,
                 frequencyRange = frequencyRange,
                 bytesPerValue = safeWavChunks.fmtChunk.bitsPerSample / 8,
+                isFloat = safeWavChunks.fmtChunk.sampleFormat == WavFileParser.SAMPLE_FLOAT32,
                 guanoChunkInfo = wavChunks.guanoChunk
             )
 
@@ -207,6 +207,17 @@ class WavFileReader(private val ctx: Context) {
         // Delete the cache file on exiting from the app:
         cacheFile.deleteOnExit()
 
+        // Large recordings can be many GB, so fail early with a useful message rather than
+        // part way through the copy. The previous cache file is about to be overwritten, so
+        // its space counts as available. The length is unknown for some providers.
+        val sourceLength = ctx.contentResolver.openAssetFileDescriptor(uri, "r")?.use {
+            it.length
+        } ?: AssetFileDescriptor.UNKNOWN_LENGTH
+        val availableSpace = ctx.cacheDir.usableSpace + cacheFile.length()
+        if (sourceLength != AssetFileDescriptor.UNKNOWN_LENGTH && sourceLength > availableSpace) {
+            throw IOException("Insufficient storage to open the file ($sourceLength bytes needed, $availableSpace available).")
+        }
+
         // Copy the content from the URI into the cache file:
         ctx.contentResolver.openInputStream(uri).use { inputStream ->
             if (inputStream == null) {
@@ -232,7 +243,7 @@ class WavFileReader(private val ctx: Context) {
      * If anything goes wrong, an exception is thrown.
      *
      */
-    fun readData(range: HORange, dataBuffer: ShortArray, bufferOffset: Int = 0) : Int {
+    fun readData(range: LongHORange, dataBuffer: ByteBuffer, bufferOffset: Int = 0) : Int {
         if (openState == null) {
             throw IllegalStateException("Attempt to readData when the WavFileReader has not been successfully opened.")
         }
@@ -28,18 +28,23 @@ import android.graphics.Color
 import android.util.Log
 import androidx.compose.ui.unit.DpSize
 import androidx.compose.ui.unit.dp
-import androidx.core.graphics.createBitmap
 import kotlinx.coroutines.CoroutineScope
 import kotlinx.coroutines.flow.MutableStateFlow
 import kotlinx.coroutines.sync.Mutex
 import kotlinx.coroutines.sync.withLock
+import kotlinx.coroutines.yield
 import org.batgizmo.app.BitmapHolder
 import org.batgizmo.app.FloatRange
 import org.batgizmo.app.HORange
+import org.batgizmo.app.LongHORange
 import org.batgizmo.app.Settings
 import org.batgizmo.app.UIModel
 import org.batgizmo.app.pipeline.ColourMapStep.Companion.dbRangeMax
 import uk.org.gimell.batgimzoapp.BuildConfig
+import java.nio.ByteBuffer
+import kotlin.math.abs
+import kotlin.math.ceil
+import kotlin.math.floor
 import kotlin.math.log2
 import kotlin.math.pow
 import kotlin.math.roundToInt
@@ -55,7 +60,7 @@ abstract class AbstractPipeline(
     protected val mutableYAxisRangeFlow: MutableStateFlow<FloatRange>,
     protected val mutableDetailsTextFlow: MutableStateFlow<String?>,
     protected val sampleRate: Int,
-    protected val sampleCount: Int,
+    protected val sampleCount: Long,
     protected val preserveRawDataBuffer: Boolean,
     protected val onTrigger: () -> Unit = {}
 ) {
@@ -74,13 +79,23 @@ abstract class AbstractPipeline(
         const val CANARY_ENTRIES = 1
         const val CANARY_VALUE = 0xFACE.toShort()
 
+        // Renders of more time buckets than this show a coarse pass, transforming every
+        // PROGRESSIVE_COLUMN_STEP'th window, before the full resolution one:
+        const val PROGRESSIVE_MIN_COLUMNS = 4096
+        const val PROGRESSIVE_COLUMN_STEP = 8
+
         external fun findBnCRange(
             xMin: Int, xMax: Int,
             yMin: Int, yMax: Int,
             frequencyBuckets: Int,
-            transformedDataBuffer: FloatArray
+            transformedDataBuffer: ByteBuffer
         ): FloatArray?
 
+        /**
+         * Move the columns of an RGB_565 bitmap left, or right if columns is negative.
+         */
+        external fun shiftBitmapColumns(bitmap: Bitmap, columns: Int): Int
+
         /**
          * Calculate the FFT window size and overlap we are going to use, based on user settings
          * and screen factors.
@@ -162,29 +177,41 @@ abstract class AbstractPipeline(
     /**
      * A raw data buffer and its associated range of indexes which are
      * have been assigned. A null value means the range is not yet known.
+     *
+     * The buffer holds 16 bit samples, and comes from the NativeArena.
      */
-    data class RangedRawDataBuffer(val buffer: ShortArray, var assignedRange: HORange? = null) {
+    data class RangedRawDataBuffer(val buffer: ByteBuffer, var assignedRange: HORange? = null) {
+        // The number of samples the buffer holds, including the canary:
+        val size: Int
+            get() = buffer.capacity() / Short.SIZE_BYTES
+
+        var canary: Short
+            get() = buffer.getShort((size - 1) * Short.SIZE_BYTES)
+            set(value) {
+                buffer.putShort((size - 1) * Short.SIZE_BYTES, value)
+            }
+
         override fun equals(other: Any?): Boolean {
             if (this === other) return true
             if (javaClass != other?.javaClass) return false
 
             other as RangedRawDataBuffer
 
-            if (!buffer.contentEquals(other.buffer)) return false
+            if (buffer !== other.buffer) return false
             if (assignedRange != other.assignedRange) return false
 
             return true
         }
 
         override fun hashCode(): Int {
-            var result = buffer.contentHashCode()
+            var result = System.identityHashCode(buffer)
             result = 31 * result + (assignedRange?.hashCode() ?: 0)
             return result
         }
 
         fun reset() {
-            buffer.fill(0)
-            buffer[buffer.size - 1] = CANARY_VALUE.toShort()
+            NativeArena.fillShort(buffer, 0)
+            canary = CANARY_VALUE
             if (assignedRange != null)
                 assignedRange = HORange(0, 0)
         }
@@ -196,7 +223,7 @@ abstract class AbstractPipeline(
         val transformStep: TransformStep,
         val colourMapStep: ColourMapStep,
         val rangedRawDataBuffer: RangedRawDataBuffer,
-        val transformedDataBuffer: FloatArray,
+        val transformedDataBuffer: ByteBuffer,
     ) {
         override fun equals(other: Any?): Boolean {
             if (this === other) return true
@@ -209,7 +236,7 @@ abstract class AbstractPipeline(
             if (transformStep != other.transformStep) return false
             if (colourMapStep != other.colourMapStep) return false
             if (rangedRawDataBuffer != other.rangedRawDataBuffer) return false
-            if (!transformedDataBuffer.contentEquals(other.transformedDataBuffer)) return false
+            if (transformedDataBuffer !== other.transformedDataBuffer) return false
 
             return true
         }
@@ -220,17 +247,17 @@ abstract class AbstractPipeline(
             result = 31 * result + transformStep.hashCode()
             result = 31 * result + colourMapStep.hashCode()
             result = 31 * result + rangedRawDataBuffer.hashCode()
-            result = 31 * result + transformedDataBuffer.contentHashCode()
+            result = 31 * result + System.identityHashCode(transformedDataBuffer)
             return result
         }
     }
 
     data class CalculatedParams(
-        val rawTotalDataLength: Int,
+        val rawTotalDataLength: Long,       // 64 bit: long recordings can exceed 2^31 samples.
         val rawSampleRate: Int,
         val rawTimeInterval: Float,
-        val rawPagedDataLength: Int,
-        val rawOffsetToPage: Int,
+        val rawPagedDataLength: Int,        // A page always fits in memory, so Int is enough.
+        val rawOffsetToPage: Long,
         val fftWindowSize: Int,
         val fftStride: Int,
         val fftOverlap: Int,
@@ -250,6 +277,24 @@ abstract class AbstractPipeline(
     protected var pipelineData: PipelineData? = null
     private var cachedRawDataBuffer: RangedRawDataBuffer? = null
 
+    // True when the raw data buffer holds the whole page, so it can be transformed again
+    // with new FFT parameters without reading it from the source:
+    private var rawPageLoaded = false
+
+    /**
+     * Whether a change of FFT parameters may reconfigure the pipeline in place, transforming
+     * the raw data already loaded. Override this for sources that keep writing to the raw data
+     * buffer while the pipeline runs.
+     */
+    protected open val canReconfigureInPlace: Boolean = true
+
+    // Results for other FFT parameters on this page, to zoom back to or precomputed:
+    private val transformCache = TransformCache(0)
+
+    // Changed by anything that changes the raw data or the pipeline, so that a precompute
+    // in progress knows to give up:
+    private var renderGeneration = 0L
+
     // Synchronize access to data members:
     protected val mutex = Mutex()
 
@@ -270,6 +315,18 @@ abstract class AbstractPipeline(
     suspend fun shutdown() {
         mutex.withLock {
             internalShutdown()
+
+            // The pipeline is finished with, so the next one can have its memory:
+            NativeArena.release(NativeArena.SLOT_RAW)
+            NativeArena.release(NativeArena.SLOT_TRANSFORMED)
+            cachedRawDataBuffer = null
+            rawPageLoaded = false
+            transformCache.clear()
+            renderGeneration++
+            synchronized(spectrogramBitmapHolder) { spectrogramBitmapHolder.trim() }
+            synchronized(amplitudeBitmapHolder) { amplitudeBitmapHolder.trim() }
+            // No buffers from the arena are held now, so its memory can safely be freed:
+            NativeArena.trim()
         }
     }
 
@@ -289,11 +346,16 @@ abstract class AbstractPipeline(
         // that might arise between the pipeline and native layer processing in different threads:
         pipelineData = null
 
+        // The old bitmaps are kept by the holders for the next pipeline to reuse:
         synchronized(spectrogramBitmapHolder) {
             spectrogramBitmapHolder.bitmap = null
+            if (updateUI)
+                spectrogramBitmapHolder.publishAll()
         }
         synchronized(amplitudeBitmapHolder) {
             amplitudeBitmapHolder.bitmap = null
+            if (updateUI)
+                amplitudeBitmapHolder.publishAll()
         }
 
         if (updateUI) {
@@ -319,6 +381,8 @@ abstract class AbstractPipeline(
     }
 
     private suspend fun internalResetState(updateUI: Boolean = true) {
+        renderGeneration++
+
         // First reset anything that needs it at the pipeline level:
         resetPipelineState()
 
@@ -341,22 +405,25 @@ abstract class AbstractPipeline(
      * Override this to do any reset that might need doing at the pipeline level.
      */
     protected open suspend fun resetPipelineState() {
+        rawPageLoaded = false
         val pld = pipelineData
         if (pld != null) {
             pld.rangedRawDataBuffer.reset()
             // Reset to the value that corresponds to the start of the colour map:
-            pld.transformedDataBuffer.fill(dbRangeMax.start)
+            NativeArena.fillFloat(pld.transformedDataBuffer, dbRangeMax.start)
         }
 
         synchronized(spectrogramBitmapHolder) {
             spectrogramBitmapHolder.bitmap?.apply {
                 eraseColor(Color.BLACK)
+                spectrogramBitmapHolder.publishAll()
             }
         }
 
         synchronized(amplitudeBitmapHolder) {
             amplitudeBitmapHolder.bitmap?.apply {
                 eraseColor(Color.BLACK)
+                amplitudeBitmapHolder.publishAll()
             }
         }
     }
@@ -372,20 +439,23 @@ abstract class AbstractPipeline(
      */
     suspend fun fullExecute(
         fftParameters: FftParameters,
-        rawPageRange: HORange? = null,
+        rawPageRange: LongHORange? = null,
         amplitudeSizeDp: DpSize? = null,
-        doRender: Boolean = true
+        doRender: Boolean = true,
+        spectrogramSizeDp: DpSize? = null
     ) {
         mutex.withLock {
-            internalFullExecute(fftParameters, rawPageRange, amplitudeSizeDp, doRender)
+            internalFullExecute(fftParameters, rawPageRange, amplitudeSizeDp, doRender,
+                spectrogramSizeDp)
         }
     }
 
     private suspend fun internalFullExecute(
         fftParameters: FftParameters,
-        rawPageRange: HORange? = null,
+        rawPageRange: LongHORange? = null,
         amplitudeSizeDp: DpSize? = null,
         doRender: Boolean,
+        spectrogramSizeDp: DpSize? = null
     ) {
         if (BuildConfig.DEBUG)
             Log.d(logTag, "internalExecute called")
@@ -393,25 +463,273 @@ abstract class AbstractPipeline(
         // Slight hack if no amplitude pane:
         val dummyAmplitudeSize = DpSize(100.dp, 100.dp)
 
+        renderGeneration++
+
+        // A move to an overlapping page only needs the columns it uncovers transforming:
+        if (doRender && rawPageRange != null && shiftPage(fftParameters, rawPageRange))
+            return
+
+        // Keep the current result, in case the user zooms back to it:
+        pipelineData?.let {
+            if (canReconfigureInPlace && rawPageLoaded)
+                cacheCurrent(it)
+        }
+
+        // If the raw data for the page is already loaded, the new pipeline can transform it
+        // again rather than reading it from the source:
+        val loadedCalcs = if (canReconfigureInPlace && rawPageLoaded) pipelineData?.calcs else null
+
         // Shut down any existing pipeline without updating the
         // UI, to avoid momentary blanking of the screen.
         internalShutdown(updateUI = false)
 
+        // Only cachedRawDataBuffer still points into the arena now, over the raw slot's current
+        // block, so the memory that slots have given up can be freed for the new pipeline:
+        NativeArena.freeRetired()
+
         if (BuildConfig.DEBUG)
             Log.d(logTag, "internalExecute calling setupPipeline")
         pipelineData = setupPipeline(
             fftParameters,
             rawPageRange,
-            amplitudeSizeDp ?: dummyAmplitudeSize
+            amplitudeSizeDp ?: dummyAmplitudeSize,
+            spectrogramSizeDp,
+            loadedCalcs
         )
         pipelineData?.let {
             startPipeline(it)
+
+            // Parameters that have been used or precomputed before just need copying back:
+            if (doRender && rawPageLoaded && restoreCached(it))
+                return
+
             if (doRender) {
-                it.dataSourceStep.fullRender()
+                if (canReconfigureInPlace
+                    && it.calcs.transformedTimeBucketCount > PROGRESSIVE_MIN_COLUMNS) {
+                    // Show a coarse pass straight away, rather than a blank pane, while the
+                    // full resolution is done from the raw data it loads:
+                    it.transformStep.columnStep = PROGRESSIVE_COLUMN_STEP
+                    try {
+                        if (rawPageLoaded)
+                            it.dataSourceStep.rerenderFromBuffer(null) {}
+                        else
+                            it.dataSourceStep.fullRender()
+                    } finally {
+                        it.transformStep.columnStep = 1
+                    }
+                    rawPageLoaded = true
+                    spectrogramBitmapHolder.signalUpdate()
+                    amplitudeBitmapHolder.signalUpdate()
+                }
+
+                if (rawPageLoaded) {
+                    // Show the visible part as soon as it is done, then do the rest:
+                    it.dataSourceStep.rerenderFromBuffer(visibleTransformedRange(it.calcs)) {
+                        spectrogramBitmapHolder.signalUpdate()
+                        amplitudeBitmapHolder.signalUpdate()
+                    }
+                }
+                else
+                    it.dataSourceStep.fullRender()
+                rawPageLoaded = canReconfigureInPlace
             }
         }
     }
 
+    /**
+     * Copy the pipeline's current result into the transform cache.
+     */
+    private fun cacheCurrent(pld: PipelineData) {
+        if (transformCache.contains(pld.calcs))
+            return
+        synchronized(amplitudeBitmapHolder) {
+            amplitudeBitmapHolder.bitmap?.let {
+                transformCache.copyOf(pld.calcs, pld.transformedDataBuffer, it)?.let { entry ->
+                    transformCache.put(entry)
+                }
+            }
+        }
+    }
+
+    /**
+     * Copy a cached result for the pipeline's parameters into its buffers and render it.
+     * Returns false if there isn't one.
+     */
+    private fun restoreCached(pld: PipelineData): Boolean {
+        val entry = transformCache.get(pld.calcs) ?: return false
+        synchronized(amplitudeBitmapHolder) {
+            val amplitudeBitmap = amplitudeBitmapHolder.bitmap
+            if (amplitudeBitmap == null || amplitudeBitmap.width != entry.amplitudeBitmap.width)
+                return false
+            transformCache.restore(entry, pld.transformedDataBuffer, amplitudeBitmap)
+            amplitudeBitmapHolder.publishAll()
+        }
+
+        if (BuildConfig.DEBUG)
+            Log.d(logTag, "restoreCached: FFT window ${pld.calcs.fftWindowSize}, stride ${pld.calcs.fftStride}")
+
+        pld.transformStep.noteAssignedRange(HORange(0, pld.calcs.transformedTimeBucketCount))
+        pld.colourMapStep.fullRender()
+        spectrogramBitmapHolder.signalUpdate()
+        amplitudeBitmapHolder.signalUpdate()
+        return true
+    }
+
+    /**
+     * Called from a worker thread, while the user is idle.
+     *
+     * Transform the loaded page with other FFT parameters, such as those of the neighbouring
+     * zoom levels, into the transform cache, so that a zoom to them only has to copy the
+     * result. The pipeline's mutex is only held a slice at a time, and the work is abandoned
+     * as soon as the pipeline does anything else.
+     */
+    suspend fun precompute(fftParameters: FftParameters) {
+        val generation: Long
+        val calcs: CalculatedParams
+        val entry: TransformCache.Entry
+        mutex.withLock {
+            val pld = pipelineData
+            if (pld == null || !canReconfigureInPlace || !rawPageLoaded)
+                return
+            val pageRange = LongHORange(pld.calcs.rawOffsetToPage,
+                pld.calcs.rawOffsetToPage + pld.calcs.rawPagedDataLength)
+            calcs = doCalculations(model.settings, sampleRate, sampleCount, fftParameters, pageRange)
+            if (calcs == pld.calcs || transformCache.contains(calcs)
+                || calcs.rawPagedDataLength != pld.calcs.rawPagedDataLength)
+                return
+            val amplitudeHeight =
+                synchronized(amplitudeBitmapHolder) { amplitudeBitmapHolder.bitmap?.height } ?: return
+            generation = renderGeneration
+            entry = transformCache.createEntry(calcs, amplitudeHeight) ?: return
+        }
+
+        if (BuildConfig.DEBUG)
+            Log.d(logTag, "precompute: FFT window ${calcs.fftWindowSize}, stride ${calcs.fftStride}")
+
+        val window = TransformStep.createHannWindow(calcs.fftWindowSize)
+        NativeArena.fillFloat(entry.transformedDataBuffer, dbRangeMax.start)
+        entry.amplitudeBitmap.eraseColor(Color.BLACK)
+
+        TransformCache.precomputeMutex.withLock {
+            val rc = TransformCache.initPrecompute(
+                calcs.fftWindowSize, calcs.sliceTransformedTimeBucketCount
+            )
+            require(rc == 0) { "initPrecompute failed" }
+            try {
+                var index = 0
+                while (index < calcs.transformedTimeBucketCount) {
+                    val windows = minOf(
+                        calcs.sliceTransformedTimeBucketCount,
+                        calcs.transformedTimeBucketCount - index
+                    )
+                    mutex.withLock {
+                        val pld = pipelineData
+                        if (renderGeneration != generation || pld == null)
+                            return
+                        val done = TransformCache.precomputeSlice(
+                            pld.rangedRawDataBuffer.buffer, calcs.rawPagedDataLength,
+                            index * calcs.fftStride, windows, calcs.fftStride, window,
+                            entry.transformedDataBuffer, index,
+                            dbRangeMax.start, entry.amplitudeBitmap
+                        )
+                        require(done == windows) { "precomputeSlice failed: rc = $done" }
+                    }
+                    index += windows
+                    yield()
+                }
+            } finally {
+                TransformCache.cleanupPrecompute()
+            }
+        }
+
+        mutex.withLock {
+            if (renderGeneration == generation)
+                transformCache.put(entry)
+        }
+    }
+
+    /**
+     * Move the pipeline to a page that overlaps the current one, with the same FFT parameters,
+     * by moving the raw data, transformed data and bitmaps that the pages share and rendering
+     * only the columns that are new. The page start is kept on the current page's column grid,
+     * which moves it by less than one column from the start requested.
+     *
+     * Returns false, having changed nothing, if the pipeline can't be moved like this.
+     */
+    private fun shiftPage(fftParameters: FftParameters, rawPageRange: LongHORange): Boolean {
+        val pld = pipelineData
+        if (pld == null || !canReconfigureInPlace || !rawPageLoaded)
+            return false
+
+        val old = pld.calcs
+        val requested =
+            doCalculations(model.settings, sampleRate, sampleCount, fftParameters, rawPageRange)
+        val columns = Math.floorDiv(
+            requested.rawOffsetToPage - old.rawOffsetToPage + old.fftStride / 2,
+            old.fftStride.toLong()
+        )
+        val calcs = requested.copy(rawOffsetToPage = old.rawOffsetToPage + columns * old.fftStride)
+        if (columns == 0L || abs(columns) >= old.transformedTimeBucketCount
+            || calcs.copy(rawOffsetToPage = old.rawOffsetToPage) != old
+            || calcs.rawOffsetToPage < 0
+            || calcs.rawOffsetToPage + calcs.rawPagedDataLength > calcs.rawTotalDataLength)
+            return false
+
+        if (BuildConfig.DEBUG)
+            Log.d(logTag, "shiftPage: moving $columns columns to ${calcs.rawOffsetToPage}")
+
+        // Move the data the pages share to where it belongs in the new page:
+        val shift = columns.toInt()
+        moveEntries(pld.rangedRawDataBuffer.buffer, shift * old.fftStride,
+            old.rawPagedDataLength, Short.SIZE_BYTES)
+        moveEntries(pld.transformedDataBuffer, shift * old.transformedFrequencyBucketCount,
+            old.transformedTimeBucketCount * old.transformedFrequencyBucketCount, Float.SIZE_BYTES)
+        synchronized(spectrogramBitmapHolder) {
+            spectrogramBitmapHolder.bitmap?.let { shiftBitmapColumns(it, shift) }
+            spectrogramBitmapHolder.publishAll()
+        }
+        synchronized(amplitudeBitmapHolder) {
+            amplitudeBitmapHolder.bitmap?.let { shiftBitmapColumns(it, shift) }
+            amplitudeBitmapHolder.publishAll()
+        }
+
+        pld.dataSourceStep.params = DataSourceStep.Params(calcs = calcs)
+        pld.transformStep.params = TransformStep.Params(calcs = calcs)
+        pld.colourMapStep.params = pld.colourMapStep.params?.copy(calcs = calcs)
+        pipelineData = pld.copy(calcs = calcs)
+
+        // Render the columns that were uncovered:
+        val count = old.transformedTimeBucketCount
+        pld.dataSourceStep.renderTransformedRange(
+            if (shift > 0) HORange(count - shift, count) else HORange(0, -shift)
+        )
+        return true
+    }
+
+    /**
+     * Move the first count entries of a buffer towards its start by shift entries, or
+     * towards its end if shift is negative, dropping those moved beyond either end.
+     */
+    private fun moveEntries(buffer: ByteBuffer, shift: Int, count: Int, entryBytes: Int) {
+        val kept = (count - abs(shift)).toLong() * entryBytes
+        val rc = if (shift > 0)
+            NativeArena.move(buffer, shift.toLong() * entryBytes, 0, kept)
+        else
+            NativeArena.move(buffer, 0, -shift.toLong() * entryBytes, kept)
+        check(rc == 0) { "Failed to move pipeline data by $shift entries" }
+    }
+
+    /**
+     * The range of transformed time buckets that is visible on screen.
+     */
+    private fun visibleTransformedRange(calcs: CalculatedParams): HORange {
+        val visible = model.timeVisibleRangeFlow.value
+        return HORange(
+            floor(visible.start * calcs.transformedTimeBucketCount).toInt(),
+            ceil(visible.endInclusive * calcs.transformedTimeBucketCount).toInt()
+        )
+    }
+
     /**
      * Render the raw data slice whose range is supplied.
      */
@@ -451,6 +769,30 @@ abstract class AbstractPipeline(
         }
     }
 
+    /**
+     * Call this method on a worker thread.
+     *
+     * Give the spectrogram bitmap the number of rows for the visible frequency range, which
+     * a zoom may change without changing the FFT parameters, redoing the colour mapping from
+     * the transformed data if it has changed.
+     */
+    suspend fun refitSpectrogramRows(spectrogramSizeDp: DpSize?) {
+        mutex.withLock {
+            val pld = pipelineData ?: return
+            val rows = spectrogramRows(pld.calcs, spectrogramSizeDp)
+            synchronized(spectrogramBitmapHolder) {
+                val bitmap = spectrogramBitmapHolder.bitmap ?: return
+                if (bitmap.height == rows)
+                    return
+                if (BuildConfig.DEBUG)
+                    Log.d(logTag, "refitSpectrogramRows: ${bitmap.height} to $rows rows")
+                spectrogramBitmapHolder.bitmap = spectrogramBitmapHolder.obtainBitmap(bitmap.width, rows)
+            }
+            pld.colourMapStep.fullRender()
+            spectrogramBitmapHolder.signalUpdate()
+        }
+    }
+
     /**
      * Call this method on a worker thread.
      *
@@ -534,8 +876,9 @@ abstract class AbstractPipeline(
      * Set up the pipeline ready to be started. If anything bad happens,
      * we throw an exception.
      */
-    private suspend fun setupPipeline(fftParameters: FftParameters, rawPageRange: HORange?,
-                              amplitudeSizeDp: DpSize)
+    private suspend fun setupPipeline(fftParameters: FftParameters, rawPageRange: LongHORange?,
+                              amplitudeSizeDp: DpSize, spectrogramSizeDp: DpSize?,
+                              loadedCalcs: CalculatedParams? = null)
             : PipelineData {
         /**
          * Build a pipeline including all its steps and buffers.
@@ -570,29 +913,41 @@ abstract class AbstractPipeline(
              * sized to accommodate the entire data range corresponding to the
              * maximum file time window.
              */
-            /**
-             * Allocate buffers used to share data between steps. These buffers are
-             * sized to accommodate the entire data range corresponding to the
-             * maximum file time window.
-             */
+
+            // The buffers come from the native arena, which reuses the memory of the last
+            // pipeline, up to the budget in the settings:
+            NativeArena.setBudget(model.settings.memoryBudgetMb.toLong() shl 20)
+            // Cached transforms are outside the arena, and may take a quarter as much again:
+            transformCache.budgetBytes = (model.settings.memoryBudgetMb.toLong() shl 20) / 4
 
             // Buffer for raw data read from the data file:
-            var rangedRawDataBuffer: RangedRawDataBuffer? = null
             val sizeRequired = calcs.rawPagedDataLength + CANARY_ENTRIES
+            val rawBuffer = NativeArena.allocate(
+                NativeArena.SLOT_RAW, sizeRequired.toLong() * Short.SIZE_BYTES, "raw data"
+            )
+            val rangedRawDataBuffer: RangedRawDataBuffer
             val crwb = cachedRawDataBuffer
-            if (preserveRawDataBuffer && crwb != null && crwb.buffer.size == sizeRequired) {
+
+            // A raw page that is already loaded can be kept if the new parameters cover
+            // the same samples:
+            rawPageLoaded = loadedCalcs != null
+                    && loadedCalcs.rawOffsetToPage == calcs.rawOffsetToPage
+                    && loadedCalcs.rawPagedDataLength == calcs.rawPagedDataLength
+            if ((preserveRawDataBuffer || rawPageLoaded) && crwb != null && crwb.size == sizeRequired) {
+                // The arena has handed back the same memory, data and all:
                 if (BuildConfig.DEBUG)
-                    Log.d(logTag, "reusing the raw data buffer: assignedRange = ${cachedRawDataBuffer?.assignedRange}")
-                rangedRawDataBuffer = cachedRawDataBuffer
+                    Log.d(logTag, "reusing the raw data buffer: assignedRange = ${crwb.assignedRange}")
+                rangedRawDataBuffer = RangedRawDataBuffer(rawBuffer, crwb.assignedRange)
             }
             else {
-                rangedRawDataBuffer = RangedRawDataBuffer(ShortArray(sizeRequired))
+                rangedRawDataBuffer = RangedRawDataBuffer(rawBuffer)
+                NativeArena.fillShort(rawBuffer, 0)
+                rawPageLoaded = false
             }
-            require(rangedRawDataBuffer != null) { "Internal error: rawDataBuffer should not be null" }
 
             // Hold a reference in case we want to re-use it on rebuilding the pipeline:
             cachedRawDataBuffer = rangedRawDataBuffer
-            rangedRawDataBuffer.buffer[rangedRawDataBuffer.buffer.size - 1] = CANARY_VALUE.toShort()
+            rangedRawDataBuffer.canary = CANARY_VALUE
 
             val transformedDataBufferSize =
                 calcs.transformedTimeBucketCount * calcs.transformedFrequencyBucketCount
@@ -600,35 +955,35 @@ abstract class AbstractPipeline(
             // Buffer for transformed data generated by the SFFT transform step.
             // We flatten the data into a one dimensional array in the way you
             // would guess:
-            val transformedDataBuffer = FloatArray(transformedDataBufferSize)
+            val transformedDataBuffer = NativeArena.allocate(
+                NativeArena.SLOT_TRANSFORMED,
+                transformedDataBufferSize.toLong() * Float.SIZE_BYTES, "transformed data"
+            )
             // Initialize to the value of the lowest end of the colour map:
-            transformedDataBuffer.fill(dbRangeMax.start)
+            NativeArena.fillFloat(transformedDataBuffer, dbRangeMax.start)
+
+            if (BuildConfig.DEBUG)
+                Log.d(logTag, NativeArena.statsText())
 
             /**
              * Bitmap to hold the final transformed and colour mapped data, and place
              * a reference to it in the holder so that other parts of the code
-             * (such as UI rendering) can access it.
+             * (such as UI rendering) can access it. The bitmaps of the last
+             * configuration are reused if they are big enough. The renderer keeps
+             * drawing the last image published until the new one is.
              */
-
-            val spectrogramBitmap = createBitmap(
-                calcs.transformedTimeBucketCount,
-                calcs.transformedFrequencyBucketCount,
-                Bitmap.Config.RGB_565
-            )
-            spectrogramBitmap.apply {
-                eraseColor(Color.BLACK)
+            synchronized(spectrogramBitmapHolder) {
+                spectrogramBitmapHolder.bitmap = spectrogramBitmapHolder.obtainBitmap(
+                    calcs.transformedTimeBucketCount,
+                    spectrogramRows(calcs, spectrogramSizeDp)
+                )
             }
-            spectrogramBitmapHolder.bitmap = spectrogramBitmap
-
-            val amplitudeBitmap = createBitmap(
-                calcs.transformedTimeBucketCount,
-                amplitudeSizeDp.height.value.roundToInt().coerceIn(10, null),
-                Bitmap.Config.RGB_565
-            )
-            amplitudeBitmap.apply {
-                eraseColor(Color.BLACK)
+            synchronized(amplitudeBitmapHolder) {
+                amplitudeBitmapHolder.bitmap = amplitudeBitmapHolder.obtainBitmap(
+                    calcs.transformedTimeBucketCount,
+                    amplitudeSizeDp.height.value.roundToInt().coerceIn(10, null)
+                )
             }
-            amplitudeBitmapHolder.bitmap = amplitudeBitmap
 
             /**
              * Create the steps in REVERSE order below so that each step can be passed
@@ -637,7 +992,7 @@ abstract class AbstractPipeline(
 
             // Create a step to map the transformed data (spectral intensities) to colours:
             val colourMapStep =
-                ColourMapStep(transformedDataBuffer, spectrogramBitmap, model.colourMapSize, model.settings)
+                ColourMapStep(transformedDataBuffer, spectrogramBitmapHolder, model.colourMapSize, model.settings)
             // Use the existing BnC range, so this is preserved when a new file is loaded:
             colourMapStep.params =
                 ColourMapStep.Params(calcs = calcs, bnCRangeLogical = model.bnCRangeFlow.value)
@@ -677,6 +1032,33 @@ abstract class AbstractPipeline(
         }
     }
 
+    /**
+     * The number of rows for the spectrogram bitmap. That is one per frequency bucket, unless
+     * there are more buckets than screen pixels for the frequency range at its current zoom.
+     * Then it is one per pixel, and the colour mapping max pools the buckets into them, so
+     * that a narrow call isn't lost when the image is shrunk.
+     */
+    private fun spectrogramRows(calcs: CalculatedParams, spectrogramSizeDp: DpSize?): Int {
+        if (spectrogramSizeDp == null)
+            return calcs.transformedFrequencyBucketCount
+        val visible = model.frequencyVisibleRangeFlow.value
+        val visibleFraction = (visible.endInclusive - visible.start).coerceIn(0.01f, 1f)
+        val pixels = spectrogramSizeDp.height.value *
+                context.resources.displayMetrics.density / visibleFraction
+        return ceil(pixels).toInt().coerceIn(1, calcs.transformedFrequencyBucketCount)
+    }
+
+    /**
+     * Allows a subclass to modify the FFT parameters calculated from the settings, for
+     * example to reduce the processing load.
+     */
+    protected open fun adjustFftParameters(
+        settings: Settings,
+        fftParameters: FftParameters
+    ): FftParameters {
+        return fftParameters
+    }
+
     /**
      * Calculate FFT parameters taking into account Settings and
      * assuming that the initial axis ranges is a full view of the first window into
@@ -689,7 +1071,7 @@ abstract class AbstractPipeline(
     ): FftParameters {
         mutex.withLock {
             val maxRawDataCount = (model.settings.dataPageIntervalS * sampleRate).toInt()
-            val rawDataCount: Int = minOf(sampleCount, maxRawDataCount)
+            val rawDataCount: Int = minOf(sampleCount, maxRawDataCount.toLong()).toInt()
             // val xAxisSpan = rawDataCount.toFloat() / sampleRate
 
             val yAxisSpan = sampleRate / 2.0f
@@ -700,23 +1082,25 @@ abstract class AbstractPipeline(
 
             val fftParameters = calculateFftParameters(model.settings, screenFactors, sampleRate)
 
-            return fftParameters
+            return adjustFftParameters(model.settings, fftParameters)
         }
     }
 
     private fun doCalculations(
         settings: Settings,
         sampleRate: Int,
-        sampleCount: Int,
+        sampleCount: Long,
         fftParameters: FftParameters,
-        theRawPageRange: HORange?
+        theRawPageRange: LongHORange?
     ): CalculatedParams {
 
         // Limit the raw data buffer size to the maximum file window configured in
         // settings:
         val rawSamplesPerInterval = (settings.dataPageIntervalS * sampleRate).toInt()
-        val rawPageRange = theRawPageRange ?: HORange(0, minOf(sampleCount, rawSamplesPerInterval))
-        val rawPageDataCount = rawPageRange.second - rawPageRange.first
+        val rawPageRange = theRawPageRange
+            ?: LongHORange(0L, minOf(sampleCount, rawSamplesPerInterval.toLong()))
+        // The page length is bounded by the page interval, so can safely be narrowed:
+        val rawPageDataCount = (rawPageRange.second - rawPageRange.first).toInt()
 
         // Use calculated FFT parameters values rather values from settings:
         val nFft = fftParameters.windowSamples
@@ -831,14 +1215,17 @@ abstract class AbstractPipeline(
             val mySampleRate: Int? = pipelineData?.calcs?.rawSampleRate
 
             return if (mySampleRate != null)
-                calculateFftParameters(settings, screenFactors, mySampleRate)
+                adjustFftParameters(
+                    settings,
+                    calculateFftParameters(settings, screenFactors, mySampleRate)
+                )
             else
                 null
         }
     }
 
     data class PagingData(
-        val rawTotalDataLength: Int,
+        val rawTotalDataLength: Long,
         val rawSampleRate: Int,
     )
 
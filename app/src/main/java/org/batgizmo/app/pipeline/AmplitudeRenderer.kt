@@ -31,7 +31,7 @@ import androidx.compose.ui.Modifier
 import androidx.compose.ui.graphics.Color
 import androidx.compose.ui.graphics.toArgb
 import org.batgizmo.app.BitmapHolder
-import org.batgizmo.app.HORange
+import org.batgizmo.app.LongHORange
 import org.batgizmo.app.Settings
 import org.batgizmo.app.UIModel
 import org.batgizmo.app.ui.GraphBase
@@ -46,39 +46,33 @@ class AmplitudeDrawThread(model: UIModel, surfaceHolder: SurfaceHolder, bitmapHo
     }
 
     override fun draw(bmPaint: Paint) {
-        val bitmap = bitmapHolder.bitmap
+        // The pipeline publishes to the holder without waiting for this thread to draw:
+        val frame = bitmapHolder.acquireFront()
         var canvas1: Canvas? = null
         try {
-            // The bitmap is also accessed by the pipeline thread:
-            synchronized(model.amplitudeBitmapHolder) {
-                val canvas = surfaceHolder.lockHardwareCanvas()
-                canvas1 = canvas
-                if (canvas != null) {
-                    if (bitmap != null) {
-                        val (expandedSrcRect, expandedDestRect) = calculateImageMapping(
-                            bitmap, canvas,
-                            model.timeVisibleRangeFlow,
-                            model.amplitudeVisibleRangeFlow)
+            val canvas = surfaceHolder.lockHardwareCanvas()
+            canvas1 = canvas
+            if (canvas != null) {
+                if (frame != null) {
+                    val (expandedSrcRect, expandedDestRect) = calculateImageMapping(
+                        frame, canvas,
+                        model.timeVisibleRangeFlow,
+                        model.amplitudeVisibleRangeFlow)
 
-                        // Log.d(this::class.simpleName, "expandedSrcRect = $expandedSrcRect, expandedDestRect = $expandedDestRect")
-                        // Copy the data from the source to the screen in one go:
-                        canvas.drawBitmap(
-                            bitmap,
-                            expandedSrcRect,
-                            expandedDestRect,
-                            bmPaint
-                        )
+                    // Log.d(this::class.simpleName, "expandedSrcRect = $expandedSrcRect, expandedDestRect = $expandedDestRect")
+                    // Copy the data from the source to the screen in one go:
+                    drawImage(canvas, frame, expandedSrcRect, expandedDestRect, bmPaint)
 
-                        bitmapHolder.cursorTime?.let { t ->
-                            val x = canvas.width * (t - model.timeAxisRangeFlow.value.start) /
-                                    (model.timeAxisRangeFlow.value.endInclusive - model.timeAxisRangeFlow.value.start)
-                            if (x >=0 && x < canvas.width )
-                                canvas.drawLine(x, 0f, x, (canvas.height - 1).toFloat(), cursorPaint)
-                        }
+                    // A scrolling display always has the newest data at its right hand edge:
+                    bitmapHolder.cursorTime?.takeIf { frame.ringHead < 0 }?.let { t ->
+                        val x = canvas.width * (t - model.timeAxisRangeFlow.value.start) /
+                                (model.timeAxisRangeFlow.value.endInclusive - model.timeAxisRangeFlow.value.start)
+                        if (x >=0 && x < canvas.width )
+                            canvas.drawLine(x, 0f, x, (canvas.height - 1).toFloat(), cursorPaint)
                     }
-                    else
-                        canvas.drawColor(Color.Black.toArgb())
                 }
+                else
+                    canvas.drawColor(Color.Black.toArgb())
             }
         } finally {
             if (canvas1 != null) {
@@ -100,7 +94,7 @@ class AmplitudeSHCallback(
 class AmplitudeRenderer(
     private val model: UIModel,
     private val graph: GraphBase,
-    private val rawPageRangeState: MutableState<HORange?>,
+    private val rawPageRangeState: MutableState<LongHORange?>,
     bitmapHolder: BitmapHolder
 ) : RendererBase(model, graph, rawPageRangeState, bitmapHolder) {
 
@@ -23,13 +23,15 @@
 package org.batgizmo.app.pipeline
 
 import android.graphics.Bitmap
+import org.batgizmo.app.BitmapHolder
 import org.batgizmo.app.FloatRange
 import org.batgizmo.app.HORange
 import org.batgizmo.app.Settings
+import java.nio.ByteBuffer
 
 class ColourMapStep(
-    private val transformedDataBuffer: FloatArray,
-    private val bitmap: Bitmap,
+    private val transformedDataBuffer: ByteBuffer,
+    private val spectrogramBitmapHolder: BitmapHolder,
     private val colourMapSize: Int?,
     private val settings: Settings
 ) : AbstractStep() {
@@ -38,7 +40,7 @@ class ColourMapStep(
         private external fun doColourMapping(
             first: Int,
             second: Int,
-            transformedDataBuffer: FloatArray,
+            transformedDataBuffer: ByteBuffer,
             transformedTimeBucketCount: Int,
             transformedFrequencyBucketCount: Int,
             bitmap: Bitmap,
@@ -95,8 +97,11 @@ class ColourMapStep(
          * multiply it by the number of frequency buckets to get the buffer index.
          */
 
-        // The bitmap is also accessed by the rendering thread:
-        synchronized (bitmap) {
+        // Write the back buffer, then publish it for the renderer:
+        synchronized(spectrogramBitmapHolder) {
+            val bitmap = spectrogramBitmapHolder.bitmap
+            require(bitmap != null) { "Internal error, spectrogram bitmap has not been allocated" }
+
             // Do the actual colour mapping:
             val rc = doColourMapping(
                 sliceRange.first, sliceRange.second,
@@ -108,6 +113,7 @@ class ColourMapStep(
             )
             require(rc >= 0) { "doColourMapping failed: rc = $rc" }
 
+            spectrogramBitmapHolder.publish(sliceRange.first, sliceRange.second)
         }
     }
 
@@ -71,8 +71,11 @@ abstract class DataSourceStep(
             Log.d(this::class.simpleName, "getMaxAxisRanges calcs.rawOffsetToPage = ${calcs.rawOffsetToPage}")
 
         val halfFftWindow = calcs.fftWindowSize / 2
-        var xAxisMin = (calcs.rawOffsetToPage + halfFftWindow) * calcs.rawTimeInterval
-        var xAxisMax = (calcs.rawOffsetToPage + calcs.rawPagedDataLength - halfFftWindow) * calcs.rawTimeInterval
+        // Work in Double until the end: the page offset can be a very large
+        // sample index, which would lose precision as a Float:
+        val rawSampleRate = calcs.rawSampleRate.toDouble()
+        var xAxisMin = ((calcs.rawOffsetToPage + halfFftWindow) / rawSampleRate).toFloat()
+        var xAxisMax = ((calcs.rawOffsetToPage + calcs.rawPagedDataLength - halfFftWindow) / rawSampleRate).toFloat()
 
         val yAxisMin = 0f
         val yAxisMax = calcs.transformedFrequencyInterval * calcs.transformedFrequencyBucketCount
@@ -81,6 +84,52 @@ abstract class DataSourceStep(
     }
 
     override fun fullRender() {
+        if (BuildConfig.DEBUG)
+            Log.d(this::class.simpleName, "fullRender start")
+
+        for ((range, transformedEntryIndex) in slices())
+            sliceRender(range, transformedEntryIndex)
+    }
+
+    /**
+     * Fetch and render only the slices that overlap a range of transformed time buckets, as
+     * when a page move uncovers some columns.
+     */
+    fun renderTransformedRange(transformedRange: HORange) {
+        val calcs = getSafeParams().calcs
+        for ((range, transformedEntryIndex) in slices()) {
+            if (transformedEntryIndex < transformedRange.second
+                && transformedEntryIndex + calcs.sliceTransformedTimeBucketCount > transformedRange.first)
+                sliceRender(range, transformedEntryIndex)
+        }
+    }
+
+    /**
+     * Transform the data already in the raw data buffer again, as after a change of FFT
+     * parameters, without fetching it from the source. The slices that overlap the priority
+     * range, in transformed time buckets, are done first, then onPriorityDone is called so
+     * that they can be shown while the rest are done.
+     */
+    fun rerenderFromBuffer(priorityRange: HORange?, onPriorityDone: () -> Unit) {
+        val calcs = getSafeParams().calcs
+        val (priority, rest) = slices().partition { (_, transformedEntryIndex) ->
+            priorityRange == null
+                    || (transformedEntryIndex < priorityRange.second
+                        && transformedEntryIndex + calcs.sliceTransformedTimeBucketCount > priorityRange.first)
+        }
+
+        for ((range, transformedEntryIndex) in priority)
+            nextStep.sliceRender(range, transformedEntryIndex)
+        onPriorityDone()
+        for ((range, transformedEntryIndex) in rest)
+            nextStep.sliceRender(range, transformedEntryIndex)
+    }
+
+    /**
+     * The slices that cover the raw data, each with the index in the transformed data
+     * buffer of its first result.
+     */
+    private fun slices(): List<Pair<HORange, Int>> {
         val safeParams = getSafeParams()
 
         /**
@@ -90,9 +139,6 @@ abstract class DataSourceStep(
         val calcs = safeParams.calcs
         val sliceSize = calcs.rawSliceEntries
 
-        if (BuildConfig.DEBUG)
-            Log.d(this::class.simpleName, "fullRender start")
-
         /**
          * Round up the number of slices to process, to include any final partial slice. This
          * means we don't miss out the end of the data. It also means we need to handle the case
@@ -106,6 +152,7 @@ abstract class DataSourceStep(
         val assignedDataRange = rangedRawDataBuffer.assignedRange
         // Log.d(logTag, "JM: assignedDataRange = $assignedDataRange")
 
+        val slices = ArrayList<Pair<HORange, Int>>(numSlices)
         var relativeStart = 0
         for (i in 0 until numSlices) {
 
@@ -124,10 +171,10 @@ abstract class DataSourceStep(
             else
                 HORange(relativeStart, relativeEnd)
 
-            // If there is anything left to render, do so:
+            // If there is anything left to render, include it:
             if (clippedDataRange.second > clippedDataRange.first) {
                 // Log.d(logTag, "JM: rendering raw data slice $clippedDataRange")
-                sliceRender(clippedDataRange, transformedEntryIndex)
+                slices.add(Pair(clippedDataRange, transformedEntryIndex))
             }
 
             // Increment this even if we didn't actually render the slice:
@@ -140,5 +187,6 @@ abstract class DataSourceStep(
             if (relativeStart >= calcs.rawTotalDataLength)
                 break   // EOF
         }
+        return slices
     }
-}
\ No newline at end of file
+}
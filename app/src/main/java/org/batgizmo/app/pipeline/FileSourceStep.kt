@@ -23,6 +23,7 @@
 package org.batgizmo.app.pipeline
 
 import org.batgizmo.app.HORange
+import org.batgizmo.app.LongHORange
 import org.batgizmo.app.WavFileReader
 
 class FileSourceStep(nextStep: AbstractStep,
@@ -47,7 +48,7 @@ class FileSourceStep(nextStep: AbstractStep,
         val calcs = safeParams.calcs
 
         // The slice is relative to the page:
-        val absoluteRange = HORange(sliceRange.first + calcs.rawOffsetToPage,
+        val absoluteRange = LongHORange(sliceRange.first + calcs.rawOffsetToPage,
             minOf(sliceRange.second + calcs.rawOffsetToPage, calcs.rawTotalDataLength))
 
         // Log.d(this::class.simpleName, "push absoluteRange = $absoluteRange")
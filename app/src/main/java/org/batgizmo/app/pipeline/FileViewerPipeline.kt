@@ -45,7 +45,7 @@ class FileViewerPipeline(
     mutableYAxisRangeFlow: MutableStateFlow<FloatRange>,
     mutableDetailsTextFlow: MutableStateFlow<String?>,
     sampleRate: Int,
-    sampleCount: Int
+    sampleCount: Long
 ) : AbstractPipeline(
         scope,
         context,
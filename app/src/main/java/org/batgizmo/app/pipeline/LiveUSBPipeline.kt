@@ -27,6 +27,7 @@ import kotlinx.coroutines.CoroutineScope
 import kotlinx.coroutines.flow.MutableStateFlow
 import org.batgizmo.app.BitmapHolder
 import org.batgizmo.app.FloatRange
+import org.batgizmo.app.Settings
 import org.batgizmo.app.UIModel
 
 /**
@@ -43,7 +44,7 @@ class LiveUSBPipeline(
     mutableYAxisRangeFlow: MutableStateFlow<FloatRange>,
     mutableDetailsTextFlow: MutableStateFlow<String?>,
     sampleRate: Int,
-    sampleCount: Int,
+    sampleCount: Long,
     onTrigger: () ->Unit
 ) : AbstractPipeline(
     scope,
@@ -63,6 +64,18 @@ class LiveUSBPipeline(
         const val DEFAULTLIVETIMESPAN_S = 3f
     }
 
+    // The stream keeps writing to the raw data buffer, with the parameters it started with:
+    override val canReconfigureInPlace = false
+
+    init {
+        // Each live stream starts at full quality:
+        QualityGovernor.start()
+    }
+
+    override fun adjustFftParameters(settings: Settings, fftParameters: FftParameters): FftParameters {
+        return QualityGovernor.adjust(settings, fftParameters)
+    }
+
     override fun createDataSourceStep(
         pipeline: AbstractPipeline,
         transformStep: TransformStep,
@@ -0,0 +1,135 @@
+/*
+ * Copyright (c) 2025 John Mears
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+package org.batgizmo.app.pipeline
+
+import java.nio.ByteBuffer
+import java.nio.ByteOrder
+import java.util.Locale
+
+/**
+ * Access to the native arena that holds the large pipeline buffers, so that rebuilding the
+ * pipeline, as on every zoom, reuses their memory rather than leaving the old arrays to
+ * the garbage collector. See core/arena.h.
+ *
+ * The buffers are direct, in native byte order, and the native layer uses them in place.
+ * A buffer's contents are only meaningful until its slot is next acquired or released, but
+ * its memory stays allocated until trim is called, so a stale buffer never reaches freed
+ * memory.
+ */
+class NativeArena {
+    data class Stats(
+        val budget: Long,
+        val capacity: Long,
+        val inUse: Long,
+        val highWater: Long
+    )
+
+    companion object {
+        // Keep in step with arena_slot in the native code. The other slots are native only:
+        const val SLOT_RAW = 0
+        const val SLOT_TRANSFORMED = 1
+
+        /**
+         * Limit the memory used by the arena. Memory that has been released is given up,
+         * to be freed by freeRetired or trim, if the arena is over the new budget.
+         */
+        external fun setBudget(bytes: Long)
+
+        /**
+         * The slot's buffer, of the size requested, or null if that would take the arena
+         * over budget.
+         */
+        private external fun acquire(slot: Int, bytes: Long): ByteBuffer?
+
+        /**
+         * Mark the slot as no longer in use, keeping its memory for reuse.
+         */
+        external fun release(slot: Int)
+
+        /**
+         * Free the memory of all slots that have been released, and any given up since the
+         * last trim. Only call this with no pipeline live, as it invalidates their buffers.
+         */
+        external fun trim()
+
+        /**
+         * Free the memory given up since the last trim, which counts against the budget until
+         * then, keeping that of all slots. Only call this when no buffer is held other than
+         * the slots' current ones.
+         */
+        external fun freeRetired()
+
+        /**
+         * The budget, capacity, bytes in use and high-water mark for the arena, then the
+         * size, capacity and high-water mark of each slot.
+         */
+        private external fun snapshot(): LongArray?
+
+        /**
+         * Set every value in a buffer from this arena.
+         */
+        external fun fillShort(buffer: ByteBuffer, value: Short)
+        external fun fillFloat(buffer: ByteBuffer, value: Float)
+
+        /**
+         * Copy bytes within a buffer from this arena, from one byte offset to another. The
+         * ranges may overlap. Returns -1 if either is out of the buffer's bounds.
+         */
+        external fun move(buffer: ByteBuffer, from: Long, to: Long, bytes: Long): Int
+
+        /**
+         * Get the slot's buffer, of the size requested. The contents are undefined, unless
+         * the slot was last acquired at the same size. Throws if the memory budget in the
+         * settings doesn't allow for it.
+         */
+        fun allocate(slot: Int, bytes: Long, description: String): ByteBuffer {
+            val buffer = acquire(slot, bytes)
+            if (buffer == null) {
+                val budgetMb = (snapshot()?.get(0) ?: 0L) shr 20
+                throw IllegalStateException(
+                    "The $description buffer needs ${(bytes + (1 shl 20) - 1) shr 20} MB, which is more " +
+                            "than the memory budget of $budgetMb MB allows. Try a larger " +
+                            "memory budget or a shorter data buffer length in settings."
+                )
+            }
+            return buffer.order(ByteOrder.nativeOrder())
+        }
+
+        fun stats(): Stats? {
+            val values = snapshot() ?: return null
+            return Stats(values[0], values[1], values[2], values[3])
+        }
+
+        /**
+         * Memory in use, allocated and at its peak, against the budget, in MB.
+         */
+        fun statsText(): String {
+            val stats = stats() ?: return ""
+            return String.format(
+                Locale.US, "%-10s %5.1f/%5.1f MB  peak %5.1f  budget %d",
+                "memory", stats.inUse / 1048576.0, stats.capacity / 1048576.0,
+                stats.highWater / 1048576.0, stats.budget shr 20
+            )
+        }
+    }
+}
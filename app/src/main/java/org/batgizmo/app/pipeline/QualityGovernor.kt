@@ -0,0 +1,142 @@
+/*
+ * Copyright (c) 2025 John Mears
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+package org.batgizmo.app.pipeline
+
+import org.batgizmo.app.Settings
+import kotlin.math.log2
+
+/**
+ * Steps the live display quality down when the device can't keep up, and back up when it
+ * can, using the native governor for the decisions. See core/governor.h.
+ *
+ * Level 0 is the quality the settings ask for. Each level above that caps the FFT window
+ * overlap further, and the last also halves the window size.
+ */
+class QualityGovernor {
+    companion object {
+        // Overlap caps in percent, indexed by level:
+        private val OVERLAP_CAPS = intArrayOf(100, 75, 50, 25, 25)
+        val LEVELS = OVERLAP_CAPS.size
+        private const val MIN_DEGRADED_NFFT = 256
+
+        private external fun reset(levels: Int): Int
+        private external fun update(
+            processingNs: Long,
+            dataNs: Long,
+            backlog: Int,
+            dropped: Int,
+            upCostRatio: Float
+        ): Int
+
+        /**
+         * The level currently applied to live FFT parameters.
+         */
+        @Volatile
+        var level = 0
+            private set
+
+        @Volatile
+        private var enabled = false
+
+        // The parameters the settings ask for, before degrading:
+        @Volatile
+        private var baseParameters: AbstractPipeline.FftParameters? = null
+
+        /**
+         * Start again at full quality, as a new live stream starts.
+         */
+        fun start() {
+            require(reset(LEVELS) == 0)
+            level = 0
+            baseParameters = null
+        }
+
+        /**
+         * Called whenever live FFT parameters are calculated, to apply the current level.
+         */
+        fun adjust(
+            settings: Settings,
+            params: AbstractPipeline.FftParameters
+        ): AbstractPipeline.FftParameters {
+            enabled = settings.adaptiveQuality
+            baseParameters = params
+            return if (enabled) degrade(params, level) else params
+        }
+
+        /**
+         * Account for one slice taking processingNs to process data lasting dataNs,
+         * with backlog buffers waiting and dropped buffers lost since the last call.
+         *
+         * Returns true if the level has changed, in which case the pipeline needs to be
+         * rebuilt with new FFT parameters.
+         */
+        fun update(processingNs: Long, dataNs: Long, backlog: Int, dropped: Int): Boolean {
+            val base = baseParameters
+            if (!enabled || base == null)
+                return false
+
+            val upCostRatio = if (level > 0)
+                cost(degrade(base, level - 1)) / cost(degrade(base, level))
+            else
+                1f
+
+            val newLevel = update(processingNs, dataNs, backlog, dropped, upCostRatio)
+            if (newLevel == level)
+                return false
+            level = newLevel
+            return true
+        }
+
+        fun degrade(
+            params: AbstractPipeline.FftParameters,
+            level: Int
+        ): AbstractPipeline.FftParameters {
+            val l = level.coerceIn(0, LEVELS - 1)
+            var windowSamples = params.windowSamples
+            var windowOverlap = params.windowOverlap
+
+            // The last level also halves the window, keeping the overlap proportion:
+            if (l == LEVELS - 1 && windowSamples / 2 >= MIN_DEGRADED_NFFT) {
+                windowSamples /= 2
+                windowOverlap /= 2
+            }
+
+            val maxOverlap = windowSamples * OVERLAP_CAPS[l] / 100
+            windowOverlap = windowOverlap.coerceIn(1, maxOf(maxOverlap, 1))
+
+            return AbstractPipeline.FftParameters(
+                windowSamples = windowSamples,
+                windowOverlap = windowOverlap
+            )
+        }
+
+        /**
+         * Relative processing cost per second of data: FFTs per second times the cost of each.
+         */
+        private fun cost(params: AbstractPipeline.FftParameters): Float {
+            val stride = maxOf(params.windowSamples - params.windowOverlap, 1)
+            val n = params.windowSamples.toFloat()
+            return n * log2(n) / stride
+        }
+    }
+}
@@ -26,7 +26,9 @@ import android.graphics.Bitmap
 import android.graphics.Canvas
 import android.graphics.Paint
 import android.graphics.Rect
+import android.graphics.RectF
 import android.util.Log
+import android.view.Surface
 import android.view.SurfaceHolder
 import android.view.SurfaceView
 import androidx.compose.foundation.layout.fillMaxSize
@@ -40,7 +42,7 @@ import androidx.compose.ui.viewinterop.AndroidView
 import kotlinx.coroutines.flow.StateFlow
 import org.batgizmo.app.BitmapHolder
 import org.batgizmo.app.FloatRange
-import org.batgizmo.app.HORange
+import org.batgizmo.app.LongHORange
 import org.batgizmo.app.Settings
 import org.batgizmo.app.UIModel
 import org.batgizmo.app.ui.GraphBase
@@ -55,10 +57,69 @@ abstract class DrawThread(
     protected val surfaceHolder: SurfaceHolder,
     protected val bitmapHolder: BitmapHolder
 ) : Thread() {
+    companion object {
+        /**
+         * Take the surface's native window for drawing natively, setting up its buffers.
+         * Returns a handle for drawFrameNative, to be freed by detachNativeSurface, or 0 on
+         * failure.
+         */
+        private external fun attachNativeSurface(surface: Surface): Long
+        private external fun detachNativeSurface(display: Long)
+
+        private external fun drawFrameNative(
+            display: Long,
+            tiles: Array<Bitmap>?,
+            tileColumns: Int,
+            width: Int,
+            height: Int,
+            xFirst: Float,
+            xLast: Float,
+            yFirst: Float,
+            yLast: Float,
+            ringHead: Int,
+            ringColumns: Int
+        ): Int
+    }
+
     var running: AtomicBoolean = AtomicBoolean(true)
 
+    /**
+     * Whether this thread draws natively, with drawFrameNatively. Fixed for the life of the
+     * surface.
+     */
+    protected open val nativeDisplay = false
+
+    // The surface's native window, from attachNativeSurface, while drawing natively:
+    private val nativeSurfaceLock = Any()
+    private var nativeSurface = 0L
+
     private var logTag = this::class.simpleName
 
+    /**
+     * Called from the UI thread when the surface is created or changes, to take its native
+     * window once, rather than for every frame.
+     */
+    fun onSurfaceChanged() {
+        if (!nativeDisplay)
+            return
+        synchronized(nativeSurfaceLock) {
+            if (nativeSurface != 0L)
+                detachNativeSurface(nativeSurface)
+            nativeSurface = attachNativeSurface(surfaceHolder.surface)
+        }
+    }
+
+    /**
+     * Called from the UI thread when the surface is destroyed, once this thread has finished.
+     */
+    fun onSurfaceDestroyed() {
+        synchronized(nativeSurfaceLock) {
+            if (nativeSurface != 0L)
+                detachNativeSurface(nativeSurface)
+            nativeSurface = 0L
+        }
+    }
+
     fun terminateThread() {
         running.set(false)
         // Wake up the thread so it can terminate itself:
@@ -87,6 +148,7 @@ abstract class DrawThread(
 
             // Log.d(this::class.simpleName, "Thread about to call draw.")
             draw(bmPaint)
+            bitmapHolder.onDrawn()
 
             if (!running.get())
                 break
@@ -94,7 +156,7 @@ abstract class DrawThread(
     }
 
     protected fun calculateImageMapping(
-        bitmap: Bitmap,
+        frame: BitmapHolder.Frame,
         canvas: Canvas,
         xVisibleRangeFlow: StateFlow<FloatRange>,
         yVisibleRangeFlow: StateFlow<FloatRange>,
@@ -149,9 +211,9 @@ abstract class DrawThread(
 
         // Get the visible source region in pixels:
         val srcXVisibleRangePixels =
-            logicalToPixels(xVisibleRangeFlow.value, bitmap.width)
+            logicalToPixels(xVisibleRangeFlow.value, frame.width)
         val srcYVisibleRangePixels =
-            logicalToPixels(yVisibleRangeFlow.value, bitmap.height)
+            logicalToPixels(yVisibleRangeFlow.value, frame.height)
 
         // Calculate the expanded source region in exact source pixels, by rounding
         // outwards:
@@ -192,6 +254,108 @@ abstract class DrawThread(
         return Pair(expandedSrcRect, expandedDestRect)
     }
 
+    /**
+     * Draw the visible part of the frame, or black if there isn't one, by scaling it in
+     * native code straight into the surface's buffer, bypassing the canvas and the texture
+     * upload. Returns false if that failed, having drawn nothing.
+     */
+    protected fun drawFrameNatively(
+        frame: BitmapHolder.Frame?,
+        xVisibleRangeFlow: StateFlow<FloatRange>,
+        yVisibleRangeFlow: StateFlow<FloatRange>
+    ): Boolean {
+        // The same mapping of the visible range to pixels as calculateImageMapping:
+        val width = frame?.width ?: 0
+        val height = frame?.height ?: 0
+        val x = xVisibleRangeFlow.value
+        val y = yVisibleRangeFlow.value
+        return synchronized(nativeSurfaceLock) {
+            if (nativeSurface == 0L)
+                return false
+            drawFrameNative(
+                nativeSurface,
+                frame?.tiles?.toTypedArray(),
+                BitmapHolder.TILE_COLUMNS,
+                width, height,
+                x.start * (width - 1), x.endInclusive * (width - 1),
+                y.start * (height - 1), y.endInclusive * (height - 1),
+                frame?.ringHead ?: -1, frame?.ringColumns ?: 0
+            ) == 0
+        }
+    }
+
+    /**
+     * Draw the source rectangle of the frame to the destination one. If the frame is
+     * a ring, the source is in time order, so it is drawn in up to two parts, one either
+     * side of the ring's head.
+     */
+    protected fun drawImage(
+        canvas: Canvas,
+        frame: BitmapHolder.Frame,
+        src: Rect,
+        dst: Rect,
+        bmPaint: Paint
+    ) {
+        if (src.width() <= 0)
+            return
+        val xScale = dst.width().toFloat() / src.width()
+        fun dstX(x: Int) = dst.left + (x - src.left) * xScale
+
+        val columns = frame.ringColumns
+        if (frame.ringHead < 0 || columns <= 0) {
+            drawColumns(canvas, frame, src.left, src.right, dst.left.toFloat(), xScale,
+                src, dst, bmPaint)
+            return
+        }
+
+        // Source columns before split are those after the head in the frame:
+        val head = frame.ringHead % columns
+        val split = columns - head
+        if (src.left < split)
+            drawColumns(canvas, frame, src.left + head, minOf(src.right, split) + head,
+                dst.left.toFloat(), xScale, src, dst, bmPaint)
+        if (src.right > split) {
+            val left = maxOf(src.left, split)
+            drawColumns(canvas, frame, left - split, src.right - split,
+                dstX(left), xScale, src, dst, bmPaint)
+        }
+    }
+
+    /**
+     * Draw the frame's columns first until second, and src's rows, from dstFirst across,
+     * tile by tile. A hardware canvas only uploads the tiles that have changed since it last
+     * drew them.
+     */
+    private fun drawColumns(
+        canvas: Canvas,
+        frame: BitmapHolder.Frame,
+        first: Int,
+        second: Int,
+        dstFirst: Float,
+        xScale: Float,
+        src: Rect,
+        dst: Rect,
+        bmPaint: Paint
+    ) {
+        val lastTile = minOf((second - 1) / BitmapHolder.TILE_COLUMNS, frame.tiles.size - 1)
+        for (tile in first.coerceAtLeast(0) / BitmapHolder.TILE_COLUMNS..lastTile) {
+            val tileStart = tile * BitmapHolder.TILE_COLUMNS
+            val left = maxOf(first, tileStart)
+            val right = minOf(second, tileStart + frame.tiles[tile].width)
+            if (right <= left)
+                continue
+            canvas.drawBitmap(
+                frame.tiles[tile],
+                Rect(left - tileStart, src.top, right - tileStart, src.bottom),
+                RectF(
+                    dstFirst + (left - first) * xScale, dst.top.toFloat(),
+                    dstFirst + (right - first) * xScale, dst.bottom.toFloat()
+                ),
+                bmPaint
+            )
+        }
+    }
+
     protected abstract fun draw(bmPaint: Paint)
 }
 
@@ -207,7 +371,10 @@ abstract class SHCallback(
     override fun surfaceCreated(holder: SurfaceHolder) {
         // Launch the rendering thread which uses our holder:
         drawThread = createThread(model, holder)
-        drawThread?.apply { start() }
+        drawThread?.apply {
+            onSurfaceChanged()
+            start()
+        }
 
         // Do a single initial update to render any pre-existing bitmap. This is important for
         // example after a rotation.
@@ -222,6 +389,8 @@ abstract class SHCallback(
     ) {
         // Log.d(this::class.simpleName, "surfaceChanged: width = $width height = $height")
 
+        drawThread?.onSurfaceChanged()
+
         // The size may have changed, so signal that a UI updated is needed:
         bitmapHolder.signalUpdate()
     }
@@ -230,6 +399,7 @@ abstract class SHCallback(
         drawThread?.let {
             it.terminateThread()   // Signal a clean shutdown of the thread.
             it.join()              // Wait for thread to finish,
+            it.onSurfaceDestroyed()
             if (BuildConfig.DEBUG)
                 Log.d(this::class.simpleName, "DrawThread complete")
         }
@@ -239,7 +409,7 @@ abstract class SHCallback(
 abstract class RendererBase(
     private val model: UIModel,
     private val graph: GraphBase,
-    private val rawPageRangeState: MutableState<HORange?>,
+    private val rawPageRangeState: MutableState<LongHORange?>,
     protected val bitmapHolder: BitmapHolder
 ) {
     protected var liveMode: Boolean = false
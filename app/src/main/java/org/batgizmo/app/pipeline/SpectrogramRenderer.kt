@@ -45,7 +45,7 @@ import kotlinx.coroutines.Job
 import kotlinx.coroutines.delay
 import kotlinx.coroutines.launch
 import org.batgizmo.app.BitmapHolder
-import org.batgizmo.app.HORange
+import org.batgizmo.app.LongHORange
 import org.batgizmo.app.Settings
 import org.batgizmo.app.UIModel
 import org.batgizmo.app.ui.GraphBase
@@ -69,33 +69,41 @@ class SpectrogramDrawThread(
         pathEffect = DashPathEffect(floatArrayOf(2f, 20f), 0f)
     }
 
+    // Fixed for the life of the surface, as it can't switch between the hardware canvas and
+    // native drawing once one has been used:
+    override val nativeDisplay = model.settings.nativeDisplay
+    private var nativeDisplayFailed = false
+
     override fun draw(bmPaint: Paint) {
-        val bitmap = bitmapHolder.bitmap
+        // The pipeline publishes to the holder without waiting for this thread to draw:
+        val frame = bitmapHolder.acquireFront()
+
+        if (nativeDisplay && !nativeDisplayFailed) {
+            if (drawFrameNatively(frame, model.timeVisibleRangeFlow, model.frequencyVisibleRangeFlow))
+                return
+            nativeDisplayFailed = true
+            Log.w(this::class.simpleName, "Native spectrogram drawing failed, using the canvas instead")
+        }
+
         var canvas1: Canvas? = null
         try {
-            // The bitmap is also accessed by the pipeline thread:
-            synchronized(model.spectrogramBitmapHolder) {
-                val canvas = surfaceHolder.lockHardwareCanvas()
-                canvas1 = canvas
-                if (canvas != null) {
-                    if (bitmap == null) {
-                        // Blank the display if the bitmap is null:
-                        canvas.drawColor(Color.Black.toArgb())
-                    } else {
-                        val (expandedSrcRect, expandedDestRect) = calculateImageMapping(
-                            bitmap, canvas,
-                            model.timeVisibleRangeFlow,
-                            model.frequencyVisibleRangeFlow)
-
-                        // Log.d(this::class.simpleName, "expandedSrcRect = $expandedSrcRect, expandedDestRect = $expandedDestRect")
-                        // Copy the data from the source to the screen in one go:
-                        canvas.drawBitmap(
-                            bitmap,
-                            expandedSrcRect,
-                            expandedDestRect,
-                            bmPaint
-                        )
-                    }
+            // The software canvas draws to the surface the same way as native drawing, so it
+            // can take over from it:
+            val canvas = if (nativeDisplay) surfaceHolder.lockCanvas() else surfaceHolder.lockHardwareCanvas()
+            canvas1 = canvas
+            if (canvas != null) {
+                if (frame == null) {
+                    // Blank the display if there is no frame:
+                    canvas.drawColor(Color.Black.toArgb())
+                } else {
+                    val (expandedSrcRect, expandedDestRect) = calculateImageMapping(
+                        frame, canvas,
+                        model.timeVisibleRangeFlow,
+                        model.frequencyVisibleRangeFlow)
+
+                    // Log.d(this::class.simpleName, "expandedSrcRect = $expandedSrcRect, expandedDestRect = $expandedDestRect")
+                    // Copy the data from the source to the screen in one go:
+                    drawImage(canvas, frame, expandedSrcRect, expandedDestRect, bmPaint)
                 }
             }
         } finally {
@@ -125,7 +133,7 @@ private enum class SpectrogramGestureState(val code: Int) {
 class SpectrogramRenderer(
     private val model: UIModel,
     private val graph: GraphBase,
-    private val rawPageRangeState: MutableState<HORange?>,
+    private val rawPageRangeState: MutableState<LongHORange?>,
     bitmapHolder: BitmapHolder,
 ) : RendererBase(model, graph, rawPageRangeState, bitmapHolder) {
 
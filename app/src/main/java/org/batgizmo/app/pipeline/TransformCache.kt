@@ -0,0 +1,181 @@
+/*
+ * Copyright (c) 2025 John Mears
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+package org.batgizmo.app.pipeline
+
+import android.graphics.Bitmap
+import android.graphics.Canvas
+import android.graphics.Rect
+import kotlinx.coroutines.sync.Mutex
+import java.nio.ByteBuffer
+import java.nio.ByteOrder
+
+/**
+ * A small cache of transformed pages, keyed by their calculated parameters. A zoom back to
+ * FFT parameters that were in use recently, or that were precomputed while the user was idle,
+ * then copies the result rather than transforming the page again.
+ *
+ * Entries are ordinary direct buffers and bitmaps, outside the native arena, and the least
+ * recently used are dropped to make room for new ones within budgetBytes, before anything is
+ * allocated. Not thread safe: the pipeline only uses it while holding its mutex.
+ */
+class TransformCache(var budgetBytes: Long) {
+    class Entry(
+        val calcs: AbstractPipeline.CalculatedParams,
+        val transformedDataBuffer: ByteBuffer,
+        val amplitudeBitmap: Bitmap
+    ) {
+        val bytes: Long
+            get() = transformedDataBuffer.capacity().toLong() + amplitudeBitmap.allocationByteCount
+    }
+
+    companion object {
+        // How long the user must leave the view alone before neighbouring zoom levels are
+        // precomputed:
+        const val PRECOMPUTE_IDLE_MS = 750L
+
+        /**
+         * Set up the native precompute transform, which is separate from the pipeline's own,
+         * for the window size and the number of windows in a slice.
+         */
+        external fun initPrecompute(fftWindowSize: Int, windowsPerSlice: Int): Int
+
+        /**
+         * Free the native precompute transform.
+         */
+        external fun cleanupPrecompute()
+
+        /**
+         * As TransformStep.doSlices, for up to a slice of windows, without trigger detection.
+         * Return the number of windows processed, or -1 if it didn't work out.
+         */
+        external fun precomputeSlice(
+            rawDataBuffer: ByteBuffer,
+            rawDataEntries: Int,
+            startIndex: Int,
+            windowCount: Int,
+            fftStride: Int,
+            window: FloatArray,
+            transformedDataBuffer: ByteBuffer,
+            transformedBufferIndex: Int,
+            minDB: Float,
+            amplitudeBitmap: Bitmap
+        ): Int
+
+        // Only one precompute uses the native transform at a time:
+        val precomputeMutex = Mutex()
+    }
+
+    // In access order, so the first entry is the least recently used:
+    private val entries = LinkedHashMap<AbstractPipeline.CalculatedParams, Entry>(8, 0.75f, true)
+
+    fun get(calcs: AbstractPipeline.CalculatedParams): Entry? = entries[calcs]
+
+    fun contains(calcs: AbstractPipeline.CalculatedParams): Boolean = entries.containsKey(calcs)
+
+    /**
+     * An empty entry for a page transformed with the parameters supplied, or null if it
+     * wouldn't fit in the budget at all. The least recently used entries are dropped to make
+     * room for it first, and the memory of one of the same size is reused.
+     */
+    fun createEntry(calcs: AbstractPipeline.CalculatedParams, amplitudeHeight: Int): Entry? {
+        val bufferBytes = calcs.transformedTimeBucketCount.toLong() *
+                calcs.transformedFrequencyBucketCount * Float.SIZE_BYTES
+        // RGB_565 has two bytes a pixel:
+        val bitmapBytes = calcs.transformedTimeBucketCount.toLong() * amplitudeHeight * 2
+        val bytes = bufferBytes + bitmapBytes
+        if (bytes > budgetBytes || bufferBytes > Int.MAX_VALUE)
+            return null
+
+        var reusable: Entry? = null
+        var total = entries.values.sumOf { it.bytes }
+        val iterator = entries.values.iterator()
+        while (total + bytes > budgetBytes && iterator.hasNext()) {
+            val evicted = iterator.next()
+            total -= evicted.bytes
+            iterator.remove()
+            if (reusable == null
+                && evicted.transformedDataBuffer.capacity().toLong() == bufferBytes
+                && evicted.amplitudeBitmap.width == calcs.transformedTimeBucketCount
+                && evicted.amplitudeBitmap.height == amplitudeHeight)
+                reusable = evicted
+        }
+
+        return Entry(
+            calcs,
+            reusable?.transformedDataBuffer
+                ?: ByteBuffer.allocateDirect(bufferBytes.toInt()).order(ByteOrder.nativeOrder()),
+            reusable?.amplitudeBitmap
+                ?: Bitmap.createBitmap(calcs.transformedTimeBucketCount, amplitudeHeight,
+                    Bitmap.Config.RGB_565)
+        )
+    }
+
+    /**
+     * Add an entry from createEntry, dropping the least recently used ones if the budget has
+     * shrunk since, which may include the new one, until the cache fits its budget.
+     */
+    fun put(entry: Entry) {
+        entries[entry.calcs] = entry
+        var total = entries.values.sumOf { it.bytes }
+        val iterator = entries.values.iterator()
+        while (total > budgetBytes && iterator.hasNext()) {
+            total -= iterator.next().bytes
+            iterator.remove()
+        }
+    }
+
+    /**
+     * An entry holding a copy of the pipeline's current result, or null if it wouldn't fit
+     * in the budget.
+     */
+    fun copyOf(
+        calcs: AbstractPipeline.CalculatedParams,
+        transformedDataBuffer: ByteBuffer,
+        amplitudeBitmap: Bitmap
+    ): Entry? {
+        val entry = createEntry(calcs, amplitudeBitmap.height) ?: return null
+        whole(entry.transformedDataBuffer).put(whole(transformedDataBuffer))
+        Canvas(entry.amplitudeBitmap).drawBitmap(amplitudeBitmap, 0f, 0f, null)
+        return entry
+    }
+
+    /**
+     * Copy an entry's result into the pipeline's buffer and amplitude bitmap, which must be
+     * as wide as the entry's. The amplitude is scaled if the height of the amplitude pane has
+     * changed since, as after a rotation.
+     */
+    fun restore(entry: Entry, transformedDataBuffer: ByteBuffer, amplitudeBitmap: Bitmap) {
+        whole(transformedDataBuffer).put(whole(entry.transformedDataBuffer))
+        Canvas(amplitudeBitmap).drawBitmap(
+            entry.amplitudeBitmap, null,
+            Rect(0, 0, amplitudeBitmap.width, amplitudeBitmap.height), null
+        )
+    }
+
+    fun clear() {
+        entries.clear()
+    }
+
+    // A view of all of a buffer, leaving its own position alone:
+    private fun whole(buffer: ByteBuffer): ByteBuffer = buffer.duplicate().apply { clear() }
+}
@@ -22,11 +22,16 @@
 
 package org.batgizmo.app.pipeline
 
+import android.content.Context
 import android.graphics.Bitmap
+import android.os.Build
 import android.util.Log
 import org.batgizmo.app.BitmapHolder
 import org.batgizmo.app.HORange
 import org.batgizmo.app.UIModel
+import uk.org.gimell.batgimzoapp.BuildConfig
+import java.io.File
+import java.nio.ByteBuffer
 import kotlin.math.PI
 import kotlin.math.cos
 import kotlin.math.round
@@ -38,57 +43,91 @@ import kotlin.math.round
 class TransformStep(
     private val model: UIModel,
     private val nextStep: AbstractStep,
-    private val rawDataBuffer: ShortArray,
-    private val transformedDataBuffer: FloatArray,
+    private val rawDataBuffer: ByteBuffer,
+    private val transformedDataBuffer: ByteBuffer,
     private val amplitudeBitmapHolder: BitmapHolder,
     private val onTrigger: () -> Unit
 ) : AbstractStep() {
 
     companion object {
         /**
-         * Prepare to do FFTs. This allocates buffers in the native layer that
-         * must be freed in due course by calling cleanupFft.
+         * Prepare to do FFTs. This allocates buffers in the native layer, including
+         * scratch space for windowsPerSlice unwrapped windows, that must be freed in due
+         * course by calling cleanupFft.
+         *
+         * The native layer uses the fastest transform plan for this device from its FFT
+         * wisdom. If this case hasn't been seen before, the candidates are timed on a
+         * background thread and the default plan is used until the next setup.
          *
          * Return -1 if it didn't work out, otherwise 0.
          */
-        private external fun initFft(fftWindowSize: Int): Int
+        private external fun initFft(fftWindowSize: Int, fftStride: Int, windowsPerSlice: Int): Int
+
+        /**
+         * Load the FFT wisdom file, which records the fastest transform plans for this device.
+         * The fingerprint identifies the device and software; wisdom with a different
+         * fingerprint is discarded. Return -1 if there was no usable wisdom, otherwise 0.
+         */
+        private external fun loadFftWisdom(path: String, fingerprint: String): Int
+
+        /**
+         * Forget the FFT wisdom, so that each case is tuned again when next used.
+         */
+        private external fun resetFftWisdom()
+
+        private const val FFT_WISDOM_FILE_NAME = "fft_wisdom.txt"
+
+        fun initFftWisdom(context: Context) {
+            val path = File(context.filesDir, FFT_WISDOM_FILE_NAME).path
+            val fingerprint = "${Build.MANUFACTURER} ${Build.MODEL} ${Build.SUPPORTED_ABIS.firstOrNull()} " +
+                    "${Build.VERSION.INCREMENTAL} ${BuildConfig.VERSION_CODE}"
+            synchronized(dummySyncObject) {
+                loadFftWisdom(path, fingerprint)
+            }
+        }
+
+        fun retuneFft() {
+            synchronized(dummySyncObject) {
+                resetFftWisdom()
+            }
+        }
 
         /**
-         * Do a series of SFFTs. The input buffer contains the raw data, with windows
-         * unwrapped. The output buffer is populated with the SFFT of each input window.
+         * Transform windowCount windows spaced by fftStride from startIndex in the raw
+         * data, applying the window supplied. The results are written to the transformed
+         * data buffer from transformedBufferIndex on, in time buckets, and drawn in the
+         * amplitude bitmap. The windows are unwrapped into native scratch space for
+         * windowsPerSlice windows; longer runs are processed a slice at a time within the
+         * one call. The data buffers are from NativeArena.
+         *
+         * If columnStep is more than 1, only every columnStep'th window is transformed, and
+         * its result fills the time buckets up to the next, for a quick coarse preview. The
+         * amplitude is not drawn.
          *
          * minDB is the minimum dB range supported by BnC, which will be used to avoid
-         * attempting log(0).
+         * attempting log(0). triggerFlagBuffer[0] is set non zero if the trigger threshold
+         * was reached.
          *
          * Return the number of windows processed, or -1 if it didn't work out.
          */
-        private external fun doFft(
-            numWindows: Int,
-            sliceBuffer: FloatArray,
-            transformedDataBuffer: FloatArray,
+        private external fun doSlices(
+            rawDataBuffer: ByteBuffer,
+            rawDataEntries: Int,
+            startIndex: Int,
+            windowCount: Int,
+            fftStride: Int,
+            window: FloatArray,
+            fftWindowSize: Int,
+            windowsPerSlice: Int,
+            columnStep: Int,
+            transformedDataBuffer: ByteBuffer,
             transformedBufferIndex: Int,
             minDB: Float,
             triggerFlagBuffer: IntArray,
             minTriggerBucket: Int,
             maxTriggerBucket: Int,
-            autoTriggerThresholdDb: Float
-        ): Int
-
-        /**
-         * Do amplitude calculations. For each FFT window unwrapped in the slice buffer
-         * calculate the range of raw data values, and draw that range as a vertical line
-         * in the output bitmap.
-         *
-         * Return the number of windows processed, or -1 if it didn't work out.
-         */
-        private external fun doAmplitude(
-            numWindows: Int,
-            fftWindowSize: Int,
-            sliceBuffer: FloatArray,
-            transformedBufferIndex: Int,
-            transformedBufferTimeSize: Int,
-            transformedSliceTimeSize: Int,
-            bitmap: Bitmap
+            autoTriggerThresholdDb: Float,
+            amplitudeBitmap: Bitmap
         ): Int
 
         /**
@@ -96,22 +135,15 @@ class TransformStep(
          */
         private external fun cleanupFft()
 
-        /**
-         * Unwrap windows for SFFT from the raw data buffer, applying the window supplied.
-         */
-        private external fun unwrapSlices(
-            rawDataBuffer: ShortArray,
-            rawDataEntries: Int,
-            startIndex: Int,
-            windowCount: Int,
-            fftStride: Int,
-            window: FloatArray,
-            fftWindowSize: Int,
-            inputSliceBuffer: FloatArray
-        ): Int
-
         // Used to synchronize native layer access:
         private val dummySyncObject = String.toString()
+
+        fun createHannWindow(length: Int): FloatArray {
+            require(length > 0) { "Length must be positive" }
+            return FloatArray(length) { i ->
+                (0.5 * (1 - cos(2f * PI * i / (length - 1f)))).toFloat()
+            }
+        }
     }
 
     private val logTag = this::class.simpleName
@@ -127,10 +159,15 @@ class TransformStep(
             initializeStep()
         }
 
+    /**
+     * Transform only every columnStep'th window while this is more than 1, as for the
+     * coarse pass of a progressive render.
+     */
+    var columnStep = 1
+
     // This data class is immutable so no special thread safety is needed.
     data class StepData(
-        val fftWindow: FloatArray,
-        val inputSliceBuffer: FloatArray
+        val fftWindow: FloatArray
     ) {
         override fun equals(other: Any?): Boolean {
             if (this === other) return true
@@ -139,15 +176,12 @@ class TransformStep(
             other as StepData
 
             if (!fftWindow.contentEquals(other.fftWindow)) return false
-            if (!inputSliceBuffer.contentEquals(other.inputSliceBuffer)) return false
 
             return true
         }
 
         override fun hashCode(): Int {
-            var result = fftWindow.contentHashCode()
-            result = 31 * result + inputSliceBuffer.contentHashCode()
-            return result
+            return fftWindow.contentHashCode()
         }
     }
 
@@ -174,22 +208,17 @@ class TransformStep(
         val fftWindow = createHannWindow(safeParams.calcs.fftWindowSize)
         val calcs = safeParams.calcs
 
-        // Buffer that holds SFFT input data:
-        val unwrappedRawDataEntries = calcs.sliceTransformedTimeBucketCount * calcs.fftWindowSize
-        val inputSliceBuffer = FloatArray(unwrappedRawDataEntries + 1)   // +1 for canary.
-
         // TODO: revisit use of synchronized:
         synchronized(dummySyncObject) {
             initFftWindow = calcs.fftWindowSize
-            val rc = initFft(calcs.fftWindowSize)
+            val rc = initFft(calcs.fftWindowSize, calcs.fftStride, calcs.sliceTransformedTimeBucketCount)
             require(rc != -1) { "initFft failed" }
 
             _dataAssignedRange = null
         }
 
         stepData = StepData(
-            fftWindow = fftWindow,
-            inputSliceBuffer = inputSliceBuffer
+            fftWindow = fftWindow
         )
     }
 
@@ -227,14 +256,17 @@ class TransformStep(
         /**
          * Calculate the actual number of windows we will calculate.
          * The last slice is usually shorter than the others, so we have to use the actual number
-         * rather than the maximum as pre calculated.
+         * rather than the maximum as pre calculated. The range may also cover a run of
+         * several contiguous slices, which are transformed together.
          */
         val windowCount =
             if (sliceRange.second - sliceRange.first < calcs.fftWindowSize)
                 0
             else {
                 ((sliceRange.second - sliceRange.first) - calcs.fftWindowSize) / calcs.fftStride + 1; }
-        require(windowCount <= calcs.sliceTransformedTimeBucketCount) { "Internal error: two many windows to transform" }
+        require(transformedEntryIndex + windowCount <= calcs.transformedTimeBucketCount) {
+            "Internal error: two many windows to transform"
+        }
 
         if (windowCount > 0) {
 
@@ -242,23 +274,6 @@ class TransformStep(
                 Log.e(logTag, "FFT window size mismatch. Race condition? $windowCount != $initFftWindow")
             }
 
-            /**
-             * Unwrap the FFT windows and apply the window function. This is in C
-             * because it was excruciatingly slow in Kotlin. We ignore any data remaining
-             * at the end of the input buffer, which should be less than a window's worth.
-             */
-            val rc1 = unwrapSlices(
-                rawDataBuffer, calcs.rawPagedDataLength, sliceRange.first,
-                windowCount, calcs.fftStride,
-                windowData, calcs.fftWindowSize,
-                safeStepData.inputSliceBuffer
-            )
-            require(rc1 >= 0) { "unwrapSlices failed" }
-
-            /**
-             * Do the actual FFT.
-             */
-
             // Map the trigger frequency range from settings to a range of frequency buckets:
             var minTriggerBucket = round(model.settings.autoTriggerRangeMinkHz * 1000 / calcs.transformedFrequencyInterval).toInt()
             minTriggerBucket = minTriggerBucket.coerceIn(0, calcs.transformedFrequencyBucketCount - 1)
@@ -266,35 +281,36 @@ class TransformStep(
             maxTriggerBucket = maxTriggerBucket.coerceIn(0, calcs.transformedFrequencyBucketCount - 1)
             val autoTriggerThresholdDb = model.settings.autoTriggerThresholdDb
 
+            /**
+             * Unwrap the FFT windows, apply the window function, do the actual FFT and
+             * draw the amplitude, all in one native call. We ignore any data remaining
+             * at the end of the input range, which should be less than a window's worth.
+             */
             synchronized(dummySyncObject) {
-
-                val rc2 = doFft(
-                    windowCount, safeStepData.inputSliceBuffer,
-                    transformedDataBuffer,
-                    transformedEntryIndex * calcs.transformedFrequencyBucketCount,
-                    ColourMapStep.dbRangeMax.start,
-                    triggerResultBuffer,
-                    minTriggerBucket, maxTriggerBucket,
-                    autoTriggerThresholdDb
-                )
-
                 synchronized(amplitudeBitmapHolder) {
 
                     require(amplitudeBitmapHolder.bitmap != null) {
                         "Internal error, amplitude bitmap has not been allocated"
                     }
 
-                    val rc3 = doAmplitude(
-                        windowCount, calcs.fftWindowSize,
-                        safeStepData.inputSliceBuffer,
-                        transformedEntryIndex,
-                        calcs.transformedTimeBucketCount,
+                    val rc = doSlices(
+                        rawDataBuffer, calcs.rawPagedDataLength, sliceRange.first,
+                        windowCount, calcs.fftStride,
+                        windowData, calcs.fftWindowSize,
                         calcs.sliceTransformedTimeBucketCount,
+                        columnStep,
+                        transformedDataBuffer, transformedEntryIndex,
+                        ColourMapStep.dbRangeMax.start,
+                        triggerResultBuffer,
+                        minTriggerBucket, maxTriggerBucket,
+                        autoTriggerThresholdDb,
                         amplitudeBitmapHolder.bitmap!!
                     )
+                    require(rc == windowCount) { "doSlices failed: rc = $rc" }
+                    amplitudeBitmapHolder.publish(transformedEntryIndex, transformedEntryIndex + windowCount)
 
                     amplitudeBitmapHolder.cursorTime =
-                        (transformedEntryIndex + calcs.sliceTransformedTimeBucketCount) * calcs.transformedTimeInterval
+                        (transformedEntryIndex + windowCount) * calcs.transformedTimeInterval
                 }
             }
 
@@ -311,22 +327,29 @@ class TransformStep(
              * cares about.
              */
             val nextSliceRange = HORange(transformedEntryIndex, transformedEntryIndex + windowCount)
-            // Note the range in the transformed buffer that has been assigned values:
-            val dar = _dataAssignedRange
-            if (dar == null)
-                _dataAssignedRange = nextSliceRange
-            else {
-                _dataAssignedRange = HORange(
-                    minOf(dar.first, nextSliceRange.first),
-                    maxOf(dar.second, nextSliceRange.second)
-                )
-            }
-            // Log.d(logTag, "JM: transformed _dataAssignedRange = $_dataAssignedRange")
+            noteAssignedRange(nextSliceRange)
             if (nextSliceRange.second - nextSliceRange.first > 0)
                 nextStep.sliceRender(nextSliceRange)
         }
     }
 
+    /**
+     * Note a range in the transformed buffer that has been assigned values, whether by this
+     * step or by copying in a cached result.
+     */
+    fun noteAssignedRange(range: HORange) {
+        val dar = _dataAssignedRange
+        if (dar == null)
+            _dataAssignedRange = range
+        else {
+            _dataAssignedRange = HORange(
+                minOf(dar.first, range.first),
+                maxOf(dar.second, range.second)
+            )
+        }
+        // Log.d(logTag, "JM: transformed _dataAssignedRange = $_dataAssignedRange")
+    }
+
     private fun getSafeParams(): Params {
         val p = params
         require(p != null) { "params must be set before getSafeParams us called" }
@@ -338,13 +361,6 @@ class TransformStep(
         return stepData!!
     }
 
-    private fun createHannWindow(length: Int): FloatArray {
-        require(length > 0) { "Length must be positive" }
-        return FloatArray(length) { i ->
-            (0.5 * (1 - cos(2f * PI * i / (length - 1f)))).toFloat()
-        }
-    }
-
     /**
      * Call this method from a worker thread.
      */
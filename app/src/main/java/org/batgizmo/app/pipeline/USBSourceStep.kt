@@ -61,7 +61,7 @@ class USBSourceStep(
             try {
                 val safeParams = getSafeParams()
                 val calcs = safeParams.calcs
-                val rawDataSize = rangedRawDataBuffer.buffer.size - AbstractPipeline.CANARY_ENTRIES
+                val rawDataSize = rangedRawDataBuffer.size - AbstractPipeline.CANARY_ENTRIES
 
                 // We need to populate raw data up to this index to be ready to submit the
                 // next slice:
@@ -74,25 +74,24 @@ class USBSourceStep(
                 // the count of values we have from the start of the buffer:
                 var transformedDataBufferOffset = 0
 
+                // The real time duration of the new data in each slice, for the quality governor:
+                val sliceDataNs = (calcs.rawSliceEntries - calcs.rawSliceOverlap) * 1_000_000_000L /
+                        calcs.rawSampleRate
+
                 // The for statement will check if a cancel is pending, and if so pass control
                 // to the finally block for cleanup and to prevent this job becoming a zombie:
                 for (bufferDescriptor in LiveDataBridge.renderingChannel) {
                     if (rawDataSize > 0) {
-                        // Copy the native data into rawDataBuffer with wrap:
-                        val copiedCount = nativeUSB.copyURBBufferData(
-                            bufferDescriptor.nativeAddress,
-                            bufferDescriptor.samples,
-                            rangedRawDataBuffer.buffer,
-                            rawDataBufferOffset,
-                            rawDataSize
-                        )
-                        rawDataBufferOffset += copiedCount
-
-                        // Check the canary value:
-                        require(
-                            this@USBSourceStep.rangedRawDataBuffer.buffer[rawDataSize]
-                                    == AbstractPipeline.CANARY_VALUE
-                        )
+                        rawDataBufferOffset += copyBuffer(bufferDescriptor, rawDataBufferOffset, rawDataSize)
+
+                        // Take any further buffers that are already waiting too, so that a catch up
+                        // burst is rendered in one go. Stop at the end of the visible region, as
+                        // rendering will wrap there:
+                        while (rawDataBufferOffset < visibleBufferOffsetLimit(calcs)) {
+                            val waiting = LiveDataBridge.renderingChannel.tryReceive().getOrNull()
+                                ?: break
+                            rawDataBufferOffset += copyBuffer(waiting, rawDataBufferOffset, rawDataSize)
+                        }
 
                         /*
                         Here's what we need to do. Data is arriving in native buffers, we know how much
@@ -118,59 +117,33 @@ class USBSourceStep(
                         Any data left over after the last full slice is discarded - no fractional slices.
                     */
 
+                        /*
+                         * Gather all the slices that are ready into one contiguous run, and render
+                         * them together. A large URB or a catch up burst after a stall can make several
+                         * ready at once, and rendering them in one go means the fixed cost of each
+                         * render (the pipeline mutex, JNI calls and UI signals) is paid only once.
+                         */
+                        var runFirstIndex = 0
+                        var runTransformedOffset = 0
+                        var runSlices = 0
+
                         // Loop while there is enough data buffered to fill a slice:
                         while (rawDataBufferOffset >= nextSliceEndIndexHO) {
 
-                            /*
-                         * We have enough data to submit a slice to the pipeline.
-                         *
-                         * Beware that we are executing the pipeline slice calculation asynchronously here,
-                         * without any locking that would prevent contention with other pipeline execution
-                         * resulting from initial loading or the UI. Higher level application logic prevents
-                         * this happening. But perhaps this should be more rigorous, and invoke the slice
-                         * execution via the owning pipeline object, which would grab the pipeline mutex.
-                         *
-                         * We do the sliceRender call back in through the front door so that the pipeline
-                         * is locked versus any other pipeline requests, such as from the UI. That is OK
-                         * as we aren't holding any other locks at this point.
-                         */
-
-                            // Have the pipeline process the new slice:
+                            // The slice is ready, so add it to the run:
                             val sliceDataRange = HORange(
                                 nextSliceEndIndexHO - calcs.rawSliceEntries,
                                 nextSliceEndIndexHO
                             )
-
-                            // Keep track of the contiguous range raw data that we have populated:
-                            val dar = rangedRawDataBuffer.assignedRange
-                            if (dar == null) {
-                                // This is the first slice we've seen:
-                                rangedRawDataBuffer.assignedRange = sliceDataRange
-                            } else {
-                                // Extend the existing range to include the current range:
-                                rangedRawDataBuffer.assignedRange = HORange(
-                                    minOf(dar.first, sliceDataRange.first),
-                                    maxOf(dar.second, sliceDataRange.second)
-                                )
+                            if (runSlices == 0) {
+                                runFirstIndex = sliceDataRange.first
+                                runTransformedOffset = transformedDataBufferOffset
                             }
-                            // Log.d(logTag, "JM: new raw data _dataAssignedRange = ${rangedRawDataBuffer.assignedRange}")
-
-                            pipeline.sliceRender(sliceDataRange, transformedDataBufferOffset)
-
-                            // Render the slices to UI as we go:
-                            spectrogramBitmapHolder.signalUpdate()
-                            amplitudeBitmapHolder.signalUpdate()
+                            runSlices++
 
                             // Did we overlap the end of the visible region?
-                            val visibleBufferOffsetLimit =
-                                (rangedRawDataBuffer.buffer.size * model.timeVisibleRangeFlow.value.endInclusive)
-                                    .toInt()
-                                    .coerceIn(
-                                        calcs.rawSliceEntries,
-                                        rangedRawDataBuffer.buffer.size
-                                    )
                             val visibleRegionOverflow =
-                                nextSliceEndIndexHO > visibleBufferOffsetLimit
+                                nextSliceEndIndexHO > visibleBufferOffsetLimit(calcs)
 
                             // Increment allowing for slice overlap so that the slices result in transformed
                             // data at equal intervals:
@@ -179,13 +152,21 @@ class USBSourceStep(
 
                             /*
                             Wrap if we need to. There are two cases that need a wrap:
-                            * The slice we just rendered overlaps the end of the visible region,
+                            * The slice we just added overlaps the end of the visible region,
                             * OR, the next slice would overflow the end of the raw buffer.
                             Actually the second shouldn't arise, but we check for paranoia reasons.
+
+                            Either way, the run ends here as the next slice isn't contiguous with it.
                          */
 
                             // Would the next slice worth of data overlap the end of the visible region?
                             if (visibleRegionOverflow) {
+                                renderRun(
+                                    HORange(runFirstIndex, sliceDataRange.second),
+                                    runTransformedOffset, runSlices, sliceDataNs
+                                )
+                                runSlices = 0
+
                                 // Simplification - just discard surplus data at the end of the raw buffer
                                 // and reset. No one can tell if the start of the visible spectrogram exactly
                                 // picks up where it left off at the end.
@@ -195,6 +176,15 @@ class USBSourceStep(
                                 transformedDataBufferOffset = 0
                             }
                         }
+
+                        if (runSlices > 0) {
+                            val runEndIndex = nextSliceEndIndexHO -
+                                    (calcs.rawSliceEntries - calcs.rawSliceOverlap)
+                            renderRun(
+                                HORange(runFirstIndex, runEndIndex),
+                                runTransformedOffset, runSlices, sliceDataNs
+                            )
+                        }
                     }
                 }
             } finally {
@@ -203,6 +193,126 @@ class USBSourceStep(
         }
     }
 
+    /**
+     * Copy the native data for a buffer from the rendering channel into the raw data buffer
+     * with wrap, returning the number of samples copied.
+     */
+    private fun copyBuffer(
+        bufferDescriptor: LiveDataBridge.BufferDescriptor,
+        rawDataBufferOffset: Int,
+        rawDataSize: Int
+    ): Int {
+        LiveDataBridge.renderingBacklog.updateAndGet { maxOf(it - 1, 0) }
+
+        val copiedCount = nativeUSB.copyURBBufferData(
+            bufferDescriptor.nativeAddress,
+            bufferDescriptor.samples,
+            rangedRawDataBuffer.buffer,
+            rawDataBufferOffset,
+            rawDataSize
+        )
+
+        // Check the canary value:
+        require(rangedRawDataBuffer.canary == AbstractPipeline.CANARY_VALUE)
+
+        return copiedCount
+    }
+
+    /**
+     * The raw data buffer offset corresponding to the end of the visible region, where
+     * live rendering wraps back to the start.
+     */
+    private fun visibleBufferOffsetLimit(calcs: AbstractPipeline.CalculatedParams): Int {
+        return (rangedRawDataBuffer.size * model.timeVisibleRangeFlow.value.endInclusive)
+            .toInt()
+            .coerceIn(
+                calcs.rawSliceEntries,
+                rangedRawDataBuffer.size
+            )
+    }
+
+    /**
+     * The number of transformed columns rendered before rendering wraps, which is the width
+     * of the ring for a scrolling display. Rendering wraps after the first slice to end
+     * beyond the visible region.
+     */
+    private fun ringColumns(calcs: AbstractPipeline.CalculatedParams): Int {
+        val sliceStep = calcs.rawSliceEntries - calcs.rawSliceOverlap
+        val slices = (visibleBufferOffsetLimit(calcs) - calcs.rawSliceEntries) / sliceStep + 2
+        return slices * calcs.sliceTransformedTimeBucketCount
+    }
+
+    /**
+     * Render a contiguous run of one or more slices, whose raw data range is supplied,
+     * and signal the UI once for the lot.
+     */
+    private suspend fun renderRun(
+        runDataRange: HORange,
+        transformedDataBufferOffset: Int,
+        slices: Int,
+        sliceDataNs: Long
+    ) {
+        // Keep track of the contiguous range raw data that we have populated:
+        val dar = rangedRawDataBuffer.assignedRange
+        if (dar == null) {
+            // This is the first slice we've seen:
+            rangedRawDataBuffer.assignedRange = runDataRange
+        } else {
+            // Extend the existing range to include the current range:
+            rangedRawDataBuffer.assignedRange = HORange(
+                minOf(dar.first, runDataRange.first),
+                maxOf(dar.second, runDataRange.second)
+            )
+        }
+        // Log.d(logTag, "JM: new raw data _dataAssignedRange = ${rangedRawDataBuffer.assignedRange}")
+
+        /*
+         * Beware that we are executing the pipeline slice calculation asynchronously here,
+         * without any locking that would prevent contention with other pipeline execution
+         * resulting from initial loading or the UI. Higher level application logic prevents
+         * this happening. But perhaps this should be more rigorous, and invoke the slice
+         * execution via the owning pipeline object, which would grab the pipeline mutex.
+         *
+         * We do the sliceRender call back in through the front door so that the pipeline
+         * is locked versus any other pipeline requests, such as from the UI. That is OK
+         * as we aren't holding any other locks at this point.
+         */
+
+        // The run ends at the newest column, which a scrolling display draws last:
+        val safeParams = getSafeParams()
+        val ringHead = if (model.settings.scrollingLive)
+            transformedDataBufferOffset + slices * safeParams.calcs.sliceTransformedTimeBucketCount
+        else
+            -1
+        val ringColumns = ringColumns(safeParams.calcs)
+        for (holder in listOf(spectrogramBitmapHolder, amplitudeBitmapHolder)) {
+            synchronized(holder) {
+                holder.ringHead = ringHead
+                holder.ringColumns = ringColumns
+            }
+        }
+
+        // Have the pipeline process the new slices:
+        val renderStartNs = System.nanoTime()
+        pipeline.sliceRender(runDataRange, transformedDataBufferOffset)
+
+        // Let the governor step quality up or down to keep up with the data.
+        // A change rebuilds the pipeline, including the channel job:
+        if (QualityGovernor.update(
+                System.nanoTime() - renderStartNs,
+                slices * sliceDataNs,
+                LiveDataBridge.renderingBacklog.get(),
+                LiveDataBridge.renderingDropped.getAndSet(0)
+            )
+        ) {
+            model.onQualityLevelChange(QualityGovernor.level)
+        }
+
+        // Render the slices to UI as we go:
+        spectrogramBitmapHolder.signalUpdate()
+        amplitudeBitmapHolder.signalUpdate()
+    }
+
     override fun start() {
         channelJob?.cancel()        // Paranoia.
         channelJob = createChannelJob()
@@ -36,6 +36,7 @@ import android.media.AudioDeviceInfo
 import android.media.AudioManager
 import android.media.AudioManager.GET_DEVICES_OUTPUTS
 import android.os.Build
+import android.os.ParcelFileDescriptor
 import android.os.Parcelable
 import android.util.Base64
 import android.util.Log
@@ -59,8 +60,11 @@ import kotlinx.coroutines.sync.Mutex
 import kotlinx.coroutines.sync.withLock
 import kotlinx.coroutines.withContext
 import kotlinx.parcelize.Parcelize
+import org.batgizmo.app.Settings
 import org.batgizmo.app.UIModel
 import org.batgizmo.app.diagnosticLogger
+import java.io.File
+import java.io.IOException
 import java.nio.ByteBuffer
 import java.nio.ByteOrder
 
@@ -87,17 +91,21 @@ class NativeUSB {
         sampleRate: Int,
         maxPacketSize: Int
     ): Int
+    external fun streamSynthetic(sampleRate: Int, callsPerSecond: Float, speed: Float): Int
     external fun cancelStream()
     external fun pauseStream()
     external fun resumeStream()
     external fun startRecordingFd(fd: Int): Boolean
     external fun stopRecording()
+    external fun startURBCapture(fd: Int): Boolean
+    external fun stopURBCapture()
     external fun startAudio(audioDeviceId: Int, heterodynekHz: Int,
                             heterodyne2kHz: Int, audioBoostFactor: Int): Boolean
     external fun stopAudio()
     external fun setHeterodyne(heterodyne1kHz: Int, heterodyne2kHz: Int)
+    // The target is a direct buffer of 16 bit samples in native byte order:
     external fun copyURBBufferData(sourceOffset: Long, sourceSamples: Int,
-                                   targetBuffer: ShortArray, targetBufferOffset: Int, targetBufferSize: Int): Int
+                                   targetBuffer: ByteBuffer, targetBufferOffset: Int, targetBufferSize: Int): Int
 }
 
 class UsbService(private val context: Context,
@@ -110,6 +118,10 @@ class UsbService(private val context: Context,
         // The maximum multiple of 48kHz supported by full speed USB:
         const val MAX_SAMPLING_RATE = 384000
         const val MIN_SAMPLING_RATE = 44100
+
+        // Raw URBs are captured to this file in the app's external files directory, for
+        // replay off the device by tools/batgizmo-urb-replay:
+        const val URB_CAPTURE_FILE_NAME = "urb_capture.bgurb"
     }
 
     data class UsbConnectResult(
@@ -275,6 +287,12 @@ class UsbService(private val context: Context,
                     though, so I will wait for someone to ask for it.
                  */
 
+                // A synthetic source replaces the microphone entirely when enabled:
+                if (model.settings.syntheticSampleRate != Settings.SyntheticSourceOptions.SYNTHETIC_OFF.value) {
+                    startSyntheticStreaming(model.settings.syntheticSampleRate)
+                    return
+                }
+
                 // Select the first item if present, and request permission to access it:
                 val device = usbManager.deviceList.values.firstOrNull()
                 if (device == null) {
@@ -980,6 +998,9 @@ class UsbService(private val context: Context,
                     "Sampling rate of $actualSampleRate must be in the range $MIN_SAMPLING_RATE..$MAX_SAMPLING_RATE"
                 }
 
+                if (model.settings.captureURBs)
+                    startURBCapture()
+
                 // Run the audio streaming in a thread so the UI can remain responsive:
                 streamingThread = Thread( {
 
@@ -1002,6 +1023,42 @@ class UsbService(private val context: Context,
         return null
     }
 
+    /**
+     * Stream synthetic data in place of a microphone, for load testing at rates and call
+     * densities that real hardware can't provide. Success is signalled via the channel as
+     * for a real device.
+     */
+    private fun startSyntheticStreaming(sampleRate: Int) {
+        // In case it is already connected:
+        internalDisconnect()
+
+        val callsPerSecond = model.settings.syntheticCallsPerSecond.toFloat()
+        val speed = model.settings.syntheticSpeed.toFloat()
+        isConnected = true
+
+        streamingThread = Thread( {
+            val errno = nativeUsb.streamSynthetic(sampleRate, callsPerSecond, speed)
+            if (errno != 0) {
+                usbErrorChannel.trySend(UsbErrorResult(errno))
+            }
+            Log.i(logTag, "Synthetic streaming thread exiting with errno = $errno")
+        }, "data streaming")
+        streamingThread?.start()
+
+        val result = UsbConnectResult(
+            true,
+            deviceName = "synthetic",
+            productName = "Synthetic data ($callsPerSecond calls/s)",
+            sampleRate = sampleRate
+        )
+        diagnosticLogger.log {
+            "Connected to synthetic source: $result"
+        }
+        scope.launch(context=Dispatchers.Default) {
+            usbConnectChannel.send(result)
+        }
+    }
+
     private fun setEndpointSamplingRate(
         sampleRate: Int,
         it: UsbDeviceConnection,
@@ -1090,6 +1147,25 @@ class UsbService(private val context: Context,
         }
     }
 
+    /**
+     * Capture the raw URBs from the stream that is about to start. Capture ends when streaming
+     * ends. Any previous capture is overwritten.
+     */
+    private fun startURBCapture() {
+        val dir = context.getExternalFilesDir(null) ?: context.filesDir
+        val file = File(dir, URB_CAPTURE_FILE_NAME)
+        try {
+            val pfd = ParcelFileDescriptor.open(file,
+                ParcelFileDescriptor.MODE_CREATE or ParcelFileDescriptor.MODE_TRUNCATE
+                        or ParcelFileDescriptor.MODE_WRITE_ONLY)
+            // The native code takes ownership of the fd:
+            if (nativeUsb.startURBCapture(pfd.detachFd()))
+                Log.i(this::class.simpleName, "Capturing URBs to ${file.path}")
+        } catch (e: IOException) {
+            Log.w(this::class.simpleName, "Unable to capture URBs to ${file.path}: $e")
+        }
+    }
+
     suspend fun startRecording(fd: Int) {
         mutex.withLock {
             if (isConnected && ldRecordingState.value == RecordingState.OFF) {
@@ -25,11 +25,11 @@ package org.batgizmo.app.ui
 import androidx.compose.runtime.Composable
 import androidx.compose.runtime.MutableState
 import androidx.compose.ui.Modifier
-import org.batgizmo.app.HORange
+import org.batgizmo.app.LongHORange
 import org.batgizmo.app.UIModel
 import org.batgizmo.app.pipeline.AmplitudeRenderer
 
-class AmplitudeGraph(model: UIModel, rawPageRangeState: MutableState<HORange?>)
+class AmplitudeGraph(model: UIModel, rawPageRangeState: MutableState<LongHORange?>)
     : GraphBase(model, rawPageRangeState,
         model.timeAxisRangeFlow, model.amplitudeAxisRangeFlow, supportCursor = true) {
 
@@ -59,6 +59,7 @@ fun FileMetadata(context: Context, model: UIModel, onDismiss: () -> Unit) {
         entries.add(Pair("File name", (it.fileName ?: "(none)")))
         entries.add(Pair("Sample rate", "%.1f kHz".format(it.sampleRate / 1000f)))
         entries.add(Pair("Channels", "${it.numChannels}"))
+        entries.add(Pair("Sample format", "${it.bytesPerValue * 8} bit ${if (it.isFloat) "float" else "integer"}"))
         entries.add(Pair("Duration (s)", FileWriter.prettyFloat3Dps(it.lengthSeconds)))
         val guano = it.guanoChunkInfo
         if (guano != null) {
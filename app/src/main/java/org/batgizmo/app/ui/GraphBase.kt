@@ -50,7 +50,7 @@ import androidx.lifecycle.compose.collectAsStateWithLifecycle
 import kotlinx.coroutines.flow.StateFlow
 import kotlinx.parcelize.Parcelize
 import org.batgizmo.app.FloatRange
-import org.batgizmo.app.HORange
+import org.batgizmo.app.LongHORange
 import org.batgizmo.app.UIModel
 import org.batgizmo.app.pipeline.RendererBase
 
@@ -60,7 +60,7 @@ import org.batgizmo.app.pipeline.RendererBase
  */
 abstract class GraphBase(
     protected val model: UIModel,
-    protected val rawPageRangeState: MutableState<HORange?>,
+    protected val rawPageRangeState: MutableState<LongHORange?>,
     protected val xAxisRangeFlow: StateFlow<FloatRange>,
     protected val yAxisRangeFlow: StateFlow<FloatRange>,
     private val supportCursor: Boolean) {
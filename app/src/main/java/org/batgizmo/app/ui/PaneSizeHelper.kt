@@ -37,7 +37,7 @@ import androidx.compose.ui.unit.DpSize
 import androidx.compose.ui.unit.IntSize
 import kotlinx.coroutines.CoroutineScope
 import kotlinx.coroutines.launch
-import org.batgizmo.app.HORange
+import org.batgizmo.app.LongHORange
 import org.batgizmo.app.UIModel
 import uk.org.gimell.batgimzoapp.BuildConfig
 
@@ -67,7 +67,7 @@ class PaneSizeHelper {
     @Composable
     fun compose(
         model: UIModel, scope: CoroutineScope, showAmplitudePane: Boolean,
-        density: Density, rawPageRange: HORange?
+        density: Density, rawPageRange: LongHORange?
     ): Pair<(IntSize)->Unit, (IntSize)->Unit> {
         var configurationGeneration by rememberSaveable { mutableIntStateOf(0) }
         var lastConfigurationHash by rememberSaveable { mutableIntStateOf(0) }
@@ -58,6 +58,7 @@ import kotlinx.coroutines.launch
 import org.batgizmo.app.Settings
 import org.batgizmo.app.UIModel
 import org.batgizmo.app.diagnosticLogger
+import org.batgizmo.app.pipeline.TransformStep
 
 class SettingsUI(private val model: UIModel) {
 
@@ -228,6 +229,21 @@ class SettingsUI(private val model: UIModel) {
                 }
             }
 
+            item {
+                Row(verticalAlignment = Alignment.CenterVertically) {
+                    MyListSelector<Settings.MemoryBudgetOptions>(
+                        Settings.MemoryBudgetOptions.entries,
+                        "Memory budget",
+                        model.settings.memoryBudgetMb
+                    ) { value: Int ->
+                        // Signal the updated settings values:
+                        scope.launch {
+                            model.updateStoredSettings(model.settings.copy(memoryBudgetMb = value))
+                        }
+                    }
+                }
+            }
+
             item {
                 Row(verticalAlignment = Alignment.CenterVertically) {
                     MyListSelector<Settings.PagingOverlapOptions>(
@@ -243,6 +259,21 @@ class SettingsUI(private val model: UIModel) {
                 }
             }
 
+            item {
+                Row(verticalAlignment = Alignment.CenterVertically) {
+                    MyListSelector<Settings.FileChannelOptions>(
+                        Settings.FileChannelOptions.entries,
+                        "Multichannel file channel",
+                        model.settings.fileChannel
+                    ) { value: Int ->
+                        // Signal the updated settings values:
+                        scope.launch {
+                            model.updateStoredSettings(model.settings.copy(fileChannel = value))
+                        }
+                    }
+                }
+            }
+
             item {
                 Row(verticalAlignment = Alignment.CenterVertically) {
                     MyListSelector<Settings.NFftOptions>(
@@ -273,6 +304,63 @@ class SettingsUI(private val model: UIModel) {
                 }
             }
 
+            item {
+                Row(verticalAlignment = Alignment.CenterVertically) {
+
+                    MyCheckbox(
+                        "Adaptive quality when live", model.settings.adaptiveQuality
+                    ) { checked: Boolean ->
+                        // Lets the live display reduce overlap and window size on slow devices
+                        // rather than dropping data:
+                        scope.launch {
+                            model.updateStoredSettings(model.settings.copy(adaptiveQuality = checked))
+                        }
+                    }
+                }
+            }
+
+            item {
+                Row(verticalAlignment = Alignment.CenterVertically) {
+
+                    MyCheckbox(
+                        "Scrolling display when live", model.settings.scrollingLive
+                    ) { checked: Boolean ->
+                        // The newest data stays at the right hand edge, rather than the
+                        // display sweeping across and starting again at the left:
+                        scope.launch {
+                            model.updateStoredSettings(model.settings.copy(scrollingLive = checked))
+                        }
+                    }
+                }
+            }
+
+            item {
+                Row(verticalAlignment = Alignment.CenterVertically) {
+
+                    MyCheckbox(
+                        "Draw spectrogram natively", model.settings.nativeDisplay
+                    ) { checked: Boolean ->
+                        // Scales the spectrogram straight into the display's buffer rather
+                        // than through the GPU. Takes effect when the display is next created:
+                        scope.launch {
+                            model.updateStoredSettings(model.settings.copy(nativeDisplay = checked))
+                        }
+                    }
+                }
+            }
+
+            item {
+                Row(verticalAlignment = Alignment.CenterVertically) {
+                    // The FFT is tuned for this device as each window size and overlap is first
+                    // used. This forgets the results so that tuning happens again:
+                    Button(
+                        onClick = { TransformStep.retuneFft() }
+                    ) {
+                        Text("Re-tune FFT")
+                    }
+                }
+            }
+
             item {
                 HorizontalDivider(thickness = 2.dp)
                 Text("Recording")
@@ -413,6 +501,76 @@ class SettingsUI(private val model: UIModel) {
                 }
             }
 
+            item {
+                Row(verticalAlignment = Alignment.CenterVertically) {
+
+                    MyCheckbox(
+                        "Capture raw USB data for replay", model.settings.captureURBs
+                    ) { checked: Boolean ->
+                        // Takes effect when a microphone is next connected:
+                        scope.launch {
+                            model.updateStoredSettings(model.settings.copy(captureURBs = checked))
+                        }
+                    }
+                }
+            }
+
+            item {
+                Row(verticalAlignment = Alignment.CenterVertically) {
+
+                    MyCheckbox(
+                        "Show pipeline latency overlay", model.settings.showLatencyOverlay
+                    ) { checked: Boolean ->
+                        scope.launch {
+                            model.updateStoredSettings(model.settings.copy(showLatencyOverlay = checked))
+                        }
+                    }
+                }
+            }
+
+            item {
+                Row(verticalAlignment = Alignment.CenterVertically) {
+                    MyListSelector<Settings.SyntheticSourceOptions>(
+                        Settings.SyntheticSourceOptions.entries,
+                        "Synthetic data source",
+                        model.settings.syntheticSampleRate
+                    ) { value: Int ->
+                        // Takes effect when live mode is next entered:
+                        scope.launch {
+                            model.updateStoredSettings(model.settings.copy(syntheticSampleRate = value))
+                        }
+                    }
+                }
+            }
+
+            item {
+                Row(verticalAlignment = Alignment.CenterVertically) {
+                    MyListSelector<Settings.SyntheticDensityOptions>(
+                        Settings.SyntheticDensityOptions.entries,
+                        "Synthetic call density",
+                        model.settings.syntheticCallsPerSecond
+                    ) { value: Int ->
+                        scope.launch {
+                            model.updateStoredSettings(model.settings.copy(syntheticCallsPerSecond = value))
+                        }
+                    }
+                }
+            }
+
+            item {
+                Row(verticalAlignment = Alignment.CenterVertically) {
+                    MyListSelector<Settings.SyntheticSpeedOptions>(
+                        Settings.SyntheticSpeedOptions.entries,
+                        "Synthetic data speed",
+                        model.settings.syntheticSpeed
+                    ) { value: Int ->
+                        scope.launch {
+                            model.updateStoredSettings(model.settings.copy(syntheticSpeed = value))
+                        }
+                    }
+                }
+            }
+
             item {
                 Row(
                     verticalAlignment = Alignment.CenterVertically,
@@ -42,7 +42,7 @@ import kotlinx.coroutines.Dispatchers
 import kotlinx.coroutines.channels.Channel
 import kotlinx.coroutines.withContext
 import org.batgizmo.app.FloatRange
-import org.batgizmo.app.HORange
+import org.batgizmo.app.LongHORange
 import org.batgizmo.app.UIModel
 import uk.org.gimell.batgimzoapp.R
 
@@ -53,7 +53,7 @@ class Sliders {
     fun Compose(
         modifier: Modifier, model: UIModel,
         bnCRange: State<FloatRange>, enabled: Boolean,
-        rawPageRangeState: State<HORange?>
+        rawPageRangeState: State<LongHORange?>
     ) {
         // Get a coroutine scope linked to the Compose scope, using the main UI thread.
         val scope = rememberCoroutineScope()
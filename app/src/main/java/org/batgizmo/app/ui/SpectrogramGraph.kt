@@ -25,13 +25,13 @@ package org.batgizmo.app.ui
 import androidx.compose.runtime.Composable
 import androidx.compose.runtime.MutableState
 import androidx.compose.ui.Modifier
-import org.batgizmo.app.HORange
+import org.batgizmo.app.LongHORange
 import org.batgizmo.app.UIModel
 import org.batgizmo.app.pipeline.SpectrogramRenderer
 
 class SpectrogramGraph(
     model: UIModel,
-    rawPageRangeState: MutableState<HORange?>,
+    rawPageRangeState: MutableState<LongHORange?>,
 )
     : GraphBase(model, rawPageRangeState,
     model.timeAxisRangeFlow, model.frequencyAxisRangeFlow, supportCursor = false) {
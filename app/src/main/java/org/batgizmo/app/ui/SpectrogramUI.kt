@@ -74,6 +74,7 @@ import androidx.compose.material3.Text
 import androidx.compose.material3.TopAppBar
 import androidx.compose.material3.adaptive.currentWindowAdaptiveInfo
 import androidx.compose.runtime.Composable
+import androidx.compose.runtime.DisposableEffect
 import androidx.compose.runtime.LaunchedEffect
 import androidx.compose.runtime.MutableFloatState
 import androidx.compose.runtime.MutableIntState
@@ -105,24 +106,29 @@ import androidx.compose.ui.platform.LocalDensity
 import androidx.compose.ui.res.painterResource
 import androidx.compose.ui.res.vectorResource
 import androidx.compose.ui.text.TextStyle
+import androidx.compose.ui.text.font.FontFamily
 import androidx.compose.ui.text.style.TextOverflow
 import androidx.compose.ui.unit.IntOffset
 import androidx.compose.ui.unit.IntSize
+import androidx.compose.ui.unit.TextUnit
 import androidx.compose.ui.unit.dp
 import androidx.compose.ui.unit.sp
 import androidx.lifecycle.compose.collectAsStateWithLifecycle
 import androidx.window.core.layout.WindowHeightSizeClass
 import androidx.window.core.layout.WindowSizeClass
+import kotlinx.coroutines.delay
 import kotlinx.coroutines.flow.collectLatest
 import kotlinx.coroutines.launch
 import org.batgizmo.app.FileWriter
 import org.batgizmo.app.FileWriter.TriggerType
-import org.batgizmo.app.HORange
+import org.batgizmo.app.LongHORange
 import org.batgizmo.app.OpenWavFileResult
 import org.batgizmo.app.Settings
+import org.batgizmo.app.Telemetry
 import org.batgizmo.app.UIModel
 import org.batgizmo.app.diagnosticLogger
 import org.batgizmo.app.pipeline.AbstractPipeline
+import org.batgizmo.app.pipeline.NativeArena
 import org.batgizmo.app.pipeline.UsbService
 import org.batgizmo.app.ui.TopLevelUI.AppMode
 import uk.org.gimell.batgimzoapp.BuildConfig
@@ -200,7 +206,7 @@ class SpectrogramUI(
         val processingFlag: MutableState<Boolean> = mutableStateOf(false),
         val pagingState: MutableState<PagingStateHandler?> = mutableStateOf(null),
         val pagingEnabled: MutableState<Boolean> = mutableStateOf(false),
-        val rawPageRange: MutableState<HORange?> = mutableStateOf(null),
+        val rawPageRange: MutableState<LongHORange?> = mutableStateOf(null),
         val pageLeftEnabled: MutableState<Boolean> = mutableStateOf(false),
         val pageRightEnabled: MutableState<Boolean> = mutableStateOf(false),
         val liveMode: MutableIntState = mutableIntStateOf(LiveMode.OFF.value),
@@ -251,7 +257,7 @@ class SpectrogramUI(
     class PagingStateHandler(
         settings: Settings,
         private val pagingData: AbstractPipeline.PagingData,
-        private val rawPageRange: MutableState<HORange?>,
+        private val rawPageRange: MutableState<LongHORange?>,
         private val pagingEnabled: MutableState<Boolean>,
         private val pageRightEnabled: MutableState<Boolean>,
         private val pageLeftEnabled: MutableState<Boolean>
@@ -259,8 +265,8 @@ class SpectrogramUI(
         private data class Internals(
             val rawPageLength: Int,
             val stride: Int,
-            val totalPages: Int,
-            var currentPage: Int
+            val totalPages: Long,
+            var currentPage: Long
         )
 
         private val logTag = this::class.simpleName
@@ -277,13 +283,14 @@ class SpectrogramUI(
             val stride =
                 (rawPageLength.toFloat() * (1f - settings.pageOverlapPercent.toFloat() / 100f) + 0.5).toInt()
                     .coerceIn(1, rawPageLength)
+            // 64 bit: long recordings can exceed 2^31 samples.
             val totalPages = pagingData.rawTotalDataLength / stride + 1
 
             return Internals(
                 rawPageLength = rawPageLength,
                 stride = stride,
                 totalPages = totalPages,
-                currentPage = 0
+                currentPage = 0L
             )
         }
 
@@ -301,18 +308,18 @@ class SpectrogramUI(
             pageLeftEnabled.value = internals.currentPage > 0
         }
 
-        private fun setPage(newPage: Int) {
-            var result: HORange? = null
+        private fun setPage(newPage: Long) {
+            var result: LongHORange? = null
 
             if (newPage in 0..<internals.totalPages) {
 
                 // The last page has more overlap to avoid spilling off the end:
                 val endCorrection = maxOf(
-                    0,
+                    0L,
                     (newPage + 1) * internals.stride - pagingData.rawTotalDataLength
                 )
 
-                val start = maxOf(newPage * internals.stride - endCorrection, 0)
+                val start = maxOf(newPage * internals.stride - endCorrection, 0L)
                 var endExclusive = maxOf(start + internals.rawPageLength)
                 endExclusive = minOf(
                     endExclusive,
@@ -320,7 +327,7 @@ class SpectrogramUI(
                 )    // Don't overrun the end of data.
 
                 if (start >= 0) // Paranoia.
-                    result = HORange(start, endExclusive)
+                    result = LongHORange(start, endExclusive)
             }
 
             if (result != null) {
@@ -337,7 +344,7 @@ class SpectrogramUI(
 
         fun reset(settings: Settings) {
             internals = calcInternals(settings)
-            setPage(0)
+            setPage(0L)
         }
     }
 
@@ -751,6 +758,16 @@ class SpectrogramUI(
 
                     if (uiState.liveMode.intValue != LiveMode.OFF.value) {
                         MyLamp2(20.dp, colour)
+
+                        // Show when the live display has been degraded to keep up with the data:
+                        val qualityLevel by model.qualityLevelFlow.collectAsState()
+                        if (qualityLevel > 0) {
+                            Text(
+                                "  Quality -$qualityLevel",
+                                fontSize = textHeightSp,
+                                color = Color.Gray
+                            )
+                        }
                     }
 
                     Spacer(Modifier.weight(1f))
@@ -768,6 +785,10 @@ class SpectrogramUI(
 
                 }
 
+                if (model.settings.showLatencyOverlay) {
+                    ComposeLatencyOverlay(textHeightSp)
+                }
+
                 // Takes up excess vertical space:
                 Spacer(modifier = Modifier.weight(1f))
 
@@ -860,6 +881,39 @@ class SpectrogramUI(
        }
     }
 
+    /**
+     * Show the p50 and p99 latency of each pipeline stage, and the pipeline memory use,
+     * updated twice a second. Telemetry is only collected while this is shown.
+     */
+    @Composable
+    private fun ComposeLatencyOverlay(textHeightSp: TextUnit) {
+        val statsText = remember { mutableStateOf("") }
+
+        DisposableEffect(Unit) {
+            Telemetry.reset()
+            Telemetry.enable(true)
+            onDispose {
+                Telemetry.enable(false)
+            }
+        }
+
+        LaunchedEffect(Unit) {
+            while (true) {
+                statsText.value = Telemetry.statsText() + "\n" + NativeArena.statsText()
+                delay(500)
+            }
+        }
+
+        Text(
+            statsText.value,
+            style = TextStyle(
+                fontSize = textHeightSp,
+                fontFamily = FontFamily.Monospace,
+                color = Color.Gray
+            )
+        )
+    }
+
     @SuppressLint("UnusedBoxWithConstraintsScope")
     @Composable
     private fun ComposeHeterodyneCursor() {
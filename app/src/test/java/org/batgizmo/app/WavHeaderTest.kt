@@ -0,0 +1,74 @@
+/*
+ * Copyright (c) 2025 John Mears
+ *
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in all
+ * copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+ * AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+ * SOFTWARE.
+ */
+
+package org.batgizmo.app
+
+import org.junit.Assert.assertEquals
+import org.junit.Test
+import java.nio.ByteBuffer
+import java.nio.ByteOrder
+
+class WavHeaderTest {
+    private val guano = "GUANO|Version: 1.0\n".toByteArray(Charsets.UTF_8)
+
+    private fun text(header: ByteArray, offset: Int) = String(header, offset, 4, Charsets.US_ASCII)
+
+    @Test
+    fun smallFileHasClassicHeader() {
+        val entries = 384000L
+        val header = FileWriter.createWavHeaderWithGuano(entries, 384000, 16, guano)
+        val b = ByteBuffer.wrap(header).order(ByteOrder.LITTLE_ENDIAN)
+
+        assertEquals(44 + 8 + guano.size, header.size)
+        assertEquals("RIFF", text(header, 0))
+        assertEquals(entries * 2 + 36 + 8 + guano.size, b.getInt(4).toLong())
+        assertEquals("fmt ", text(header, 12))
+        assertEquals("data", text(header, header.size - 8))
+        assertEquals(entries * 2, b.getInt(header.size - 4).toLong())
+    }
+
+    @Test
+    fun fileOver4GiBHasRf64Header() {
+        // 5 GiB of 16 bit samples:
+        val entries = 5L * 1024 * 1024 * 1024 / 2
+        val header = FileWriter.createWavHeaderWithGuano(entries, 384000, 16, guano)
+        val b = ByteBuffer.wrap(header).order(ByteOrder.LITTLE_ENDIAN)
+
+        assertEquals(44 + 36 + 8 + guano.size, header.size)
+        assertEquals("RF64", text(header, 0))
+        assertEquals(-1, b.getInt(4))
+        assertEquals("WAVE", text(header, 8))
+
+        // The real sizes are in the ds64 chunk:
+        assertEquals("ds64", text(header, 12))
+        assertEquals(28, b.getInt(16))
+        assertEquals(entries * 2 + 36 + 8 + guano.size + 36, b.getLong(20))
+        assertEquals(entries * 2, b.getLong(28))
+        assertEquals(entries, b.getLong(36))
+        assertEquals(0, b.getInt(44))
+
+        assertEquals("fmt ", text(header, 48))
+        assertEquals(384000, b.getInt(60))
+        assertEquals("data", text(header, header.size - 8))
+        assertEquals(-1, b.getInt(header.size - 4))
+    }
+}